@@ -0,0 +1,381 @@
+// bench.c
+// End-to-end benchmark for the wipe binary. Creates sparse image files (and,
+// as root, loop devices over them), runs every wipe mode against each in
+// turn and reports throughput, CPU seconds per GB, peak RSS and how much a
+// verify pass adds, as CSV or JSON.
+// WARNING: only ever writes the files it creates under --dir.
+// Usage:
+//   ./bench [--bin ./a.out] [--dir DIR] [--sizes MB,...] [--chunks MB,...]
+//           [--engines sync,uring] [--threads N,...] [--qd N] [--modes M,...]
+//           [--targets file,loop] [--buffered] [--json] [--out FILE] [--log FILE]
+// Modes: clear, verify (clear + verify), pipeline (pipelined verify), purge
+// (three passes over a fully written image, swept one after the other),
+// purge-interleave (the same passes interleaved over regions), purge-verify,
+// smart (three-pass smart purge of a fully written image), smart-verify,
+// smart-sparse (smart purge of an image with a quarter of it written).
+// Example:
+//   sudo ./bench --sizes 256,1024 --chunks 4,16 --threads 1,4 --out bench.csv
+//   ./bench --targets file --modes clear,verify --json
+// Build:
+//   gcc -O2 -o bench bench.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <linux/fs.h>
+#include <linux/loop.h>
+
+#define MAX_LIST 16
+#define FILL_CHUNK (1024 * 1024)
+// The "smart-sparse" mode writes one FILL_CHUNK in every SPARSE_STRIDE.
+#define SPARSE_STRIDE (4ULL * 1024 * 1024)
+
+enum prefill { FILL_NONE, FILL_FULL, FILL_SPARSE };
+
+struct mode {
+    const char *name;
+    const char *cmd;        // wipe subcommand, or NULL for a full clear
+    const char *args[4];    // extra wipe options, NULL-terminated
+    enum prefill fill;
+    const char *base;       // mode whose time the verify overhead is relative to
+};
+
+static const struct mode modes[] = {
+    {"clear", NULL, {NULL}, FILL_NONE, NULL},
+    {"verify", NULL, {"--verify", NULL}, FILL_NONE, "clear"},
+    {"pipeline", NULL, {"--verify", "--pipeline", NULL}, FILL_NONE, "clear"},
+    {"purge", "purge", {"--order", "sweep", NULL}, FILL_FULL, NULL},
+    {"purge-interleave", "purge", {"--order", "interleave", NULL}, FILL_FULL, NULL},
+    {"purge-verify", "purge", {"--order", "sweep", "--verify", NULL}, FILL_FULL, "purge"},
+    {"smart", "smart", {NULL}, FILL_FULL, NULL},
+    {"smart-verify", "smart", {"--verify", NULL}, FILL_FULL, "smart"},
+    {"smart-sparse", "smart", {NULL}, FILL_SPARSE, NULL},
+};
+#define NMODES (int)(sizeof(modes) / sizeof(modes[0]))
+
+struct list {
+    unsigned v[MAX_LIST];
+    int n;
+};
+
+struct result {
+    int ok;
+    double seconds, cpu;
+    long rss_kb;
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int parse_list(const char *s, struct list *l, unsigned lo, unsigned hi) {
+    l->n = 0;
+    while (*s) {
+        char *end;
+        unsigned long v = strtoul(s, &end, 10);
+        if (end == s || v < lo || v > hi || l->n == MAX_LIST) return -1;
+        l->v[l->n++] = (unsigned)v;
+        s = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return -1;
+    }
+    return l->n ? 0 : -1;
+}
+
+// Whether name appears in a comma-separated list.
+static int in_list(const char *list, const char *name) {
+    size_t n = strlen(name);
+    for (const char *p = list; p && *p; ) {
+        const char *e = strchr(p, ',');
+        size_t l = e ? (size_t)(e - p) : strlen(p);
+        if (l == n && strncmp(p, name, n) == 0) return 1;
+        p = e ? e + 1 : NULL;
+    }
+    return 0;
+}
+
+// Attach a loop device over backing with autoclear set, so it goes away
+// once the returned descriptor (and any wipe holding it) is closed.
+static int loop_attach(const char *backing, char *dev, size_t n) {
+    int bfd = open(backing, O_RDWR);
+    if (bfd < 0) return -1;
+    for (int attempt = 0; attempt < 8; attempt++) {
+        int ctl = open("/dev/loop-control", O_RDWR);
+        if (ctl < 0) break;
+        int nr = ioctl(ctl, LOOP_CTL_GET_FREE);
+        close(ctl);
+        if (nr < 0) break;
+        snprintf(dev, n, "/dev/loop%d", nr);
+        int lfd = open(dev, O_RDWR);
+        if (lfd < 0) break;
+        if (ioctl(lfd, LOOP_SET_FD, bfd) != 0) {
+            close(lfd);
+            if (errno == EBUSY) continue;   // raced another user for it
+            break;
+        }
+        struct loop_info64 info;
+        memset(&info, 0, sizeof(info));
+        info.lo_flags = LO_FLAGS_AUTOCLEAR;
+        snprintf((char *)info.lo_file_name, sizeof(info.lo_file_name), "%.*s", LO_NAME_SIZE - 1, backing);
+        ioctl(lfd, LOOP_SET_STATUS64, &info);
+        close(bfd);
+        return lfd;
+    }
+    close(bfd);
+    return -1;
+}
+
+// Return the image to all holes, then write what the mode expects to find.
+static int prepare(const char *backing, const char *target, int loop_fd,
+                   unsigned long long size, enum prefill fill) {
+    int bfd = open(backing, O_RDWR);
+    if (bfd < 0) return -1;
+    int rc = ftruncate(bfd, 0) == 0 && ftruncate(bfd, (off_t)size) == 0 ? 0 : -1;
+    if (rc == 0 && fill != FILL_NONE) {
+        int fd = open(target, O_WRONLY);
+        char *buf = malloc(FILL_CHUNK);
+        if (fd < 0 || !buf) rc = -1;
+        unsigned long long x = 0x9E3779B97F4A7C15ULL;
+        unsigned long long step = fill == FILL_FULL ? FILL_CHUNK : SPARSE_STRIDE;
+        for (unsigned long long off = 0; rc == 0 && off < size; off += step) {
+            for (size_t i = 0; i < FILL_CHUNK; i += 8) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                memcpy(buf + i, &x, 8);
+            }
+            size_t len = size - off < FILL_CHUNK ? (size_t)(size - off) : FILL_CHUNK;
+            if (pwrite(fd, buf, len, (off_t)off) != (ssize_t)len) rc = -1;
+        }
+        if (rc == 0 && fsync(fd) != 0) rc = -1;
+        free(buf);
+        if (fd >= 0) close(fd);
+    }
+    // Start every run cold: nothing of the image left in the page cache.
+    fsync(bfd);
+    posix_fadvise(bfd, 0, 0, POSIX_FADV_DONTNEED);
+    close(bfd);
+    if (loop_fd >= 0) ioctl(loop_fd, BLKFLSBUF, 0);
+    return rc;
+}
+
+// Run the wipe binary with argv, answering its confirmation prompt, and
+// collect wall time and the child's resource usage.
+static int run(char *const *argv, int log_fd, struct result *r) {
+    int p[2];
+    if (pipe(p) != 0) return -1;
+    double t0 = now_seconds();
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(p[0]);
+        close(p[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        dup2(p[0], 0);
+        dup2(log_fd, 1);
+        dup2(log_fd, 2);
+        close(p[0]);
+        close(p[1]);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(p[0]);
+    if (write(p[1], "CONFIRM\n", 8) != 8) { /* the child reports the abort */ }
+    close(p[1]);
+
+    int status;
+    struct rusage ru;
+    while (wait4(pid, &status, 0, &ru) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    r->seconds = now_seconds() - t0;
+    r->cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    r->rss_kb = ru.ru_maxrss;
+    r->ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [--bin ./a.out] [--dir DIR] [--sizes MB,...] [--chunks MB,...]\n", prog);
+    printf("       [--engines sync,uring] [--threads N,...] [--qd N] [--modes M,...]\n");
+    printf("       [--targets file,loop] [--buffered] [--json] [--out FILE] [--log FILE]\n");
+    printf("  --bin FILE : wipe binary to measure (default ./a.out)\n");
+    printf("  --dir DIR  : where the sparse images are created (default .)\n");
+    printf("  --sizes    : image sizes in MB (default 256)\n");
+    printf("  --chunks   : request sizes in MB passed as --chunk (default 16)\n");
+    printf("  --engines  : I/O engines to compare (default sync,uring)\n");
+    printf("  --threads  : worker counts to compare (default 1,4)\n");
+    printf("  --qd N     : io_uring queue depth (default: the binary's)\n");
+    printf("  --modes    : any of clear,verify,pipeline,purge,purge-verify,smart (default all)\n");
+    printf("  --targets  : 'file' runs on the image itself, 'loop' on a loop device over it\n");
+    printf("             (default both when root, else file)\n");
+    printf("  --buffered : run without --direct\n");
+    printf("  --json     : emit a JSON array instead of CSV\n");
+    printf("  --out FILE : write the results there instead of stdout\n");
+    printf("  --log FILE : keep the wipe binary's output (default discarded)\n");
+}
+
+int main(int argc, char **argv) {
+    const char *bin = "./a.out", *dir = ".", *engines = "sync,uring", *mode_list = NULL;
+    const char *targets = geteuid() == 0 ? "file,loop" : "file";
+    const char *out_path = NULL, *log_path = "/dev/null";
+    const char *qd = NULL;
+    int json = 0, direct = 1;
+    struct list sizes, chunks, threads;
+    parse_list("256", &sizes, 1, 1024 * 1024);
+    parse_list("16", &chunks, 1, 256);
+    parse_list("1,4", &threads, 1, 256);
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        int bad = 0;
+        if (strcmp(a, "--json") == 0) json = 1;
+        else if (strcmp(a, "--buffered") == 0) direct = 0;
+        else if (!v) bad = 1;
+        else if (strcmp(a, "--bin") == 0) bin = argv[++i];
+        else if (strcmp(a, "--dir") == 0) dir = argv[++i];
+        else if (strcmp(a, "--engines") == 0) engines = argv[++i];
+        else if (strcmp(a, "--modes") == 0) mode_list = argv[++i];
+        else if (strcmp(a, "--targets") == 0) targets = argv[++i];
+        else if (strcmp(a, "--out") == 0) out_path = argv[++i];
+        else if (strcmp(a, "--log") == 0) log_path = argv[++i];
+        else if (strcmp(a, "--qd") == 0) qd = argv[++i];
+        else if (strcmp(a, "--sizes") == 0) bad = parse_list(argv[++i], &sizes, 1, 1024 * 1024) != 0;
+        else if (strcmp(a, "--chunks") == 0) bad = parse_list(argv[++i], &chunks, 1, 256) != 0;
+        else if (strcmp(a, "--threads") == 0) bad = parse_list(argv[++i], &threads, 1, 256) != 0;
+        else bad = 1;
+        if (bad) {
+            fprintf(stderr, "Bad or unknown option '%s'\n", a);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (access(bin, X_OK) != 0) {
+        fprintf(stderr, "%s is not executable; build it first or pass --bin\n", bin);
+        return 1;
+    }
+    if (in_list(targets, "loop") && geteuid() != 0) {
+        fprintf(stderr, "Loop devices need root; use --targets file\n");
+        return 1;
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    int log_fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (!out || log_fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", !out ? out_path : log_path, strerror(errno));
+        return 1;
+    }
+    if (json) fprintf(out, "[");
+    else fprintf(out, "target,size_mb,mode,engine,chunk_mb,threads,status,seconds,mb_s,cpu_s_per_gb,peak_rss_kb,verify_overhead_pct\n");
+    int rows = 0, failures = 0;
+
+    static const char *const kinds[] = {"file", "loop"};
+    for (int s = 0; s < sizes.n; s++) {
+        unsigned long long size = (unsigned long long)sizes.v[s] * 1024 * 1024;
+        char backing[512];
+        snprintf(backing, sizeof(backing), "%s/zt-bench-%u.img", dir, sizes.v[s]);
+        int bfd = open(backing, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (bfd < 0 || ftruncate(bfd, (off_t)size) != 0) {
+            fprintf(stderr, "Failed to create %s: %s\n", backing, strerror(errno));
+            return 1;
+        }
+        close(bfd);
+
+        for (int k = 0; k < 2; k++) {
+            if (!in_list(targets, kinds[k])) continue;
+            char target[512];
+            int loop_fd = -1;
+            if (k == 0) snprintf(target, sizeof(target), "%s", backing);
+            else if ((loop_fd = loop_attach(backing, target, sizeof(target))) < 0) {
+                fprintf(stderr, "Failed to attach a loop device to %s: %s\n", backing, strerror(errno));
+                failures++;
+                continue;
+            }
+
+            for (int c = 0; c < chunks.n; c++)
+            for (int t = 0; t < threads.n; t++)
+            for (const char *e = engines; e && *e; e = strchr(e, ',') ? strchr(e, ',') + 1 : NULL) {
+                char engine[16], chunk[16], nthreads[16];
+                snprintf(engine, sizeof(engine), "%.*s", (int)strcspn(e, ","), e);
+                snprintf(chunk, sizeof(chunk), "%u", chunks.v[c]);
+                snprintf(nthreads, sizeof(nthreads), "%u", threads.v[t]);
+                double seconds[NMODES] = {0};
+
+                for (int m = 0; m < NMODES; m++) {
+                    if (mode_list && !in_list(mode_list, modes[m].name)) continue;
+                    char journal[560];
+                    snprintf(journal, sizeof(journal), "%s.journal", backing);
+                    char *args[24];
+                    int na = 0;
+                    args[na++] = (char *)bin;
+                    if (modes[m].cmd) args[na++] = (char *)modes[m].cmd;
+                    args[na++] = target;
+                    if (direct) args[na++] = "--direct";
+                    args[na++] = "--engine";
+                    args[na++] = engine;
+                    args[na++] = "--chunk";
+                    args[na++] = chunk;
+                    args[na++] = "--threads";
+                    args[na++] = nthreads;
+                    if (qd) {
+                        args[na++] = "--qd";
+                        args[na++] = (char *)qd;
+                    }
+                    args[na++] = "--journal";
+                    args[na++] = journal;
+                    for (int x = 0; modes[m].args[x]; x++) args[na++] = (char *)modes[m].args[x];
+                    args[na] = NULL;
+
+                    fprintf(stderr, "%s %u MB %-16s %s, %s MB chunks, %s thread(s) ... ",
+                            kinds[k], sizes.v[s], modes[m].name, engine, chunk, nthreads);
+                    struct result r = {0};
+                    if (prepare(backing, target, loop_fd, size, modes[m].fill) != 0 ||
+                        run(args, log_fd, &r) != 0) {
+                        fprintf(stderr, "setup failed: %s\n", strerror(errno));
+                        failures++;
+                        continue;
+                    }
+                    if (!r.ok) failures++;
+                    seconds[m] = r.ok ? r.seconds : 0;
+                    double mb = size / (1024.0 * 1024.0), gb = mb / 1024.0;
+                    char ovh[32];
+                    snprintf(ovh, sizeof(ovh), json ? "null" : "");
+                    for (int b = 0; modes[m].base && b < NMODES; b++)
+                        if (strcmp(modes[b].name, modes[m].base) == 0 && seconds[b] > 0 && r.ok)
+                            snprintf(ovh, sizeof(ovh), "%.1f", (r.seconds - seconds[b]) / seconds[b] * 100.0);
+                    fprintf(stderr, "%s, %.1f MB/s\n", r.ok ? "ok" : "FAILED", mb / r.seconds);
+
+                    if (json)
+                        fprintf(out, "%s\n  {\"target\": \"%s\", \"size_mb\": %u, \"mode\": \"%s\", \"engine\": \"%s\", "
+                                "\"chunk_mb\": %s, \"threads\": %s, \"status\": \"%s\", \"seconds\": %.3f, \"mb_s\": %.1f, "
+                                "\"cpu_s_per_gb\": %.3f, \"peak_rss_kb\": %ld, \"verify_overhead_pct\": %s}",
+                                rows ? "," : "", kinds[k], sizes.v[s], modes[m].name, engine, chunk, nthreads,
+                                r.ok ? "ok" : "failed", r.seconds, mb / r.seconds, r.cpu / gb, r.rss_kb, ovh);
+                    else
+                        fprintf(out, "%s,%u,%s,%s,%s,%s,%s,%.3f,%.1f,%.3f,%ld,%s\n", kinds[k], sizes.v[s],
+                                modes[m].name, engine, chunk, nthreads, r.ok ? "ok" : "failed", r.seconds,
+                                mb / r.seconds, r.cpu / gb, r.rss_kb, ovh);
+                    fflush(out);
+                    rows++;
+                }
+            }
+            if (loop_fd >= 0) close(loop_fd);
+        }
+        unlink(backing);
+    }
+    if (json) fprintf(out, "\n]\n");
+    if (out != stdout) fclose(out);
+    close(log_fd);
+    fprintf(stderr, "%d run%s, %d failed\n", rows, rows == 1 ? "" : "s", failures);
+    return failures ? 1 : 0;
+}
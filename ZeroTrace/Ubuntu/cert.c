@@ -0,0 +1,197 @@
+// cert.c
+// Wipe certificate writer.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "cert.h"
+#include "../common/badrange.h"
+#include "../common/pattern.h"
+
+#define CERT_FORMAT 1
+
+// s as a JSON string; control characters become \u escapes.
+static void json_str(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void json_time(FILE *f, time_t t) {
+    struct tm tm;
+    char buf[32];
+    gmtime_r(&t, &tm);
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    json_str(f, buf);
+}
+
+static void device_json(FILE *f, const struct cert_device *d) {
+    fprintf(f, "    {\n      \"path\": ");
+    json_str(f, d->path);
+    fprintf(f, ",\n      \"model\": ");
+    json_str(f, d->model);
+    fprintf(f, ",\n      \"serial\": ");
+    json_str(f, d->serial);
+    fprintf(f, ",\n      \"size\": %llu,\n      \"logical_block\": %u,\n      \"physical_block\": %u,\n"
+               "      \"rotational\": %s,\n      \"transport\": ",
+            d->size, d->logical_block, d->physical_block, d->rotational ? "true" : "false");
+    json_str(f, d->transport);
+    fprintf(f, ",\n      \"io\": ");
+    if (d->engine) {
+        fprintf(f, "{\"engine\": \"%s\", \"depth\": %u, \"threads\": %u, \"chunk\": %zu, \"offload\": ",
+                d->engine, d->depth, d->threads, d->chunk);
+        if (d->offload) json_str(f, d->offload);
+        else fprintf(f, "null");
+        fprintf(f, "}");
+    } else {
+        fprintf(f, "null");
+    }
+    fprintf(f, ",\n      \"status\": ");
+    json_str(f, d->status ? d->status : "not started");
+    double mbps = d->seconds > 0 ? (d->written + d->verified) / (1024.0 * 1024.0) / d->seconds : 0;
+    fprintf(f, ",\n      \"written\": %llu,\n      \"verified\": %llu,\n      \"seconds\": %.3f,\n"
+               "      \"mb_per_s\": %.1f,\n      \"readback_digest\": ",
+            d->written, d->verified, d->seconds, mbps);
+    if (d->digested) {
+        char hex[2 * DIGEST_SIZE + 1];
+        digest_hex(d->digest, hex);
+        fprintf(f, "{\"algorithm\": \"BLAKE3\", \"bytes\": %llu, \"hex\": \"%s\"}", d->size, hex);
+    } else {
+        fprintf(f, "null");
+    }
+    fprintf(f, ",\n      \"sample\": ");
+    if (d->sampled) {
+        const struct sample_result *s = &d->sample;
+        char seed[2 * PATTERN_KEY_SIZE + 1];
+        pattern_key_hex(&s->seed, seed);
+        fprintf(f, "{\"random_blocks\": %llu, \"block_size\": %d, \"fixed_reads\": %llu, \"boundaries\": %llu, "
+                   "\"all_boundaries\": %llu, \"bytes\": %llu, \"seed\": \"%s\", \"bound99\": %.6g, "
+                   "\"confidence\": %.6g}",
+                s->random, SAMPLE_BLOCK, s->fixed, s->boundaries, s->all_boundaries, s->bytes, seed, s->bound99,
+                s->confidence);
+    } else {
+        fprintf(f, "null");
+    }
+    fprintf(f, ",\n      \"bad_ranges\": ");
+    bad_list_json(d->bad, f);
+    fprintf(f, "\n    }");
+}
+
+static int write_file(const char *path, const char *data, size_t len) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Could not create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    size_t n = fwrite(data, 1, len, f);
+    if (fclose(f) != 0 || n != len) {
+        fprintf(stderr, "Could not write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int cert_write(const char *path, const struct cert_run *run, const struct cert_device *dev, int n,
+               const unsigned char key[DIGEST_KEY_SIZE]) {
+    char *doc = NULL;
+    size_t len = 0;
+    FILE *f = open_memstream(&doc, &len);
+    if (!f) {
+        fprintf(stderr, "Out of memory for the certificate\n");
+        return -1;
+    }
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+
+    fprintf(f, "{\n  \"format\": %d,\n  \"tool\": \"zeroTraceVerified\",\n  \"host\": ", CERT_FORMAT);
+    json_str(f, host);
+    fprintf(f, ",\n  \"started\": ");
+    json_time(f, run->started);
+    fprintf(f, ",\n  \"finished\": ");
+    json_time(f, run->finished);
+    fprintf(f, ",\n  \"mode\": ");
+    json_str(f, run->mode);
+    fprintf(f, ",\n  \"passes\": ");
+    json_str(f, run->passes);
+    fprintf(f, ",\n  \"verify\": ");
+    json_str(f, run->verify);
+    fprintf(f, ",\n  \"direct_io\": %s,\n  \"engine\": ", run->direct ? "true" : "false");
+    json_str(f, run->engine);
+    fprintf(f, ",\n  \"queue_depth\": %u,\n  \"threads\": %u,\n  \"chunk\": %zu,\n  \"devices\": [\n",
+            run->depth, run->threads, run->chunk);
+    for (int i = 0; i < n; i++) {
+        device_json(f, &dev[i]);
+        fprintf(f, i + 1 < n ? ",\n" : "\n");
+    }
+    fprintf(f, "  ]\n}\n");
+    if (fclose(f) != 0) {
+        free(doc);
+        fprintf(stderr, "Out of memory for the certificate\n");
+        return -1;
+    }
+
+    int rc = write_file(path, doc, len);
+    if (rc == 0 && key) {
+        struct digest d;
+        unsigned char mac[DIGEST_SIZE];
+        char hex[2 * DIGEST_SIZE + 1];
+        digest_init_keyed(&d, key);
+        digest_update(&d, doc, len);
+        digest_final(&d, mac);
+        digest_hex(mac, hex);
+
+        char *sig = NULL, *line = NULL;
+        int ln = asprintf(&line, "%s  %s\n", hex, path);
+        if (asprintf(&sig, "%s.sig", path) < 0 || ln < 0) {
+            fprintf(stderr, "Out of memory for the certificate\n");
+            rc = -1;
+        } else {
+            rc = write_file(sig, line, (size_t)ln);
+        }
+        free(sig);
+        free(line);
+    }
+    free(doc);
+    return rc;
+}
+
+int cert_read_key(const char *path, unsigned char key[DIGEST_KEY_SIZE]) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char buf[160];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = 0;
+
+    const char *p = buf;
+    while (isspace((unsigned char)*p)) p++;
+    for (int i = 0; i < DIGEST_KEY_SIZE; i++) {
+        unsigned v;
+        if (!isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1]) || sscanf(p, "%2x", &v) != 1) {
+            fprintf(stderr, "%s must hold a %d-byte key as %d hex digits\n", path, DIGEST_KEY_SIZE,
+                    2 * DIGEST_KEY_SIZE);
+            return -1;
+        }
+        key[i] = (unsigned char)v;
+        p += 2;
+    }
+    while (isspace((unsigned char)*p)) p++;
+    if (*p) {
+        fprintf(stderr, "%s must hold a %d-byte key as %d hex digits\n", path, DIGEST_KEY_SIZE, 2 * DIGEST_KEY_SIZE);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+// cert.h
+// Wipe certificate for the Linux wiper: one JSON document per run naming
+// every device (model, serial, geometry), what was done to it (passes,
+// verification, timing, throughput), the bad ranges, and the BLAKE3 of
+// what the verify pass read back. With a key the document is also MACed
+// (keyed BLAKE3) into a detached FILE.sig in b3sum's output format, so
+// `xxd -r -p KEYFILE | b3sum --keyed FILE` reproduces it.
+
+#ifndef ZT_CERT_H
+#define ZT_CERT_H
+
+#include <time.h>
+
+#include "sample.h"
+#include "../common/digest.h"
+
+struct bad_list;
+
+struct cert_device {
+    const char *path;
+    char model[64];
+    char serial[128];
+    unsigned long long size;
+    unsigned logical_block, physical_block;
+    int rotational;
+    char transport[16];
+    const char *engine;                 // how it was written (NULL = not reached)
+    unsigned depth, threads;
+    size_t chunk;
+    const char *offload;                // kernel offload of the clear; NULL = written
+    const char *status;
+    unsigned long long written, verified;
+    double seconds;
+    int digested;                       // digest covers all of [0, size) as read back
+    unsigned char digest[DIGEST_SIZE];
+    int sampled;                        // verified by sample_verify; sample holds the outcome
+    struct sample_result sample;
+    struct bad_list *bad;
+};
+
+struct cert_run {
+    const char *mode;       // "FULL CLEAR", "SMART PURGE", ...
+    const char *passes;     // what was written, e.g. "1 (zeros)"
+    const char *verify;     // "full", "pipelined", "sampled" or "none"
+    const char *engine;
+    int direct;
+    unsigned depth, threads;
+    size_t chunk;
+    time_t started, finished;
+};
+
+// Write the certificate for n devices to path, and path.sig when key is
+// set. Returns 0, or -1 with the reason printed.
+int cert_write(const char *path, const struct cert_run *run, const struct cert_device *dev, int n,
+               const unsigned char key[DIGEST_KEY_SIZE]);
+
+// Parse 64 hex digits (surrounding whitespace allowed) from the file at
+// path. Returns 0, or -1 with the reason printed.
+int cert_read_key(const char *path, unsigned char key[DIGEST_KEY_SIZE]);
+
+#endif
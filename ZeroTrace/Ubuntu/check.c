@@ -0,0 +1,695 @@
+// check.c
+// Self-checks for the Linux wiper's building blocks, run against plain
+// files and images built by the real tools: filesystem maps on mkfs.ext4
+// images (4 KiB and 1 KiB blocks, meta_bg, 64-bit) compared block by block
+// with dumpe2fs, and on FAT images; the order in which plan.c issues sweep
+// and interleaved passes, and what an aborted interleaved run reports; the
+// offsets a checkpointed write hands the journal, and resuming from them;
+// and verify catching a wrong byte at its exact offset. Prints one line per
+// check and exits 1 if any failed. Checks whose tool is missing are
+// reported as skipped.
+// Usage:
+//   ./check [--dir DIR] [--keep]
+// Build:
+//   gcc -Wall -Wextra -O2 -pthread -o check check.c engine.c fsmap.c offload.c plan.c readback.c smart.c uring.c ../common/badrange.c ../common/buffers.c ../common/journal.c ../common/pattern.c ../common/progress.c ../common/latency.c ../common/memcheck.c ../common/cpu.c ../common/digest.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "engine.h"
+#include "fsmap.h"
+#include "plan.h"
+#include "smart.h"
+#include "../common/journal.h"
+#include "../common/pattern.h"
+
+#define MB (1024ULL * 1024)
+#define GRAIN 4096
+
+static int failed, passed, skipped;
+static char dir[256];
+
+static void result(int ok, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    printf("%s ", ok ? "ok  " : "FAIL");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+    if (ok) passed++;
+    else failed++;
+}
+
+static void skip(const char *what, const char *why) {
+    printf("skip %s: %s\n", what, why);
+    skipped++;
+}
+
+static int have_tool(const char *name) {
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "command -v %s >/dev/null 2>&1 || test -x /sbin/%s || test -x /usr/sbin/%s",
+             name, name, name);
+    return system(cmd) == 0;
+}
+
+static int run(const char *fmt, ...) {
+    char cmd[2048];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(cmd, sizeof(cmd), fmt, ap);
+    va_end(ap);
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+static void path_in(char *out, size_t n, const char *name) {
+    snprintf(out, n, "%s/%s", dir, name);
+}
+
+// A file of len bytes of `byte` (a hole when byte is 0).
+static int make_file(const char *path, unsigned long long len, unsigned char byte) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0 || ftruncate(fd, (off_t)len) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if (byte) {
+        static unsigned char buf[MB];
+        memset(buf, byte, sizeof(buf));
+        for (unsigned long long off = 0; off < len; off += sizeof(buf)) {
+            size_t l = len - off < sizeof(buf) ? (size_t)(len - off) : sizeof(buf);
+            if (pwrite(fd, buf, l, (off_t)off) != (ssize_t)l) {
+                close(fd);
+                return -1;
+            }
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+// Grains of m holding a non-zero byte of fd that m does not mark. Holes
+// are skipped, so sparse images of any size are cheap to walk.
+static unsigned long long unmarked_data(int fd, const struct dirty_map *m) {
+    static unsigned char buf[GRAIN];
+    unsigned long long missed = 0;
+    off_t end = lseek(fd, 0, SEEK_END), pos = 0;
+    while (pos < end) {
+        off_t data = lseek(fd, pos, SEEK_DATA);
+        if (data < 0) break;
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        for (off_t g = data / GRAIN * GRAIN; g < hole; g += GRAIN) {
+            ssize_t n = pread(fd, buf, GRAIN, g);
+            if (n <= 0) break;
+            for (ssize_t i = 0; i < n; i++) {
+                if (!buf[i]) continue;
+                if (!dirty_map_test(m, (unsigned long long)g / GRAIN)) missed++;
+                break;
+            }
+        }
+        pos = hole;
+    }
+    return missed;
+}
+
+// ---- fsmap: ext4 ----------------------------------------------------------
+
+// Files for mkfs.ext4 -d to put in the image: data the map must find.
+static int make_tree(const char *tree) {
+    char p[700];
+    if (mkdir(tree, 0700) != 0 && errno != EEXIST) return -1;
+    snprintf(p, sizeof(p), "%s/big", tree);
+    if (make_file(p, 3 * MB + 777, 0x5A) != 0) return -1;
+    snprintf(p, sizeof(p), "%s/small", tree);
+    if (make_file(p, 100, 0xA5) != 0) return -1;
+    snprintf(p, sizeof(p), "%s/sub", tree);
+    if (mkdir(p, 0700) != 0 && errno != EEXIST) return -1;
+    snprintf(p, sizeof(p), "%s/sub/mid", tree);
+    return make_file(p, 200 * 1024, 0x11);
+}
+
+// Free blocks per dumpe2fs: "  Free blocks: a-b, c, ..." for every group;
+// with bigalloc each number is the first block of a free cluster. Returns
+// the filesystem's block count and size, or 0 on failure.
+static unsigned long long dumpe2fs_free(const char *img, unsigned char **free_out, unsigned *bs_out) {
+    char cmd[700], line[65536];
+    snprintf(cmd, sizeof(cmd), "dumpe2fs %s 2>/dev/null", img);
+    FILE *f = popen(cmd, "r");
+    if (!f) return 0;
+    unsigned long long blocks = 0;
+    unsigned bs = 0, cs = 0;
+    unsigned char *fr = NULL;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "Block count: %llu", &blocks) == 1 || sscanf(line, "Block size: %u", &bs) == 1 ||
+            sscanf(line, "Cluster size: %u", &cs) == 1)
+            continue;
+        if (strncmp(line, "  Free blocks: ", 15) != 0 || !blocks) continue;
+        if (!fr && !(fr = calloc(blocks, 1))) break;
+        for (char *s = line + 15; *s && *s != '\n';) {
+            char *e;
+            unsigned long long a = strtoull(s, &e, 10), b = a;
+            if (e == s) break;
+            if (*e == '-') b = strtoull(e + 1, &e, 10);
+            if (bs && cs > bs) b += cs / bs - 1;
+            for (unsigned long long x = a; x <= b && x < blocks; x++) fr[x] = 1;
+            s = e;
+            while (*s == ',' || *s == ' ') s++;
+        }
+    }
+    pclose(f);
+    if (!fr || !bs) {
+        free(fr);
+        return 0;
+    }
+    *free_out = fr;
+    *bs_out = bs;
+    return blocks;
+}
+
+// Build an ext4 image with mkfs.ext4 and check the map against dumpe2fs:
+// every block in use (data, metadata, descriptor copies) lies in a marked
+// grain, and no grain made only of free blocks is marked.
+static void check_ext4(const char *name, const char *features, unsigned long long size_mb) {
+    char img[600], tree[600];
+    path_in(img, sizeof(img), name);
+    path_in(tree, sizeof(tree), "tree");
+    if (make_tree(tree) != 0 ||
+        run("mkfs.ext4 -q -F %s -d %s %s %lluM >/dev/null 2>&1", features, tree, img, size_mb) != 0) {
+        result(0, "fsmap %s: mkfs.ext4 %s failed", name, features);
+        return;
+    }
+    int fd = open(img, O_RDONLY | O_CLOEXEC);
+    struct dirty_map m;
+    struct fs_info fi;
+    unsigned long long size = size_mb * MB;
+    if (fd < 0 || dirty_map_init(&m, 0, size, GRAIN) != 0) {
+        result(0, "fsmap %s: cannot open the image", name);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    int rc = fsmap_build(fd, 0, &m, &fi);
+    if (rc != 0) {
+        result(0, "fsmap %s: fsmap_build returned %d", name, rc);
+    } else {
+        unsigned long long missed = unmarked_data(fd, &m);
+        result(missed == 0, "fsmap %s: every grain holding data is marked (%llu missed)", name, missed);
+
+        unsigned char *fr = NULL;
+        unsigned bs = 0;
+        unsigned long long blocks = dumpe2fs_free(img, &fr, &bs);
+        if (!blocks) {
+            skip(name, "dumpe2fs output unavailable");
+        } else {
+            unsigned long long used = 0, unmarked = 0, leaked = 0;
+            for (unsigned long long b = 0; b < blocks; b++) {
+                if (fr[b]) continue;
+                used++;
+                if (!dirty_map_test(&m, b * bs / GRAIN)) unmarked++;
+            }
+            unsigned long long per = bs < GRAIN ? GRAIN / bs : 1;
+            for (unsigned long long g = 0; g < m.ngrains && (g + 1) * per <= blocks; g++) {
+                int all_free = 1;
+                for (unsigned long long b = g * GRAIN / bs; b < (g + 1) * GRAIN / bs && all_free; b++)
+                    all_free = fr[b];
+                if (all_free && dirty_map_test(&m, g)) leaked++;
+            }
+            result(unmarked == 0 && leaked == 0 && fi.size == blocks * bs,
+                   "fsmap %s: %s, %llu of %llu blocks in use per dumpe2fs; %llu unmarked, %llu free grains marked",
+                   name, fi.type, used, blocks, unmarked, leaked);
+            free(fr);
+        }
+    }
+    dirty_map_free(&m);
+    close(fd);
+    if (rc == 0) unlink(img);
+}
+
+// ---- fsmap: FAT -------------------------------------------------------------
+
+static void put16(unsigned char *p, unsigned v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put32(unsigned char *p, unsigned v) {
+    put16(p, v & 0xFFFF);
+    put16(p + 2, v >> 16);
+}
+
+// A FAT16 image laid out by hand, so the answer is known exactly: 64 MB,
+// 8 KiB clusters, a file in clusters 2-4 and one in 10-11, a bad cluster
+// (20) and a free one (30) that both hold stale data.
+#define FAT_BPS 512
+#define FAT_SPC 16
+#define FAT_TOTAL (64 * 2048)
+#define FAT_SIZE 32
+#define FAT_ROOT 512
+
+static unsigned long long fat_cluster(unsigned c) {
+    unsigned data = 1 + 2 * FAT_SIZE + FAT_ROOT * 32 / FAT_BPS;
+    return ((unsigned long long)data + (unsigned long long)(c - 2) * FAT_SPC) * FAT_BPS;
+}
+
+static int make_fat16(const char *img) {
+    int fd = open(img, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    unsigned char bs[FAT_BPS], fat[FAT_SIZE * FAT_BPS], cl[FAT_SPC * FAT_BPS];
+    memset(bs, 0, sizeof(bs));
+    bs[0] = 0xEB;
+    bs[1] = 0x3C;
+    bs[2] = 0x90;
+    memcpy(bs + 3, "ZTCHECK ", 8);
+    put16(bs + 11, FAT_BPS);
+    bs[13] = FAT_SPC;
+    put16(bs + 14, 1);
+    bs[16] = 2;
+    put16(bs + 17, FAT_ROOT);
+    put16(bs + 19, 0);
+    bs[21] = 0xF8;
+    put16(bs + 22, FAT_SIZE);
+    put32(bs + 32, FAT_TOTAL);
+    bs[510] = 0x55;
+    bs[511] = 0xAA;
+
+    memset(fat, 0, sizeof(fat));
+    put16(fat, 0xFFF8);
+    put16(fat + 2, 0xFFFF);
+    put16(fat + 2 * 2, 3);
+    put16(fat + 3 * 2, 4);
+    put16(fat + 4 * 2, 0xFFFF);
+    put16(fat + 10 * 2, 11);
+    put16(fat + 11 * 2, 0xFFFF);
+    put16(fat + 20 * 2, 0xFFF7);
+
+    int rc = ftruncate(fd, (off_t)FAT_TOTAL * FAT_BPS) == 0 && pwrite(fd, bs, sizeof(bs), 0) == (ssize_t)sizeof(bs) &&
+             pwrite(fd, fat, sizeof(fat), FAT_BPS) == (ssize_t)sizeof(fat) &&
+             pwrite(fd, fat, sizeof(fat), FAT_BPS + sizeof(fat)) == (ssize_t)sizeof(fat) ? 0 : -1;
+    static const unsigned with_data[] = {2, 3, 4, 10, 11, 20, 30};
+    memset(cl, 0x77, sizeof(cl));
+    for (size_t i = 0; rc == 0 && i < sizeof(with_data) / sizeof(with_data[0]); i++)
+        if (pwrite(fd, cl, sizeof(cl), (off_t)fat_cluster(with_data[i])) != (ssize_t)sizeof(cl)) rc = -1;
+    close(fd);
+    return rc;
+}
+
+static int grains_marked(const struct dirty_map *m, unsigned long long off, unsigned long long len, int whole) {
+    unsigned long long g0 = whole ? (off + GRAIN - 1) / GRAIN : off / GRAIN;
+    unsigned long long g1 = whole ? (off + len) / GRAIN : (off + len + GRAIN - 1) / GRAIN;
+    int all = 1, any = 0;
+    for (unsigned long long g = g0; g < g1; g++) {
+        int d = dirty_map_test(m, g);
+        all &= d;
+        any |= d;
+    }
+    return whole ? any : all;
+}
+
+static void check_fat16(void) {
+    char img[600];
+    path_in(img, sizeof(img), "fat16.img");
+    if (make_fat16(img) != 0) {
+        result(0, "fsmap FAT16: cannot build the image");
+        return;
+    }
+    int fd = open(img, O_RDONLY | O_CLOEXEC);
+    struct dirty_map m;
+    struct fs_info fi;
+    if (fd < 0 || dirty_map_init(&m, 0, (unsigned long long)FAT_TOTAL * FAT_BPS, GRAIN) != 0) {
+        result(0, "fsmap FAT16: cannot open the image");
+        if (fd >= 0) close(fd);
+        return;
+    }
+    int rc = fsmap_build(fd, 0, &m, &fi);
+    unsigned long long cb = FAT_SPC * FAT_BPS;
+    int ok = rc == 0 && strcmp(fi.type, "FAT16") == 0 && fi.block == cb && fi.used == 5 * cb &&
+             grains_marked(&m, 0, fat_cluster(2), 0) &&
+             grains_marked(&m, fat_cluster(2), 3 * cb, 0) && grains_marked(&m, fat_cluster(10), 2 * cb, 0) &&
+             !grains_marked(&m, fat_cluster(20), cb, 1) && !grains_marked(&m, fat_cluster(30), cb, 1);
+    result(ok, "fsmap FAT16 (hand-built): metadata and clusters 2-4, 10-11 marked; bad and free clusters not (%s, %llu KB used)",
+           rc == 0 ? fi.type : "unmapped", rc == 0 ? fi.used / 1024 : 0);
+    if (rc == 0) {
+        // The stale clusters' grains, and nothing else, hold unmarked data.
+        unsigned long long want = 0;
+        static const unsigned stale[] = {20, 30};
+        for (int i = 0; i < 2; i++)
+            want += (fat_cluster(stale[i]) + cb + GRAIN - 1) / GRAIN - fat_cluster(stale[i]) / GRAIN;
+        unsigned long long missed = unmarked_data(fd, &m);
+        result(missed == want, "fsmap FAT16 (hand-built): only the stale bad and free clusters left unmarked (%llu grains)",
+               missed);
+    }
+    dirty_map_free(&m);
+    close(fd);
+    unlink(img);
+}
+
+// mkfs.fat's own layouts, FAT12 to FAT32: the map must cover everything the
+// tool wrote (boot sectors, FSInfo, both FATs, the root directory).
+static void check_mkfs_fat(const char *bits, unsigned long long size_mb) {
+    char img[600], what[64];
+    snprintf(what, sizeof(what), "mkfs.fat -F %s", bits);
+    if (!have_tool("mkfs.fat")) {
+        skip(what, "mkfs.fat not installed");
+        return;
+    }
+    path_in(img, sizeof(img), "fat.img");
+    unlink(img);
+    if (run("mkfs.fat -C -F %s %s %llu >/dev/null 2>&1", bits, img, size_mb * 1024) != 0) {
+        result(0, "fsmap %s: mkfs.fat failed", what);
+        return;
+    }
+    int fd = open(img, O_RDONLY | O_CLOEXEC);
+    struct dirty_map m;
+    struct fs_info fi;
+    if (fd < 0 || dirty_map_init(&m, 0, size_mb * MB, GRAIN) != 0) {
+        result(0, "fsmap %s: cannot open the image", what);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    int rc = fsmap_build(fd, 0, &m, &fi);
+    unsigned long long missed = rc == 0 ? unmarked_data(fd, &m) : 0;
+    result(rc == 0 && strncmp(fi.type, "FAT", 3) == 0 && missed == 0 && grains_marked(&m, 0, 512, 0),
+           "fsmap %s: %s, every grain holding data is marked (%llu missed)", what,
+           rc == 0 ? fi.type : "unmapped", missed);
+    dirty_map_free(&m);
+    close(fd);
+    unlink(img);
+}
+
+// ---- plan ordering ----------------------------------------------------------
+
+// A backend that records what it is asked to do instead of doing it. The
+// pass is told apart by its pattern: zeros (no pattern), 0xFF, random.
+struct call {
+    int verify, pass;
+    unsigned long long start, len;
+};
+
+static struct call calls[256];
+static int ncalls;
+static int fail_pass = -1;
+static unsigned long long fail_at = ~0ULL;
+
+static int pass_of(const struct wipe_io *io) {
+    return !io->pattern ? 0 : io->pattern->random ? 2 : 1;
+}
+
+static int record(const struct wipe_io *io, int verify, unsigned long long *done) {
+    if (ncalls < (int)(sizeof(calls) / sizeof(calls[0])))
+        calls[ncalls++] = (struct call){verify, pass_of(io), io->start, io->len};
+    *done = io->len;
+    if (!verify && pass_of(io) == fail_pass && io->start <= fail_at && fail_at < io->start + io->len) {
+        *done = fail_at - io->start;
+        return -1;
+    }
+    return 0;
+}
+
+static int rec_write(const struct wipe_backend *b, const struct wipe_io *io, unsigned long long *written) {
+    (void)b;
+    return record(io, 0, written);
+}
+
+static int rec_verify(const struct wipe_backend *b, const struct wipe_io *io, unsigned long long *verified) {
+    (void)b;
+    return record(io, 1, verified);
+}
+
+static const struct wipe_backend recorder = {"recorder", rec_write, rec_verify};
+
+static int run_plan(int fd, unsigned long long region, int verify, const struct extent *ext, long n,
+                    struct plan_result res[3]) {
+    struct pass_pattern passes[3];
+    memset(passes, 0, sizeof(passes));
+    passes[1].byte = 0xFF;
+    passes[2].random = 1;
+    struct wipe_plan plan = {.passes = passes, .npasses = 3, .ext = ext, .next = n, .verify = verify, .region = region};
+    struct wipe_io io = {.fd = fd, .start = 0, .len = 40 * MB, .chunk = MB};
+    struct wipe_io tail = io;
+    tail.len = 0;
+    ncalls = 0;
+    // plan_run prints its progress lines; they are not what is checked.
+    fflush(stdout);
+    int saved = dup(1), null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    dup2(null, 1);
+    int rc = plan_run(&plan, &recorder, &io, &tail, res);
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+    close(null);
+    return rc;
+}
+
+static void check_plan(void) {
+    char scratch[600];
+    path_in(scratch, sizeof(scratch), "plan.img");
+    int fd = open(scratch, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        result(0, "plan: cannot create %s", scratch);
+        return;
+    }
+    struct plan_result res[3];
+
+    // Sweep: each pass covers the whole range, read back before the next.
+    int rc = run_plan(fd, 0, 1, NULL, 0, res);
+    int ok = rc == 0 && ncalls == 6;
+    for (int i = 0; ok && i < 6; i++)
+        ok = calls[i].pass == i / 2 && calls[i].verify == i % 2 && calls[i].start == 0 && calls[i].len == 40 * MB;
+    result(ok, "plan sweep: write and verify each pass over the whole range, pass by pass (%d calls)", ncalls);
+
+    // Interleaved: every pass over a region, then the next region; the
+    // last region is short.
+    rc = run_plan(fd, 16 * MB, 1, NULL, 0, res);
+    static const unsigned long long lo[] = {0, 16 * MB, 32 * MB}, len[] = {16 * MB, 16 * MB, 8 * MB};
+    ok = rc == 0 && ncalls == 18;
+    for (int i = 0; ok && i < 18; i++) {
+        int r = i / 6, p = i % 6 / 2;
+        ok = calls[i].pass == p && calls[i].verify == i % 2 && calls[i].start == lo[r] && calls[i].len == len[r];
+    }
+    for (int p = 0; ok && p < 3; p++) ok = res[p].written == 40 * MB && res[p].verified == 40 * MB && res[p].verify == 0;
+    result(ok, "plan interleave: all passes over each 16 MB region in turn, each read back before the next (%d calls)",
+           ncalls);
+
+    // Interleaved over extents: only their parts inside each region.
+    static const struct extent ext[] = {{MB, 2 * MB}, {15 * MB, 3 * MB}, {33 * MB, MB}};
+    rc = run_plan(fd, 16 * MB, 0, ext, 3, res);
+    static const struct call want[] = {
+        {0, 0, MB, 2 * MB}, {0, 0, 15 * MB, MB}, {0, 1, MB, 2 * MB}, {0, 1, 15 * MB, MB},
+        {0, 2, MB, 2 * MB}, {0, 2, 15 * MB, MB}, {0, 0, 16 * MB, 2 * MB}, {0, 1, 16 * MB, 2 * MB},
+        {0, 2, 16 * MB, 2 * MB}, {0, 0, 33 * MB, MB}, {0, 1, 33 * MB, MB}, {0, 2, 33 * MB, MB},
+    };
+    ok = rc == 0 && ncalls == 12;
+    for (int i = 0; ok && i < 12; i++)
+        ok = calls[i].pass == want[i].pass && calls[i].start == want[i].start && calls[i].len == want[i].len;
+    result(ok, "plan interleave over extents: extents split at region boundaries (%d calls)", ncalls);
+
+    // A write failure in the second region stops the run; the passes it
+    // cut short are incomplete, not OK.
+    fail_pass = 1;
+    fail_at = 20 * MB;
+    rc = run_plan(fd, 16 * MB, 1, NULL, 0, res);
+    fail_pass = -1;
+    fail_at = ~0ULL;
+    ok = rc != 0 && res[0].write == PLAN_INCOMPLETE && res[1].write == -1 && res[2].write == PLAN_INCOMPLETE &&
+         res[0].verify == PLAN_NOT_RUN && res[1].verify == PLAN_NOT_RUN && res[0].written == 32 * MB &&
+         res[1].written == 20 * MB && res[2].written == 16 * MB && plan_status(res, 3) &&
+         strcmp(plan_status(res, 3), "write failed") == 0;
+    result(ok, "plan interleave abort: failed pass reported as failed, the others as incomplete (%s)",
+           plan_status(res, 3) ? plan_status(res, 3) : "no status");
+    close(fd);
+    unlink(scratch);
+}
+
+// ---- journal resume ---------------------------------------------------------
+
+struct durable_log {
+    struct journal *jr;
+    unsigned long long offsets[64];
+    int n, stop_after;
+    volatile int cancel;
+};
+
+static void on_durable(void *ctx, unsigned long long end) {
+    struct durable_log *d = ctx;
+    if (d->n < 64) d->offsets[d->n++] = end;
+    d->jr->offset = end;
+    journal_save(d->jr);
+    if (d->n == d->stop_after) d->cancel = 1;
+}
+
+// Bytes of [0, len) of path that do not hold `byte`, and the first of them.
+static unsigned long long wrong_bytes(const char *path, unsigned long long len, unsigned char byte,
+                                      unsigned long long *first) {
+    static unsigned char buf[MB];
+    unsigned long long wrong = 0;
+    *first = len;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return len;
+    for (unsigned long long off = 0; off < len; off += sizeof(buf)) {
+        size_t l = len - off < sizeof(buf) ? (size_t)(len - off) : sizeof(buf);
+        if (pread(fd, buf, l, (off_t)off) != (ssize_t)l) {
+            wrong += l;
+            continue;
+        }
+        for (size_t i = 0; i < l; i++) {
+            if (buf[i] == byte) continue;
+            if (!wrong) *first = off + i;
+            wrong++;
+        }
+    }
+    close(fd);
+    return wrong;
+}
+
+static void check_resume(enum io_engine engine) {
+    const char *en = engine_name(engine);
+    char target[600];
+    path_in(target, sizeof(target), "resume.img");
+    unsigned long long len = 32 * MB + 4096;
+    if (make_file(target, len, 0) != 0) {
+        result(0, "resume %s: cannot create %s", en, target);
+        return;
+    }
+    struct journal jr;
+    memset(&jr, 0, sizeof(jr));
+    path_in(jr.path, sizeof(jr.path), "resume.journal");
+    snprintf(jr.device, sizeof(jr.device), "resume.img");
+    snprintf(jr.serial, sizeof(jr.serial), "check");
+    jr.size = len;
+    jr.pass = 2;
+    jr.has_key = 1;
+    memset(jr.key.bytes, 0x3C, sizeof(jr.key.bytes));
+
+    struct pass_pattern ff;
+    memset(&ff, 0, sizeof(ff));
+    ff.byte = 0xFF;
+    struct durable_log d;
+    memset(&d, 0, sizeof(d));
+    d.jr = &jr;
+    d.stop_after = 3;
+    int fd = open(target, O_RDWR | O_CLOEXEC);
+    struct wipe_io io = {
+        .fd = fd, .start = 0, .len = len, .chunk = MB, .depth = 4, .threads = 1, .engine = engine,
+        .pattern = &ff, .cancel = &d.cancel, .checkpoint = 4 * MB, .on_durable = on_durable, .durable_ctx = &d,
+    };
+    unsigned long long w1 = 0;
+    int rc = fd >= 0 ? engine_write(&io, &w1) : -1;
+
+    // Checkpoints come at window ends, in order, and stop where the cancel did.
+    int ok = rc == ENGINE_CANCELLED && d.n >= 3;
+    for (int i = 0; ok && i < d.n; i++)
+        ok = d.offsets[i] % MB == 0 && (i == 0 || d.offsets[i] > d.offsets[i - 1]) && d.offsets[i] < len;
+    ok = ok && d.offsets[2] == 12 * MB && w1 == d.offsets[d.n - 1];
+    result(ok, "resume %s: checkpoints at 4 MB window ends, cancelled at %llu MB with %llu MB written", en,
+           d.n ? d.offsets[d.n - 1] / MB : 0, w1 / MB);
+
+    // The journal on disk holds the last of them, with the pass and key.
+    struct journal back;
+    memset(&back, 0, sizeof(back));
+    snprintf(back.path, sizeof(back.path), "%s", jr.path);
+    int lr = journal_load(&back);
+    ok = lr == 0 && back.offset == d.offsets[d.n - 1] && back.pass == 2 && back.has_key &&
+         memcmp(back.key.bytes, jr.key.bytes, sizeof(jr.key.bytes)) == 0 && journal_matches(&back, len, "check") &&
+         !journal_matches(&back, len + 512, "check") && !journal_matches(&back, len, "other");
+    result(ok, "resume %s: journal reloads offset %llu, pass and key, and matches only its own device", en,
+           back.offset);
+
+    // Everything below the offset is written; resuming there finishes the rest.
+    unsigned long long first;
+    unsigned long long below = wrong_bytes(target, back.offset, 0xFF, &first);
+    d.stop_after = -1;
+    d.cancel = 0;
+    io.start = back.offset;
+    io.len = len - back.offset;
+    unsigned long long w2 = 0;
+    rc = engine_write(&io, &w2);
+    unsigned long long wrong = wrong_bytes(target, len, 0xFF, &first);
+    result(below == 0 && rc == 0 && w2 == len - back.offset && wrong == 0 && jr.offset == len,
+           "resume %s: data below the checkpoint durable; resumed write covers the remaining %llu bytes (%llu wrong)",
+           en, w2, wrong);
+    if (fd >= 0) close(fd);
+    journal_remove(&jr);
+    unlink(target);
+}
+
+// ---- verify / read-back -----------------------------------------------------
+
+static void check_mismatch(enum io_engine engine, unsigned threads, int random) {
+    const char *en = engine_name(engine);
+    char target[600];
+    path_in(target, sizeof(target), "verify.img");
+    unsigned long long len = 16 * MB + 512;
+    struct pass_pattern pat;
+    memset(&pat, 0, sizeof(pat));
+    pat.byte = 0xFF;
+    pat.random = random;
+    memset(pat.key.bytes, 0x42, sizeof(pat.key.bytes));
+    int fd = make_file(target, len, 0) == 0 ? open(target, O_RDWR | O_CLOEXEC) : -1;
+    struct wipe_io io = {
+        .fd = fd, .start = 0, .len = len, .chunk = MB, .depth = 4, .threads = threads, .engine = engine,
+        .pattern = &pat,
+    };
+    unsigned long long n = 0, v = 0;
+    int wrc = fd >= 0 ? engine_write(&io, &n) : -1;
+    int clean = wrc == 0 ? engine_verify(&io, &v) : -1;
+
+    // One byte changed behind the engine's back, away from any boundary.
+    unsigned long long bad = 9 * MB + 12345;
+    unsigned char b = 0;
+    int poked = pread(fd, &b, 1, (off_t)bad) == 1 && (b ^= 0x01, pwrite(fd, &b, 1, (off_t)bad) == 1);
+    fsync(fd);
+    unsigned long long v2 = 0;
+    int vrc = poked ? engine_verify(&io, &v2) : -1;
+    result(wrc == 0 && clean == 0 && v == len && vrc == 1 && v2 == bad,
+           "verify %s, %u thread%s, %s: clean read-back passes; one flipped byte caught at offset %llu", en, threads,
+           threads == 1 ? "" : "s", random ? "random" : "0xFF", v2);
+    if (fd >= 0) close(fd);
+    unlink(target);
+}
+
+int main(int argc, char **argv) {
+    int keep = 0;
+    const char *base = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) base = argv[++i];
+        else if (strcmp(argv[i], "--keep") == 0) keep = 1;
+        else {
+            fprintf(stderr, "Usage: %s [--dir DIR] [--keep]\n", argv[0]);
+            return 2;
+        }
+    }
+    snprintf(dir, sizeof(dir), "%s/zt-check.XXXXXX", base ? base : "/tmp");
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "Cannot create a scratch directory under %s: %s\n", base ? base : "/tmp", strerror(errno));
+        return 2;
+    }
+
+    if (have_tool("mkfs.ext4")) {
+        check_ext4("ext4-4k.img", "-b 4096", 64);
+        check_ext4("ext4-1k.img", "-b 1024", 64);
+        check_ext4("ext4-metabg.img", "-b 1024 -O meta_bg,^resize_inode", 512);
+        check_ext4("ext4-metabg64.img", "-b 1024 -O 64bit,meta_bg,^resize_inode", 512);
+        check_ext4("ext4-bigalloc.img", "-b 4096 -O bigalloc -C 65536", 256);
+    } else {
+        skip("fsmap ext4", "mkfs.ext4 not installed");
+    }
+    check_fat16();
+    check_mkfs_fat("12", 8);
+    check_mkfs_fat("16", 64);
+    check_mkfs_fat("32", 256);
+    check_plan();
+    check_resume(ENGINE_SYNC);
+    check_resume(ENGINE_URING);
+    check_mismatch(ENGINE_SYNC, 1, 0);
+    check_mismatch(ENGINE_URING, 4, 0);
+    check_mismatch(ENGINE_URING, 2, 1);
+
+    if (!keep) run("rm -rf '%s'", dir);
+    printf("%d passed, %d failed, %d skipped\n", passed, failed, skipped);
+    return failed ? 1 : 0;
+}
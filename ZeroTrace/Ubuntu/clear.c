@@ -1,10 +1,44 @@
 // zeroTraceVerified_linux.c
 // WARNING: destructive. Run as root.
 // Usage:
-//   ./zeroTraceVerified /dev/sdX [--test] [--verify]
+//   ./zeroTraceVerified devices
+//   ./zeroTraceVerified [clear|purge|smart|verify] /dev/sdX [/dev/sdY ...]
+//                               [--test] [--verify] [--direct] [--engine sync|uring] [--qd N] [--threads N]
+//                               [--pipeline] [--lag MB] [--smart] [--grain KB]
+//                               [--fs] [--no-sweep] [--offload auto|zeroout|discard|secdiscard]
+//                               [--resume] [--journal FILE] [--autotune] [--retune] [--chunk MB]
+//                               [--progress-interval SEC] [--progress-fd N] [--prom FILE]
+//                               [--latency] [--heatmap-region MB] [--max-bad MB] [--bad-log FILE]
+//                               [--sample N] [--cert FILE] [--cert-key FILE]
+//                               [--order sweep|interleave] [--region MB] [--no-auto]
+//   ./zeroTraceVerified --files <path> [path ...] [--smart] [--keep] [--report FILE] [--threads N]
+//   ./zeroTraceVerified --free-space <dir> [--smart] [--reserve MB] [--slack] [--threads N]
 // Example:
+//   ./zeroTraceVerified devices
 //   ./zeroTraceVerified /dev/sdb --test
+//   ./zeroTraceVerified purge /dev/sdb --verify --direct
+//   ./zeroTraceVerified purge /dev/sdb --direct --order interleave --region 2048
+//   ./zeroTraceVerified verify /dev/sdb --direct --cert wipe.json
 //   ./zeroTraceVerified /dev/sdb --verify
+//   ./zeroTraceVerified /dev/sdb --verify --qd 16
+//   ./zeroTraceVerified /dev/sdb --verify --direct
+//   ./zeroTraceVerified /dev/nvme0n1 --direct --threads 4 --qd 8
+//   ./zeroTraceVerified /dev/sdb /dev/sdc /dev/sdd --verify --direct
+//   ./zeroTraceVerified /dev/nvme0n1 --verify --direct --pipeline --lag 2048
+//   ./zeroTraceVerified /dev/sdb --smart --verify --direct
+//   ./zeroTraceVerified /dev/sdb1 --fs --verify --direct
+//   ./zeroTraceVerified /dev/nvme0n1 --offload auto --verify --direct
+//   ./zeroTraceVerified /dev/sdb --verify --direct --resume
+//   ./zeroTraceVerified /dev/nvme0n1 --direct --autotune
+//   ./zeroTraceVerified /dev/sdb /dev/sdc --direct --progress-fd 3 --prom /var/lib/node_exporter/zerotrace.prom 3>progress.jsonl
+//   ./zeroTraceVerified /dev/sdb --verify --direct --bad-log badranges.txt
+//   ./zeroTraceVerified /dev/sdb --direct --sample 4603
+//   ./zeroTraceVerified /dev/sdb /dev/sdc --verify --direct --cert wipe.json --cert-key site.key
+//   ./zeroTraceVerified /dev/sdb --verify --direct --latency --heatmap-region 256   (kill -USR1 for a report mid-run)
+//   ./zeroTraceVerified --files /srv/exports/customer42 --smart --report shred.tsv
+//   ./zeroTraceVerified --free-space /srv --reserve 2048 --slack
+// Build:
+//   gcc -O2 -pthread -o a.out clear.c cert.c device.c engine.c freespace.c fsmap.c offload.c plan.c readback.c sample.c shred.c smart.c topology.c tune.c uring.c ../common/badrange.c ../common/buffers.c ../common/digest.c ../common/journal.c ../common/pattern.c ../common/progress.c ../common/latency.c ../common/memcheck.c ../common/cpu.c
 
 #define _GNU_SOURCE
 #include <stdio.h>
@@ -13,135 +47,1629 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/ioctl.h>
 #include <linux/fs.h>
 #include <sys/stat.h>
 
+#include "cert.h"
+#include "device.h"
+#include "engine.h"
+#include "freespace.h"
+#include "fsmap.h"
+#include "offload.h"
+#include "plan.h"
+#include "readback.h"
+#include "sample.h"
+#include "shred.h"
+#include "smart.h"
+#include "topology.h"
+#include "tune.h"
+#include "../common/badrange.h"
+#include "../common/buffers.h"
+#include "../common/journal.h"
+#include "../common/latency.h"
+#include "../common/memcheck.h"
+#include "../common/pattern.h"
+#include "../common/progress.h"
+
 #define BUF_SIZE (16ULL * 1024 * 1024)
+#define DEFAULT_QD 4
+// Direct I/O drops O_SYNC; instead the written range is made durable with
+// fdatasync every BARRIER_BYTES and once more at the end.
+#define BARRIER_BYTES (1024ULL * 1024 * 1024)
+#define MAX_DEVICES 64
+// How far the pipelined verifier trails the writer by default.
+#define DEFAULT_LAG_MB 1024
+#define DEFAULT_PROGRESS_SECONDS 2.0
+// Latency heatmap: bytes of the device per cell.
+#define DEFAULT_HEATMAP_REGION_MB 1024
+// A device with more bad bytes than this is given up on rather than
+// bisected sector by sector to the end.
+#define DEFAULT_MAX_BAD_MB 256
+// Smart purge: dirty-map granularity, and the clean gap between two dirty
+// runs that is written through on rotational disks, where a seek costs more
+// than the bytes. Solid-state media only coalesce runs that touch.
+#define DEFAULT_GRAIN_KB 64
+#define ROTATIONAL_MERGE_GAP (4ULL * 1024 * 1024)
+#define SMART_PASSES 3
+// --order interleave: region every pass covers before the next region.
+// Larger than the write cache of any drive we expect, so a pass is on the
+// medium before the next one overwrites it.
+#define DEFAULT_REGION_MB 1024
+// Offload: bytes per ioctl, and how many are in flight unless --threads says
+// otherwise. The kernel splits each range into requests the device accepts.
+#define OFFLOAD_RANGE (256ULL * 1024 * 1024)
+#define OFFLOAD_THREADS 4
+// Journal checkpoint interval when writes are O_SYNC (direct I/O uses the
+// barrier interval).
+#define CHECKPOINT_BYTES (1024ULL * 1024 * 1024)
+// Autotune: how much of the start of the device the probes write, and for
+// how long each setting runs.
+#define TUNE_REGION (1024ULL * 1024 * 1024)
+#define TUNE_SECONDS 0.4
+// --files: walking and writing threads unless --threads says otherwise.
+#define SHRED_THREADS 8
+// --free-space: fillers written at once, and the free space left to
+// other processes, unless --threads and --reserve say otherwise.
+#define FILL_THREADS 4
+#define DEFAULT_RESERVE_MB 256
+
+// Options shared by every device in one run.
+struct wipe_opts {
+    int testMode, verifyMode, directMode, pipelineMode, smartMode;
+    int fsMode, sweep;       // filesystem-aware order; sweep the free space after
+    enum offload_kind offload;
+    int resume;
+    const char *journalPath; // NULL = derived from the device's serial
+    int autotune;            // 1 = probe unless cached, 2 = always probe
+    unsigned long long lag;  // bytes between writer and pipelined verifier
+    size_t grain;            // smart purge dirty-map granularity
+    enum io_engine engine;
+    unsigned qd;
+    unsigned threads;
+    size_t chunk;           // bytes per request
+    double progressInterval;
+    int progressFd;         // JSON progress lines; -1 = none
+    const char *promPath;   // Prometheus textfile; NULL = none
+    int latency;            // time every request; report at the end and on SIGUSR1
+    unsigned long long heatmapRegion;
+    unsigned long long maxBad;  // bytes of bad sectors tolerated per device
+    const char *badLog;         // bad ranges of every device are appended here; NULL = none
+    unsigned long long sample;  // verify this many random blocks instead of everything (0 = all)
+    const char *certPath;       // wipe certificate written at the end; NULL = none
+    const unsigned char *certKey; // MAC key for the certificate; NULL = unsigned
+    int purgeMode;              // the smart passes over the whole device
+    unsigned long long region;  // purge and smart: interleave the passes over regions this large (0 = sweeps)
+    int verifyOnly;             // read back and check, write nothing
+    int filesMode;              // the paths are files and directories to shred, not devices
+    int keep;                   // --files: overwrite only, remove nothing
+    const char *reportPath;     // --files: one line per entry; NULL = problems only
+    int freeSpaceMode;          // the path is a mounted filesystem whose free space is wiped
+    unsigned long long reserve; // --free-space: bytes left free for other processes
+    int slack;                  // --free-space: also the slack after EOF of quiet files
+    int mediaPolicy;            // take what the options below leave open from each device's topology
+    int engineGiven, qdGiven, chunkGiven, threadsGiven;
+};
+
+// One device being wiped. Several run concurrently, one thread each.
+struct wipe_job {
+    pthread_t tid;
+    const char *path;
+    const struct wipe_opts *opts;
+    char tag[80];           // "[/dev/sdb] " when wiping several devices
+    unsigned long long size;
+    unsigned long long written;
+    unsigned long long verified;
+    double seconds;
+    const char *status;     // NULL while running, then "OK" or a failure reason
+    struct progress_job *progress;
+    struct lat_log *lat;    // NULL unless --latency
+    struct bad_list *bad;   // sectors given up on
+    struct cert_device cert; // identity, read-back digest and sample for --cert
+};
+
+// Every job, for the SIGUSR1 latency dump; report_lock keeps one report's
+// lines together and the logs alive while they are read.
+static struct wipe_job *all_jobs;
+static int all_jobs_count;
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void usage(const char *prog) {
-    printf("Usage: %s <device> [--test] [--verify]\n", prog);
+    printf("Usage: %s devices\n", prog);
+    printf("       %s [clear|purge|smart|verify] <device> [device ...] [--test] [--verify] [--direct]\n", prog);
+    printf("       [--engine sync|uring] [--qd N] [--threads N] [--no-auto]\n");
+    printf("       [--pipeline] [--lag MB] [--smart] [--grain KB] [--fs] [--no-sweep]\n");
     printf("Example: %s /dev/sdb --test\n", prog);
+    printf("  devices  : list the disks found in sysfs (media, bus, model, serial, whether in use)\n");
+    printf("             and the policy each would get; writes nothing\n");
+    printf("  clear    : one zero pass over the whole device (the default)\n");
+    printf("  purge    : three passes (0x00, 0xFF, random) over the whole device, each read back\n");
+    printf("             before the next with --verify\n");
+    printf("  smart    : the same as --smart\n");
+    printf("  --order sweep|interleave : for purge and smart. 'sweep' (default) writes each pass\n");
+    printf("             over the whole device before the next; 'interleave' writes every pass\n");
+    printf("             over one region, with one fdatasync after each, before moving on\n");
+    printf("  --region MB : interleave region, larger than the drive's cache (default %d)\n", DEFAULT_REGION_MB);
+    printf("  verify   : write nothing; read the device back and check it is all zeros, as a\n");
+    printf("             clear would (--sample and --cert apply)\n");
+    printf("  files, free-space : the same as --files and --free-space\n");
     printf("  --test   : write a single BUF_SIZE chunk (dry run)\n");
     printf("  --verify : after overwrite, read back entire device and confirm all bytes are zero (slow)\n");
+    printf("  --direct : O_DIRECT writes and reads, aligned to the device sector size. Verification\n");
+    printf("             then reads the medium rather than the page cache.\n");
+    printf("  --engine : I/O engine. 'uring' (default) keeps several requests in flight;\n");
+    printf("             'sync' issues one blocking pwrite at a time. Falls back to sync\n");
+    printf("             automatically when io_uring is unavailable.\n");
+    printf("  --qd N   : io_uring queue depth per thread (default %d)\n", DEFAULT_QD);
+    printf("  --threads N : split the device into interleaved chunk-sized stripes shared by N\n");
+    printf("             worker threads, for both overwrite and verify (default 1)\n");
+    printf("  --pipeline : with --verify, verify while writing. A verifier re-reads each window\n");
+    printf("             once it is durable while the writer moves ahead, instead of a second\n");
+    printf("             full pass afterwards. Throttled automatically on rotational disks.\n");
+    printf("  --lag MB : pipeline window; the verifier trails the writer by this much (default %d)\n", DEFAULT_LAG_MB);
+    printf("  --smart  : smart purge. Scan the device first and report how much of it holds data,\n");
+    printf("             then overwrite only those parts with three passes (0x00, 0xFF, random),\n");
+    printf("             coalesced into long sequential writes. With --verify every pass is read\n");
+    printf("             back; with --test only the scan and report are done.\n");
+    printf("  --grain KB : smart purge granularity, a power of two from 4 to 1024 (default %d)\n", DEFAULT_GRAIN_KB);
+    printf("  --fs     : read the ext2/3/4 or FAT filesystem on the device (unmounted) and overwrite\n");
+    printf("             its allocated blocks and metadata first, then sweep the rest. With --smart\n");
+    printf("             the allocation map replaces the scan.\n");
+    printf("  --no-sweep : with --fs, stop once the allocated blocks and metadata are overwritten\n");
+    printf("  --offload K : let the kernel clear the device in %llu MB ranges, %d at a time (or\n", OFFLOAD_RANGE / (1024 * 1024), OFFLOAD_THREADS);
+    printf("             --threads): 'zeroout' (BLKZEROOUT), 'discard' (BLKDISCARD), 'secdiscard'\n");
+    printf("             (BLKSECDISCARD), or 'auto' (zeroout when the device advertises write-zeroes).\n");
+    printf("             Rejected ranges are written normally. Discarded blocks need not read back\n");
+    printf("             as zero on every device; --verify checks.\n");
+    printf("  --resume : continue an interrupted wipe from the last durable checkpoint in its journal.\n");
+    printf("             Full clears keep the journal (zerotrace-<serial>.journal in the current\n");
+    printf("             directory) up to date at every barrier; Ctrl-C or SIGTERM stops at a checkpoint.\n");
+    printf("  --journal FILE : journal location (one device only)\n");
+    printf("  --chunk MB : bytes per write and read request, 1 to 256 (default %llu)\n", BUF_SIZE / (1024 * 1024));
+    printf("  --progress-interval SEC : how often progress is reported (default %.0f)\n", DEFAULT_PROGRESS_SECONDS);
+    printf("  --progress-fd N : also write progress as one JSON object per device per interval\n");
+    printf("             to file descriptor N (bytes done, MB/s now and smoothed, pass, ETA)\n");
+    printf("  --prom FILE : keep a Prometheus textfile with the same figures for every device,\n");
+    printf("             replaced atomically each interval (node_exporter textfile collector)\n");
+    printf("  --latency : time every request. At the end of each device, and whenever the process\n");
+    printf("             gets SIGUSR1, print per-pass latency histograms and a heatmap of throughput\n");
+    printf("             across the device, with unusually slow regions listed as suspect media\n");
+    printf("  --heatmap-region MB : bytes of the device per heatmap cell (default %d)\n", DEFAULT_HEATMAP_REGION_MB);
+    printf("  --max-bad MB : a failed request is retried and bisected down to the sector size, and\n");
+    printf("             only sectors that still fail are skipped and listed; a device with more than\n");
+    printf("             this much bad is given up on (default %d)\n", DEFAULT_MAX_BAD_MB);
+    printf("  --bad-log FILE : append every device's bad ranges to FILE (device offset length kind error)\n");
+    printf("  --sample N : verify a sample instead of reading everything back: N randomly placed\n");
+    printf("             %d KB blocks, the first and last MiB (partition tables) and the boundaries\n", SAMPLE_BLOCK / 1024);
+    printf("             between requests, read in offset order. Reports the confidence reached;\n");
+    printf("             4603 blocks give 99%% confidence that under 0.1%% of the device was missed.\n");
+    printf("             Full clears only.\n");
+    printf("  --cert FILE : write a JSON wipe certificate: every device's model, serial, geometry,\n");
+    printf("             result, bytes written and verified, timing, bad ranges and, for a full\n");
+    printf("             --verify, the BLAKE3 of everything read back (what b3sum prints for an\n");
+    printf("             image of the wiped device), hashed by worker threads as the reads land\n");
+    printf("  --cert-key FILE : MAC the certificate with the 32-byte key in FILE (64 hex digits)\n");
+    printf("             into FILE.sig; check with: xxd -r -p KEYFILE | b3sum --keyed CERT\n");
+    printf("  Media policy: for a disk (not an image file, loop or virtual device) the settings\n");
+    printf("             not given are taken from sysfs. Spinning disks get 16 MB requests two deep,\n");
+    printf("             and a full clear is autotuned first; solid-state media get 4 MB requests deep\n");
+    printf("             enough to fill the device's queue (NVMe: a thread per hardware queue, up to\n");
+    printf("             4), and a full clear becomes one BLKZEROOUT pass when the device zeroes ranges\n");
+    printf("             itself. Requests are sized to the optimal I/O size and max_sectors_kb.\n");
+    printf("             Devices without command queueing are written one request at a time.\n");
+    printf("  --no-auto : no media policy; the built-in defaults for everything not given\n");
+    printf("  --autotune : before a full clear, spend a few seconds timing writes to the first\n");
+    printf("             %llu MB over chunk sizes, queue depths and thread counts, then wipe with\n", TUNE_REGION / (1024 * 1024));
+    printf("             the fastest. Results are cached per device model and serial.\n");
+    printf("  --retune : like --autotune, but ignore the cache\n");
+    printf("Several devices may be given; they are wiped concurrently, one job per device,\n");
+    printf("with progress lines prefixed by the device name and a summary at the end.\n");
+    printf("\n");
+    printf("Usage: %s --files <path> [path ...] [--smart] [--keep] [--report FILE] [--threads N]\n", prog);
+    printf("  --files  : shred files instead of devices. Every regular file under the given\n");
+    printf("             directories (or given itself) has its extents overwritten in place, then\n");
+    printf("             is truncated and unlinked; directories are removed once empty. Symbolic\n");
+    printf("             links are removed, not followed, and other mounted filesystems are skipped.\n");
+    printf("             One zero pass, or the three smart passes with --smart. --threads walkers\n");
+    printf("             share the trees (default %d). Copy-on-write filesystems (btrfs, reflinked\n", SHRED_THREADS);
+    printf("             XFS) write elsewhere; such files are reported as relocated.\n");
+    printf("  --keep   : with --files, overwrite but leave every file and directory in place\n");
+    printf("  --report FILE : with --files, write 'status<TAB>bytes<TAB>path' for every entry\n");
+    printf("\n");
+    printf("Usage: %s --free-space <dir> [--smart] [--reserve MB] [--slack] [--threads N]\n", prog);
+    printf("  --free-space : wipe the free space of the mounted filesystem holding <dir>.\n");
+    printf("             Filler files are preallocated in a hidden directory there and\n");
+    printf("             overwritten (direct I/O where the filesystem allows it), --threads at\n");
+    printf("             once (default %d), until only the reserve is left; then they are\n", FILL_THREADS);
+    printf("             removed. If other processes take the free space below half the reserve\n");
+    printf("             the fill stops and gives the space back at once.\n");
+    printf("  --reserve MB : free space left to other processes (default %d)\n", DEFAULT_RESERVE_MB);
+    printf("  --slack  : also overwrite the unused end of the last block of files unchanged\n");
+    printf("             for ten minutes, through the block device under the filesystem\n");
 }
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        usage(argv[0]);
-        return 1;
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Report a new phase and, with --latency, start timing it. The caller hangs
+// the returned recorder (NULL when not timing) on the phase's wipe_io.
+static struct lat_rec *begin_phase(struct wipe_job *job, const char *phase, int pass, int passes,
+                                   enum progress_counter track, unsigned long long total, unsigned long long done) {
+    char name[32];
+    progress_phase(job->progress, phase, pass, passes, track, total, done);
+    if (pass) snprintf(name, sizeof(name), "pass %d %s", pass, phase);
+    else snprintf(name, sizeof(name), "%s", phase);
+    return lat_log_phase(job->lat, name);
+}
+
+static void report_latency(const struct wipe_job *job) {
+    pthread_mutex_lock(&report_lock);
+    lat_log_report(job->lat, stdout, job->tag);
+    pthread_mutex_unlock(&report_lock);
+}
+
+// SIGUSR1 is blocked in every thread; this one takes it and reports every
+// device's latencies so far.
+static void *latency_dumper(void *arg) {
+    sigset_t *set = arg;
+    int sig;
+    while (sigwait(set, &sig) == 0) {
+        pthread_mutex_lock(&report_lock);
+        for (int d = 0; d < all_jobs_count; d++) lat_log_report(all_jobs[d].lat, stdout, all_jobs[d].tag);
+        pthread_mutex_unlock(&report_lock);
+    }
+    return NULL;
+}
+
+// Mark what the filesystem on the device has allocated. Returns 0 when it
+// was mapped, 1 when there is no filesystem to read, -1 on failure (status set).
+static int map_filesystem(struct wipe_job *job, const struct wipe_io *io, struct dirty_map *map) {
+    const char *t = job->tag;
+    struct fs_info fi;
+    int rc = fsmap_build(io->fd, io->align, map, &fi);
+    if (rc < 0) {
+        job->status = "filesystem unreadable";
+    } else if (rc > 0) {
+        printf("%sNo ext2/3/4 or FAT filesystem found\n", t);
+    } else {
+        printf("%s%s filesystem: %llu MB in %u-byte blocks, %.1f MB allocated\n", t, fi.type,
+               fi.size / (1024ULL*1024ULL), fi.block, fi.used / (1024.0 * 1024.0));
+        if (fi.size < io->len)
+            printf("%s%.1f MB past the end of the filesystem are not covered by its map\n", t,
+                   (io->len - fi.size) / (1024.0 * 1024.0));
+    }
+    return rc;
+}
+
+// Filesystem-aware wipe of one device: zero everything the filesystem has
+// allocated, plus its metadata, so sensitive data is gone as early as
+// possible; then, unless told not to, sweep the rest of the device.
+static void fs_wipe(struct wipe_job *job, struct wipe_io *io, struct wipe_io *tail_io) {
+    const struct wipe_opts *o = job->opts;
+    const char *t = job->tag;
+    size_t grain = o->grain < io->align ? io->align : o->grain;
+
+    struct dirty_map map;
+    if (dirty_map_init(&map, io->start, io->len, grain) != 0) {
+        fprintf(stderr, "%sOut of memory for the allocation map\n", t);
+        job->status = "out of memory";
+        return;
+    }
+    int frc = map_filesystem(job, io, &map);
+    if (frc < 0) {
+        dirty_map_free(&map);
+        return;
+    }
+    if (frc > 0) dirty_map_set_range(&map, io->start, io->len);
+
+    struct extent *ext = NULL, *rest = NULL;
+    unsigned long long first = dirty_map_bytes(&map);
+    long n = smart_extents(&map, 0, &ext), nrest = 0;
+    if (n >= 0 && o->sweep) {
+        dirty_map_invert(&map);
+        nrest = smart_extents(&map, 0, &rest);
+    }
+    dirty_map_free(&map);
+    if (n < 0 || nrest < 0) {
+        fprintf(stderr, "%sOut of memory for the extent list\n", t);
+        free(ext);
+        job->status = "out of memory";
+        return;
+    }
+    printf("%sOverwriting %.1f MB of allocated blocks and metadata first (%ld extent%s)\n", t,
+           first / (1024.0 * 1024.0), n, n == 1 ? "" : "s");
+    if (o->testMode) {
+        printf("%s[TEST] Map only; nothing written.\n", t);
+        free(ext);
+        free(rest);
+        return;
+    }
+
+    double t0 = now_seconds();
+    io->latency = tail_io->latency = begin_phase(job, "write", 0, 0, PROGRESS_WRITTEN,
+                                                 o->sweep ? io->len + tail_io->len : first, 0);
+    int rc = smart_write(io, ext, n, &job->written);
+    fsync(io->fd);
+    if (rc == 0)
+        printf("%sAllocated blocks and metadata overwritten: %.1f MB in %.1f s\n", t,
+               job->written / (1024.0 * 1024.0), now_seconds() - t0);
+
+    int swept = 0;
+    if (rc == 0 && o->sweep) {
+        unsigned long long w = 0;
+        printf("%sSweeping the remaining %.1f MB ...\n", t, (io->len - first + tail_io->len) / (1024.0 * 1024.0));
+        rc = smart_write(io, rest, nrest, &w);
+        job->written += w;
+        if (rc == 0 && tail_io->len) {
+            rc = engine_write(tail_io, &w);
+            job->written += w;
+        }
+        fsync(io->fd);
+        swept = rc == 0;
+    }
+    if (rc == ENGINE_CANCELLED) {
+        printf("%sInterrupted after %llu bytes written.\n", t, job->written);
+        job->status = "interrupted";
+        free(ext);
+        free(rest);
+        return;
+    }
+    if (!o->verifyOnly) printf("%sOverwrite complete. Total bytes written: %llu\n", t, job->written);
+    if (rc != 0) job->status = "write failed";
+
+    if (o->verifyMode) {
+        int vrc;
+        printf("%sStarting verification of the %s ...\n", t, swept ? "whole device" : "allocated blocks");
+        io->latency = tail_io->latency = begin_phase(job, "verify", 0, 0, PROGRESS_VERIFIED,
+                                                     swept ? io->len + tail_io->len : first, 0);
+        if (swept) {
+            vrc = engine_verify(io, &job->verified);
+            if (vrc == 0 && tail_io->len) {
+                unsigned long long r = 0;
+                posix_fadvise(tail_io->fd, (off_t)tail_io->start, (off_t)tail_io->len, POSIX_FADV_DONTNEED);
+                vrc = engine_verify(tail_io, &r);
+                job->verified += r;
+            }
+        } else {
+            vrc = smart_verify(io, ext, n, &job->verified);
+        }
+        if (vrc == 0) printf("%sVerification succeeded: %s zero.\n", t, swept ? "all bytes" : "allocated blocks and metadata");
+        else if (!job->status) job->status = vrc == ENGINE_CANCELLED ? "interrupted"
+                                           : vrc > 0 ? "verify mismatch" : "verify read error";
+    }
+    free(ext);
+    free(rest);
+}
+
+static struct lat_rec *plan_phase(void *ctx, const char *phase, int pass, int passes,
+                                  enum progress_counter track, unsigned long long total) {
+    return begin_phase(ctx, phase, pass, passes, track, total, 0);
+}
+
+// The purge passes (0x00, 0xFF, random) over ext, or all of io when ext is
+// NULL, plus the tail; sets job->status on failure.
+static void run_passes(struct wipe_job *job, struct wipe_io *io, struct wipe_io *tail_io,
+                       const struct extent *ext, long n, struct readback *rb) {
+    const struct wipe_opts *o = job->opts;
+    struct pass_pattern passes[SMART_PASSES];
+    memset(passes, 0, sizeof(passes));
+    passes[1].byte = 0xFF;
+    passes[2].random = 1;
+    struct wipe_plan plan = {
+        .passes = passes,
+        .npasses = SMART_PASSES,
+        .ext = ext,
+        .next = n,
+        .verify = o->verifyMode,
+        .region = o->region,
+        .tag = job->tag,
+        .phase = plan_phase,
+        .ctx = job,
+        .digest = rb,
+    };
+    struct plan_result res[SMART_PASSES];
+    double t0 = now_seconds();
+    plan_run(&plan, backend_engine(io->engine), io, tail_io, res);
+    double secs = now_seconds() - t0;
+    unsigned long long bytes = 0;
+    for (int p = 0; p < SMART_PASSES; p++) {
+        job->written += res[p].written;
+        job->verified += res[p].verified;
+        bytes += res[p].written + res[p].verified;
+    }
+    if (!job->status) job->status = plan_status(res, SMART_PASSES);
+    plan_report(res, SMART_PASSES, stdout, job->tag);
+    printf("%sPasses took %.1f s, %.1f MB/s (%s order)\n", job->tag, secs,
+           secs > 0 ? bytes / (1024.0 * 1024.0) / secs : 0, o->region ? "interleaved" : "sweep");
+}
+
+// Smart purge of one device: scan for data, report occupancy, then run each
+// pass over the dirty extents only (the unaligned tail, if any, is always
+// included). Sets job->status on failure.
+static void smart_wipe(struct wipe_job *job, const struct device *dev, struct wipe_io *io,
+                       struct wipe_io *tail_io) {
+    const struct wipe_opts *o = job->opts;
+    const char *t = job->tag;
+    size_t grain = o->grain < io->align ? io->align : o->grain;
+
+    struct dirty_map map;
+    if (dirty_map_init(&map, io->start, io->len, grain) != 0) {
+        fprintf(stderr, "%sOut of memory for the dirty map\n", t);
+        job->status = "out of memory";
+        return;
+    }
+    int need_scan = o->fsMode ? map_filesystem(job, io, &map) : 1;
+    if (need_scan < 0) {
+        dirty_map_free(&map);
+        return;
+    }
+    if (need_scan) {
+        printf("%sScanning for data (%zu KiB grain) ...\n", t, grain / 1024);
+        io->latency = begin_phase(job, "scan", 0, 0, PROGRESS_SCANNED, io->len, 0);
+        int src = smart_scan(io, &map);
+        if (src != 0) {
+            dirty_map_free(&map);
+            job->status = src == ENGINE_CANCELLED ? "interrupted" : "scan failed";
+            return;
+        }
+    }
+    unsigned long long used = dirty_map_bytes(&map);
+    struct extent *ext;
+    long n = smart_extents(&map, dev->topo.rotational ? ROTATIONAL_MERGE_GAP : 0, &ext);
+    dirty_map_free(&map);
+    if (n < 0) {
+        fprintf(stderr, "%sOut of memory for the extent list\n", t);
+        job->status = "out of memory";
+        return;
+    }
+    unsigned long long per_pass = tail_io->len;
+    for (long i = 0; i < n; i++) per_pass += ext[i].len;
+    printf("%sOccupancy: %.1f of %llu MB hold data (%.1f%%)\n", t, used / (1024.0 * 1024.0),
+           io->len / (1024ULL*1024ULL), io->len ? 100.0 * used / io->len : 0.0);
+    printf("%sWriting %ld extent%s, %.1f MB per pass\n", t, n, n == 1 ? "" : "s", per_pass / (1024.0 * 1024.0));
+    if (o->testMode) {
+        printf("%s[TEST] Scan only; nothing written.\n", t);
+        free(ext);
+        return;
+    }
+
+    run_passes(job, io, tail_io, ext, n, NULL);
+    free(ext);
+}
+
+// --purge: the three passes over the whole device. With rb, the last pass's
+// read-back is hashed into it.
+static void purge_wipe(struct wipe_job *job, struct wipe_io *io, struct wipe_io *tail_io, struct readback *rb) {
+    printf("%sPurging all %llu MB: %d passes\n", job->tag, (io->len + tail_io->len) / (1024ULL*1024ULL), SMART_PASSES);
+    if (job->opts->testMode) {
+        printf("%s[TEST] Plan only; nothing written.\n", job->tag);
+        return;
+    }
+    run_passes(job, io, tail_io, NULL, 0, rb);
+}
+
+// Engine callback: everything below end is durable, record it.
+static void checkpoint(void *ctx, unsigned long long end) {
+    struct journal *j = ctx;
+    j->offset = end;
+    journal_save(j);
+}
+
+// Set up the journal for a full clear, loading it first with --resume.
+// Returns the offset to start writing from, or -1 (status set) to give up.
+static long long open_journal(struct wipe_job *job, const struct device *dev, struct journal *jr) {
+    const struct wipe_opts *o = job->opts;
+    const char *t = job->tag;
+    memset(jr, 0, sizeof(*jr));
+    if (o->journalPath) snprintf(jr->path, sizeof(jr->path), "%s", o->journalPath);
+    else journal_default_path(jr->path, sizeof(jr->path), job->path, dev->topo.serial);
+
+    unsigned long long start = 0;
+    if (o->resume) {
+        int lr = journal_load(jr);
+        if (lr < 0) {
+            job->status = "journal damaged";
+            return -1;
+        }
+        if (lr > 0) {
+            printf("%sNo journal at %s; starting from the beginning\n", t, jr->path);
+        } else if (!journal_matches(jr, dev->size, dev->topo.serial)) {
+            fprintf(stderr, "%sJournal %s is for another device (%llu bytes, serial '%s'); not resuming\n",
+                    t, jr->path, jr->size, jr->serial);
+            job->status = "journal mismatch";
+            return -1;
+        } else {
+            start = jr->offset;
+            printf("%sResuming from %s at offset %llu (%llu MB already durable)\n", t, jr->path,
+                   start, start / (1024ULL*1024ULL));
+        }
+    }
+    snprintf(jr->device, sizeof(jr->device), "%s", job->path);
+    snprintf(jr->serial, sizeof(jr->serial), "%s", dev->topo.serial);
+    jr->size = dev->size;
+    jr->pass = 1;
+    jr->has_key = 0;
+    jr->offset = start;
+    if (journal_save(jr) != 0) {
+        job->status = "journal unwritable";
+        return -1;
+    }
+    return (long long)start;
+}
+
+// Pick chunk size, queue depth and threads for this device, from the cache
+// or by probing. Keeps io's settings if probing fails.
+static void autotune(struct wipe_job *job, const struct device *dev, struct wipe_io *io) {
+    const struct wipe_opts *o = job->opts;
+    const char *t = job->tag;
+    char key[400], path[512];
+    snprintf(key, sizeof(key), "%s|%s|%s|%s", dev->topo.model[0] ? dev->topo.model : "-",
+             dev->topo.serial[0] ? dev->topo.serial : job->path, o->directMode ? "direct" : "sync", engine_name(io->engine));
+    tune_cache_path(path, sizeof(path));
+
+    struct tune_result r;
+    if (o->autotune != 2 && tune_cache_load(path, key, &r) == 0) {
+        printf("%sAutotune: cached result for this device in %s\n", t, path);
+    } else {
+        printf("%sAutotune: probing the first %llu MB ...\n", t, TUNE_REGION / (1024ULL*1024ULL));
+        if (tune_probe(io, TUNE_REGION, TUNE_SECONDS, &r) != 0) {
+            fprintf(stderr, "%sAutotune failed; keeping the defaults\n", t);
+            return;
+        }
+        tune_cache_store(path, key, &r);
+    }
+    io->chunk = r.chunk;
+    io->depth = r.depth;
+    io->threads = r.threads;
+    printf("%sAutotune: %zu MB requests, queue depth %u, %u thread%s (%.1f MB/s measured)\n", t,
+           io->chunk / (1024 * 1024), io->depth, io->threads, io->threads == 1 ? "" : "s", r.mbps);
+}
+
+// Report what sysfs says about the device and, with the media policy on,
+// fill in what the command line left open: engine, request size, queue
+// depth and threads for every mode; for a full clear, one offloaded pass on
+// solid-state media that zero ranges themselves, or a tuned streaming
+// overwrite on spinning disks. Returns whether to autotune.
+static int apply_policy(struct wipe_job *job, const struct device *dev, struct wipe_io *io,
+                        enum offload_kind *offload) {
+    const struct wipe_opts *o = job->opts;
+    const char *t = job->tag;
+    const struct topology *tp = &dev->topo;
+    if (!dev->is_block) return 0;
+    struct media_policy p;
+    int virt = topology_policy(tp, &p);
+    printf("%sMedia: %s on %s%s%s%s; requests up to %llu KB, optimal I/O %llu KB, %u queued", t, p.media,
+           tp->transport, tp->model[0] ? " (" : "", tp->model, tp->model[0] ? ")" : "",
+           tp->max_request / 1024, tp->optimal_io / 1024, tp->nr_requests);
+    if (tp->queue_depth) printf(", device queue depth %u", tp->queue_depth);
+    printf(", %u hardware queue%s\n", tp->hw_queues, tp->hw_queues == 1 ? "" : "s");
+    if (!o->mediaPolicy) return 0;
+    if (virt) {
+        printf("%sMedia policy: none for a virtual device; built-in defaults\n", t);
+        return 0;
+    }
+
+    if (!o->engineGiven) io->engine = p.engine;
+    if (!o->qdGiven) io->depth = p.depth;
+    if (!o->chunkGiven) io->chunk = p.chunk;
+    if (!o->threadsGiven) io->threads = p.threads;
+    // An explicit --offload stands; a journal, a pipelined verify or
+    // --autotune need the writes themselves.
+    int clear = !o->smartMode && !o->purgeMode && !o->fsMode && !o->testMode && !o->verifyOnly;
+    if (clear && p.offload != OFFLOAD_NONE && o->offload == OFFLOAD_NONE && !o->resume && !o->journalPath &&
+        !o->pipelineMode && !o->autotune)
+        *offload = p.offload;
+    int tune = clear && p.tune && *offload == OFFLOAD_NONE && !o->chunkGiven && !o->qdGiven && !o->threadsGiven;
+    if (*offload != OFFLOAD_NONE && o->offload == OFFLOAD_NONE)
+        printf("%sMedia policy: %s, one %s pass\n", t, p.media, offload_name(*offload));
+    else
+        printf("%sMedia policy: %s, %s engine, %zu KB requests on %zu-byte boundaries, queue depth %u, %u thread%s%s\n",
+               t, p.media, engine_name(io->engine), io->chunk / 1024, p.align,
+               io->engine == ENGINE_URING ? io->depth : 1, io->threads, io->threads == 1 ? "" : "s",
+               tune ? ", tuned first" : "");
+    return tune;
+}
+
+// How the device is written, for --cert: the media policy and autotune make
+// it differ from device to device.
+static void record_io(struct wipe_job *job, const struct wipe_io *io, enum offload_kind offload) {
+    job->cert.engine = engine_name(io->engine);
+    job->cert.depth = io->engine == ENGINE_URING ? io->depth : 1;
+    job->cert.threads = io->threads;
+    job->cert.chunk = io->chunk;
+    job->cert.offload = offload == OFFLOAD_NONE ? NULL : offload_name(offload);
+}
+
+// Every byte of the run is written, verified or bad; say which, and list
+// the bad ranges. A device with bad sectors is not reported as OK.
+static void account_bytes(struct wipe_job *job) {
+    const struct wipe_opts *o = job->opts;
+    const char *t = job->tag;
+    unsigned long long unwritable = bad_list_bytes(job->bad, BAD_WRITE);
+    unsigned long long unreadable = bad_list_bytes(job->bad, BAD_READ);
+    if (!unwritable && !unreadable) return;
+    printf("%sAccounting: %llu bytes written, %llu unwritable", t, job->written, unwritable);
+    if (o->verifyMode) printf("; %llu verified, %llu unreadable", job->verified, unreadable);
+    printf(" (device %llu bytes)\n", job->size);
+    bad_list_report(job->bad, stdout, t);
+    if (o->badLog) {
+        pthread_mutex_lock(&report_lock);
+        if (bad_list_save(job->bad, o->badLog, job->path) != 0)
+            fprintf(stderr, "%sCould not write the bad-range log %s: %s\n", t, o->badLog, strerror(errno));
+        pthread_mutex_unlock(&report_lock);
+    }
+    if (!job->status) job->status = unwritable ? "bad sectors" : "unreadable sectors";
+}
+
+// --sample: check a random sample and the fixed regions of io's range
+// instead of all of it, and say how much that establishes.
+static int verify_sample(struct wipe_job *job, const struct wipe_io *io) {
+    const struct wipe_opts *o = job->opts;
+    const char *t = job->tag;
+    unsigned long long estimate = o->sample * SAMPLE_BLOCK + 2 * 1024 * 1024;
+    printf("%sStarting sampled verification (%llu random blocks) ...\n", t, o->sample);
+    struct wipe_io s = *io;
+    s.latency = begin_phase(job, "verify", 0, 0, PROGRESS_VERIFIED, estimate < io->len ? estimate : io->len, 0);
+    struct sample_result r;
+    int vrc = sample_verify(&s, o->sample, &r);
+    job->verified += r.bytes;
+    job->cert.sampled = 1;
+    job->cert.sample = r;
+
+    char seed[2 * PATTERN_KEY_SIZE + 1];
+    pattern_key_hex(&r.seed, seed);
+    printf("%sSampled %llu random blocks, both ends and %llu of %llu request boundaries: %llu MB read\n", t,
+           r.random, r.boundaries, r.all_boundaries, r.bytes / (1024ULL*1024ULL));
+    printf("%sSample seed: %s\n", t, seed);
+    if (vrc == 0 && r.random)
+        printf("%sConfidence: %.2f%% that under 0.1%% of the device holds old data; at 99%% confidence, under %.4f%%\n",
+               t, r.confidence * 100, r.bound99 * 100);
+    return vrc;
+}
+
+// Wipe (and optionally verify) one device. Sets job->status; returns 0 on success.
+static int wipe_device(struct wipe_job *job) {
+    const struct wipe_opts *o = job->opts;
+    const char *t = job->tag;
+
+    struct device dev;
+    int flags = o->verifyOnly ? O_RDONLY | (o->directMode ? O_DIRECT : 0) : O_RDWR | (o->directMode ? O_DIRECT : O_SYNC);
+    if (device_open(&dev, job->path, flags) != 0) {
+        job->status = "open failed";
+        return -1;
+    }
+    unsigned long long disk_len = dev.size;
+    job->size = disk_len;
+    memcpy(job->cert.model, dev.topo.model, sizeof(job->cert.model));
+    memcpy(job->cert.serial, dev.topo.serial, sizeof(job->cert.serial));
+    job->cert.logical_block = dev.logical_block;
+    job->cert.physical_block = dev.physical_block;
+    job->cert.rotational = dev.topo.rotational;
+    memcpy(job->cert.transport, dev.topo.transport, sizeof(job->cert.transport));
+    printf("%sDisk length: %llu bytes (~%llu MB)\n", t, disk_len, disk_len / (1024ULL*1024ULL));
+    printf("%sSector size: %u logical, %u physical\n", t, dev.logical_block, dev.physical_block);
+    job->bad = bad_list_new(o->maxBad);
+    if (!job->bad) {
+        device_close(&dev);
+        job->status = "out of memory";
+        return -1;
+    }
+    if (o->latency) {
+        struct lat_log *l = lat_log_new(job->path, disk_len, o->heatmapRegion);
+        if (!l) fprintf(stderr, "%sOut of memory for latency statistics; not timing requests\n", t);
+        pthread_mutex_lock(&report_lock);
+        job->lat = l;
+        pthread_mutex_unlock(&report_lock);
+    }
+    enum offload_kind offload = offload_pick(o->offload, &dev);
+
+    // O_DIRECT can only move whole logical blocks. An image file whose size
+    // is not a multiple of that gets its last few bytes written and checked
+    // through a second, buffered descriptor.
+    unsigned long long tail = o->directMode ? disk_len % dev.logical_block : 0;
+    int tail_fd = -1;
+    if (tail) {
+        tail_fd = open(job->path, o->verifyOnly ? O_RDONLY : O_RDWR);
+        if (tail_fd < 0) {
+            fprintf(stderr, "%sFailed to open device for unaligned tail: %s\n", t, strerror(errno));
+            device_close(&dev);
+            job->status = "open failed";
+            return -1;
+        }
+    }
+
+    struct wipe_io io = {
+        .fd = dev.fd,
+        .start = 0,
+        .len = disk_len - tail,
+        .chunk = o->chunk,
+        .align = device_io_align(&dev),
+        .sector = dev.logical_block,
+        .depth = o->qd,
+        .threads = o->threads,
+        .barrier = o->directMode ? BARRIER_BYTES : 0,
+        .engine = o->engine,
+        .tag = t,
+        .progress = job->progress,
+        .bad = job->bad,
+        .cancel = journal_interrupt_flag(),
+    };
+    int tune = apply_policy(job, &dev, &io, &offload);
+    if (offload != OFFLOAD_NONE || o->offload != OFFLOAD_NONE)
+        printf("%sOffload: %s (device limits: write-zeroes %llu MB, discard %llu MB per request)\n", t,
+               offload == OFFLOAD_NONE ? "none, writing zeros" : offload_name(offload),
+               dev.topo.write_zeroes_max / (1024ULL*1024ULL), dev.topo.discard_max / (1024ULL*1024ULL));
+    struct wipe_io tail_io = io;
+    tail_io.fd = tail_fd;
+    tail_io.start = io.len;
+    tail_io.len = tail;
+    tail_io.barrier = tail;
+    tail_io.engine = ENGINE_SYNC;
+    record_io(job, &io, offload);
+
+    // --cert: the verify that reads the final contents back, the full
+    // clear's or the last purge pass's, hands every request it checks, the
+    // tail included, to hashing threads; reads stay one pass. Smart and
+    // filesystem-aware runs read back only part of the device.
+    struct readback *rb = NULL;
+    if (o->certPath && o->verifyMode && !o->sample && !o->smartMode && !o->fsMode) {
+        rb = readback_new(0, disk_len, 0);
+        if (!rb) fprintf(stderr, "%sOut of memory for the read-back digest; the certificate will have none\n", t);
+    }
+
+    if (o->smartMode) {
+        smart_wipe(job, &dev, &io, &tail_io);
+        goto done;
+    }
+    if (o->purgeMode) {
+        purge_wipe(job, &io, &tail_io, rb);
+        goto done;
+    }
+    if (o->fsMode) {
+        fs_wipe(job, &io, &tail_io);
+        goto done;
+    }
+
+    if ((o->autotune || tune) && !o->testMode && offload == OFFLOAD_NONE) autotune(job, &dev, &io);
+    record_io(job, &io, offload);
+
+    // Full clears keep a journal; --resume starts after its durable offset.
+    // The verify pass below still covers the whole device.
+    struct journal jr;
+    struct wipe_io full = io;
+    int journaled = !o->testMode && !o->verifyOnly && offload == OFFLOAD_NONE;
+    unsigned long long resume_at = 0;
+    if (journaled) {
+        long long s = open_journal(job, &dev, &jr);
+        if (s < 0) goto done;
+        resume_at = (unsigned long long)s < io.len ? (unsigned long long)s : io.len;
+        io.start = resume_at;
+        io.len -= resume_at;
+        io.checkpoint = o->directMode ? BARRIER_BYTES : CHECKPOINT_BYTES;
+        io.on_durable = checkpoint;
+        io.durable_ctx = &jr;
+    }
+
+    full.digest = io.digest = tail_io.digest = rb;
+
+    // Writes and reads go through the backend: the engine, or the kernel
+    // offload with the engine behind it.
+    struct offload_backend ob;
+    const struct wipe_backend *b = backend_engine(io.engine);
+    if (offload != OFFLOAD_NONE) {
+        backend_offload(&ob, offload, OFFLOAD_RANGE, o->threads > 1 ? o->threads : OFFLOAD_THREADS);
+        b = &ob.b;
+    }
+
+    if (!o->verifyOnly) printf("%sStarting overwrite%s ...\n", t, o->testMode ? " (test: single chunk)" : "");
+    int pipelined = o->verifyMode && o->pipelineMode && !o->testMode && offload == OFFLOAD_NONE;
+    int rc = 0, vrc = 0;
+    if (pipelined)
+        io.latency = begin_phase(job, "write+verify", 0, 0, PROGRESS_VERIFIED, disk_len, 0);
+    else if (!o->testMode && !o->verifyOnly)
+        io.latency = tail_io.latency = begin_phase(job, offload != OFFLOAD_NONE ? "offload" : "write", 0, 0,
+                                                   PROGRESS_WRITTEN, disk_len, resume_at);
+    if (o->verifyOnly) {
+        // verify: read back what an earlier run left, nothing written.
+    } else if (o->testMode) {
+        io.len = io.len < BUF_SIZE ? io.len : BUF_SIZE;
+        io.latency = begin_phase(job, "write", 0, 0, PROGRESS_WRITTEN, io.len, 0);
+        rc = b->write(b, &io, &job->written);
+        if (rc != 0) fprintf(stderr, "%sTest write failed\n", t);
+        else printf("%s[TEST] %llu bytes written.\n", t, job->written);
+        fsync(dev.fd);
+        io.len = disk_len - tail;
+    } else if (offload != OFFLOAD_NONE) {
+        unsigned long long w = 0;
+        rc = b->write(b, &io, &job->written);
+        if (rc == 0 && tail) {
+            rc = engine_write(&tail_io, &w);
+            job->written += w;
+        }
+        fsync(dev.fd);
+        printf("%sOffloaded %llu MB with %s; %llu MB written by the fallback\n", t, ob.offloaded / (1024ULL*1024ULL),
+               offload_name(offload), (job->written - ob.offloaded) / (1024ULL*1024ULL));
+        if (offload != OFFLOAD_ZEROOUT && ob.offloaded && !o->verifyMode)
+            printf("%sNote: discarded blocks are not guaranteed to read back as zero; --verify checks.\n", t);
+    } else if (pipelined) {
+        printf("%sVerifier trailing the writer by %llu MB%s\n", t, o->lag / (1024ULL*1024ULL),
+               dev.topo.rotational ? " (throttled: rotational media)" : "");
+        rc = engine_write_verify(&io, o->lag, dev.topo.rotational, &job->written, &job->verified, &vrc);
+        if (rc == 0 && vrc == 0 && resume_at) {
+            // The part written before the interruption has not been re-read yet.
+            unsigned long long v = 0;
+            struct wipe_io head = full;
+            head.len = resume_at;
+            head.latency = io.latency;
+            vrc = b->verify(b, &head, &v);
+            job->verified += v;
+        }
+        if (rc == 0 && tail) {
+            unsigned long long w = 0;
+            rc = engine_write(&tail_io, &w);
+            job->written += w;
+        }
+        fsync(dev.fd);
+    } else {
+        rc = b->write(b, &io, &job->written);
+        if (rc == 0 && tail) {
+            unsigned long long w = 0;
+            rc = engine_write(&tail_io, &w);
+            job->written += w;
+        }
+        fsync(dev.fd);
+    }
+    if (journaled && journal_interrupted()) {
+        printf("%sInterrupted with %llu MB durable; checkpoint kept in %s. Run again with --resume.\n",
+               t, jr.offset / (1024ULL*1024ULL), jr.path);
+        job->status = "interrupted";
+        goto done;
+    }
+    if (rc == ENGINE_CANCELLED) {
+        printf("%sInterrupted after %llu bytes written.\n", t, job->written);
+        job->status = "interrupted";
+        goto done;
+    }
+    if (!o->verifyOnly) printf("%sOverwrite complete. Total bytes written: %llu\n", t, job->written);
+    if (rc != 0) job->status = "write failed";
+    else if (journaled) journal_remove(&jr);
+
+    if (o->verifyMode) {
+        if (o->sample) {
+            vrc = verify_sample(job, &full);
+            tail_io.latency = NULL;
+        } else if (!pipelined) {
+            printf("%sStarting verification (this will take a while)...\n", t);
+            full.latency = tail_io.latency = begin_phase(job, "verify", 0, 0, PROGRESS_VERIFIED, disk_len, 0);
+            vrc = b->verify(b, &full, &job->verified);
+        }
+        if (vrc == 0 && tail) {
+            // The tail was written through the page cache; drop it so the
+            // read comes from the medium.
+            unsigned long long r = 0;
+            posix_fadvise(tail_fd, (off_t)tail_io.start, (off_t)tail, POSIX_FADV_DONTNEED);
+            vrc = engine_verify(&tail_io, &r);
+            job->verified += r;
+        }
+        if (vrc == 0) {
+            int holes = bad_list_bytes(job->bad, BAD_WRITE) || bad_list_bytes(job->bad, BAD_READ);
+            if (o->sample) printf("%sSampled verification succeeded: every %sbyte read was zero.\n", t, holes ? "readable " : "");
+            else printf("%sVerification succeeded: all %sbytes zero.\n", t, holes ? "written and readable " : "");
+        } else if (vrc == ENGINE_CANCELLED) {
+            if (!job->status) job->status = "interrupted";
+        } else if (!job->status) {
+            job->status = vrc > 0 ? "verify mismatch" : "verify read error";
+        }
+        if (o->verifyOnly)
+            printf("%sVerification only: %llu bytes read back, nothing written.\n", t, job->verified);
     }
 
-    const char *devPath = argv[1];
-    int testMode = 0, verifyMode = 0;
-    for (int i = 2; i < argc; i++) {
-        if (strcmp(argv[i], "--test") == 0) testMode = 1;
-        else if (strcmp(argv[i], "--verify") == 0) verifyMode = 1;
+done:
+    if (tail_fd >= 0) close(tail_fd);
+    device_close(&dev);
+    account_bytes(job);
+    if (rb) {
+        // Only a clean run's digest is evidence: after a mismatch or an
+        // unreadable sector part of the device was never hashed as read.
+        unsigned long long hashed = 0;
+        job->cert.digested = readback_finish(rb, job->cert.digest, &hashed) == 0 && !job->status;
+        if (job->cert.digested) {
+            char hex[2 * DIGEST_SIZE + 1];
+            digest_hex(job->cert.digest, hex);
+            printf("%sRead-back digest (BLAKE3): %s\n", t, hex);
+        }
+    }
+    if (!job->status) job->status = "OK";
+    progress_job_end(job->progress, job->status);
+    if (job->lat) report_latency(job);
+    return strcmp(job->status, "OK") == 0 ? 0 : -1;
+}
+
+static const char *mode_name(const struct wipe_opts *o) {
+    return o->verifyOnly ? "VERIFY ONLY" : o->testMode ? "TEST" : o->purgeMode ? "PURGE"
+         : o->smartMode ? "SMART PURGE" : o->fsMode ? "FILESYSTEM-AWARE" : "FULL CLEAR";
+}
+
+// --cert: one certificate covering every device of the run.
+static int write_certificate(const struct wipe_opts *o, const struct wipe_job *jobs, int n, time_t started) {
+    struct cert_device *cd = calloc(n, sizeof(*cd));
+    if (!cd) {
+        fprintf(stderr, "Out of memory for the certificate\n");
+        return -1;
     }
+    for (int d = 0; d < n; d++) {
+        cd[d] = jobs[d].cert;
+        cd[d].path = jobs[d].path;
+        cd[d].size = jobs[d].size;
+        cd[d].status = jobs[d].status;
+        cd[d].written = jobs[d].written;
+        cd[d].verified = jobs[d].verified;
+        cd[d].seconds = jobs[d].seconds;
+        cd[d].bad = jobs[d].bad;
+    }
+    int policy_offload = 0;
+    for (int d = 0; d < n; d++) policy_offload |= jobs[d].cert.offload != NULL;
+    char passes[64];
+    if (o->verifyOnly) snprintf(passes, sizeof(passes), "0 (read back only)");
+    else if (o->smartMode || o->purgeMode) snprintf(passes, sizeof(passes), "%d (0x00, 0xFF, random)", SMART_PASSES);
+    else if (o->offload != OFFLOAD_NONE) snprintf(passes, sizeof(passes), "1 (%s, zeros where rejected)", offload_name(o->offload));
+    else if (policy_offload) snprintf(passes, sizeof(passes), "1 (zeros, or the offload in each device's io)");
+    else snprintf(passes, sizeof(passes), "1 (zeros)");
+    struct cert_run run = {
+        .mode = mode_name(o),
+        .passes = passes,
+        .verify = !o->verifyMode ? "none" : o->sample ? "sampled" : o->pipelineMode && !o->smartMode && !o->fsMode && !o->testMode &&
+                  o->offload == OFFLOAD_NONE ? "pipelined" : "full",
+        .engine = engine_name(o->engine),
+        .direct = o->directMode,
+        .depth = o->engine == ENGINE_URING ? o->qd : 1,
+        .threads = o->threads,
+        .chunk = o->chunk,
+        .started = started,
+        .finished = time(NULL),
+    };
+    int rc = cert_write(o->certPath, &run, cd, n, o->certKey);
+    if (rc == 0) printf("Certificate written to %s%s\n", o->certPath, o->certKey ? " (MAC in .sig)" : "");
+    free(cd);
+    return rc;
+}
 
-    printf("WARNING: This will overwrite data on %s\n", devPath);
-    printf("Test mode: %s\n", testMode ? "YES (single chunk)" : "NO (full wipe)");
-    printf("Verify mode: %s\n", verifyMode ? "YES" : "NO");
+static void *job_main(void *arg) {
+    struct wipe_job *job = arg;
+    double t0 = now_seconds();
+    wipe_device(job);
+    job->seconds = now_seconds() - t0;
+    printf("%sFinished: %s\n", job->tag, job->status);
+    return NULL;
+}
+
+static int confirm(void) {
     printf("Type the word 'CONFIRM' (uppercase) to proceed: ");
-    char confirm[64];
-    if (!fgets(confirm, sizeof(confirm), stdin)) return 1;
-    confirm[strcspn(confirm, "\r\n")] = 0;
-    if (strcmp(confirm, "CONFIRM") != 0) {
+    char line[64];
+    if (!fgets(line, sizeof(line), stdin)) return 0;
+    line[strcspn(line, "\r\n")] = 0;
+    if (strcmp(line, "CONFIRM") != 0) {
         printf("Aborted: confirmation not received.\n");
-        return 1;
+        return 0;
     }
+    return 1;
+}
+
+// Passes for --files and --free-space: one of zeros, or 0x00, 0xFF and
+// random with --smart. Returns how many, or -1 without a random source.
+static int file_passes(const struct wipe_opts *o, struct pass_pattern passes[SMART_PASSES]) {
+    memset(passes, 0, SMART_PASSES * sizeof(passes[0]));
+    if (!o->smartMode) return 1;
+    passes[1].byte = 0xFF;
+    passes[2].random = 1;
+    if (pattern_key_generate(&passes[2].key) != 0) {
+        fprintf(stderr, "No system random source available\n");
+        return -1;
+    }
+    return SMART_PASSES;
+}
 
-    int fd = open(devPath, O_RDWR | O_SYNC);
-    if (fd < 0) {
-        perror("Failed to open device");
+// --files: shred files and directory trees instead of devices.
+static int shred_main(const struct wipe_opts *o, const char *const *paths, int n) {
+    struct pass_pattern passes[SMART_PASSES];
+    int npasses = file_passes(o, passes);
+    if (npasses < 0) return 1;
+
+    for (int i = 0; i < n; i++)
+        printf("WARNING: This will overwrite %s %s\n", o->keep ? "every file under" : "and delete", paths[i]);
+    printf("Passes: %s\n", o->smartMode ? "3 (0x00, 0xFF, random)" : "1 (zeros)");
+    printf("Engine: %s (%u thread%s)\n", engine_name(o->engine), o->threads, o->threads == 1 ? "" : "s");
+    if (!confirm()) return 1;
+
+    FILE *report = NULL;
+    if (o->reportPath && !(report = fopen(o->reportPath, "w"))) {
+        fprintf(stderr, "Could not create %s: %s\n", o->reportPath, strerror(errno));
+        return 1;
+    }
+    journal_catch_signals();
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    struct progress_opts popts = {
+        .interval = o->progressInterval,
+        .human = 1,
+        .json_fd = o->progressFd,
+        .prom_path = o->promPath,
+    };
+    if (progress_start(&popts) != 0) {
+        if (report) fclose(report);
         return 1;
     }
+    struct progress_job *pj = progress_job_add("files", "");
+    progress_phase(pj, "shred", 0, 0, PROGRESS_WRITTEN, 0, 0);
 
-    unsigned long long disk_len = 0;
-    if (ioctl(fd, BLKGETSIZE64, &disk_len) != 0) {
-        perror("BLKGETSIZE64 failed");
-        close(fd);
+    struct shred_opts so = {
+        .passes = passes,
+        .npasses = npasses,
+        .threads = o->threads,
+        .engine = o->engine,
+        .depth = o->qd,
+        .chunk = o->chunk,
+        .keep = o->keep,
+        .report = report,
+        .cancel = journal_interrupt_flag(),
+        .progress = pj,
+    };
+    struct shred_totals t;
+    double t0 = now_seconds();
+    int rc = shred_paths(paths, n, &so, &t);
+    double secs = now_seconds() - t0;
+    progress_job_end(pj, rc == 0 ? "OK" : rc == ENGINE_CANCELLED ? "cancelled" : "failed");
+    progress_stop();
+    if (report && fclose(report) != 0) fprintf(stderr, "Could not write %s\n", o->reportPath);
+
+    printf("Shredded %llu file%s: %.1f MB, %d pass%s, %.1f s (%.1f files/s, %.1f MB/s)\n", t.files,
+           t.files == 1 ? "" : "s", t.bytes / (1024.0 * 1024.0), npasses, npasses == 1 ? "" : "es", secs,
+           secs > 0 ? t.files / secs : 0, secs > 0 ? t.bytes * (double)npasses / (1024.0 * 1024.0) / secs : 0);
+    if (!o->keep) printf("Removed %llu directories and other entries\n", t.removed);
+    if (t.relocated)
+        printf("%llu file%s relocated by a copy-on-write filesystem; wipe its free space or the device\n",
+               t.relocated, t.relocated == 1 ? " was" : "s were");
+    if (t.failed) printf("%llu entr%s not shredded%s\n", t.failed, t.failed == 1 ? "y" : "ies",
+                         o->reportPath ? " (see the report)" : "");
+    if (rc == ENGINE_CANCELLED) printf("Interrupted; files not yet reached are untouched.\n");
+    printf("I/O buffers: %s\n", buffer_impl());
+    printf("Clear operation finished. Mode: FILES%s.\n", o->keep ? " (kept)" : "");
+    return rc == 0 ? 0 : 1;
+}
+
+// --free-space: wipe what a mounted filesystem has free, leaving its files.
+static int freespace_main(const struct wipe_opts *o, const char *dir) {
+    struct pass_pattern passes[SMART_PASSES];
+    int npasses = file_passes(o, passes);
+    if (npasses < 0) return 1;
+    struct stat st;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "%s is not a directory\n", dir);
         return 1;
     }
-    printf("Disk length: %llu bytes (~%llu MB)\n", disk_len, disk_len / (1024ULL*1024ULL));
 
-    void *buf;
-    if (posix_memalign(&buf, 4096, BUF_SIZE) != 0) {
-        fprintf(stderr, "posix_memalign failed\n");
-        close(fd);
+    printf("WARNING: This will fill the free space of the filesystem holding %s\n", dir);
+    printf("Reserve: %llu MB left free for other processes\n", o->reserve / (1024 * 1024));
+    printf("Passes: %s%s\n", o->smartMode ? "3 (0x00, 0xFF, random)" : "1 (zeros)",
+           o->slack ? ", also over the slack after EOF" : "");
+    printf("Engine: %s (%u filler%s at once)\n", engine_name(o->engine), o->threads, o->threads == 1 ? "" : "s");
+    if (!confirm()) return 1;
+
+    journal_catch_signals();
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    struct progress_opts popts = {
+        .interval = o->progressInterval,
+        .human = 1,
+        .json_fd = o->progressFd,
+        .prom_path = o->promPath,
+    };
+    if (progress_start(&popts) != 0) return 1;
+    struct progress_job *pj = progress_job_add(dir, "");
+    progress_phase(pj, "fill", 0, 0, PROGRESS_WRITTEN, 0, 0);
+
+    struct freespace_opts fo = {
+        .passes = passes,
+        .npasses = npasses,
+        .threads = o->threads,
+        .engine = o->engine,
+        .depth = o->qd,
+        .chunk = o->chunk,
+        .reserve = o->reserve,
+        .slack = o->slack,
+        .cancel = journal_interrupt_flag(),
+        .progress = pj,
+    };
+    struct freespace_totals t;
+    double t0 = now_seconds();
+    int rc = freespace_wipe(dir, &fo, &t);
+    double secs = now_seconds() - t0;
+    progress_job_end(pj, rc == 0 ? "OK" : rc == ENGINE_CANCELLED ? "cancelled" : "failed");
+    progress_stop();
+
+    printf("Free space: %.1f MB at the start; %.1f MB overwritten, %d pass%s, %.1f s (%.1f MB/s)\n",
+           t.free_before / (1024.0 * 1024.0), t.filled / (1024.0 * 1024.0), npasses, npasses == 1 ? "" : "es",
+           secs, secs > 0 ? t.filled * (double)npasses / (1024.0 * 1024.0) / secs : 0);
+    if (o->slack && !t.slack_skipped)
+        printf("Slack: %.1f KB after EOF in %llu file%s; %llu failed\n", t.slack_bytes / 1024.0, t.slack_files,
+               t.slack_files == 1 ? "" : "s", t.slack_failed);
+    if (rc == 0)
+        printf("The last %llu MB of free space (the reserve) were not overwritten\n", o->reserve / (1024 * 1024));
+    if (t.pressure)
+        printf("Stopped early: other processes needed the space. Run again when the filesystem is quieter.\n");
+    else if (rc == ENGINE_CANCELLED) printf("Interrupted; the fillers were removed.\n");
+    printf("I/O buffers: %s\n", buffer_impl());
+    printf("Clear operation finished. Mode: FREE SPACE.\n");
+    return rc == 0 ? 0 : 1;
+}
+
+// devices: every disk discovery finds and the policy a full clear of it
+// would get. The menu script shows this before asking which to wipe.
+static int list_devices(void) {
+    struct topology t[MAX_DEVICES];
+    int n = topology_list(t, MAX_DEVICES);
+    if (n < 0) {
+        fprintf(stderr, "Cannot read /sys/block: %s\n", strerror(errno));
         return 1;
     }
-    memset(buf, 0, BUF_SIZE);
+    if (n == 0) {
+        fprintf(stderr, "No disks found\n");
+        return 1;
+    }
+    printf("%-10s %10s  %-8s %-9s %-24s %-20s %-6s %s\n", "DEVICE", "SIZE", "MEDIA", "TRANSPORT", "MODEL", "SERIAL",
+           "IN USE", "POLICY");
+    for (int i = 0; i < n; i++) {
+        struct media_policy p;
+        char policy[96];
+        if (topology_policy(&t[i], &p) != 0) snprintf(policy, sizeof(policy), "defaults");
+        else if (p.offload != OFFLOAD_NONE) snprintf(policy, sizeof(policy), "one %s pass", offload_name(p.offload));
+        else
+            snprintf(policy, sizeof(policy), "%s, %zu KB x %u deep, %u thread%s%s", engine_name(p.engine),
+                     p.chunk / 1024, p.depth, p.threads, p.threads == 1 ? "" : "s", p.tune ? ", tuned" : "");
+        printf("%-10s %7.1f GB  %-8s %-9s %-24.24s %-20.20s %-6s %s\n", t[i].name, t[i].size / 1e9, p.media,
+               t[i].transport, t[i].model[0] ? t[i].model : "-", t[i].serial[0] ? t[i].serial : "-",
+               t[i].in_use ? "yes" : "no", policy);
+    }
+    return 0;
+}
 
-    printf("Starting overwrite%s ...\n", testMode ? " (test: single chunk)" : "");
-    unsigned long long total_written = 0;
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
 
-    if (testMode) {
-        ssize_t w = pwrite(fd, buf, BUF_SIZE, 0);
-        if (w < 0) perror("Test write failed");
-        else {
-            total_written += w;
-            printf("[TEST] %zd bytes written.\n", w);
+    const char *devPaths[argc];
+    int ndev = 0, reserveGiven = 0;
+    const char *certKeyPath = NULL;
+    int interleave = 0;
+    int regionGiven = 0;
+    unsigned long long region = DEFAULT_REGION_MB * 1024ULL * 1024;
+    unsigned char certKey[DIGEST_KEY_SIZE];
+    struct wipe_opts opts = {
+        .engine = ENGINE_URING,
+        .qd = DEFAULT_QD,
+        .threads = 1,
+        .lag = DEFAULT_LAG_MB * 1024ULL * 1024,
+        .grain = DEFAULT_GRAIN_KB * 1024,
+        .chunk = BUF_SIZE,
+        .progressInterval = DEFAULT_PROGRESS_SECONDS,
+        .progressFd = -1,
+        .heatmapRegion = DEFAULT_HEATMAP_REGION_MB * 1024ULL * 1024,
+        .maxBad = DEFAULT_MAX_BAD_MB * 1024ULL * 1024,
+        .sweep = 1,
+        .reserve = DEFAULT_RESERVE_MB * 1024ULL * 1024,
+        .mediaPolicy = 1,
+    };
+    // The mode may be named by a subcommand; without one the run is a full
+    // clear, or whatever --smart, --files or --free-space say.
+    const char *cmd = argv[1];
+    int first = 2;
+    if (strcmp(cmd, "devices") == 0) {
+        if (argc > 2) {
+            fprintf(stderr, "devices takes no arguments\n");
+            return 1;
         }
-        fsync(fd);
-    } else {
-        unsigned long long remaining = disk_len;
-        off_t offset = 0;
-        while (remaining > 0) {
-            size_t to_write = (remaining >= BUF_SIZE) ? BUF_SIZE : remaining;
-            ssize_t w = pwrite(fd, buf, to_write, offset);
-            if (w < 0) {
-                perror("Write failed");
-                break;
+        return list_devices();
+    }
+    if (strcmp(cmd, "purge") == 0) opts.purgeMode = 1;
+    else if (strcmp(cmd, "smart") == 0) opts.smartMode = 1;
+    else if (strcmp(cmd, "verify") == 0) opts.verifyOnly = opts.verifyMode = 1;
+    else if (strcmp(cmd, "files") == 0) opts.filesMode = 1;
+    else if (strcmp(cmd, "free-space") == 0) opts.freeSpaceMode = 1;
+    else if (strcmp(cmd, "clear") != 0) first = 1;
+    for (int i = first; i < argc; i++) {
+        if (strcmp(argv[i], "--test") == 0) opts.testMode = 1;
+        else if (strcmp(argv[i], "--verify") == 0) opts.verifyMode = 1;
+        else if (strcmp(argv[i], "--direct") == 0) opts.directMode = 1;
+        else if (strcmp(argv[i], "--pipeline") == 0) opts.pipelineMode = 1;
+        else if (strcmp(argv[i], "--smart") == 0) opts.smartMode = 1;
+        else if (strcmp(argv[i], "--fs") == 0) opts.fsMode = 1;
+        else if (strcmp(argv[i], "--no-sweep") == 0) opts.sweep = 0;
+        else if (strcmp(argv[i], "--resume") == 0) opts.resume = 1;
+        else if (strcmp(argv[i], "--autotune") == 0) opts.autotune = opts.autotune ? opts.autotune : 1;
+        else if (strcmp(argv[i], "--retune") == 0) opts.autotune = 2;
+        else if (strcmp(argv[i], "--latency") == 0) opts.latency = 1;
+        else if (strcmp(argv[i], "--no-auto") == 0) opts.mediaPolicy = 0;
+        else if (strcmp(argv[i], "--files") == 0) opts.filesMode = 1;
+        else if (strcmp(argv[i], "--keep") == 0) opts.keep = 1;
+        else if (strcmp(argv[i], "--free-space") == 0) opts.freeSpaceMode = 1;
+        else if (strcmp(argv[i], "--slack") == 0) opts.slack = 1;
+        else if (strcmp(argv[i], "--reserve") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 16 || v > 1024 * 1024) {
+                fprintf(stderr, "Reserve must be between 16 and 1048576 MB\n");
+                return 1;
+            }
+            opts.reserve = (unsigned long long)v * 1024 * 1024;
+            reserveGiven = 1;
+        }
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) opts.reportPath = argv[++i];
+        else if (strcmp(argv[i], "--bad-log") == 0 && i + 1 < argc) opts.badLog = argv[++i];
+        else if (strcmp(argv[i], "--cert") == 0 && i + 1 < argc) opts.certPath = argv[++i];
+        else if (strcmp(argv[i], "--cert-key") == 0 && i + 1 < argc) certKeyPath = argv[++i];
+        else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 1 || v > 1000000) {
+                fprintf(stderr, "Sample must be between 1 and 1000000 blocks\n");
+                return 1;
             }
-            remaining -= w;
-            offset += w;
-            total_written += w;
-            if ((total_written % (256ULL * 1024 * 1024)) == 0) {
-                printf("... %llu MB written\n", total_written / (1024ULL*1024ULL));
+            opts.sample = (unsigned long long)v;
+            opts.verifyMode = 1;
+        }
+        else if (strcmp(argv[i], "--max-bad") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 1 || v > 1024 * 1024) {
+                fprintf(stderr, "Max bad must be between 1 and 1048576 MB\n");
+                return 1;
+            }
+            opts.maxBad = (unsigned long long)v * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--heatmap-region") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 1 || v > 1024 * 1024) {
+                fprintf(stderr, "Heatmap region must be between 1 and 1048576 MB\n");
+                return 1;
+            }
+            opts.heatmapRegion = (unsigned long long)v * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) opts.journalPath = argv[++i];
+        else if (strcmp(argv[i], "--prom") == 0 && i + 1 < argc) opts.promPath = argv[++i];
+        else if (strcmp(argv[i], "--progress-fd") == 0 && i + 1 < argc) {
+            int v = atoi(argv[++i]);
+            if (v < 1 || fcntl(v, F_GETFD) < 0) {
+                fprintf(stderr, "--progress-fd %d is not an open file descriptor\n", v);
+                return 1;
+            }
+            opts.progressFd = v;
+        }
+        else if (strcmp(argv[i], "--progress-interval") == 0 && i + 1 < argc) {
+            double v = atof(argv[++i]);
+            if (v < 0.1 || v > 3600) {
+                fprintf(stderr, "Progress interval must be between 0.1 and 3600 seconds\n");
+                return 1;
+            }
+            opts.progressInterval = v;
+        }
+        else if (strcmp(argv[i], "--offload") == 0 && i + 1 < argc) {
+            const char *k = argv[++i];
+            if (strcmp(k, "auto") == 0) opts.offload = OFFLOAD_AUTO;
+            else if (strcmp(k, "zeroout") == 0) opts.offload = OFFLOAD_ZEROOUT;
+            else if (strcmp(k, "discard") == 0) opts.offload = OFFLOAD_DISCARD;
+            else if (strcmp(k, "secdiscard") == 0) opts.offload = OFFLOAD_SECDISCARD;
+            else {
+                fprintf(stderr, "Unknown offload '%s'\n", k);
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--grain") == 0 && i + 1 < argc) {
+            long v = atol(argv[++i]);
+            if (v < 4 || v > 1024 || (v & (v - 1)) != 0) {
+                fprintf(stderr, "Grain must be a power of two between 4 and 1024 KB\n");
+                return 1;
+            }
+            opts.grain = (size_t)v * 1024;
+        }
+        else if (strcmp(argv[i], "--order") == 0 && i + 1 < argc) {
+            const char *k = argv[++i];
+            if (strcmp(k, "sweep") == 0) interleave = 0;
+            else if (strcmp(k, "interleave") == 0) interleave = 1;
+            else {
+                fprintf(stderr, "Unknown order '%s'\n", k);
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--region") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 1 || v > 1024 * 1024) {
+                fprintf(stderr, "Region must be between 1 and 1048576 MB\n");
+                return 1;
+            }
+            region = (unsigned long long)v * 1024 * 1024;
+            regionGiven = 1;
+        }
+        else if (strcmp(argv[i], "--lag") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 16 || v > 1024 * 1024) {
+                fprintf(stderr, "Lag must be between 16 and 1048576 MB\n");
+                return 1;
             }
+            opts.lag = (unsigned long long)v * 1024 * 1024;
         }
-        fsync(fd);
+        else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char *e = argv[++i];
+            if (strcmp(e, "sync") == 0) opts.engine = ENGINE_SYNC;
+            else if (strcmp(e, "uring") == 0) opts.engine = ENGINE_URING;
+            else {
+                fprintf(stderr, "Unknown engine '%s'\n", e);
+                usage(argv[0]);
+                return 1;
+            }
+            opts.engineGiven = 1;
+        } else if (strcmp(argv[i], "--qd") == 0 && i + 1 < argc) {
+            int v = atoi(argv[++i]);
+            if (v < 1 || v > 4096) {
+                fprintf(stderr, "Queue depth must be between 1 and 4096\n");
+                return 1;
+            }
+            opts.qd = (unsigned)v;
+            opts.qdGiven = 1;
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            int v = atoi(argv[++i]);
+            if (v < 1 || v > 256) {
+                fprintf(stderr, "Chunk must be between 1 and 256 MB\n");
+                return 1;
+            }
+            opts.chunk = (size_t)v * 1024 * 1024;
+            opts.chunkGiven = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int v = atoi(argv[++i]);
+            if (v < 1 || v > 256) {
+                fprintf(stderr, "Thread count must be between 1 and 256\n");
+                return 1;
+            }
+            opts.threads = (unsigned)v;
+            opts.threadsGiven = 1;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        } else {
+            devPaths[ndev++] = argv[i];
+        }
+    }
+    if (ndev == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (opts.certPath && (opts.freeSpaceMode || opts.filesMode)) {
+        fprintf(stderr, "--cert applies to devices only\n");
+        return 1;
+    }
+    if (certKeyPath) {
+        if (!opts.certPath) {
+            fprintf(stderr, "--cert-key needs --cert\n");
+            return 1;
+        }
+        if (cert_read_key(certKeyPath, certKey) != 0) return 1;
+        opts.certKey = certKey;
+    }
+    if ((interleave || regionGiven) && ((!opts.purgeMode && !opts.smartMode) ||
+                                     opts.filesMode || opts.freeSpaceMode)) {
+        fprintf(stderr, "--order and --region apply to purge and smart only\n");
+        return 1;
+    }
+    if (regionGiven && !interleave) {
+        fprintf(stderr, "--region needs --order interleave\n");
+        return 1;
+    }
+    opts.region = interleave ? region : 0;
+    if (opts.freeSpaceMode) {
+        if (opts.filesMode || opts.keep || opts.reportPath || ndev != 1 || opts.testMode || opts.verifyMode ||
+            opts.directMode || opts.pipelineMode || opts.fsMode || opts.resume || opts.autotune ||
+            opts.offload != OFFLOAD_NONE || opts.journalPath || opts.latency || !opts.mediaPolicy) {
+            fprintf(stderr, "--free-space takes one directory and only --smart, --reserve, --slack, --engine,\n"
+                            "--qd, --threads, --chunk and the progress options\n");
+            return 1;
+        }
+        if (!opts.threadsGiven) opts.threads = FILL_THREADS;
+        return freespace_main(&opts, devPaths[0]);
+    }
+    if (opts.slack || reserveGiven) {
+        fprintf(stderr, "--reserve and --slack apply to --free-space only\n");
+        return 1;
+    }
+    if (opts.filesMode) {
+        if (opts.testMode || opts.verifyMode || opts.directMode || opts.pipelineMode || opts.fsMode ||
+            opts.resume || opts.autotune || opts.offload != OFFLOAD_NONE || opts.journalPath || opts.latency ||
+            !opts.mediaPolicy) {
+            fprintf(stderr, "--files takes only --smart, --keep, --report, --engine, --qd, --threads, --chunk\n"
+                            "and the progress options\n");
+            return 1;
+        }
+        if (!opts.threadsGiven) opts.threads = SHRED_THREADS;
+        return shred_main(&opts, devPaths, ndev);
+    }
+    if (opts.keep || opts.reportPath) {
+        fprintf(stderr, "--keep and --report apply to --files only\n");
+        return 1;
+    }
+    if (ndev > MAX_DEVICES) {
+        fprintf(stderr, "Too many devices (max %d)\n", MAX_DEVICES);
+        return 1;
+    }
+    if (opts.journalPath && ndev > 1) {
+        fprintf(stderr, "--journal names one file; with several devices each gets its own default journal\n");
+        return 1;
+    }
+    if (opts.resume && (opts.smartMode || opts.purgeMode || opts.fsMode || opts.offload != OFFLOAD_NONE || opts.testMode)) {
+        fprintf(stderr, "--resume applies to full clears only\n");
+        return 1;
+    }
+    if (opts.sample && (opts.smartMode || opts.fsMode || opts.testMode || opts.pipelineMode)) {
+        fprintf(stderr, "--sample applies to full clears only and replaces --pipeline\n");
+        return 1;
+    }
+    if (opts.purgeMode && (opts.smartMode || opts.fsMode || opts.pipelineMode || opts.sample || opts.autotune ||
+                           opts.offload != OFFLOAD_NONE)) {
+        fprintf(stderr, "purge writes its passes over the whole device; it takes no --smart, --fs, --pipeline,\n"
+                        "--sample, --autotune or --offload\n");
+        return 1;
+    }
+    if (opts.verifyOnly && (opts.testMode || opts.smartMode || opts.fsMode || opts.pipelineMode || opts.resume ||
+                            opts.autotune || opts.offload != OFFLOAD_NONE || opts.journalPath)) {
+        fprintf(stderr, "verify only reads; it takes no --test, --smart, --fs, --pipeline, --resume, --journal,\n"
+                        "--autotune or --offload\n");
+        return 1;
+    }
+    if (opts.autotune && (opts.smartMode || opts.fsMode)) {
+        // The probes overwrite the start of the device, which --smart and
+        // --fs still have to read.
+        fprintf(stderr, "--autotune applies to full clears only\n");
+        return 1;
+    }
+    if (opts.offload != OFFLOAD_NONE && (opts.smartMode || opts.fsMode)) {
+        fprintf(stderr, "--offload clears the whole device and cannot be combined with --smart or --fs\n");
+        return 1;
     }
 
-    printf("Overwrite complete. Total bytes written: %llu\n", total_written);
+    for (int d = 0; d < ndev; d++) {
+        struct topology tp;
+        char what[128] = "";
+        if (topology_path(devPaths[d], &tp) == 0)
+            snprintf(what, sizeof(what), " (%s%s%.1f GB on %s)", tp.model, tp.model[0] ? ", " : "",
+                     tp.size / 1e9, tp.transport);
+        if (opts.verifyOnly) printf("Reading back %s%s; nothing is written\n", devPaths[d], what);
+        else printf("WARNING: This will overwrite data on %s%s\n", devPaths[d], what);
+        if (tp.in_use && !opts.verifyOnly)
+            printf("WARNING: %s is in use: it or a partition on it is mounted, swap, or under dm/md\n", devPaths[d]);
+    }
+    if (opts.purgeMode) printf("Purge: YES (%d passes over the whole device)\n", SMART_PASSES);
+    if (opts.region)
+        printf("Pass order: interleaved, every pass over each %llu MB region before the next\n",
+               opts.region / (1024ULL*1024ULL));
+    if (opts.smartMode)
+        printf("Smart purge: YES (%zu KiB grain, %d passes over the parts holding data)\n",
+               opts.grain / 1024, SMART_PASSES);
+    if (opts.fsMode)
+        printf("Filesystem-aware: YES (allocated blocks and metadata first%s)\n",
+               opts.smartMode ? "" : opts.sweep ? ", then the rest" : ", no sweep");
+    if (!opts.verifyOnly)
+        printf("Test mode: %s\n", !opts.testMode ? "NO (full wipe)" : opts.smartMode ? "YES (scan only)" : "YES (single chunk)");
+    printf("Verify mode: %s", opts.verifyMode ? "YES" : "NO");
+    if (opts.verifyMode) printf(" (%s check)", memcheck_impl());
+    if (opts.sample) printf(", sampled: %llu random blocks plus fixed regions", opts.sample);
+    if (opts.verifyMode && opts.pipelineMode && !opts.smartMode) printf(", pipelined %llu MB behind the writer", opts.lag / (1024ULL*1024ULL));
+    printf("\n");
+    if (opts.offload != OFFLOAD_NONE) printf("Offload: %s (falls back to writes per range)\n", offload_name(opts.offload));
+    if (!opts.verifyOnly) printf("Direct I/O: %s\n", opts.directMode ? "YES (O_DIRECT, cache bypassed)" : "NO (O_SYNC)");
+    else if (opts.directMode) printf("Direct I/O: YES (O_DIRECT, reads bypass the cache)\n");
+    printf("Engine: %s (queue depth %u, %u thread%s)\n", engine_name(opts.engine),
+           opts.engine == ENGINE_URING ? opts.qd : 1, opts.threads, opts.threads == 1 ? "" : "s");
+    if (opts.mediaPolicy) printf("Media policy: YES (disks get what is not given from their topology)\n");
+    if (opts.certPath) {
+        printf("Certificate: %s%s", opts.certPath, opts.certKey ? " (MAC in .sig)" : "");
+        if (opts.verifyMode && !opts.sample && !opts.smartMode && !opts.fsMode)
+            printf(", read-back BLAKE3%s (%s)", opts.purgeMode ? " of the last pass" : "", digest_impl());
+        printf("\n");
+    }
+    if (!opts.verifyOnly && !confirm()) return 1;
+    time_t started = time(NULL);
+
+    // Ctrl-C and SIGTERM stop every job at its next request: every wipe_io
+    // carries the flag, and a journaled clear keeps its last checkpoint.
+    journal_catch_signals();
 
-    if (verifyMode) {
-        printf("Starting verification (this will take a while)...\n");
-        unsigned long long total_read = 0;
-        int ok = 1;
-        while (1) {
-            ssize_t r = pread(fd, buf, BUF_SIZE, total_read);
-            if (r < 0) {
-                perror("Read failed");
-                ok = 0;
+    struct wipe_job *jobs = calloc(ndev, sizeof(*jobs));
+    if (!jobs) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    // Line-buffer stdout so progress from every device streams as it
+    // happens even when the output is piped to a log.
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    // Block SIGUSR1 before any thread starts so only the dumper takes it.
+    static sigset_t usr1;
+    if (opts.latency) {
+        pthread_t dumper;
+        sigemptyset(&usr1);
+        sigaddset(&usr1, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &usr1, NULL);
+        if (pthread_create(&dumper, NULL, latency_dumper, &usr1) == 0) pthread_detach(dumper);
+        else fprintf(stderr, "No latency dump thread; reports come at the end only\n");
+    }
+    struct progress_opts popts = {
+        .interval = opts.progressInterval,
+        .human = 1,
+        .json_fd = opts.progressFd,
+        .prom_path = opts.promPath,
+    };
+    if (progress_start(&popts) != 0) {
+        free(jobs);
+        return 1;
+    }
+    for (int d = 0; d < ndev; d++) {
+        jobs[d].path = devPaths[d];
+        jobs[d].opts = &opts;
+        if (ndev > 1) snprintf(jobs[d].tag, sizeof(jobs[d].tag), "[%s] ", devPaths[d]);
+        jobs[d].progress = progress_job_add(devPaths[d], jobs[d].tag);
+    }
+    pthread_mutex_lock(&report_lock);
+    all_jobs = jobs;
+    all_jobs_count = ndev;
+    pthread_mutex_unlock(&report_lock);
+
+    int failed = 0;
+    if (ndev == 1) {
+        double t0 = now_seconds();
+        wipe_device(&jobs[0]);
+        jobs[0].seconds = now_seconds() - t0;
+        progress_stop();
+        failed = strcmp(jobs[0].status, "OK") != 0;
+    } else {
+        int started = 0;
+        for (; started < ndev; started++) {
+            if (pthread_create(&jobs[started].tid, NULL, job_main, &jobs[started]) != 0) {
+                fprintf(stderr, "Failed to start job for %s\n", jobs[started].path);
                 break;
             }
-            if (r == 0) break;
-            unsigned char *b = buf;
-            for (ssize_t i = 0; i < r; i++) {
-                if (b[i] != 0x00) {
-                    fprintf(stderr, "Verification failed: non-zero byte at offset %llu (0x%02X)\n",
-                            total_read + i, b[i]);
-                    ok = 0;
-                    break;
-                }
-            }
-            if (!ok) break;
-            total_read += r;
-            if ((total_read % (256ULL * 1024 * 1024)) == 0) {
-                printf("... %llu MB verified\n", total_read / (1024ULL*1024ULL));
-            }
         }
-        if (ok) {
-            printf("Verification succeeded: all bytes zero.\n");
+        for (int d = 0; d < started; d++) pthread_join(jobs[d].tid, NULL);
+        for (int d = started; d < ndev; d++) {
+            jobs[d].status = "not started";
+            progress_job_end(jobs[d].progress, jobs[d].status);
+        }
+        progress_stop();
+
+        printf("\n%-24s %-18s %16s %16s %10s\n", "Device", "Result", "Written", "Verified", "MB/s");
+        for (int d = 0; d < ndev; d++) {
+            struct wipe_job *j = &jobs[d];
+            double mbps = j->seconds > 0 ? (j->written + j->verified) / (1024.0 * 1024.0) / j->seconds : 0;
+            printf("%-24s %-18s %16llu %16llu %10.1f\n", j->path, j->status, j->written, j->verified, mbps);
+            if (strcmp(j->status, "OK") != 0) failed++;
         }
+        printf("%d of %d device%s wiped successfully.\n", ndev - failed, ndev, ndev == 1 ? "" : "s");
     }
 
-    free(buf);
-    close(fd);
+    if (opts.certPath && write_certificate(&opts, jobs, ndev, started) != 0) failed++;
+
+    pthread_mutex_lock(&report_lock);
+    for (int d = 0; d < ndev; d++) {
+        lat_log_free(jobs[d].lat);
+        bad_list_free(jobs[d].bad);
+    }
+    all_jobs_count = 0;
+    pthread_mutex_unlock(&report_lock);
+    free(jobs);
+    printf("I/O buffers: %s\n", buffer_impl());
     printf("Clear operation finished. Mode: %s. Verify: %s\n",
-           testMode ? "TEST" : "FULL CLEAR",
-           verifyMode ? "ENABLED" : "DISABLED");
-    return 0;
+           mode_name(&opts),
+           opts.verifyMode ? "ENABLED" : "DISABLED");
+    return failed ? 1 : 0;
 }
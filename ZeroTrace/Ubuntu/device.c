@@ -0,0 +1,66 @@
+// device.c
+// Target size and sector geometry via the block-device ioctls; the rest of
+// what the kernel knows about a block device comes from sysfs (topology.c).
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#include "device.h"
+
+int device_open(struct device *d, const char *path, int flags) {
+    memset(d, 0, sizeof(*d));
+    d->fd = open(path, flags);
+    if (d->fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(d->fd, &st) != 0) {
+        fprintf(stderr, "fstat %s failed: %s\n", path, strerror(errno));
+        device_close(d);
+        return -1;
+    }
+
+    if (S_ISBLK(st.st_mode)) {
+        d->is_block = 1;
+        if (ioctl(d->fd, BLKGETSIZE64, &d->size) != 0) {
+            fprintf(stderr, "BLKGETSIZE64 on %s failed: %s\n", path, strerror(errno));
+            device_close(d);
+            return -1;
+        }
+        int lbs = 0;
+        unsigned int pbs = 0;
+        if (ioctl(d->fd, BLKSSZGET, &lbs) != 0 || lbs <= 0) lbs = 512;
+        if (ioctl(d->fd, BLKPBSZGET, &pbs) != 0 || pbs == 0) pbs = (unsigned)lbs;
+        d->logical_block = (unsigned)lbs;
+        d->physical_block = pbs;
+        topology_read(st.st_rdev, &d->topo);
+    } else if (S_ISREG(st.st_mode)) {
+        // Disk images: the filesystem block size is what O_DIRECT needs.
+        d->size = (unsigned long long)st.st_size;
+        d->logical_block = st.st_blksize > 0 ? (unsigned)st.st_blksize : 4096;
+        d->physical_block = d->logical_block;
+    } else {
+        fprintf(stderr, "%s is not a block device or image file\n", path);
+        device_close(d);
+        return -1;
+    }
+    return 0;
+}
+
+void device_close(struct device *d) {
+    if (d->fd >= 0) close(d->fd);
+    d->fd = -1;
+}
+
+unsigned device_io_align(const struct device *d) {
+    return d->physical_block > d->logical_block ? d->physical_block : d->logical_block;
+}
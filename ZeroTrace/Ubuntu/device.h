@@ -0,0 +1,26 @@
+// device.h
+// Opening the wipe target and querying its size and sector geometry.
+
+#ifndef ZT_DEVICE_H
+#define ZT_DEVICE_H
+
+#include "topology.h"
+
+struct device {
+    int fd;
+    int is_block;                  // block device (vs. regular image file)
+    unsigned long long size;       // BLKGETSIZE64, or st_size for files
+    unsigned logical_block;        // BLKSSZGET: smallest addressable unit
+    unsigned physical_block;       // BLKPBSZGET: unit the media writes in
+    struct topology topo;          // sysfs: queue limits, identity, bus (zeroed for files)
+};
+
+// Open path with the given open(2) flags and fill in size and geometry.
+// Prints the reason and returns -1 on failure.
+int device_open(struct device *d, const char *path, int flags);
+void device_close(struct device *d);
+
+// Alignment to use for buffers, offsets and lengths when doing direct I/O.
+unsigned device_io_align(const struct device *d);
+
+#endif
@@ -0,0 +1,830 @@
+// engine.c
+// Synchronous and io_uring overwrite / verify loops, optionally split over
+// several worker threads that each own an interleaved set of stripes.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "engine.h"
+#include "readback.h"
+#include "uring.h"
+#include "../common/badrange.h"
+#include "../common/buffers.h"
+#include "../common/latency.h"
+#include "../common/memcheck.h"
+#include "../common/pattern.h"
+#include "../common/progress.h"
+
+// State shared by every worker of one engine_write / engine_verify call.
+struct run_state {
+    const struct wipe_io *io;
+    int is_write;
+    size_t chunk;                  // request size: io->chunk, capped for buffered requests
+    const void *tile;              // fixed-byte writes repeat this; NULL when requests carry data
+    struct readback *digest;       // checked reads are handed over here (verify runs only)
+    unsigned long long nchunks;
+    unsigned long long done;       // bytes completed by all workers (atomic)
+    unsigned long long bad_off;    // lowest mismatching offset seen so far
+    unsigned char bad_byte;
+    int warned;                    // io_uring fallback already announced
+    pthread_mutex_t lock;
+};
+
+static const char *tag(const struct wipe_io *io) {
+    return io->tag ? io->tag : "";
+}
+
+// Worker `index` of `count` owns chunks index, index + count, index + 2*count...
+// so every worker streams across the whole device and the drive sees
+// requests spread over all of its queues rather than one hot region.
+struct stripe {
+    unsigned long long next;       // next chunk index to hand out
+    unsigned count;
+};
+
+// One in-flight request: where it goes and how much of it is still pending.
+struct slot {
+    unsigned long long off;   // start of the request on the device
+    size_t len;               // full request length
+    size_t done;              // bytes completed so far (short I/O is resubmitted)
+    size_t lost;              // bytes given up on as bad
+    unsigned long long issued; // lat_now_ns() when first queued, with io->latency set
+    int busy;
+};
+
+const char *engine_name(enum io_engine e) {
+    switch (e) {
+    case ENGINE_SYNC:  return "sync";
+    case ENGINE_URING: return "io_uring";
+    }
+    return "?";
+}
+
+static int stripe_next(const struct run_state *rs, struct stripe *sp,
+                       unsigned long long *off, size_t *len) {
+    const struct wipe_io *io = rs->io;
+    if (sp->next >= rs->nchunks) return 0;
+    if (io->cancel && *io->cancel) return 0;
+    if (io->ranges) {
+        *off = io->ranges[sp->next].off;
+        *len = io->ranges[sp->next].len;
+        sp->next += sp->count;
+        return 1;
+    }
+    unsigned long long rel = sp->next * rs->chunk;
+    unsigned long long remaining = io->len - rel;
+    *off = io->start + rel;
+    *len = (remaining >= rs->chunk) ? rs->chunk : (size_t)remaining;
+    sp->next += sp->count;
+    return 1;
+}
+
+// Add completed bytes to the shared total and to the job's progress; the
+// reporter thread turns those into progress lines, never this loop.
+static void account(struct run_state *rs, unsigned long long n) {
+    __atomic_fetch_add(&rs->done, n, __ATOMIC_RELAXED);
+    progress_add(rs->io->progress, rs->is_write ? PROGRESS_WRITTEN : PROGRESS_VERIFIED, n);
+}
+
+// Keep the lowest mismatching offset across all workers, so the final report
+// names the first bad byte on the device just like a sequential pass would.
+static void note_mismatch(struct run_state *rs, unsigned long long off, unsigned char byte) {
+    pthread_mutex_lock(&rs->lock);
+    if (off < rs->bad_off) {
+        __atomic_store_n(&rs->bad_off, off, __ATOMIC_RELAXED);
+        rs->bad_byte = byte;
+    }
+    pthread_mutex_unlock(&rs->lock);
+}
+
+// Once a mismatch is known, nothing above it can change the answer.
+static int past_mismatch(struct run_state *rs, unsigned long long off) {
+    return off >= __atomic_load_n(&rs->bad_off, __ATOMIC_RELAXED);
+}
+
+// Iovecs repeating tile over len bytes, at most IOV_MAX of them (a
+// 256 MiB request fits). Returns how many were used.
+static int tile_iov(struct iovec *iov, const void *tile, size_t len) {
+    int n = 0;
+    while (len && n < IOV_MAX) {
+        size_t l = len < BUFFER_TILE ? len : BUFFER_TILE;
+        iov[n].iov_base = (void *)tile;
+        iov[n].iov_len = l;
+        len -= l;
+        n++;
+    }
+    return n;
+}
+
+// Contents of a request at off under the run's pass pattern. Workers are
+// already parallel, so random data is generated on the calling thread.
+static void fill_chunk(const struct wipe_io *io, void *buf, unsigned long long off, size_t len) {
+    if (io->pattern->random) pattern_fill(&io->pattern->key, off, buf, len);
+    else memset(buf, io->pattern->byte, len);
+}
+
+// Index of the first byte read back at off that is not what was written.
+static size_t check_chunk(const struct wipe_io *io, const void *b, unsigned long long off, size_t len) {
+    return io->pattern ? pass_check(io->pattern, off, b, len) : mem_find_not_byte(b, len, 0x00);
+}
+
+// Retry and bisection after a media error, through plain pwrite / pread.
+struct recovery {
+    struct bad_io x;
+    const struct wipe_io *io;
+    const void *tile;         // fixed-byte writes come from here, not buf
+};
+
+static int recover_transfer(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len) {
+    const struct recovery *rec = (const struct recovery *)x;
+    const struct wipe_io *io = rec->io;
+    struct iovec iov[IOV_MAX];
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = rec->tile
+            ? pwritev(io->fd, iov, tile_iov(iov, rec->tile, len - got), (off_t)(off + got))
+            : x->kind == BAD_WRITE
+            ? pwrite(io->fd, (char *)buf + got, len - got, (off_t)(off + got))
+            : pread(io->fd, (char *)buf + got, len - got, (off_t)(off + got));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return r < 0 ? errno : EIO;
+        got += (size_t)r;
+    }
+    return 0;
+}
+
+// An unreadable hole holds what should have been there, so the check of
+// the rest of the request passes over it.
+static void recover_lost(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len) {
+    const struct wipe_io *io = ((struct recovery *)x)->io;
+    if (x->kind == BAD_WRITE) return;
+    if (io->pattern) fill_chunk(io, buf, off, len);
+    else memset(buf, 0, len);
+}
+
+// A request failed at off with len bytes (from buf, or the run's tile) still
+// to go. With io->bad set, retry and bisect it. Returns 0 when the run can carry on,
+// with *lost bytes given up on; -1 when it has to stop.
+static int recover(struct run_state *rs, void *buf, unsigned long long off, size_t len, size_t *lost) {
+    const struct wipe_io *io = rs->io;
+    if (!io->bad) return -1;
+    struct recovery r = {
+        .x = {
+            .transfer = recover_transfer,
+            .lost = recover_lost,
+            .list = io->bad,
+            .kind = rs->is_write ? BAD_WRITE : BAD_READ,
+            .sector = io->sector ? io->sector : io->align,
+        },
+        .io = io,
+        .tile = rs->tile,
+    };
+    unsigned long long n = 0;
+    if (bad_salvage(&r.x, buf, off, len, &n) != 0) {
+        fprintf(stderr, "%sToo many bad sectors; giving up\n", tag(io));
+        return -1;
+    }
+    if (n)
+        fprintf(stderr, "%s%llu of %zu bytes at offset %llu could not be %s; carrying on\n", tag(io), n, len, off,
+                rs->is_write ? "written" : "read");
+    *lost += (size_t)n;
+    return 0;
+}
+
+// Index of the first unexpected byte of a request read back at off. Ranges
+// recorded as unwritable still hold whatever was there before, so they are
+// stepped over; *skipped receives their length.
+static size_t check_request(const struct wipe_io *io, const unsigned char *b, unsigned long long off, size_t len,
+                            size_t *skipped) {
+    size_t pos = 0;
+    for (;;) {
+        size_t i = pos + check_chunk(io, b + pos, off + pos, len - pos);
+        if (i >= len || !io->bad) return i;
+        unsigned long long end = bad_list_covering(io->bad, BAD_WRITE, off + i);
+        if (!end) return i;
+        pos = end - off < len ? (size_t)(end - off) : len;
+        *skipped += pos - i;
+    }
+}
+
+// Durability barrier: everything written so far must be on the medium.
+static int barrier(const struct wipe_io *io) {
+    if (fdatasync(io->fd) != 0) {
+        fprintf(stderr, "%sfdatasync failed: %s\n", tag(io), strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Synchronous engine
+
+static int sync_loop(struct run_state *rs, unsigned index, unsigned count) {
+    const struct wipe_io *io = rs->io;
+    const void *tile = rs->tile;
+    struct readback *dg = rs->digest;
+    void *buf = tile ? NULL : dg ? readback_buffer(dg, rs->chunk) : buffer_alloc(rs->chunk);
+    if (!tile && !buf) {
+        fprintf(stderr, "%sOut of memory for I/O buffers\n", tag(io));
+        return -1;
+    }
+    int per_chunk = rs->is_write && !tile;
+    struct iovec iov[IOV_MAX];
+
+    struct stripe sp = { index, count };
+    unsigned long long off, since_barrier = 0;
+    size_t len;
+    int rc = 0;
+
+    while (rc == 0 && stripe_next(rs, &sp, &off, &len)) {
+        if (!rs->is_write && past_mismatch(rs, off)) break;
+        if (per_chunk) fill_chunk(io, buf, off, len);
+
+        unsigned long long t0 = io->latency ? lat_now_ns() : 0;
+        size_t got = 0, lost = 0;
+        while (got < len) {
+            ssize_t r = tile
+                ? pwritev(io->fd, iov, tile_iov(iov, tile, len - got), (off_t)(off + got))
+                : rs->is_write
+                ? pwrite(io->fd, (char *)buf + got, len - got, (off_t)(off + got))
+                : pread(io->fd, (char *)buf + got, len - got, (off_t)(off + got));
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                fprintf(stderr, "%s%s failed at offset %llu: %s\n", tag(io),
+                        rs->is_write ? "Write" : "Read", off + got, strerror(errno));
+                rc = recover(rs, tile ? (void *)tile : (char *)buf + got, off + got, len - got, &lost);
+                break;
+            }
+            if (r == 0) {
+                fprintf(stderr, "%s%s failed: device returned no data at offset %llu\n", tag(io),
+                        rs->is_write ? "Write" : "Read", off + got);
+                rc = recover(rs, tile ? (void *)tile : (char *)buf + got, off + got, len - got, &lost);
+                break;
+            }
+            got += (size_t)r;
+        }
+        if (rc != 0) break;
+        if (io->latency) lat_record(io->latency, off, len, lat_now_ns() - t0);
+
+        if (!rs->is_write) {
+            const unsigned char *b = buf;
+            size_t i = check_request(io, b, off, len, &lost);
+            if (i < len) {
+                note_mismatch(rs, off + i, b[i]);
+                rc = 1;
+                break;
+            }
+            if (dg) {
+                readback_submit(dg, buf, rs->chunk, off, len);
+                buf = readback_buffer(dg, rs->chunk);
+                if (!buf) {
+                    fprintf(stderr, "%sOut of memory for I/O buffers\n", tag(io));
+                    rc = -1;
+                    break;
+                }
+            }
+        }
+        account(rs, len - lost);
+
+        if (rs->is_write && io->barrier) {
+            since_barrier += len;
+            if (since_barrier >= io->barrier) {
+                if (barrier(io) != 0) rc = -1;
+                since_barrier = 0;
+            }
+        }
+    }
+    if (rc == 0 && since_barrier && barrier(io) != 0) rc = -1;
+
+    if (dg) readback_release(dg, buf, rs->chunk);
+    else buffer_free(buf, rs->chunk);
+    return rc;
+}
+
+// ---------------------------------------------------------------------------
+// io_uring engine
+//
+// Zero and fixed-byte writes go out as WRITEV requests repeating the run's
+// tile, each slot with its own iovec array. Random-pattern writes and all
+// reads need a private buffer per slot, registered with the ring: the
+// former are generated for their own offset, the latter checked while
+// other reads are landing. With a read-back digest the read buffers change
+// hands after every request, so they are not registered.
+
+struct uring_run {
+    struct uring ring;
+    struct slot *slots;
+    void **bufs;        // one per slot, rs->chunk bytes (NULL when tiled)
+    struct iovec *iovs; // IOV_MAX per slot (tiled writes only)
+    unsigned nslots;
+    size_t buf_size;
+    int fixed;          // buffers registered; use *_FIXED opcodes
+    struct readback *dg; // bufs come from and go back to this
+};
+
+static void uring_run_free(struct uring_run *u) {
+    if (u->bufs) {
+        for (unsigned i = 0; i < u->nslots; i++) {
+            if (u->dg) readback_release(u->dg, u->bufs[i], u->buf_size);
+            else buffer_free(u->bufs[i], u->buf_size);
+        }
+        free(u->bufs);
+    }
+    free(u->iovs);
+    free(u->slots);
+    if (u->ring.fd >= 0) uring_exit(&u->ring);
+}
+
+// Returns 0 on success, 1 if io_uring is unavailable (caller falls back to
+// the synchronous engine), -1 on a hard error.
+static int uring_run_init(struct uring_run *u, struct run_state *rs) {
+    const struct wipe_io *io = rs->io;
+    memset(u, 0, sizeof(*u));
+    u->ring.fd = -1;
+
+    unsigned depth = io->depth ? io->depth : 1;
+    int err = uring_init(&u->ring, depth);
+    if (err < 0) {
+        if (!__atomic_exchange_n(&rs->warned, 1, __ATOMIC_RELAXED)) {
+            fprintf(stderr, "io_uring unavailable (%s); falling back to synchronous I/O\n",
+                    strerror(-err));
+        }
+        return 1;
+    }
+
+    u->nslots = depth < u->ring.entries ? depth : u->ring.entries;
+    u->slots = calloc(u->nslots, sizeof(*u->slots));
+    if (!u->slots) goto oom;
+    if (rs->tile) {
+        u->iovs = calloc((size_t)u->nslots * IOV_MAX, sizeof(*u->iovs));
+        if (!u->iovs) goto oom;
+        return 0;
+    }
+
+    u->buf_size = rs->chunk;
+    u->bufs = calloc(u->nslots, sizeof(*u->bufs));
+    if (!u->bufs) goto oom;
+    u->dg = rs->digest;
+    for (unsigned i = 0; i < u->nslots; i++) {
+        u->bufs[i] = u->dg ? readback_buffer(u->dg, u->buf_size) : buffer_alloc(u->buf_size);
+        if (!u->bufs[i]) goto oom;
+    }
+    if (u->dg) return 0;
+
+    struct iovec *iov = calloc(u->nslots, sizeof(*iov));
+    if (!iov) goto oom;
+    for (unsigned i = 0; i < u->nslots; i++) {
+        iov[i].iov_base = u->bufs[i];
+        iov[i].iov_len = u->buf_size;
+    }
+    // Registration can fail on older kernels with a small RLIMIT_MEMLOCK;
+    // plain READ/WRITE opcodes still give us the queue depth.
+    u->fixed = uring_register_buffers(&u->ring, iov, u->nslots) == 0;
+    free(iov);
+    return 0;
+
+oom:
+    fprintf(stderr, "Failed to allocate io_uring buffers\n");
+    uring_run_free(u);
+    return -1;
+}
+
+static int uring_queue(struct uring_run *u, const struct run_state *rs, unsigned s) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&u->ring);
+    if (!sqe) return -1;
+
+    struct slot *sl = &u->slots[s];
+    if (rs->tile) {
+        struct iovec *iov = &u->iovs[(size_t)s * IOV_MAX];
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->addr = (unsigned long long)(uintptr_t)iov;
+        sqe->len = (unsigned)tile_iov(iov, rs->tile, sl->len - sl->done);
+    } else {
+        if (u->fixed) {
+            sqe->opcode = rs->is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->buf_index = (unsigned short)s;
+        } else {
+            sqe->opcode = rs->is_write ? IORING_OP_WRITE : IORING_OP_READ;
+        }
+        sqe->addr = (unsigned long long)(uintptr_t)((char *)u->bufs[s] + sl->done);
+        sqe->len = (unsigned)(sl->len - sl->done);
+    }
+    sqe->fd = rs->io->fd;
+    sqe->off = sl->off + sl->done;
+    sqe->user_data = s;
+    return 0;
+}
+
+// Returns like sync_loop, or 2 if io_uring could not be set up.
+static int uring_loop(struct run_state *rs, unsigned index, unsigned count) {
+    const struct wipe_io *io = rs->io;
+    int is_write = rs->is_write;
+    struct uring_run u;
+    int init = uring_run_init(&u, rs);
+    if (init != 0) return init > 0 ? 2 : -1;
+
+    struct stripe sp = { index, count };
+    unsigned long long since_barrier = 0;   // bytes issued since the last fdatasync
+    unsigned inflight = 0;
+    int exhausted = 0;
+    int rc = 0;
+
+    for (;;) {
+        // Writes are drained before each barrier, so the fdatasync covers
+        // every request issued before it.
+        if (is_write && io->barrier && inflight == 0 && rc == 0 && since_barrier &&
+            (since_barrier >= io->barrier || exhausted)) {
+            if (barrier(io) != 0) rc = -1;
+            since_barrier = 0;
+        }
+
+        // Keep the queue full until the stripe is exhausted or we hit a problem.
+        while (rc == 0 && !exhausted && inflight < u.nslots &&
+               !(is_write && io->barrier && since_barrier >= io->barrier)) {
+            unsigned long long off;
+            size_t len;
+            if (!stripe_next(rs, &sp, &off, &len) || (!is_write && past_mismatch(rs, off))) {
+                exhausted = 1;
+                break;
+            }
+            unsigned s = 0;
+            while (u.slots[s].busy) s++;
+            struct slot *sl = &u.slots[s];
+            sl->off = off;
+            sl->len = len;
+            sl->done = 0;
+            sl->lost = 0;
+            sl->busy = 1;
+            if (io->latency) sl->issued = lat_now_ns();
+            if (is_write && !rs->tile) fill_chunk(io, u.bufs[s], off, len);
+            if (uring_queue(&u, rs, s) != 0) {
+                fprintf(stderr, "io_uring submission queue full\n");
+                sl->busy = 0;
+                rc = -1;
+                break;
+            }
+            since_barrier += len;
+            inflight++;
+        }
+        if (inflight == 0) {
+            if (rc == 0 && is_write && io->barrier && since_barrier) continue;
+            break;
+        }
+
+        int ret = uring_submit_and_wait(&u.ring, 1);
+        if (ret < 0) {
+            fprintf(stderr, "io_uring_enter failed: %s\n", strerror(-ret));
+            rc = -1;
+            break;
+        }
+
+        struct io_uring_cqe cqe;
+        while (uring_pop_cqe(&u.ring, &cqe)) {
+            unsigned s = (unsigned)cqe.user_data;
+            struct slot *sl = &u.slots[s];
+
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                uring_queue(&u, rs, s);
+                continue;
+            }
+            if (cqe.res <= 0) {
+                if (cqe.res < 0) {
+                    fprintf(stderr, "%s%s failed at offset %llu: %s\n", tag(io),
+                            is_write ? "Write" : "Read", sl->off + sl->done, strerror(-cqe.res));
+                } else {
+                    fprintf(stderr, "%s%s failed: device returned no data at offset %llu\n", tag(io),
+                            is_write ? "Write" : "Read", sl->off + sl->done);
+                }
+                // Recovery runs synchronously on this thread; the other
+                // requests in flight complete meanwhile and are reaped next.
+                void *rest = rs->tile ? (void *)rs->tile : (char *)u.bufs[s] + sl->done;
+                if (rc != 0 || recover(rs, rest, sl->off + sl->done, sl->len - sl->done, &sl->lost) != 0) {
+                    if (rc == 0) rc = -1;
+                    sl->busy = 0;
+                    inflight--;
+                    continue;
+                }
+                cqe.res = (int)(sl->len - sl->done);
+            }
+
+            sl->done += (size_t)cqe.res;
+            if (sl->done < sl->len) {
+                // Short transfer: queue the remainder of this slot.
+                uring_queue(&u, rs, s);
+                continue;
+            }
+            if (io->latency) lat_record(io->latency, sl->off, sl->len, lat_now_ns() - sl->issued);
+
+            if (!is_write) {
+                const unsigned char *b = u.bufs[s];
+                size_t i = check_request(io, b, sl->off, sl->len, &sl->lost);
+                if (i < sl->len) {
+                    note_mismatch(rs, sl->off + i, b[i]);
+                    if (rc == 0) rc = 1;
+                } else if (u.dg && rc == 0) {
+                    readback_submit(u.dg, u.bufs[s], u.buf_size, sl->off, sl->len);
+                    u.bufs[s] = readback_buffer(u.dg, u.buf_size);
+                    if (!u.bufs[s]) {
+                        fprintf(stderr, "%sOut of memory for I/O buffers\n", tag(io));
+                        rc = -1;
+                    }
+                }
+            }
+            if (rc == 0) account(rs, sl->len - sl->lost);
+            sl->busy = 0;
+            inflight--;
+        }
+    }
+
+    uring_run_free(&u);
+    return rc;
+}
+
+// ---------------------------------------------------------------------------
+// Worker threads
+
+struct worker {
+    pthread_t tid;
+    struct run_state *rs;
+    unsigned index, count;
+    int rc;
+};
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    int rc = 2;
+    if (w->rs->io->engine == ENGINE_URING) rc = uring_loop(w->rs, w->index, w->count);
+    if (rc == 2) rc = sync_loop(w->rs, w->index, w->count);
+    w->rc = rc;
+    return NULL;
+}
+
+static int engine_run(const struct wipe_io *io, int is_write, unsigned long long *done) {
+    struct run_state rs;
+    memset(&rs, 0, sizeof(rs));
+    rs.io = io;
+    rs.is_write = is_write;
+    rs.digest = is_write ? NULL : io->digest;
+    if (is_write && !(io->pattern && io->pattern->random)) {
+        rs.tile = buffer_tile(io->pattern ? io->pattern->byte : 0);
+        if (!rs.tile) {
+            fprintf(stderr, "%sOut of memory for I/O buffers\n", tag(io));
+            return -1;
+        }
+    }
+    rs.chunk = rs.tile || io->chunk < BUFFER_DATA_MAX ? io->chunk : BUFFER_DATA_MAX;
+    rs.nchunks = (io->len + rs.chunk - 1) / rs.chunk;
+    unsigned long long total = io->len;
+    if (io->ranges) {
+        rs.nchunks = io->nranges;
+        total = 0;
+        for (unsigned long long i = 0; i < io->nranges; i++) total += io->ranges[i].len;
+    }
+    rs.bad_off = io->start + io->len;
+    pthread_mutex_init(&rs.lock, NULL);
+
+    unsigned threads = io->threads ? io->threads : 1;
+    if (threads > rs.nchunks) threads = rs.nchunks ? (unsigned)rs.nchunks : 1;
+
+    struct worker *w = calloc(threads, sizeof(*w));
+    if (!w) {
+        fprintf(stderr, "Out of memory\n");
+        pthread_mutex_destroy(&rs.lock);
+        return -1;
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        w[i].rs = &rs;
+        w[i].index = i;
+        w[i].count = threads;
+    }
+
+    if (threads == 1) {
+        worker_main(&w[0]);
+    } else {
+        unsigned started = 0;
+        for (; started < threads; started++) {
+            if (pthread_create(&w[started].tid, NULL, worker_main, &w[started]) != 0) break;
+        }
+        if (started < threads) {
+            // Threads that never started leave their stripes unwritten, which
+            // must show up as a failure rather than a short success.
+            fprintf(stderr, "Failed to start worker %u of %u\n", started + 1, threads);
+            for (unsigned i = started; i < threads; i++) w[i].rc = -1;
+        }
+        for (unsigned i = 0; i < started; i++) pthread_join(w[i].tid, NULL);
+    }
+
+    int rc = 0;
+    for (unsigned i = 0; i < threads; i++) {
+        if (w[i].rc < 0) rc = -1;
+        else if (w[i].rc == 1 && rc == 0) rc = 1;
+    }
+    if (rs.bad_off < io->start + io->len) {
+        fprintf(stderr, "%sVerification failed: %s byte at offset %llu (0x%02X)\n",
+                tag(io), io->pattern ? "unexpected" : "non-zero", rs.bad_off, rs.bad_byte);
+        if (rc == 0) rc = 1;
+        *done = io->ranges ? rs.done : rs.bad_off - io->start;
+    } else {
+        *done = rs.done;
+    }
+    if (rc == 0 && rs.done < total && io->cancel && *io->cancel) rc = ENGINE_CANCELLED;
+
+    free(w);
+    pthread_mutex_destroy(&rs.lock);
+    return rc;
+}
+
+// Window size for durable checkpoints, kept on chunk boundaries so O_DIRECT
+// offsets stay aligned.
+static unsigned long long window_size(const struct wipe_io *io, unsigned long long window) {
+    if (window < io->chunk) window = io->chunk;
+    return window - window % io->chunk;
+}
+
+int engine_write(const struct wipe_io *io, unsigned long long *written) {
+    if (!io->on_durable) return engine_run(io, 1, written);
+
+    unsigned long long window = window_size(io, io->checkpoint);
+    struct wipe_io w = *io;
+    unsigned long long pos = 0;
+    int rc = 0;
+    *written = 0;
+    while (rc == 0 && pos < io->len) {
+        w.start = io->start + pos;
+        w.len = io->len - pos < window ? io->len - pos : window;
+        // Every worker syncs before returning, so the whole window is
+        // durable once engine_run is back.
+        if (!w.barrier || w.barrier > w.len) w.barrier = w.len;
+
+        unsigned long long n = 0;
+        rc = engine_run(&w, 1, &n);
+        *written += n;
+        // A single worker writes strictly in order and syncs before it
+        // stops, so a cancelled window is still durable up to where it got.
+        if (rc == ENGINE_CANCELLED && w.threads <= 1 && n) io->on_durable(io->durable_ctx, w.start + n);
+        if (rc != 0) break;
+        pos += w.len;
+        io->on_durable(io->durable_ctx, io->start + pos);
+    }
+    return rc;
+}
+
+int engine_verify(const struct wipe_io *io, unsigned long long *verified) {
+    return engine_run(io, 0, verified);
+}
+
+// ---------------------------------------------------------------------------
+// Pipelined write + verify
+//
+// The writer covers the range one window at a time and ends every window
+// with a barrier, then publishes how far the device is durable. A verifier
+// thread follows behind, re-reading everything up to that mark while the
+// writer moves on to the next window.
+
+struct pipeline {
+    const struct wipe_io *io;
+    unsigned long long durable;    // bytes from io->start written and synced
+    int writer_done;
+    int throttle;
+    unsigned long long verified;
+    int rc;                        // verifier result, as engine_verify
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Verify [pos, end) relative to io->start. On rotational media the reads go
+// out one THROTTLE_BYTES slice at a time from a single thread, each followed
+// by an idle gap as long as the slice took, so the head spends most of its
+// time with the writer instead of seeking back and forth between the two.
+#define THROTTLE_BYTES (64ULL * 1024 * 1024)
+
+static int pipeline_verify(struct pipeline *p, const struct wipe_io *v,
+                           unsigned long long pos, unsigned long long end) {
+    const struct wipe_io *io = p->io;
+    struct wipe_io sub = *v;
+    while (pos < end) {
+        unsigned long long len = end - pos;
+        if (p->throttle && len > THROTTLE_BYTES) len = THROTTLE_BYTES;
+        sub.start = io->start + pos;
+        sub.len = len;
+
+        // The window was just synced, so its pages are clean; drop them so
+        // the read-back comes from the medium even without O_DIRECT.
+        posix_fadvise(io->fd, (off_t)sub.start, (off_t)len, POSIX_FADV_DONTNEED);
+
+        double t0 = now_seconds();
+        unsigned long long n = 0;
+        int rc = engine_run(&sub, 0, &n);
+        p->verified += n;
+        if (rc != 0) return rc;
+        pos += len;
+
+        if (p->throttle && pos < end && !__atomic_load_n(&p->writer_done, __ATOMIC_RELAXED)) {
+            double idle = now_seconds() - t0;
+            struct timespec ts = { (time_t)idle, (long)((idle - (time_t)idle) * 1e9) };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return 0;
+}
+
+static void *verifier_main(void *arg) {
+    struct pipeline *p = arg;
+    struct wipe_io v = *p->io;
+    if (p->throttle) {
+        v.threads = 1;
+        v.depth = 1;
+    }
+
+    unsigned long long pos = 0;
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (p->durable == pos && !p->writer_done) pthread_cond_wait(&p->cond, &p->lock);
+        unsigned long long end = p->durable;
+        pthread_mutex_unlock(&p->lock);
+        if (end == pos) break;
+
+        p->rc = pipeline_verify(p, &v, pos, end);
+        if (p->rc != 0) break;
+        pos = end;
+    }
+    return NULL;
+}
+
+static void publish(struct pipeline *p, unsigned long long durable, int done) {
+    pthread_mutex_lock(&p->lock);
+    p->durable = durable;
+    if (done) __atomic_store_n(&p->writer_done, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+int engine_write_verify(const struct wipe_io *io, unsigned long long window, int throttle,
+                        unsigned long long *written, unsigned long long *verified, int *vrc) {
+    window = window_size(io, window);
+
+    struct pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.io = io;
+    p.throttle = throttle;
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.cond, NULL);
+
+    pthread_t vt;
+    int have_verifier = pthread_create(&vt, NULL, verifier_main, &p) == 0;
+    if (!have_verifier) {
+        fprintf(stderr, "%sFailed to start verifier thread; verifying after the write\n", tag(io));
+    }
+
+    struct wipe_io w = *io;
+    unsigned long long pos = 0;
+    int rc = 0;
+    *written = 0;
+    while (rc == 0 && pos < io->len) {
+        w.start = io->start + pos;
+        w.len = io->len - pos < window ? io->len - pos : window;
+        // Every worker syncs before returning, so the whole window is
+        // durable once engine_run is back.
+        if (!w.barrier || w.barrier > w.len) w.barrier = w.len;
+
+        unsigned long long n = 0;
+        rc = engine_run(&w, 1, &n);
+        *written += n;
+        if (rc != 0) break;
+        pos += w.len;
+        if (have_verifier) publish(&p, pos, 0);
+        if (io->on_durable) io->on_durable(io->durable_ctx, io->start + pos);
+    }
+
+    if (have_verifier) {
+        // On a write error the verifier still checks what was made durable.
+        publish(&p, pos, 1);
+        pthread_join(vt, NULL);
+    } else {
+        struct wipe_io v = *io;
+        v.len = pos;
+        p.rc = pos ? engine_run(&v, 0, &p.verified) : 0;
+    }
+    *verified = p.verified;
+    *vrc = p.rc;
+
+    pthread_cond_destroy(&p.cond);
+    pthread_mutex_destroy(&p.lock);
+    return rc < 0 ? -1 : rc;
+}
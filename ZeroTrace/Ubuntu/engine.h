@@ -0,0 +1,98 @@
+// engine.h
+// Overwrite and read-back loops shared by the Linux wiper. Two engines are
+// available: the classic one-request-at-a-time loop and an io_uring engine
+// that keeps up to `depth` requests in flight. Either can be run by several
+// threads, each owning every threads-th chunk. Zero and fixed-byte writes
+// repeat one shared tile through iovecs; reads and random writes use
+// buffers of at most BUFFER_DATA_MAX (see common/buffers.h), so their
+// requests are capped at that size.
+
+#ifndef ZT_ENGINE_H
+#define ZT_ENGINE_H
+
+#include <stddef.h>
+
+struct bad_list;
+struct pass_pattern;
+struct progress_job;
+struct lat_rec;
+struct readback;
+
+// One piece of a sampled read: see wipe_io.ranges.
+struct io_range {
+    unsigned long long off;
+    size_t len;
+};
+
+enum io_engine {
+    ENGINE_SYNC,
+    ENGINE_URING,
+};
+
+struct wipe_io {
+    int fd;
+    unsigned long long start; // first byte covered
+    unsigned long long len;   // bytes to cover from start
+    size_t chunk;             // bytes per request
+    size_t align;             // buffer alignment (0 = page size)
+    size_t sector;            // a failed request is bisected down to this (0 = align)
+    unsigned depth;           // requests in flight per thread (io_uring only)
+    unsigned threads;         // worker threads striping the range (0 = 1)
+    unsigned long long barrier; // fdatasync every this many bytes (0 = none)
+    enum io_engine engine;
+    const char *tag;          // prefix for error lines (NULL = none)
+    struct progress_job *progress;      // finished bytes are counted here (NULL = not reported)
+    struct lat_rec *latency;            // every request's latency is recorded here (NULL = not timed)
+    const struct pass_pattern *pattern; // what to write / expect (NULL = zeros)
+    volatile int *cancel;               // once set, no new requests are issued (NULL = never)
+    // Media errors: with a list set, a failed request is retried and bisected
+    // and only the sectors that still fail are given up on, recorded here,
+    // while the run carries on. Without one the run stops at the error.
+    struct bad_list *bad;
+    // Durable checkpoints for writes: with on_durable set, the range is
+    // written in windows of `checkpoint` bytes, each made durable before
+    // on_durable is told the offset below which everything is on the medium.
+    unsigned long long checkpoint;
+    void (*on_durable)(void *ctx, unsigned long long end);
+    void *durable_ctx;
+    // Sampling: with ranges set, only these are covered, in the order given,
+    // instead of the whole of [start, start + len); worker i takes ranges i,
+    // i + threads, ... They must be sorted, disjoint, inside the range and no
+    // longer than a request (chunk, and BUFFER_DATA_MAX for reads).
+    const struct io_range *ranges;
+    unsigned long long nranges;
+    // Read-back digest: with one set, every request a verify run checks is
+    // handed to it with its buffer (see readback.h). Writes ignore it.
+    struct readback *digest;
+};
+
+// Returned instead of 0 when io->cancel stopped a run before the end.
+#define ENGINE_CANCELLED 2
+
+// Overwrite [start, start + len) with zeros, or with io->pattern when set
+// (random data is generated for each request's own offset). Returns 0 when
+// the whole range was written, apart from sectors recorded in io->bad, -1
+// on a write error, ENGINE_CANCELLED when io->cancel cut it short.
+// *written receives the bytes written. With a barrier interval set, every
+// write is durable on return.
+int engine_write(const struct wipe_io *io, unsigned long long *written);
+
+// Read [start, start + len) back and check every byte is zero, or matches
+// io->pattern when set. Returns 0 on success, 1 on a mismatch (reported with
+// its exact offset), -1 on a read error. Sectors that cannot be read are
+// recorded in io->bad, when set, and skipped. *verified receives the number
+// of bytes confirmed before stopping.
+int engine_verify(const struct wipe_io *io, unsigned long long *verified);
+
+// Overwrite and verify in one pass: the range is written one window at a
+// time, each window made durable before a verifier thread re-reads it while
+// the writer carries on with the next. With throttle set (rotational media)
+// the verifier reads from one thread in paced slices to limit seeking.
+// Returns like engine_write; *vrc receives the engine_verify result for the
+// part that was written.
+int engine_write_verify(const struct wipe_io *io, unsigned long long window, int throttle,
+                        unsigned long long *written, unsigned long long *verified, int *vrc);
+
+const char *engine_name(enum io_engine e);
+
+#endif
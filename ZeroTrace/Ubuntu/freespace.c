@@ -0,0 +1,425 @@
+// freespace.c
+// Filler files over a mounted filesystem's free space, a free-space
+// watcher, and the EOF slack of existing files.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ftw.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "device.h"
+#include "freespace.h"
+#include "../common/buffers.h"
+#include "../common/pattern.h"
+#include "../common/progress.h"
+
+// Size of each filler, and the unit fillers are rounded down to; when
+// less is left, it is shared between the threads in fillers of at least
+// FILL_SHARE_MIN, and the last ones shrink to fit above the reserve.
+#define FILL_BYTES (1024ULL * 1024 * 1024)
+#define FILL_SHARE_MIN (64ULL * 1024 * 1024)
+#define FILL_UNIT (1024ULL * 1024)
+#define WATCH_SECONDS 0.25
+// Slack is only touched in files nobody has changed for this long, since
+// the block is rewritten behind the filesystem's back.
+#define SLACK_QUIET_SECONDS 600
+// Extents whose slack cannot be found or rewritten in place.
+#define SLACK_UNSAFE (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED | \
+                      FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE | \
+                      FIEMAP_EXTENT_DATA_TAIL | FIEMAP_EXTENT_UNWRITTEN | FIEMAP_EXTENT_SHARED)
+
+struct fill_run {
+    const struct freespace_opts *o;
+    char dir[4096];                 // the fillers' directory
+    pthread_mutex_t lock;           // allocation: free-space check plus fallocate
+    unsigned long long pending;     // promised to fillers that could not preallocate
+    unsigned next;                  // filler number
+    volatile int stop;              // cancel, pressure or error: writes stop at once
+    volatile int full;              // nothing left to claim: running fillers finish
+    int done;                       // the reserve was reached
+    int failed;
+    struct freespace_totals *t;
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Bytes an unprivileged process could still allocate.
+static int available(int dfd, unsigned long long *out) {
+    struct statvfs sv;
+    if (fstatvfs(dfd, &sv) != 0) return -1;
+    *out = (unsigned long long)sv.f_bavail * sv.f_frsize;
+    return 0;
+}
+
+// Alignment for O_DIRECT on fd: whole filesystem blocks, which are never
+// smaller than the device's logical block. 0 (page size) when unknown.
+static size_t direct_align(int fd) {
+    struct statvfs sv;
+    if (fstatvfs(fd, &sv) != 0 || !sv.f_bsize || (sv.f_bsize & (sv.f_bsize - 1))) return 0;
+    return (size_t)sv.f_bsize;
+}
+
+// Watch the free space while the fillers run. If other processes take it
+// below half the reserve, stop; the caller then removes the fillers.
+static void *watcher(void *arg) {
+    struct fill_run *r = arg;
+    int dfd = open(r->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) return NULL;
+    while (!r->stop) {
+        struct timespec ts = {0, (long)(WATCH_SECONDS * 1e9)};
+        nanosleep(&ts, NULL);
+        unsigned long long avail;
+        if (r->o->cancel && *r->o->cancel) r->stop = 1;
+        else if (available(dfd, &avail) == 0 && avail < r->o->reserve / 2) {
+            r->t->pressure = 1;
+            r->stop = 1;
+        }
+    }
+    close(dfd);
+    return NULL;
+}
+
+// Claim the next filler: check what is left above the reserve and
+// preallocate it while holding the lock, so two fillers never count the
+// same free space. Returns the open file, or -1 when there is nothing
+// left (r->done) or on an error (reported, r->failed).
+static int claim(struct fill_run *r, unsigned long long *size, unsigned long long *promised, int *direct) {
+    const struct freespace_opts *o = r->o;
+    int fd = -1;
+    pthread_mutex_lock(&r->lock);
+    int dfd = open(r->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    unsigned long long avail;
+    if (dfd < 0 || available(dfd, &avail) != 0) {
+        fprintf(stderr, "Cannot query free space in %s: %s\n", r->dir, strerror(errno));
+        r->failed = 1;
+        goto out;
+    }
+    unsigned long long room = avail > o->reserve + r->pending ? avail - o->reserve - r->pending : 0;
+    unsigned long long want = room / (o->threads ? o->threads : 1);
+    if (want < FILL_SHARE_MIN) want = FILL_SHARE_MIN;
+    if (want > FILL_BYTES) want = FILL_BYTES;
+    if (want > room) want = room;
+    want = want / FILL_UNIT * FILL_UNIT;
+    if (!want) {
+        r->done = 1;
+        goto out;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "fill-%06u", r->next++);
+    *direct = 1;
+    fd = openat(dfd, name, O_RDWR | O_CREAT | O_EXCL | O_DIRECT | O_CLOEXEC, 0600);
+    if (fd < 0 && errno == EINVAL) {
+        // No direct I/O on this filesystem; fdatasync makes each pass durable.
+        *direct = 0;
+        fd = openat(dfd, name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create a filler in %s: %s\n", r->dir, strerror(errno));
+        r->failed = 1;
+        goto out;
+    }
+    if (fallocate(fd, 0, 0, (off_t)want) != 0) {
+        int err = errno;
+        if (err == ENOSPC) {
+            // Someone else took the space between the check and now.
+            close(fd);
+            unlinkat(dfd, name, 0);
+            fd = -1;
+            r->done = 1;
+            goto out;
+        }
+        if (err != EOPNOTSUPP) {
+            fprintf(stderr, "fallocate failed in %s: %s\n", r->dir, strerror(err));
+            close(fd);
+            fd = -1;
+            r->failed = 1;
+            goto out;
+        }
+        // Allocated as it is written instead; hold the space back from the
+        // other fillers until then.
+        r->pending += want;
+        *promised = want;
+    }
+    *size = want;
+    r->t->fillers++;
+out:
+    if (dfd >= 0) close(dfd);
+    pthread_mutex_unlock(&r->lock);
+    return fd;
+}
+
+static void *filler(void *arg) {
+    struct fill_run *r = arg;
+    const struct freespace_opts *o = r->o;
+    while (!r->stop && !r->full) {
+        unsigned long long size = 0, pending = 0;
+        int direct = 0;
+        int fd = claim(r, &size, &pending, &direct);
+        if (fd < 0) {
+            if (r->failed) r->stop = 1;
+            else r->full = 1;
+            break;
+        }
+        progress_grow(o->progress, size * (unsigned long long)o->npasses);
+        size_t align = direct ? direct_align(fd) : 0;
+
+        int rc = 0;
+        for (int p = 0; p < o->npasses && rc == 0 && !r->stop; p++) {
+            struct wipe_io io;
+            memset(&io, 0, sizeof(io));
+            io.fd = fd;
+            io.len = size;
+            io.chunk = o->chunk;
+            io.align = align;
+            io.depth = o->depth;
+            io.threads = 1;
+            io.engine = o->engine;
+            io.progress = o->progress;
+            io.pattern = &o->passes[p];
+            io.cancel = &r->stop;
+            unsigned long long written = 0;
+            rc = engine_write(&io, &written);
+            if (rc == 0 && fdatasync(fd) != 0) rc = -1;
+            if (p == 0) __atomic_fetch_add(&r->t->filled, written, __ATOMIC_RELAXED);
+        }
+        close(fd);
+        if (pending) {
+            pthread_mutex_lock(&r->lock);
+            r->pending -= pending;
+            pthread_mutex_unlock(&r->lock);
+        }
+        if (rc == -1) {
+            // Most likely ENOSPC on a filesystem without fallocate; what was
+            // written stays until the fillers are removed.
+            if (pending) {
+                r->full = 1;
+                r->done = 1;
+            } else {
+                r->failed = 1;
+                r->stop = 1;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void remove_fillers(const char *dir) {
+    DIR *d = opendir(dir);
+    if (d) {
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+            if (strncmp(e->d_name, "fill-", 5) == 0) unlinkat(dirfd(d), e->d_name, 0);
+        }
+        closedir(d);
+    }
+    if (rmdir(dir) != 0) fprintf(stderr, "Could not remove %s: %s\n", dir, strerror(errno));
+}
+
+// --- EOF slack ---------------------------------------------------------------
+
+struct slack_run {
+    const struct freespace_opts *o;
+    dev_t dev;
+    struct device bdev;
+    unsigned blk;           // filesystem block size
+    void *block;            // one block, aligned for O_DIRECT on bdev
+    void *tail;             // the file's bytes in that block, read through the file
+    time_t now;
+    struct freespace_totals *t;
+};
+
+static struct slack_run *slack;   // nftw gives its callback no context
+
+// The block device under a filesystem, or -1 when there is none (btrfs
+// and network filesystems report an anonymous device).
+static int backing_device(dev_t dev, char *path, size_t n) {
+    char p[96], line[256];
+    snprintf(p, sizeof(p), "/sys/dev/block/%u:%u/uevent", major(dev), minor(dev));
+    FILE *f = fopen(p, "r");
+    if (!f) return -1;
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "DEVNAME=", 8) != 0) continue;
+        line[strcspn(line, "\n")] = 0;
+        snprintf(path, n, "/dev/%s", line + 8);
+        found = 1;
+    }
+    fclose(f);
+    return found ? 0 : -1;
+}
+
+// Where the block holding the last used bytes of the file open on fd lies
+// on the device, provided the file is still the one nftw saw, unchanged,
+// and the device's copy of the block still starts with the file's bytes.
+// Returns 0 and sets *phys, or -1 when the slack is not safe to rewrite.
+static int slack_check(struct slack_run *s, int fd, const struct stat *seen, unsigned used, unsigned long long *phys) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_dev != seen->st_dev || st.st_ino != seen->st_ino ||
+        st.st_size != seen->st_size || st.st_mtime != seen->st_mtime || st.st_ctime != seen->st_ctime)
+        return -1;
+    struct {
+        struct fiemap fm;
+        struct fiemap_extent fe;
+    } q;
+    unsigned long long size = (unsigned long long)st.st_size, start = size - used;
+    memset(&q, 0, sizeof(q));
+    q.fm.fm_start = size - 1;
+    q.fm.fm_length = 1;
+    q.fm.fm_flags = FIEMAP_FLAG_SYNC;
+    q.fm.fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, &q.fm) != 0 || q.fm.fm_mapped_extents != 1 || (q.fe.fe_flags & SLACK_UNSAFE) ||
+        q.fe.fe_logical > start || start - q.fe.fe_logical >= q.fe.fe_length)
+        return -1;
+    *phys = q.fe.fe_physical + (start - q.fe.fe_logical);
+    if (pread(fd, s->tail, used, (off_t)start) != (ssize_t)used ||
+        pread(s->bdev.fd, s->block, s->blk, (off_t)*phys) != (ssize_t)s->blk || memcmp(s->block, s->tail, used) != 0)
+        return -1;
+    return 0;
+}
+
+// Rewrite the slack of one file: find the block holding EOF, check through
+// the device that it holds the file's last bytes, and write the rest of the
+// block with each pass. The check is repeated right before every pass, so
+// a file that is changed, moved or removed meanwhile is left alone. What
+// remains is the window between the last check and its write: data the
+// filesystem puts in that block then is overwritten. The quiet period
+// makes that unlikely; only an unmounted filesystem rules it out.
+static void slack_file(const char *path, const struct stat *st) {
+    struct slack_run *s = slack;
+    unsigned used = (unsigned)((unsigned long long)st->st_size % s->blk);
+    if (!used || st->st_mtime > s->now - SLACK_QUIET_SECONDS || st->st_ctime > s->now - SLACK_QUIET_SECONDS)
+        return;
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_NOATIME | O_CLOEXEC);
+    if (fd < 0 && errno == EPERM) fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return;
+
+    int p = 0;
+    unsigned long long phys = 0;
+    for (; p < s->o->npasses; p++) {
+        if (slack_check(s, fd, st, used, &phys) != 0) break;
+        pass_fill(&s->o->passes[p], phys + used, (char *)s->block + used, s->blk - used);
+        ssize_t n = pwrite(s->bdev.fd, s->block, s->blk, (off_t)phys);
+        if (n != (ssize_t)s->blk) {
+            fprintf(stderr, "Slack: write for %s at device offset %llu failed: %s\n", path, phys,
+                    n < 0 ? strerror(errno) : "short write");
+            s->t->slack_failed++;
+            break;
+        }
+    }
+    close(fd);
+    if (p) progress_add(s->o->progress, PROGRESS_WRITTEN, (unsigned long long)(s->blk - used) * p);
+    if (p < s->o->npasses) return;
+    s->t->slack_files++;
+    s->t->slack_bytes += s->blk - used;
+}
+
+static int slack_visit(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)ftw;
+    if (slack->o->cancel && *slack->o->cancel) return 1;
+    if (type == FTW_F && S_ISREG(st->st_mode) && st->st_dev == slack->dev) slack_file(path, st);
+    return 0;
+}
+
+static void slack_wipe(const char *root, const struct freespace_opts *o, struct freespace_totals *t) {
+    struct slack_run s;
+    memset(&s, 0, sizeof(s));
+    s.o = o;
+    s.t = t;
+    s.now = time(NULL);
+    struct stat st;
+    struct statvfs sv;
+    char devpath[300];
+    if (stat(root, &st) != 0 || statvfs(root, &sv) != 0) return;
+    s.dev = st.st_dev;
+    s.blk = (unsigned)sv.f_bsize;
+    if (backing_device(st.st_dev, devpath, sizeof(devpath)) != 0) {
+        printf("Slack: no block device behind %s; skipped\n", root);
+        t->slack_skipped = 1;
+        return;
+    }
+    if (device_open(&s.bdev, devpath, O_RDWR | O_DIRECT | O_CLOEXEC) != 0) {
+        t->slack_skipped = 1;
+        return;
+    }
+    s.block = buffer_alloc(s.blk);
+    s.tail = malloc(s.blk);
+    if (s.block && s.tail && s.blk % device_io_align(&s.bdev) == 0) {
+        printf("Slack: overwriting the end of the last block of files unchanged for %d minutes (%s)\n",
+               SLACK_QUIET_SECONDS / 60, devpath);
+        slack = &s;
+        nftw(root, slack_visit, 64, FTW_PHYS | FTW_MOUNT);
+        slack = NULL;
+        if (fdatasync(s.bdev.fd) != 0) fprintf(stderr, "Slack: fdatasync on %s failed\n", devpath);
+    } else {
+        t->slack_skipped = 1;
+    }
+    buffer_free(s.block, s.blk);
+    free(s.tail);
+    device_close(&s.bdev);
+}
+
+int freespace_wipe(const char *dir, const struct freespace_opts *o, struct freespace_totals *t) {
+    struct fill_run r;
+    memset(&r, 0, sizeof(r));
+    memset(t, 0, sizeof(*t));
+    r.o = o;
+    r.t = t;
+    pthread_mutex_init(&r.lock, NULL);
+    snprintf(r.dir, sizeof(r.dir), "%s/.zerotrace-fill.%ld", dir, (long)getpid());
+    if (mkdir(r.dir, 0700) != 0) {
+        fprintf(stderr, "Cannot create %s: %s\n", r.dir, strerror(errno));
+        return -1;
+    }
+    int dfd = open(r.dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0 || available(dfd, &t->free_before) != 0) {
+        fprintf(stderr, "Cannot query free space in %s: %s\n", dir, strerror(errno));
+        if (dfd >= 0) close(dfd);
+        rmdir(r.dir);
+        return -1;
+    }
+    close(dfd);
+
+    // The slack goes first: the fill would push its quiet files' metadata
+    // out of the cache, and the check reads it again anyway.
+    if (o->slack) slack_wipe(dir, o, t);
+
+    unsigned threads = o->threads ? o->threads : 1;
+    pthread_t watch, tids[256];
+    int watching = pthread_create(&watch, NULL, watcher, &r) == 0;
+    unsigned started = 0;
+    if (threads > 256) threads = 256;
+    double t0 = now_seconds();
+    for (; started + 1 < threads; started++) {
+        if (pthread_create(&tids[started], NULL, filler, &r) != 0) break;
+    }
+    filler(&r);
+    for (unsigned i = 0; i < started; i++) pthread_join(tids[i], NULL);
+    r.stop = 1;
+    if (watching) pthread_join(watch, NULL);
+    printf("Filled %.1f MB in %llu filler%s in %.1f s; removing them\n", t->filled / (1024.0 * 1024.0),
+           t->fillers, t->fillers == 1 ? "" : "s", now_seconds() - t0);
+    remove_fillers(r.dir);
+    pthread_mutex_destroy(&r.lock);
+
+    if (r.failed || t->slack_failed) return -1;
+    if (t->pressure || (o->cancel && *o->cancel)) return ENGINE_CANCELLED;
+    return r.done ? 0 : -1;
+}
@@ -0,0 +1,49 @@
+// freespace.h
+// Free-space wipe for a filesystem that stays mounted. Worker threads
+// create large filler files in a hidden directory, preallocate each with
+// fallocate and overwrite it with the pass patterns through direct I/O,
+// until the free space is down to a reserve left for everyone else; then
+// the fillers are removed. A watcher stops the fill early and gives the
+// space back if other processes push the free space further down. The
+// slack after EOF in the last block of quiet files can be overwritten too,
+// through the block device under the filesystem.
+
+#ifndef ZT_FREESPACE_H
+#define ZT_FREESPACE_H
+
+#include "engine.h"
+
+struct pass_pattern;
+struct progress_job;
+
+struct freespace_opts {
+    const struct pass_pattern *passes;  // written in order over every filler
+    int npasses;
+    unsigned threads;           // fillers written at once (0 = 1)
+    enum io_engine engine;
+    unsigned depth;
+    size_t chunk;
+    unsigned long long reserve; // free bytes to leave for other processes
+    int slack;                  // also overwrite the slack after EOF of quiet files
+    volatile int *cancel;       // once set, filling stops and the fillers are removed (NULL = never)
+    struct progress_job *progress;
+};
+
+struct freespace_totals {
+    unsigned long long free_before;   // bytes available to unprivileged users at the start
+    unsigned long long filled;        // bytes of filler written (once, whatever the passes)
+    unsigned long long fillers;
+    unsigned long long slack_files;
+    unsigned long long slack_bytes;
+    unsigned long long slack_failed;  // files whose slack write failed (reported)
+    int pressure;                     // stopped early: free space fell below half the reserve
+    int slack_skipped;                // slack requested but not possible on this filesystem
+};
+
+// Wipe the free space of the filesystem holding dir. Returns 0 when the
+// fill reached the reserve and the fillers were removed, -1 on an error
+// (reported; a failed slack write counts), ENGINE_CANCELLED when o->cancel
+// or the watcher stopped it.
+int freespace_wipe(const char *dir, const struct freespace_opts *o, struct freespace_totals *t);
+
+#endif
@@ -0,0 +1,312 @@
+// fsmap.c
+// ext2/3/4 and FAT allocation parsing for the filesystem-aware wipe.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "fsmap.h"
+
+// Largest single metadata read (one FAT chunk, one bitmap block).
+#define READ_CHUNK (4U * 1024 * 1024)
+
+// Reads through a bounce buffer so that any byte range can be fetched from
+// a descriptor opened with O_DIRECT.
+struct fs_reader {
+    int fd;
+    size_t align;
+    unsigned char *bounce;
+    size_t cap;
+};
+
+static unsigned le16(const unsigned char *p) {
+    return p[0] | (unsigned)p[1] << 8;
+}
+
+static unsigned le32(const unsigned char *p) {
+    return p[0] | (unsigned)p[1] << 8 | (unsigned)p[2] << 16 | (unsigned)p[3] << 24;
+}
+
+static int fs_read(struct fs_reader *r, unsigned long long off, void *dst, size_t len) {
+    while (len > 0) {
+        unsigned long long base = off - off % r->align;
+        size_t skip = (size_t)(off - base);
+        size_t want = skip + len;
+        if (want > r->cap) want = r->cap;
+        want = (want + r->align - 1) / r->align * r->align;
+        if (want > r->cap) want = r->cap;
+
+        size_t got = 0;
+        while (got < want) {
+            ssize_t n = pread(r->fd, r->bounce + got, want - got, (off_t)(base + got));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fprintf(stderr, "Filesystem read failed at offset %llu: %s\n", base + got, strerror(errno));
+                return -1;
+            }
+            if (n == 0) break;
+            got += (size_t)n;
+        }
+        if (got <= skip) {
+            fprintf(stderr, "Filesystem read past the end of the device at offset %llu\n", off);
+            return -1;
+        }
+        size_t take = got - skip < len ? got - skip : len;
+        memcpy(dst, r->bounce + skip, take);
+        dst = (char *)dst + take;
+        off += take;
+        len -= take;
+    }
+    return 0;
+}
+
+// ---- ext2/3/4 ----
+
+#define EXT4_MAGIC 0xEF53
+#define EXT4_INCOMPAT_META_BG 0x10
+#define EXT4_INCOMPAT_64BIT 0x80
+#define EXT4_RO_COMPAT_SPARSE_SUPER 0x1
+#define EXT4_RO_COMPAT_BIGALLOC 0x200
+#define EXT4_BG_BLOCK_UNINIT 0x2
+
+static int is_power_of(unsigned long long n, unsigned b) {
+    while (n > 1 && n % b == 0) n /= b;
+    return n == 1;
+}
+
+// Groups carrying a superblock backup and a copy of the descriptor table.
+static int ext4_has_super(unsigned long long g, int sparse) {
+    if (g <= 1 || !sparse) return 1;
+    return is_power_of(g, 3) || is_power_of(g, 5) || is_power_of(g, 7);
+}
+
+// With meta_bg, descriptor block nr from first_meta on is not in the table
+// after the superblock but at the start of the first group of its
+// meta-group (past that group's superblock backup, if any), with copies in
+// the second and last groups; dpb groups share one block.
+static unsigned long long ext4_desc_block(unsigned long long g, unsigned first_data, unsigned long long bpg,
+                                          int sparse) {
+    return first_data + g * bpg + ext4_has_super(g, sparse);
+}
+
+static int ext4_map(struct fs_reader *r, const unsigned char *sb, struct dirty_map *m, struct fs_info *info) {
+    unsigned log_block = le32(sb + 24);
+    unsigned log_cluster = le32(sb + 28);
+    unsigned incompat = le32(sb + 96);
+    unsigned ro_compat = le32(sb + 100);
+    if (log_block > 6 || (ro_compat & EXT4_RO_COMPAT_BIGALLOC && (log_cluster < log_block || log_cluster > 20))) {
+        fprintf(stderr, "ext4: unsupported block size\n");
+        return -1;
+    }
+    unsigned long long bs = 1024ULL << log_block;
+    unsigned long long cs = ro_compat & EXT4_RO_COMPAT_BIGALLOC ? 1024ULL << log_cluster : bs;
+    unsigned long long blocks = le32(sb + 4);
+    unsigned desc_size = 32;
+    if (incompat & EXT4_INCOMPAT_64BIT) {
+        blocks |= (unsigned long long)le32(sb + 0x150) << 32;
+        desc_size = le16(sb + 0xFE);
+    }
+    unsigned first_data = le32(sb + 20);
+    unsigned long long bpg = le32(sb + 32);
+    unsigned long long cpg = ro_compat & EXT4_RO_COMPAT_BIGALLOC ? le32(sb + 36) : bpg;
+    unsigned long long ipg = le32(sb + 40);
+    unsigned inode_size = le32(sb + 76) == 0 ? 128 : le16(sb + 88);
+    unsigned rsv_gdt = le16(sb + 0xCE);
+    if (blocks == 0 || bpg == 0 || cpg == 0 || ipg == 0 || desc_size < 32 || desc_size > 1024 ||
+        inode_size < 128 || cpg > bs * 8) {
+        fprintf(stderr, "ext4: corrupt superblock\n");
+        return -1;
+    }
+    unsigned long long ngroups = (blocks - first_data + bpg - 1) / bpg;
+    unsigned long long gdt_blocks = (ngroups * desc_size + bs - 1) / bs;
+    unsigned long long ratio = cs / bs;   // blocks per bitmap bit
+    int sparse = (ro_compat & EXT4_RO_COMPAT_SPARSE_SUPER) != 0;
+    // Descriptor blocks kept in the table after each superblock copy; with
+    // meta_bg the rest live in their meta-groups.
+    unsigned long long dpb = bs / desc_size;
+    unsigned long long first_meta = gdt_blocks;
+    if (incompat & EXT4_INCOMPAT_META_BG && le32(sb + 0x104) < gdt_blocks) first_meta = le32(sb + 0x104);
+
+    info->type = (incompat & ~0x2U) ? "ext4" : (le32(sb + 92) & 0x4) ? "ext3" : "ext2";
+    info->size = blocks * bs;
+    info->block = (unsigned)cs;
+    info->used = 0;
+
+    unsigned char *gdt = malloc(gdt_blocks * bs);
+    unsigned char *bitmap = malloc(bs);
+    if (!gdt || !bitmap) {
+        fprintf(stderr, "ext4: out of memory\n");
+        free(gdt);
+        free(bitmap);
+        return -1;
+    }
+    int rc = fs_read(r, (first_data + 1) * bs, gdt, first_meta * bs);
+    for (unsigned long long nr = first_meta; rc == 0 && nr < gdt_blocks; nr++) {
+        unsigned long long at = ext4_desc_block(nr * dpb, first_data, bpg, sparse);
+        if (at >= blocks) {
+            fprintf(stderr, "ext4: descriptor block %llu lies outside the filesystem\n", nr);
+            rc = -1;
+            break;
+        }
+        rc = fs_read(r, at * bs, gdt + nr * bs, bs);
+    }
+
+    // Boot block, primary superblock and descriptor table.
+    dirty_map_set_range(m, 0, (first_data + 1 + first_meta + rsv_gdt) * bs);
+    for (unsigned long long g = 0; rc == 0 && g < ngroups; g++) {
+        const unsigned char *d = gdt + g * desc_size;
+        unsigned long long block_bitmap = le32(d + 0), inode_bitmap = le32(d + 4), inode_table = le32(d + 8);
+        if (desc_size >= 64) {
+            block_bitmap |= (unsigned long long)le32(d + 0x20) << 32;
+            inode_bitmap |= (unsigned long long)le32(d + 0x24) << 32;
+            inode_table |= (unsigned long long)le32(d + 0x28) << 32;
+        }
+        unsigned flags = le16(d + 18);
+        unsigned long long gstart = first_data + g * bpg;
+
+        // Metadata is marked explicitly: in a group whose bitmap was never
+        // initialised, nothing else says where it lives.
+        if (ext4_has_super(g, sparse))
+            dirty_map_set_range(m, gstart * bs, (1 + first_meta + rsv_gdt) * bs);
+        unsigned long long mg = g / dpb, pos = g % dpb;
+        if (mg >= first_meta && (pos == 0 || pos == 1 || pos == dpb - 1))
+            dirty_map_set_range(m, ext4_desc_block(g, first_data, bpg, sparse) * bs, bs);
+        dirty_map_set_range(m, block_bitmap * bs, bs);
+        dirty_map_set_range(m, inode_bitmap * bs, bs);
+        dirty_map_set_range(m, inode_table * bs, (ipg * inode_size + bs - 1) / bs * bs);
+        if (flags & EXT4_BG_BLOCK_UNINIT) continue;
+
+        if (block_bitmap >= blocks) {
+            fprintf(stderr, "ext4: group %llu has a block bitmap outside the filesystem\n", g);
+            rc = -1;
+            break;
+        }
+        rc = fs_read(r, block_bitmap * bs, bitmap, bs);
+        if (rc != 0) break;
+        // Mark runs of set bits, clipped to the filesystem (padding bits
+        // past the last block are set too).
+        for (unsigned long long i = 0; i < cpg;) {
+            if (!(bitmap[i / 8] >> (i % 8) & 1)) {
+                i++;
+                continue;
+            }
+            unsigned long long first = i;
+            while (i < cpg && (bitmap[i / 8] >> (i % 8) & 1)) i++;
+            unsigned long long b0 = first_data + (g * cpg + first) * ratio;
+            unsigned long long b1 = first_data + (g * cpg + i) * ratio;
+            if (b0 >= blocks) break;
+            if (b1 > blocks) b1 = blocks;
+            dirty_map_set_range(m, b0 * bs, (b1 - b0) * bs);
+            info->used += (b1 - b0) * bs;
+        }
+    }
+    free(gdt);
+    free(bitmap);
+    return rc;
+}
+
+// ---- FAT12/16/32 ----
+
+static int fat_map(struct fs_reader *r, const unsigned char *bs, struct dirty_map *m, struct fs_info *info) {
+    unsigned bps = le16(bs + 11), spc = bs[13], rsvd = le16(bs + 14), nfats = bs[16];
+    unsigned root_ents = le16(bs + 17);
+    unsigned long long total = le16(bs + 19) ? le16(bs + 19) : le32(bs + 32);
+    unsigned long long fat_sz = le16(bs + 22) ? le16(bs + 22) : le32(bs + 36);
+    unsigned long long root_secs = ((unsigned long long)root_ents * 32 + bps - 1) / bps;
+    unsigned long long data_start = rsvd + nfats * fat_sz + root_secs;
+    if (data_start >= total) {
+        fprintf(stderr, "FAT: corrupt boot sector\n");
+        return -1;
+    }
+    unsigned long long clusters = (total - data_start) / spc;
+    int bits = clusters < 4085 ? 12 : clusters < 65525 ? 16 : 32;
+    unsigned long long cbytes = (unsigned long long)spc * bps;
+
+    info->type = bits == 12 ? "FAT12" : bits == 16 ? "FAT16" : "FAT32";
+    info->size = total * bps;
+    info->block = (unsigned)cbytes;
+    info->used = 0;
+
+    // Boot sector, reserved area (FAT32 FSInfo and backup boot sector),
+    // every FAT copy and the fixed root directory.
+    dirty_map_set_range(m, 0, data_start * bps);
+
+    unsigned long long fat_bytes = (clusters + 2) * bits / 8 + 1;
+    if (fat_bytes > fat_sz * bps) fat_bytes = fat_sz * bps;
+    // A FAT12 entry straddles bytes, so read that (small) table whole.
+    size_t chunk = bits == 12 ? (size_t)fat_bytes : READ_CHUNK;
+    unsigned char *fat = malloc(chunk);
+    if (!fat) {
+        fprintf(stderr, "FAT: out of memory\n");
+        return -1;
+    }
+    unsigned long long per_chunk = bits == 12 ? clusters + 2 : chunk / (bits / 8);
+    unsigned long long run = 0, run_len = 0;
+    int rc = 0;
+    for (unsigned long long base = 0; base < clusters + 2 && rc == 0; base += per_chunk) {
+        unsigned long long n = clusters + 2 - base < per_chunk ? clusters + 2 - base : per_chunk;
+        size_t len = bits == 12 ? (size_t)fat_bytes : (size_t)(n * (bits / 8));
+        rc = fs_read(r, (unsigned long long)rsvd * bps + base * (bits / 8), fat, len);
+        for (unsigned long long i = 0; rc == 0 && i < n; i++) {
+            unsigned long long c = base + i;
+            unsigned v;
+            if (bits == 12) {
+                unsigned w = le16(fat + c * 3 / 2);
+                v = c & 1 ? w >> 4 : w & 0xFFF;
+            } else if (bits == 16) {
+                v = le16(fat + i * 2);
+            } else {
+                v = le32(fat + i * 4) & 0x0FFFFFFF;
+            }
+            unsigned bad = bits == 12 ? 0xFF7 : bits == 16 ? 0xFFF7 : 0x0FFFFFF7;
+            // Entries 0 and 1 are reserved; bad clusters are never written.
+            int used = c >= 2 && v != 0 && v != bad;
+            if (used && run_len && run + run_len == c) {
+                run_len++;
+            } else if (used) {
+                if (run_len) dirty_map_set_range(m, (data_start * bps) + (run - 2) * cbytes, run_len * cbytes);
+                run = c;
+                run_len = 1;
+            }
+            if (used) info->used += cbytes;
+        }
+    }
+    if (run_len) dirty_map_set_range(m, (data_start * bps) + (run - 2) * cbytes, run_len * cbytes);
+    free(fat);
+    return rc;
+}
+
+// A FAT boot sector has no magic of its own; accept it when the BPB is sane.
+static int fat_probe(const unsigned char *bs) {
+    unsigned bps = le16(bs + 11), spc = bs[13];
+    if (bs[510] != 0x55 || bs[511] != 0xAA) return 0;
+    if (bs[0] != 0xEB && bs[0] != 0xE9) return 0;
+    if (bps < 512 || bps > 4096 || (bps & (bps - 1))) return 0;
+    if (spc == 0 || (spc & (spc - 1))) return 0;
+    if (le16(bs + 14) == 0 || bs[16] == 0 || bs[16] > 4) return 0;
+    if (le16(bs + 22) == 0 && le32(bs + 36) == 0) return 0;
+    return le16(bs + 19) || le32(bs + 32);
+}
+
+int fsmap_build(int fd, size_t align, struct dirty_map *m, struct fs_info *info) {
+    struct fs_reader r = {.fd = fd, .align = align >= 512 ? align : 512, .cap = READ_CHUNK};
+    if (r.cap % r.align) r.cap += r.align - r.cap % r.align;
+    memset(info, 0, sizeof(*info));
+    if (posix_memalign((void **)&r.bounce, r.align, r.cap) != 0) {
+        fprintf(stderr, "posix_memalign failed\n");
+        return -1;
+    }
+
+    unsigned char head[2048];
+    int rc = fs_read(&r, 0, head, sizeof(head));
+    if (rc == 0) {
+        if (le16(head + 1024 + 56) == EXT4_MAGIC) rc = ext4_map(&r, head + 1024, m, info);
+        else if (fat_probe(head)) rc = fat_map(&r, head, m, info);
+        else rc = 1;
+    }
+    free(r.bounce);
+    return rc;
+}
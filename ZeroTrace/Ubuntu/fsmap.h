@@ -0,0 +1,25 @@
+// fsmap.h
+// Allocation maps read straight from the raw device, without mounting:
+// ext2/3/4 block-group bitmaps and FAT12/16/32 allocation tables. The blocks
+// a filesystem uses, plus all of its own metadata, are marked in a dirty map
+// so they can be wiped ahead of the free space.
+
+#ifndef ZT_FSMAP_H
+#define ZT_FSMAP_H
+
+#include "smart.h"
+
+struct fs_info {
+    const char *type;               // "ext4", "FAT32", ...
+    unsigned long long size;        // bytes the filesystem spans from offset 0
+    unsigned block;                 // allocation unit (block or cluster) in bytes
+    unsigned long long used;        // allocation units in use, in bytes
+};
+
+// Look for a filesystem at the start of fd and mark everything it has
+// allocated in m (which must cover offset 0). Reads honour align, so fd may
+// be open with O_DIRECT. Returns 0 when a filesystem was mapped, 1 when none
+// was recognised, -1 on a read error or a corrupt filesystem (reported).
+int fsmap_build(int fd, size_t align, struct dirty_map *m, struct fs_info *info);
+
+#endif
@@ -0,0 +1,129 @@
+// offload.c
+// Range-at-a-time BLKZEROOUT / BLKDISCARD / BLKSECDISCARD with a
+// per-range fallback to the regular write path.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#include "device.h"
+#include "offload.h"
+#include "../common/progress.h"
+
+struct offload_run {
+    const struct wipe_io *io;
+    enum offload_kind kind;
+    unsigned long long range;
+    unsigned long long nranges;
+    unsigned long long next;        // next range to claim
+    unsigned long long offloaded;
+    unsigned long long written;
+    int unsupported;                // ioctl rejected outright; write the rest
+    int failed;
+    int cancelled;                  // io->cancel seen with ranges left
+};
+
+static const char *tag(const struct wipe_io *io) {
+    return io->tag ? io->tag : "";
+}
+
+const char *offload_name(enum offload_kind kind) {
+    switch (kind) {
+    case OFFLOAD_ZEROOUT: return "BLKZEROOUT";
+    case OFFLOAD_DISCARD: return "BLKDISCARD";
+    case OFFLOAD_SECDISCARD: return "BLKSECDISCARD";
+    case OFFLOAD_AUTO: return "auto";
+    case OFFLOAD_NONE: break;
+    }
+    return "none";
+}
+
+enum offload_kind offload_pick(enum offload_kind kind, const struct device *d) {
+    if (kind != OFFLOAD_AUTO) return kind;
+    return d->is_block && d->topo.write_zeroes_max ? OFFLOAD_ZEROOUT : OFFLOAD_NONE;
+}
+
+static int issue(int fd, enum offload_kind kind, unsigned long long off, unsigned long long len) {
+    uint64_t r[2] = {off, len};
+    unsigned long req = kind == OFFLOAD_ZEROOUT ? BLKZEROOUT
+                      : kind == OFFLOAD_SECDISCARD ? BLKSECDISCARD : BLKDISCARD;
+    return ioctl(fd, req, r);
+}
+
+static void *offload_worker(void *arg) {
+    struct offload_run *or = arg;
+    const struct wipe_io *io = or->io;
+    for (;;) {
+        if (__atomic_load_n(&or->failed, __ATOMIC_RELAXED)) break;
+        if (io->cancel && *io->cancel) {
+            if (__atomic_load_n(&or->next, __ATOMIC_RELAXED) < or->nranges)
+                __atomic_store_n(&or->cancelled, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        unsigned long long k = __atomic_fetch_add(&or->next, 1, __ATOMIC_RELAXED);
+        if (k >= or->nranges) break;
+        unsigned long long off = io->start + k * or->range;
+        unsigned long long len = io->len - k * or->range < or->range ? io->len - k * or->range : or->range;
+
+        if (!__atomic_load_n(&or->unsupported, __ATOMIC_RELAXED)) {
+            if (issue(io->fd, or->kind, off, len) == 0) {
+                __atomic_fetch_add(&or->offloaded, len, __ATOMIC_RELAXED);
+                progress_add(io->progress, PROGRESS_WRITTEN, len);
+                continue;
+            }
+            int err = errno;
+            // These mean the ioctl will never work here (no support, a
+            // regular file, misaligned range); anything else may be local
+            // to this range, so the next one tries again.
+            if (err == EOPNOTSUPP || err == ENOTTY || err == EINVAL) {
+                if (!__atomic_exchange_n(&or->unsupported, 1, __ATOMIC_RELAXED))
+                    fprintf(stderr, "%s%s not available (%s); writing zeros instead\n",
+                            tag(io), offload_name(or->kind), strerror(err));
+            } else {
+                fprintf(stderr, "%s%s failed at offset %llu (%s); writing that range\n",
+                        tag(io), offload_name(or->kind), off, strerror(err));
+            }
+        }
+
+        struct wipe_io sub = *io;
+        sub.start = off;
+        sub.len = len;
+        sub.threads = 1;
+        unsigned long long w = 0;
+        int rc = engine_write(&sub, &w);
+        __atomic_fetch_add(&or->written, w, __ATOMIC_RELAXED);
+        if (rc == ENGINE_CANCELLED) __atomic_store_n(&or->cancelled, 1, __ATOMIC_RELAXED);
+        else if (rc != 0) __atomic_store_n(&or->failed, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+int offload_write(const struct wipe_io *io, enum offload_kind kind, unsigned long long range,
+                  unsigned threads, unsigned long long *offloaded, unsigned long long *written) {
+    struct offload_run or;
+    memset(&or, 0, sizeof(or));
+    or.io = io;
+    or.kind = kind;
+    or.range = range;
+    or.nranges = (io->len + range - 1) / range;
+    if (threads == 0) threads = 1;
+    if (threads > or.nranges) threads = or.nranges ? (unsigned)or.nranges : 1;
+
+    pthread_t tids[256];
+    unsigned started = 0;
+    if (threads > 256) threads = 256;
+    for (; started + 1 < threads; started++) {
+        if (pthread_create(&tids[started], NULL, offload_worker, &or) != 0) break;
+    }
+    offload_worker(&or);
+    for (unsigned i = 0; i < started; i++) pthread_join(tids[i], NULL);
+
+    *offloaded = or.offloaded;
+    *written = or.written;
+    return or.failed ? -1 : or.cancelled ? ENGINE_CANCELLED : 0;
+}
@@ -0,0 +1,34 @@
+// offload.h
+// Kernel offload for the Linux wiper: let the block layer or the device
+// zero or deallocate whole ranges (BLKZEROOUT, BLKDISCARD, BLKSECDISCARD)
+// instead of streaming zeros from user space.
+
+#ifndef ZT_OFFLOAD_H
+#define ZT_OFFLOAD_H
+
+#include "engine.h"
+
+struct device;
+
+enum offload_kind {
+    OFFLOAD_NONE,
+    OFFLOAD_ZEROOUT,      // BLKZEROOUT: reads back as zeros afterwards
+    OFFLOAD_DISCARD,      // BLKDISCARD: deallocate; contents afterwards up to the device
+    OFFLOAD_SECDISCARD,   // BLKSECDISCARD: deallocate and erase every copy
+    OFFLOAD_AUTO,         // zeroout when the device supports write-zeroes, else none
+};
+
+// Resolve OFFLOAD_AUTO for a device from its queue limits.
+enum offload_kind offload_pick(enum offload_kind kind, const struct device *d);
+
+// Cover [start, start + len) of io with the given ioctl, `threads` ranges of
+// `range` bytes in flight at once. A range the kernel rejects is written
+// with zeros through engine_write instead; once the ioctl is reported as
+// unsupported, no more are tried. Returns like engine_write; *offloaded and
+// *written receive the bytes handled by each path.
+int offload_write(const struct wipe_io *io, enum offload_kind kind, unsigned long long range,
+                  unsigned threads, unsigned long long *offloaded, unsigned long long *written);
+
+const char *offload_name(enum offload_kind kind);
+
+#endif
@@ -0,0 +1,317 @@
+// plan.c
+// Backends and the pass loop shared by every overwrite mode.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "plan.h"
+
+// ---------------------------------------------------------------------------
+// Backends
+
+static int engine_backend_write(const struct wipe_backend *b, const struct wipe_io *io, unsigned long long *written);
+static int engine_backend_verify(const struct wipe_backend *b, const struct wipe_io *io,
+                                 unsigned long long *verified);
+
+static const struct wipe_backend engine_backends[] = {
+    [ENGINE_SYNC] = { "sync", engine_backend_write, engine_backend_verify },
+    [ENGINE_URING] = { "io_uring", engine_backend_write, engine_backend_verify },
+};
+
+static enum io_engine backend_kind(const struct wipe_backend *b) {
+    return b == &engine_backends[ENGINE_SYNC] ? ENGINE_SYNC : ENGINE_URING;
+}
+
+static int engine_backend_write(const struct wipe_backend *b, const struct wipe_io *io, unsigned long long *written) {
+    struct wipe_io w = *io;
+    w.engine = backend_kind(b);
+    return engine_write(&w, written);
+}
+
+static int engine_backend_verify(const struct wipe_backend *b, const struct wipe_io *io,
+                                 unsigned long long *verified) {
+    struct wipe_io v = *io;
+    v.engine = backend_kind(b);
+    return engine_verify(&v, verified);
+}
+
+const struct wipe_backend *backend_engine(enum io_engine e) {
+    return &engine_backends[e == ENGINE_SYNC ? ENGINE_SYNC : ENGINE_URING];
+}
+
+static int offload_backend_write(const struct wipe_backend *b, const struct wipe_io *io, unsigned long long *written) {
+    struct offload_backend *ob = (struct offload_backend *)b;
+    if (io->pattern && (io->pattern->random || io->pattern->byte)) return engine_write(io, written);
+    unsigned long long off = 0, w = 0;
+    int rc = offload_write(io, ob->kind, ob->range, ob->threads, &off, &w);
+    ob->offloaded += off;
+    *written = off + w;
+    return rc;
+}
+
+static int offload_backend_verify(const struct wipe_backend *b, const struct wipe_io *io,
+                                  unsigned long long *verified) {
+    (void)b;
+    return engine_verify(io, verified);
+}
+
+void backend_offload(struct offload_backend *ob, enum offload_kind kind, unsigned long long range, unsigned threads) {
+    memset(ob, 0, sizeof(*ob));
+    ob->b.name = offload_name(kind);
+    ob->b.write = offload_backend_write;
+    ob->b.verify = offload_backend_verify;
+    ob->kind = kind;
+    ob->range = range;
+    ob->threads = threads;
+}
+
+// ---------------------------------------------------------------------------
+// Passes
+
+// Write or verify [lo, hi) of io's range: the parts of the extents inside
+// it, starting the search at extent `first`, or all of it without extents.
+static int cover(const struct wipe_plan *plan, const struct wipe_backend *b, const struct wipe_io *io,
+                 unsigned long long lo, unsigned long long hi, long first, int verify, unsigned long long *done) {
+    struct wipe_io sub = *io;
+    *done = 0;
+    if (!plan->ext) {
+        sub.start = lo;
+        sub.len = hi - lo;
+        return verify ? b->verify(b, &sub, done) : b->write(b, &sub, done);
+    }
+    for (long i = first; i < plan->next && plan->ext[i].off < hi; i++) {
+        unsigned long long s = plan->ext[i].off > lo ? plan->ext[i].off : lo;
+        unsigned long long e = plan->ext[i].off + plan->ext[i].len;
+        if (e > hi) e = hi;
+        if (s >= e) continue;
+        sub.start = s;
+        sub.len = e - s;
+        unsigned long long n = 0;
+        int rc = verify ? b->verify(b, &sub, &n) : b->write(b, &sub, &n);
+        *done += n;
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+static void print_pass(const struct wipe_plan *plan, int p, const struct pass_pattern *pat) {
+    const char *t = plan->tag ? plan->tag : "";
+    if (pat->random) {
+        char hex[2 * PATTERN_KEY_SIZE + 1];
+        pattern_key_hex(&pat->key, hex);
+        printf("%sPass %d: writing random data (ChaCha20, %s), key %s\n", t, p + 1, pattern_impl(), hex);
+    } else {
+        printf("%sPass %d: writing pattern 0x%02X\n", t, p + 1, pat->byte);
+    }
+}
+
+// Select a pass's pattern for io and tail; zeros come from the shared
+// chunk, anything else is generated.
+static void use_pass(struct wipe_io *io, struct wipe_io *tail, const struct pass_pattern *pat) {
+    io->pattern = tail->pattern = (pat->random || pat->byte) ? pat : NULL;
+}
+
+// One pass over the tail, through its own descriptor and the sync engine.
+// A verify failure is recorded in r; returns the write result.
+static int tail_pass(const struct wipe_plan *plan, struct wipe_io *tail, struct plan_result *r) {
+    const struct wipe_backend *tb = backend_engine(ENGINE_SYNC);
+    unsigned long long n = 0;
+    int rc = tb->write(tb, tail, &n);
+    r->written += n;
+    if (rc != 0 || !plan->verify || (r->verify != PLAN_NOT_RUN && r->verify != 0)) return rc;
+    posix_fadvise(tail->fd, (off_t)tail->start, (off_t)tail->len, POSIX_FADV_DONTNEED);
+    n = 0;
+    r->verify = tb->verify(tb, tail, &n);
+    r->verified += n;
+    return 0;
+}
+
+static struct lat_rec *phase(const struct wipe_plan *plan, const char *name, int pass,
+                             enum progress_counter track, unsigned long long total) {
+    return plan->phase ? plan->phase(plan->ctx, name, pass, plan->npasses, track, total) : NULL;
+}
+
+// Classic order: each pass sweeps the whole range before the next starts.
+static int run_sweeps(const struct wipe_plan *plan, const struct wipe_backend *b, struct wipe_io *io,
+                      struct wipe_io *tail, struct plan_result *res, unsigned long long per_pass) {
+    const char *t = plan->tag ? plan->tag : "";
+    const struct wipe_backend *tb = backend_engine(ENGINE_SYNC);
+    unsigned long long end = io->start + io->len;
+    int rc = 0;
+    for (int p = 0; p < plan->npasses; p++) {
+        if (res[p].write == PLAN_NO_KEY) continue;
+        if (io->cancel && *io->cancel) {
+            res[p].write = ENGINE_CANCELLED;
+            rc = -1;
+            break;
+        }
+        print_pass(plan, p, &res[p].pat);
+        use_pass(io, tail, &res[p].pat);
+
+        io->latency = tail->latency = phase(plan, "write", p + 1, PROGRESS_WRITTEN, per_pass);
+        int wrc = cover(plan, b, io, io->start, end, 0, 0, &res[p].written);
+        if (wrc == 0 && tail->len) {
+            unsigned long long w = 0;
+            wrc = tb->write(tb, tail, &w);
+            res[p].written += w;
+        }
+        fsync(io->fd);
+        res[p].write = wrc;
+        if (wrc != 0) {
+            rc = -1;
+            break;
+        }
+
+        if (plan->verify) {
+            printf("%sPass %d: verifying ...\n", t, p + 1);
+            io->digest = tail->digest = p == plan->npasses - 1 ? plan->digest : NULL;
+            io->latency = tail->latency = phase(plan, "verify", p + 1, PROGRESS_VERIFIED, per_pass);
+            int vrc = cover(plan, b, io, io->start, end, 0, 1, &res[p].verified);
+            if (vrc == 0 && tail->len) {
+                unsigned long long r = 0;
+                posix_fadvise(tail->fd, (off_t)tail->start, (off_t)tail->len, POSIX_FADV_DONTNEED);
+                vrc = tb->verify(tb, tail, &r);
+                res[p].verified += r;
+            }
+            res[p].verify = vrc;
+            if (vrc != 0) rc = -1;
+        }
+    }
+    return rc;
+}
+
+// Interleaved order: every pass over one region, then the next region.
+static int run_interleaved(const struct wipe_plan *plan, const struct wipe_backend *b, struct wipe_io *io,
+                           struct wipe_io *tail, struct plan_result *res, unsigned long long per_pass) {
+    const char *t = plan->tag ? plan->tag : "";
+    unsigned long long end = io->start + io->len;
+    int live = 0;
+    for (int p = 0; p < plan->npasses; p++) {
+        if (res[p].write == PLAN_NO_KEY) continue;
+        print_pass(plan, p, &res[p].pat);
+        res[p].write = 0;
+        live++;
+    }
+    printf("%sInterleaving %d pass%s over %llu MB regions, one barrier per pass per region\n", t, live,
+           live == 1 ? "" : "es", plan->region / (1024ULL*1024ULL));
+    io->latency = tail->latency = phase(plan, plan->verify ? "write+verify" : "write", 0, PROGRESS_WRITTEN,
+                                        per_pass * (unsigned long long)live);
+
+    // The engine's own barriers are replaced by the one after each pass.
+    struct wipe_io rio = *io;
+    rio.barrier = 0;
+    long first = 0;
+    int rc = 0;
+    for (unsigned long long lo = io->start; lo < end && rc == 0; ) {
+        unsigned long long hi = end - lo > plan->region ? lo + plan->region : end;
+        for (int p = 0; p < plan->npasses && rc == 0; p++) {
+            struct plan_result *r = &res[p];
+            if (r->write != 0) continue;
+            use_pass(&rio, tail, &r->pat);
+            unsigned long long n = 0;
+            int wrc = io->cancel && *io->cancel ? ENGINE_CANCELLED : cover(plan, b, &rio, lo, hi, first, 0, &n);
+            r->written += n;
+            if (wrc == 0 && fdatasync(io->fd) != 0) {
+                fprintf(stderr, "%sfdatasync failed: %s\n", t, strerror(errno));
+                wrc = -1;
+            }
+            if (wrc != 0) {
+                r->write = wrc;
+                if (r->verify == 0) r->verify = PLAN_NOT_RUN;
+                rc = -1;
+                break;
+            }
+            // After a mismatch the pass is not read again; the first bad
+            // offset has been reported.
+            if (plan->verify && (r->verify == PLAN_NOT_RUN || r->verify == 0)) {
+                n = 0;
+                rio.digest = p == plan->npasses - 1 ? plan->digest : NULL;
+                r->verify = cover(plan, b, &rio, lo, hi, first, 1, &n);
+                r->verified += n;
+            }
+        }
+        while (plan->ext && first < plan->next && plan->ext[first].off + plan->ext[first].len <= hi) first++;
+        lo = hi;
+    }
+    for (int p = 0; p < plan->npasses; p++) {
+        if (res[p].write != 0) continue;
+        if (rc != 0) {
+            // Stopped before this pass reached the end: what it wrote and
+            // verified covers only the regions done so far.
+            res[p].write = PLAN_INCOMPLETE;
+            if (res[p].verify == 0) res[p].verify = PLAN_NOT_RUN;
+        } else if (tail->len) {
+            use_pass(io, tail, &res[p].pat);
+            tail->digest = p == plan->npasses - 1 ? plan->digest : NULL;
+            res[p].write = tail_pass(plan, tail, &res[p]);
+            if (res[p].write != 0) rc = -1;
+        }
+    }
+    fsync(io->fd);
+    for (int p = 0; p < plan->npasses; p++)
+        if (res[p].verify != PLAN_NOT_RUN && res[p].verify != 0) rc = -1;
+    return rc;
+}
+
+int plan_run(const struct wipe_plan *plan, const struct wipe_backend *b, struct wipe_io *io,
+             struct wipe_io *tail, struct plan_result *res) {
+    const char *t = plan->tag ? plan->tag : "";
+    unsigned long long per_pass = tail->len;
+    if (plan->ext) for (long i = 0; i < plan->next; i++) per_pass += plan->ext[i].len;
+    else per_pass += io->len;
+
+    // Keys are drawn up front: an interleaved pass is written a region at
+    // a time and must be the same stream throughout.
+    memset(res, 0, plan->npasses * sizeof(*res));
+    int rc = 0;
+    for (int p = 0; p < plan->npasses; p++) {
+        res[p].write = res[p].verify = PLAN_NOT_RUN;
+        res[p].pat = plan->passes[p];
+        if (res[p].pat.random && pattern_key_generate(&res[p].pat.key) != 0) {
+            fprintf(stderr, "%sPass %d: no system random source available\n", t, p + 1);
+            res[p].write = PLAN_NO_KEY;
+            rc = -1;
+        }
+    }
+    if (plan->region && plan->npasses > 1) {
+        if (run_interleaved(plan, b, io, tail, res, per_pass) != 0) rc = -1;
+    } else {
+        if (run_sweeps(plan, b, io, tail, res, per_pass) != 0) rc = -1;
+    }
+    io->pattern = tail->pattern = NULL;
+    io->digest = tail->digest = NULL;
+    return rc;
+}
+
+const char *plan_status(const struct plan_result *res, int n) {
+    for (int p = 0; p < n; p++) {
+        if (res[p].write == PLAN_NO_KEY) return "no random source";
+        if (res[p].write == ENGINE_CANCELLED) return "interrupted";
+        if (res[p].write != 0 && res[p].write != PLAN_NOT_RUN && res[p].write != PLAN_INCOMPLETE) return "write failed";
+        if (res[p].verify == ENGINE_CANCELLED) return "interrupted";
+        if (res[p].verify == 1) return "verify mismatch";
+        if (res[p].verify == -1) return "verify read error";
+    }
+    return NULL;
+}
+
+void plan_report(const struct plan_result *res, int n, FILE *f, const char *tag) {
+    const char *t = tag ? tag : "";
+    fprintf(f, "\n%s%-6s %-8s %12s %12s  %s\n", t, "Pass", "Pattern", "Written MB", "Verified MB", "Result");
+    for (int p = 0; p < n; p++) {
+        char name[8];
+        const char *r = res[p].verify == 0 ? "OK" : res[p].verify == 1 ? "MISMATCH"
+                      : res[p].verify == -1 ? "READ ERROR" : res[p].verify == ENGINE_CANCELLED ? "interrupted"
+                      : res[p].write == 0 ? "not verified" : res[p].write == ENGINE_CANCELLED ? "interrupted"
+                      : res[p].write == PLAN_NOT_RUN || res[p].write == PLAN_NO_KEY ? "not written"
+                      : res[p].write == PLAN_INCOMPLETE ? "incomplete" : "WRITE FAILED";
+        if (res[p].pat.random) snprintf(name, sizeof(name), "Random");
+        else snprintf(name, sizeof(name), "0x%02X", res[p].pat.byte);
+        fprintf(f, "%s%-6d %-8s %12llu %12llu  %s\n", t, p + 1, name, res[p].written / (1024ULL*1024ULL),
+                res[p].verified / (1024ULL*1024ULL), r);
+    }
+}
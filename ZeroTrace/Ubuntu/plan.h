@@ -0,0 +1,97 @@
+// plan.h
+// A wipe as a plan: which passes to write, over which extents, carried out
+// by a backend. Full clears, the three-pass purge and smart purge differ
+// only in their passes and extents, so they share one loop, and a change to
+// a backend reaches every mode at once.
+
+#ifndef ZT_PLAN_H
+#define ZT_PLAN_H
+
+#include <stdio.h>
+
+#include "engine.h"
+#include "offload.h"
+#include "smart.h"
+#include "../common/pattern.h"
+#include "../common/progress.h"
+
+// How the bytes get to the device. Both calls take the range, pattern and
+// tuning from io and return like engine_write / engine_verify.
+struct wipe_backend {
+    const char *name;
+    int (*write)(const struct wipe_backend *b, const struct wipe_io *io, unsigned long long *written);
+    int (*verify)(const struct wipe_backend *b, const struct wipe_io *io, unsigned long long *verified);
+};
+
+// The engine's loops with io->engine forced to e: "sync" or "io_uring".
+const struct wipe_backend *backend_engine(enum io_engine e);
+
+// Kernel offload (see offload.h) for zero passes, `threads` ranges of
+// `range` bytes at a time; other passes, and ranges the kernel rejects, go
+// through the engine. Reads always do.
+struct offload_backend {
+    struct wipe_backend b;
+    enum offload_kind kind;
+    unsigned long long range;
+    unsigned threads;
+    unsigned long long offloaded;   // bytes the kernel took, summed over calls
+};
+void backend_offload(struct offload_backend *ob, enum offload_kind kind, unsigned long long range, unsigned threads);
+
+// Passes run in order. A random pass gets a fresh key when it starts.
+// Each pass covers the extents, or io's whole range when ext is NULL, and
+// then tail (when it has a length) through its own descriptor.
+//
+// With a region size set, the passes are interleaved instead of swept: all
+// of them are written over one region before the run moves to the next,
+// each followed by a single fdatasync, so the drive cannot merge two passes
+// in its cache and the head (or the FTL) stays in one region. Each pass is
+// read back there, when asked, before the next overwrites it.
+struct wipe_plan {
+    const struct pass_pattern *passes;
+    int npasses;
+    const struct extent *ext;
+    long next;
+    int verify;             // read every pass back before the next one
+    unsigned long long region;  // bytes per interleaved region (0 = full sweeps)
+    const char *tag;        // prefix for report lines
+    // Handed the last pass's read-back, tail included (see readback.h);
+    // every byte of io's range is hashed only when ext is NULL.
+    struct readback *digest;
+    // Called as each phase starts; returns the latency recorder for it
+    // (may be NULL).
+    struct lat_rec *(*phase)(void *ctx, const char *phase, int pass, int passes,
+                             enum progress_counter track, unsigned long long total);
+    void *ctx;
+};
+
+// plan_result.write and .verify until the pass gets that far, .write when
+// no key could be drawn for a random pass, and .write for an interleaved
+// pass that was under way when another pass's failure stopped the run.
+#define PLAN_NOT_RUN (-3)
+#define PLAN_NO_KEY (-4)
+#define PLAN_INCOMPLETE (-5)
+
+struct plan_result {
+    struct pass_pattern pat;    // as written, key included
+    unsigned long long written, verified;
+    int write;                  // backend write result, PLAN_NOT_RUN, PLAN_NO_KEY or PLAN_INCOMPLETE
+    int verify;                 // backend verify result or PLAN_NOT_RUN
+};
+
+// Run plan with b; res receives one entry per pass. A pass that cannot be
+// written stops the run; a verify failure is recorded and the next pass
+// still goes ahead. Once io->cancel is set no further request is issued and
+// the pass it stopped is recorded as ENGINE_CANCELLED. Returns 0 when every
+// pass was written, and verified if asked, -1 otherwise.
+int plan_run(const struct wipe_plan *plan, const struct wipe_backend *b, struct wipe_io *io,
+             struct wipe_io *tail, struct plan_result *res);
+
+// Why a run failed, for the job status ("write failed", "verify mismatch",
+// ...), or NULL when it did not.
+const char *plan_status(const struct plan_result *res, int n);
+
+// One line per pass: pattern, MB written and verified, result.
+void plan_report(const struct plan_result *res, int n, FILE *f, const char *tag);
+
+#endif
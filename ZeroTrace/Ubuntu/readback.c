@@ -0,0 +1,236 @@
+// readback.c
+// Hashing threads and the in-order fold of their subtrees.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "readback.h"
+#include "../common/buffers.h"
+
+#define MAX_THREADS 8
+// Requests waiting for a hashing thread, per thread.
+#define QUEUE_PER_THREAD 2
+// Buffers kept for reuse once hashed.
+#define FREE_BUFFERS 32
+// Aligned power-of-two runs one request splits into; a 256 MiB request at
+// any chunk offset needs at most 2 * 18.
+#define MAX_SUBTREES 64
+
+struct job {
+    void *buf;
+    size_t size;
+    unsigned long long off;     // from the start of the range
+    size_t len;
+};
+
+// One request, hashed: bytes before its first chunk boundary, whole
+// subtrees, and bytes after the last one it can close (the range's final
+// chunk is never closed early, it becomes the root).
+struct entry {
+    struct entry *next;
+    unsigned long long off, len;
+    unsigned char head[DIGEST_CHUNK];
+    size_t head_len;
+    unsigned n;
+    uint32_t cv[MAX_SUBTREES][8];
+    size_t sub[MAX_SUBTREES];
+    unsigned char tail[DIGEST_CHUNK];
+    size_t tail_len;
+};
+
+struct spare {
+    void *buf;
+    size_t size;
+};
+
+struct readback {
+    unsigned long long start, len;
+    unsigned long long final;        // where the last chunk starts
+    pthread_mutex_t lock;
+    pthread_cond_t work, room;
+    struct job *queue;
+    unsigned qcap, qhead, qcount;
+    struct spare spare[FREE_BUFFERS];
+    unsigned nspare;
+    struct entry *pending;           // hashed but not yet folded, by offset
+    struct digest d;
+    unsigned long long next;         // bytes folded into d
+    int stop;
+    pthread_t tids[MAX_THREADS];
+    unsigned threads;
+};
+
+static void hash_job(const struct readback *rb, const struct job *j, struct entry *e) {
+    const unsigned char *p = j->buf;
+    unsigned long long a = j->off, b = j->off + j->len;
+    unsigned long long aligned = (a + DIGEST_CHUNK - 1) / DIGEST_CHUNK * DIGEST_CHUNK;
+    unsigned long long whole = b / DIGEST_CHUNK * DIGEST_CHUNK;
+    if (whole > rb->final) whole = rb->final;
+    if (aligned > b) aligned = b;
+    memset(e, 0, offsetof(struct entry, cv));
+    e->off = a;
+    e->len = j->len;
+    e->head_len = (size_t)(aligned - a);
+    memcpy(e->head, p, e->head_len);
+    unsigned long long pos = aligned;
+    while (pos < whole) {
+        size_t s = DIGEST_CHUNK;
+        while (pos % (2 * s) == 0 && pos + 2 * s <= whole) s *= 2;
+        digest_subtree(p + (pos - a), s, pos, e->cv[e->n]);
+        e->sub[e->n++] = s;
+        pos += s;
+    }
+    e->tail_len = (size_t)(b - pos);
+    memcpy(e->tail, p + (pos - a), e->tail_len);
+}
+
+// Fold every entry that continues the digest; called with the lock held.
+static void fold(struct readback *rb) {
+    while (rb->pending && rb->pending->off == rb->next) {
+        struct entry *e = rb->pending;
+        rb->pending = e->next;
+        digest_update(&rb->d, e->head, e->head_len);
+        for (unsigned i = 0; i < e->n; i++) digest_push(&rb->d, e->cv[i], e->sub[i]);
+        digest_update(&rb->d, e->tail, e->tail_len);
+        rb->next += e->len;
+        free(e);
+    }
+}
+
+static void put_spare(struct readback *rb, void *buf, size_t size) {
+    if (rb->nspare < FREE_BUFFERS) {
+        rb->spare[rb->nspare].buf = buf;
+        rb->spare[rb->nspare].size = size;
+        rb->nspare++;
+        return;
+    }
+    buffer_free(buf, size);
+}
+
+static void *hasher(void *arg) {
+    struct readback *rb = arg;
+    pthread_mutex_lock(&rb->lock);
+    for (;;) {
+        while (!rb->qcount && !rb->stop) pthread_cond_wait(&rb->work, &rb->lock);
+        if (!rb->qcount) break;
+        struct job j = rb->queue[rb->qhead];
+        rb->qhead = (rb->qhead + 1) % rb->qcap;
+        rb->qcount--;
+        pthread_cond_broadcast(&rb->room);
+        pthread_mutex_unlock(&rb->lock);
+
+        struct entry *e = malloc(sizeof(*e));
+        if (e) hash_job(rb, &j, e);
+
+        pthread_mutex_lock(&rb->lock);
+        if (e) {
+            struct entry **at = &rb->pending;
+            while (*at && (*at)->off < e->off) at = &(*at)->next;
+            e->next = *at;
+            *at = e;
+            fold(rb);
+        } else {
+            // The range will not be complete; readback_finish reports it.
+            fprintf(stderr, "Out of memory for the read-back digest\n");
+        }
+        put_spare(rb, j.buf, j.size);
+    }
+    pthread_mutex_unlock(&rb->lock);
+    return NULL;
+}
+
+struct readback *readback_new(unsigned long long start, unsigned long long len, unsigned threads) {
+    struct readback *rb = calloc(1, sizeof(*rb));
+    if (!rb) return NULL;
+    if (!threads) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (unsigned)n : 1;
+    }
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    rb->start = start;
+    rb->len = len;
+    rb->final = len ? (len - 1) / DIGEST_CHUNK * DIGEST_CHUNK : 0;
+    rb->qcap = threads * QUEUE_PER_THREAD;
+    rb->queue = calloc(rb->qcap, sizeof(*rb->queue));
+    if (!rb->queue) {
+        free(rb);
+        return NULL;
+    }
+    digest_init(&rb->d);
+    pthread_mutex_init(&rb->lock, NULL);
+    pthread_cond_init(&rb->work, NULL);
+    pthread_cond_init(&rb->room, NULL);
+    for (; rb->threads < threads; rb->threads++) {
+        if (pthread_create(&rb->tids[rb->threads], NULL, hasher, rb) != 0) break;
+    }
+    if (!rb->threads) {
+        fprintf(stderr, "Failed to start a hashing thread\n");
+        pthread_mutex_destroy(&rb->lock);
+        pthread_cond_destroy(&rb->work);
+        pthread_cond_destroy(&rb->room);
+        free(rb->queue);
+        free(rb);
+        return NULL;
+    }
+    return rb;
+}
+
+void *readback_buffer(struct readback *rb, size_t size) {
+    pthread_mutex_lock(&rb->lock);
+    for (unsigned i = 0; i < rb->nspare; i++) {
+        if (rb->spare[i].size != size) continue;
+        void *buf = rb->spare[i].buf;
+        rb->spare[i] = rb->spare[--rb->nspare];
+        pthread_mutex_unlock(&rb->lock);
+        return buf;
+    }
+    pthread_mutex_unlock(&rb->lock);
+    return buffer_alloc(size);
+}
+
+void readback_release(struct readback *rb, void *buf, size_t size) {
+    if (!buf) return;
+    pthread_mutex_lock(&rb->lock);
+    put_spare(rb, buf, size);
+    pthread_mutex_unlock(&rb->lock);
+}
+
+void readback_submit(struct readback *rb, void *buf, size_t size, unsigned long long off, size_t len) {
+    pthread_mutex_lock(&rb->lock);
+    while (rb->qcount == rb->qcap) pthread_cond_wait(&rb->room, &rb->lock);
+    struct job *j = &rb->queue[(rb->qhead + rb->qcount) % rb->qcap];
+    j->buf = buf;
+    j->size = size;
+    j->off = off - rb->start;
+    j->len = len;
+    rb->qcount++;
+    pthread_cond_signal(&rb->work);
+    pthread_mutex_unlock(&rb->lock);
+}
+
+int readback_finish(struct readback *rb, unsigned char out[DIGEST_SIZE], unsigned long long *hashed) {
+    pthread_mutex_lock(&rb->lock);
+    rb->stop = 1;
+    pthread_cond_broadcast(&rb->work);
+    pthread_mutex_unlock(&rb->lock);
+    for (unsigned i = 0; i < rb->threads; i++) pthread_join(rb->tids[i], NULL);
+
+    int rc = rb->next == rb->len && !rb->pending ? 0 : -1;
+    if (rc == 0) digest_final(&rb->d, out);
+    *hashed = rb->next;
+    while (rb->pending) {
+        struct entry *e = rb->pending;
+        rb->pending = e->next;
+        free(e);
+    }
+    for (unsigned i = 0; i < rb->nspare; i++) buffer_free(rb->spare[i].buf, rb->spare[i].size);
+    pthread_mutex_destroy(&rb->lock);
+    pthread_cond_destroy(&rb->work);
+    pthread_cond_destroy(&rb->room);
+    free(rb->queue);
+    free(rb);
+    return rc;
+}
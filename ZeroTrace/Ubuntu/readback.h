@@ -0,0 +1,39 @@
+// readback.h
+// BLAKE3 digest of a range as the verify pass reads it back, for the wipe
+// certificate. The I/O threads hand each checked request over with the
+// buffer it was read into and carry on with a fresh one; hashing threads
+// turn requests into BLAKE3 subtrees in whatever order they arrive and fold
+// them into the digest in offset order. No byte is read twice, and the
+// digest is what b3sum prints for an image of the range.
+
+#ifndef ZT_READBACK_H
+#define ZT_READBACK_H
+
+#include <stddef.h>
+
+#include "../common/digest.h"
+
+struct readback;
+
+// Digest [start, start + len), hashed by up to `threads` threads (0 = one
+// per online CPU, capped at 8). Returns NULL when out of memory.
+struct readback *readback_new(unsigned long long start, unsigned long long len, unsigned threads);
+
+// A buffer of size bytes to read into, from those the hashing threads are
+// done with when one fits. NULL when out of memory.
+void *readback_buffer(struct readback *rb, size_t size);
+// Return a buffer that is not going to be submitted.
+void readback_release(struct readback *rb, void *buf, size_t size);
+
+// Hand over buf (size bytes, from readback_buffer) holding the checked data
+// of [off, off + len). Every byte of the range must be submitted exactly
+// once, in any order, by any thread. Waits while the hashing threads are
+// this far behind.
+void readback_submit(struct readback *rb, void *buf, size_t size, unsigned long long off, size_t len);
+
+// Wait for the hashing, then free rb. Returns 0 with out set when the whole
+// range was submitted, -1 when part of it never was (the run stopped
+// early); *hashed receives the bytes folded in, in order, from start.
+int readback_finish(struct readback *rb, unsigned char out[DIGEST_SIZE], unsigned long long *hashed);
+
+#endif
@@ -0,0 +1,173 @@
+// sample.c
+// Builds the sorted read list for a sampled verification and runs it
+// through the engine.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sample.h"
+
+// Always read: this much at each end of the range, and this much either
+// side of a request boundary (rounded up to a sector).
+#define SAMPLE_EDGE (1024ULL * 1024)
+#define SAMPLE_BOUNDARY 4096
+// Beyond this many request boundaries, an evenly spread subset is read.
+#define SAMPLE_MAX_BOUNDARIES 4096
+// The share of old data the confidence figure is quoted for.
+#define SAMPLE_TOLERANCE 0.001
+
+struct range_list {
+    struct io_range *r;
+    unsigned long long n, cap;
+};
+
+static int add(struct range_list *l, unsigned long long off, unsigned long long end) {
+    if (l->n == l->cap) {
+        unsigned long long cap = l->cap ? l->cap * 2 : 1024;
+        struct io_range *r = realloc(l->r, cap * sizeof(*r));
+        if (!r) return -1;
+        l->r = r;
+        l->cap = cap;
+    }
+    l->r[l->n].off = off;
+    l->r[l->n].len = (size_t)(end - off);
+    l->n++;
+    return 0;
+}
+
+static int by_offset(const void *a, const void *b) {
+    const struct io_range *x = a, *y = b;
+    return x->off < y->off ? -1 : x->off > y->off;
+}
+
+static int by_value(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// x to the power n, by squaring: the build links no maths library.
+static double power(double x, unsigned long long n) {
+    double r = 1;
+    for (; n; n >>= 1, x *= x) {
+        if (n & 1) r *= x;
+    }
+    return r;
+}
+
+// With n random blocks clean, the largest share p of bad blocks that
+// would still go unseen with probability 1 - level: (1 - p)^n = 1 - level.
+static double share_bound(unsigned long long n, double level) {
+    double lo = 0, hi = 1;
+    for (int i = 0; i < 60; i++) {
+        double mid = (lo + hi) / 2;
+        if (power(1 - mid, n) > 1 - level) lo = mid;
+        else hi = mid;
+    }
+    return hi;
+}
+
+// Pick `samples` distinct random block indexes below nblocks (all of them
+// when there are fewer) from the seed's keystream, sorted. Repeats are
+// dropped and drawn again. Returns how many, or -1 when out of memory.
+static long long pick_blocks(const struct pattern_key *seed, unsigned long long samples, unsigned long long nblocks,
+                             unsigned long long **out) {
+    unsigned long long want = samples < nblocks ? samples : nblocks;
+    unsigned long long *v = malloc((want ? want : 1) * sizeof(*v));
+    if (!v) return -1;
+    unsigned long long n = 0, drawn = 0;
+    if (want == nblocks) {
+        for (; n < want; n++) v[n] = n;
+    }
+    while (n < want) {
+        unsigned long long more = want - n;
+        pattern_fill(seed, drawn * sizeof(*v), v + n, more * sizeof(*v));
+        drawn += more;
+        for (unsigned long long i = n; i < want; i++) v[i] %= nblocks;
+        qsort(v, want, sizeof(*v), by_value);
+        n = 0;
+        for (unsigned long long i = 0; i < want; i++) {
+            if (n == 0 || v[i] != v[n - 1]) v[n++] = v[i];
+        }
+    }
+    *out = v;
+    return (long long)n;
+}
+
+int sample_verify(const struct wipe_io *io, unsigned long long samples, struct sample_result *r) {
+    memset(r, 0, sizeof(*r));
+    unsigned long long start = io->start, end = io->start + io->len;
+    size_t unit = io->sector ? io->sector : io->align ? io->align : 512;
+    if (!io->len) return 0;
+    if (pattern_key_generate(&r->seed) != 0) {
+        fprintf(stderr, "%sNo system random source available\n", io->tag ? io->tag : "");
+        return -1;
+    }
+
+    struct range_list raw = {0};
+    int oom = 0;
+    unsigned long long edge = io->len < SAMPLE_EDGE ? io->len : SAMPLE_EDGE;
+    oom |= add(&raw, start, start + edge);
+    oom |= add(&raw, end - edge, end);
+    r->fixed = 2;
+
+    // Request boundaries strictly inside the range, each read as a little
+    // on both sides.
+    unsigned long long span = (SAMPLE_BOUNDARY + unit - 1) / unit * unit;
+    r->all_boundaries = io->chunk ? (io->len - 1) / io->chunk : 0;
+    r->boundaries = r->all_boundaries < SAMPLE_MAX_BOUNDARIES ? r->all_boundaries : SAMPLE_MAX_BOUNDARIES;
+    for (unsigned long long k = 0; k < r->boundaries && !oom; k++) {
+        unsigned long long b = start + (1 + k * r->all_boundaries / r->boundaries) * io->chunk;
+        oom |= add(&raw, b > start + span ? b - span : start, b + span < end ? b + span : end);
+    }
+    r->fixed += r->boundaries;
+
+    unsigned long long nblocks = (io->len + SAMPLE_BLOCK - 1) / SAMPLE_BLOCK;
+    unsigned long long *picked = NULL;
+    long long distinct = oom ? -1 : pick_blocks(&r->seed, samples, nblocks, &picked);
+    if (distinct < 0) oom = 1;
+    for (long long i = 0; i < distinct && !oom; i++) {
+        unsigned long long off = start + picked[i] * SAMPLE_BLOCK;
+        oom |= add(&raw, off, off + SAMPLE_BLOCK < end ? off + SAMPLE_BLOCK : end);
+    }
+    free(picked);
+    r->random = distinct > 0 ? (unsigned long long)distinct : 0;
+
+    // Merge what overlaps and cut the result into requests of at most a
+    // block, in offset order.
+    struct range_list reads = {0};
+    if (!oom) {
+        qsort(raw.r, raw.n, sizeof(*raw.r), by_offset);
+        for (unsigned long long i = 0; i < raw.n && !oom;) {
+            unsigned long long lo = raw.r[i].off, hi = lo + raw.r[i].len;
+            for (i++; i < raw.n && raw.r[i].off <= hi; i++) {
+                if (raw.r[i].off + raw.r[i].len > hi) hi = raw.r[i].off + raw.r[i].len;
+            }
+            for (unsigned long long off = lo; off < hi && !oom; off += SAMPLE_BLOCK)
+                oom |= add(&reads, off, hi - off > SAMPLE_BLOCK ? off + SAMPLE_BLOCK : hi);
+        }
+    }
+    free(raw.r);
+    if (oom) {
+        fprintf(stderr, "%sOut of memory for the sample list\n", io->tag ? io->tag : "");
+        free(reads.r);
+        return -1;
+    }
+
+    struct wipe_io sub = *io;
+    sub.chunk = SAMPLE_BLOCK;
+    sub.ranges = reads.r;
+    sub.nranges = reads.n;
+    int rc = engine_verify(&sub, &r->bytes);
+    free(reads.r);
+
+    if (r->random == nblocks) {
+        // Every block was read: a census, not a sample.
+        r->bound99 = 0;
+        r->confidence = 1;
+    } else if (r->random) {
+        r->bound99 = share_bound(r->random, 0.99);
+        r->confidence = 1 - power(1 - SAMPLE_TOLERANCE, r->random);
+    }
+    return rc;
+}
@@ -0,0 +1,39 @@
+// sample.h
+// Sampled verification for the Linux wiper. Instead of reading the whole
+// range back, read a number of randomly placed blocks plus the places a
+// wipe most often goes wrong - the first and last MiB (MBR, primary and
+// backup GPT) and the boundaries between requests, where workers hand
+// over - and check them against the pass pattern. The reads go to the
+// engine sorted by offset, so a queue of them sweeps across the drive
+// once rather than seeking back and forth.
+
+#ifndef ZT_SAMPLE_H
+#define ZT_SAMPLE_H
+
+#include "engine.h"
+#include "../common/pattern.h"
+
+// Bytes per random sample.
+#define SAMPLE_BLOCK (64 * 1024)
+
+struct sample_result {
+    unsigned long long random;      // distinct random blocks read
+    unsigned long long fixed;       // reads of the first/last MiB and request boundaries
+    unsigned long long boundaries;  // request boundaries checked
+    unsigned long long all_boundaries;  // request boundaries in the range
+    unsigned long long bytes;       // bytes read and checked
+    struct pattern_key seed;        // picks the random blocks; the same seed reads the same sample
+    // With every random block clean: the share of SAMPLE_BLOCK blocks that
+    // could still hold old data at 99% confidence, and the confidence that
+    // under 0.1% of them do.
+    double bound99;
+    double confidence;
+};
+
+// Check `samples` random blocks of [io->start, io->start + io->len) and the
+// fixed regions against io->pattern (zeros when NULL). io->ranges must be
+// unset; io->chunk is the request size whose boundaries are checked.
+// Returns like engine_verify; r is filled in either way.
+int sample_verify(const struct wipe_io *io, unsigned long long samples, struct sample_result *r);
+
+#endif
@@ -0,0 +1,850 @@
+// shred.c
+// File-tree shredding: a work-stealing walk, FIEMAP extent maps, io_uring
+// batches for small files and the engine for large ones.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "shred.h"
+#include "uring.h"
+#include "../common/buffers.h"
+#include "../common/pattern.h"
+#include "../common/progress.h"
+
+// A file whose data fits in one tile, in a few pieces, is written as part
+// of its batch; anything larger goes through the engine on its own.
+#define SMALL_BYTES BUFFER_TILE
+#define SMALL_SPANS 4
+// Files per work item. A random pass generates one tile of data for each
+// small file, so a batch needs BUFFER_DATA_MAX of buffer.
+#define BATCH_FILES (BUFFER_DATA_MAX / BUFFER_TILE)
+#define RING_ENTRIES 256
+// user_data of a batch's fdatasync, in place of a write's length.
+#define SYNC_TAG 0xFFFFFFFFu
+// Extents asked for per FIEMAP call.
+#define FIEMAP_BATCH 64
+#define MAX_THREADS 256
+
+// An open directory. Everything is opened, unlinked and removed relative
+// to one of these, never by path, so a directory swapped for a symbolic
+// link mid-walk cannot redirect the wipe. Work below it holds a reference;
+// the last one closes it and, unless keep is set, removes it from parent.
+struct dir_ref {
+    int fd;
+    unsigned refs;              // atomic
+    struct dir_ref *parent;     // NULL for the directory holding a starting point
+    char *name;                 // in parent
+    char *path;                 // for reports
+};
+
+// A directory entry as the walk found it. What is opened by name later has
+// to be the same inode, or it was replaced in between.
+struct entry {
+    struct dir_ref *dir;        // holds a reference
+    char *name;
+    char *path;                 // for reports
+    dev_t dev;
+    ino_t ino;
+};
+
+// Work item: a directory to read, or a batch of files to shred.
+struct item {
+    int is_dir;
+    dev_t dev;          // filesystem the walk stays on
+    int n;
+    struct entry e[BATCH_FILES];
+};
+
+// One worker's queue. The owner pushes and pops at the tail, finishing a
+// subtree while its inodes are still cached; thieves take from the head,
+// where the largest unexplored subtrees are.
+struct deque {
+    pthread_mutex_t lock;
+    struct item **v;
+    size_t head, tail, cap;
+};
+
+struct shred_run {
+    const struct shred_opts *o;
+    struct deque *q;
+    unsigned nworkers;
+    unsigned long long outstanding;   // items queued or in hand (atomic)
+    struct shred_totals t;            // updated atomically
+    int random;                       // some pass writes random data
+    pthread_mutex_t lock;             // report lines
+};
+
+struct worker {
+    pthread_t tid;
+    struct shred_run *run;
+    unsigned index;
+    struct uring ring;      // fd < 0: no batching, every file goes through the engine
+    void *data;             // BUFFER_DATA_MAX of random data for a batch
+};
+
+// An extent as FIEMAP reports it, and a byte range of the file to write.
+struct file_extent {
+    unsigned long long logical, physical, len;
+    unsigned flags;
+};
+
+struct span {
+    unsigned long long off, len;
+};
+
+struct file {
+    const struct entry *ent;
+    const char *path;
+    int fd;
+    struct stat st;
+    struct file_extent *ext;    // as mapped before the first pass
+    int next;
+    struct span *spans;
+    int nspans;
+    unsigned long long bytes;   // sum of the spans
+    int mapped;                 // FIEMAP worked
+    int small;                  // written as part of the batch
+    int retry;                  // the batch write failed; write it alone
+    int failed;                 // status says why
+    int relocated;
+    struct pass_pattern pat;    // the current pass, keyed for this file
+    char status[128];
+};
+
+static void count(unsigned long long *p, unsigned long long n) {
+    __atomic_fetch_add(p, n, __ATOMIC_RELAXED);
+}
+
+static int cancelled(const struct shred_run *r) {
+    return r->o->cancel && *r->o->cancel;
+}
+
+// One line per entry in the report file; anything but success also goes
+// to stderr and counts as a failure.
+static void report(struct shred_run *r, const char *status, unsigned long long bytes, const char *path,
+                   int problem) {
+    pthread_mutex_lock(&r->lock);
+    if (r->o->report) fprintf(r->o->report, "%s\t%llu\t%s\n", status, bytes, path);
+    if (problem) fprintf(stderr, "%s: %s\n", path, status);
+    pthread_mutex_unlock(&r->lock);
+    if (problem) count(&r->t.failed, 1);
+}
+
+static void report_errno(struct shred_run *r, const char *what, int err, const char *path) {
+    char status[128];
+    snprintf(status, sizeof(status), "failed: %s: %s", what, strerror(err));
+    report(r, status, 0, path, 1);
+}
+
+static char *join(const char *dir, const char *name) {
+    size_t a = strlen(dir), b = strlen(name);
+    char *p = malloc(a + b + 2);
+    if (!p) return NULL;
+    memcpy(p, dir, a);
+    if (a && dir[a - 1] != '/') p[a++] = '/';
+    memcpy(p + a, name, b + 1);
+    return p;
+}
+
+static struct item *new_item(int is_dir, dev_t dev) {
+    struct item *it = calloc(1, sizeof(*it));
+    if (!it) return NULL;
+    it->is_dir = is_dir;
+    it->dev = dev;
+    return it;
+}
+
+// Drop a reference; the last one closes the directory and removes it from
+// its parent (the directory of a starting point only holds, it is never
+// removed), then drops the parent's.
+static void dir_put(struct shred_run *r, struct dir_ref *d) {
+    while (d && __atomic_sub_fetch(&d->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        struct dir_ref *parent = d->parent;
+        close(d->fd);
+        // A starting point given as ".", ".." or "/" is emptied but stays.
+        int named = parent && strcmp(d->name, ".") && strcmp(d->name, "..") && strcmp(d->name, "/");
+        if (named && !r->o->keep && !cancelled(r)) {
+            if (unlinkat(parent->fd, d->name, AT_REMOVEDIR) == 0) {
+                count(&r->t.removed, 1);
+                report(r, "removed", 0, d->path, 0);
+            } else {
+                report_errno(r, "rmdir", errno, d->path);
+            }
+        }
+        free(d->name);
+        free(d->path);
+        free(d);
+        d = parent;
+    }
+}
+
+// Add name in dir (found as st) to it, taking a reference on dir.
+static int add_entry(struct item *it, struct dir_ref *dir, const char *name, const char *path,
+                     const struct stat *st) {
+    struct entry *e = &it->e[it->n];
+    e->name = strdup(name);
+    e->path = strdup(path);
+    if (!e->name || !e->path) {
+        free(e->name);
+        free(e->path);
+        return -1;
+    }
+    e->dir = dir;
+    e->dev = st->st_dev;
+    e->ino = st->st_ino;
+    __atomic_fetch_add(&dir->refs, 1, __ATOMIC_RELAXED);
+    it->n++;
+    return 0;
+}
+
+static void free_item(struct shred_run *r, struct item *it) {
+    for (int i = 0; i < it->n; i++) {
+        free(it->e[i].name);
+        free(it->e[i].path);
+        dir_put(r, it->e[i].dir);
+    }
+    free(it);
+}
+
+static int push(struct shred_run *r, unsigned w, struct item *it) {
+    struct deque *q = &r->q[w];
+    pthread_mutex_lock(&q->lock);
+    if (q->tail == q->cap && q->head) {
+        memmove(q->v, q->v + q->head, (q->tail - q->head) * sizeof(*q->v));
+        q->tail -= q->head;
+        q->head = 0;
+    } else if (q->tail == q->cap) {
+        size_t cap = q->cap ? q->cap * 2 : 64;
+        struct item **v = realloc(q->v, cap * sizeof(*v));
+        if (!v) {
+            pthread_mutex_unlock(&q->lock);
+            return -1;
+        }
+        q->v = v;
+        q->cap = cap;
+    }
+    // Counted before it can be taken, so outstanding never drops to zero
+    // while work remains.
+    __atomic_fetch_add(&r->outstanding, 1, __ATOMIC_RELAXED);
+    q->v[q->tail++] = it;
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+// Queue an item on worker w; one that cannot be queued is reported and dropped.
+static void queue(struct shred_run *r, unsigned w, struct item *it) {
+    if (push(r, w, it) == 0) return;
+    for (int i = 0; i < it->n; i++) report(r, "failed: out of memory", 0, it->e[i].path, 1);
+    free_item(r, it);
+}
+
+// The newest item on w's own queue, else the oldest on another's.
+static struct item *take(struct shred_run *r, unsigned w) {
+    struct item *it = NULL;
+    for (unsigned k = 0; !it && k < r->nworkers; k++) {
+        struct deque *q = &r->q[(w + k) % r->nworkers];
+        pthread_mutex_lock(&q->lock);
+        if (q->tail > q->head) it = k == 0 ? q->v[--q->tail] : q->v[q->head++];
+        if (q->tail == q->head) q->head = q->tail = 0;
+        pthread_mutex_unlock(&q->lock);
+    }
+    return it;
+}
+
+// Symbolic links, sockets, device nodes and the like hold no data of their
+// own; the entry is removed and nothing is followed.
+static void remove_other(struct shred_run *r, int dfd, const char *name, const char *path) {
+    if (r->o->keep) {
+        report(r, "kept: not a regular file", 0, path, 0);
+        return;
+    }
+    if (unlinkat(dfd, name, 0) != 0) {
+        report_errno(r, "unlink", errno, path);
+        return;
+    }
+    count(&r->t.removed, 1);
+    report(r, "removed", 0, path, 0);
+}
+
+static void walk_dir(struct worker *w, struct item *it) {
+    struct shred_run *r = w->run;
+    struct entry *ent = &it->e[0];
+    const char *path = ent->path;
+    int fd = openat(ent->dir->fd, ent->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        report_errno(r, "open", errno, path);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    if (st.st_dev != it->dev) {
+        close(fd);
+        report(r, "skipped: another filesystem is mounted here", 0, path, 1);
+        return;
+    }
+    if (st.st_dev != ent->dev || st.st_ino != ent->ino) {
+        close(fd);
+        report(r, "skipped: replaced since it was listed", 0, path, 1);
+        return;
+    }
+    // The directory takes over the entry's name, path and reference on
+    // its parent; its own first reference is this walk's.
+    struct dir_ref *self = calloc(1, sizeof(*self));
+    int dfd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    DIR *d = self && dfd >= 0 ? fdopendir(dfd) : NULL;
+    if (!d) {
+        report_errno(r, "opendir", self ? errno : ENOMEM, path);
+        if (dfd >= 0) close(dfd);
+        close(fd);
+        free(self);
+        return;
+    }
+    self->fd = fd;
+    self->refs = 1;
+    self->parent = ent->dir;
+    self->name = ent->name;
+    self->path = ent->path;
+    it->n = 0;
+
+    struct item *batch = NULL;
+    struct dirent *e;
+    for (;;) {
+        errno = 0;
+        if (cancelled(r) || (e = readdir(d)) == NULL) break;
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        char *child = join(path, e->d_name);
+        if (!child) {
+            report(r, "failed: out of memory", 0, e->d_name, 1);
+            continue;
+        }
+        struct stat es;
+        if (fstatat(fd, e->d_name, &es, AT_SYMLINK_NOFOLLOW) != 0) {
+            report_errno(r, "stat", errno, child);
+            free(child);
+            continue;
+        }
+
+        if (S_ISDIR(es.st_mode)) {
+            struct item *sub = new_item(1, it->dev);
+            if (!sub || add_entry(sub, self, e->d_name, child, &es) != 0) {
+                report(r, "failed: out of memory", 0, child, 1);
+                free(sub);
+            } else {
+                queue(r, w->index, sub);
+            }
+        } else if (S_ISREG(es.st_mode)) {
+            if ((!batch && !(batch = new_item(0, it->dev))) || add_entry(batch, self, e->d_name, child, &es) != 0) {
+                report(r, "failed: out of memory", 0, child, 1);
+            } else if (batch->n == BATCH_FILES) {
+                queue(r, w->index, batch);
+                batch = NULL;
+            }
+        } else {
+            remove_other(r, fd, e->d_name, child);
+        }
+        free(child);
+    }
+    if (errno) report_errno(r, "readdir", errno, path);
+    if (batch) queue(r, w->index, batch);
+    closedir(d);
+    dir_put(r, self);
+}
+
+// Extents of fd, synced first so delayed allocations have their blocks.
+// Returns how many, or -errno.
+static int map_extents(int fd, struct file_extent **out) {
+    struct fiemap *fm = malloc(sizeof(*fm) + FIEMAP_BATCH * sizeof(struct fiemap_extent));
+    struct file_extent *ext = NULL;
+    int n = 0, cap = 0, last = 0, err = 0;
+    unsigned long long start = 0;
+    if (!fm) return -ENOMEM;
+    while (!last) {
+        memset(fm, 0, sizeof(*fm));
+        fm->fm_start = start;
+        fm->fm_length = FIEMAP_MAX_OFFSET - start;
+        fm->fm_flags = FIEMAP_FLAG_SYNC;
+        fm->fm_extent_count = FIEMAP_BATCH;
+        if (ioctl(fd, FS_IOC_FIEMAP, fm) != 0) {
+            err = -errno;
+            break;
+        }
+        unsigned got = fm->fm_mapped_extents;
+        if (!got) break;
+        if (n + (int)got > cap) {
+            cap = cap ? cap * 2 : FIEMAP_BATCH;
+            while (n + (int)got > cap) cap *= 2;
+            struct file_extent *e = realloc(ext, (size_t)cap * sizeof(*e));
+            if (!e) {
+                err = -ENOMEM;
+                break;
+            }
+            ext = e;
+        }
+        for (unsigned i = 0; i < got; i++) {
+            const struct fiemap_extent *fe = &fm->fm_extents[i];
+            ext[n].logical = fe->fe_logical;
+            ext[n].physical = fe->fe_physical;
+            ext[n].len = fe->fe_length;
+            ext[n++].flags = fe->fe_flags;
+            if (fe->fe_flags & FIEMAP_EXTENT_LAST) last = 1;
+        }
+        start = fm->fm_extents[got - 1].fe_logical + fm->fm_extents[got - 1].fe_length;
+    }
+    free(fm);
+    if (err) {
+        free(ext);
+        return err;
+    }
+    *out = ext;
+    return n;
+}
+
+// Whether every byte mapped in a is still at the same place in b. Inline
+// data has no block address of its own and is not compared.
+static int same_blocks(const struct file_extent *a, int na, const struct file_extent *b, int nb) {
+    int j = 0;
+    for (int i = 0; i < na; i++) {
+        if (a[i].flags & (FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_UNKNOWN)) continue;
+        unsigned long long pos = a[i].logical, end = a[i].logical + a[i].len;
+        while (pos < end) {
+            while (j < nb && b[j].logical + b[j].len <= pos) j++;
+            if (j == nb || b[j].logical > pos) return 0;
+            if (b[j].physical - b[j].logical != a[i].physical - a[i].logical) return 0;
+            pos = b[j].logical + b[j].len < end ? b[j].logical + b[j].len : end;
+        }
+    }
+    return 1;
+}
+
+static void fail_file(struct file *f, const char *what, int err) {
+    snprintf(f->status, sizeof(f->status), "failed: %s: %s", what, strerror(err));
+    f->failed = 1;
+}
+
+// What to write: the extents, merged where they follow each other in the
+// file. They run to the end of the last block, so the slack after EOF and
+// blocks preallocated past it are overwritten too; with keep set they stop
+// at EOF and the file keeps its size. Without an extent map, the whole
+// file is written.
+static int make_spans(struct file *f, int keep) {
+    unsigned long long eof = (unsigned long long)f->st.st_size;
+    int cap = f->mapped ? f->next : 1;
+    f->spans = malloc((size_t)(cap ? cap : 1) * sizeof(*f->spans));
+    if (!f->spans) return -1;
+    if (!f->mapped) {
+        unsigned long long blk = f->st.st_blksize > 0 ? (unsigned long long)f->st.st_blksize : 4096;
+        f->spans[0].off = 0;
+        f->spans[0].len = keep ? eof : (eof + blk - 1) / blk * blk;
+        f->nspans = f->spans[0].len ? 1 : 0;
+    }
+    for (int i = 0; f->mapped && i < f->next; i++) {
+        unsigned long long off = f->ext[i].logical, end = off + f->ext[i].len;
+        if (keep && end > eof) end = eof;
+        if (end <= off) continue;
+        struct span *s = f->nspans ? &f->spans[f->nspans - 1] : NULL;
+        if (s && s->off + s->len == off) s->len = end - s->off;
+        else f->spans[f->nspans++] = (struct span){off, end - off};
+    }
+    for (int i = 0; i < f->nspans; i++) f->bytes += f->spans[i].len;
+    return 0;
+}
+
+static void open_file(struct file *f, int keep) {
+    f->fd = openat(f->ent->dir->fd, f->ent->name, O_WRONLY | O_NOFOLLOW | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    if (f->fd < 0) {
+        fail_file(f, "open", errno);
+        return;
+    }
+    if (fstat(f->fd, &f->st) != 0) {
+        fail_file(f, "stat", errno);
+        return;
+    }
+    if (!S_ISREG(f->st.st_mode)) {
+        snprintf(f->status, sizeof(f->status), "skipped: no longer a regular file");
+        f->failed = 1;
+        return;
+    }
+    if (f->st.st_dev != f->ent->dev || f->st.st_ino != f->ent->ino) {
+        snprintf(f->status, sizeof(f->status), "skipped: replaced since it was listed");
+        f->failed = 1;
+        return;
+    }
+    // Overwriting would destroy the data under its other names as well.
+    if (f->st.st_nlink > 1) {
+        snprintf(f->status, sizeof(f->status), "skipped: %lu other hard links",
+                 (unsigned long)f->st.st_nlink - 1);
+        f->failed = 1;
+        return;
+    }
+    int n = map_extents(f->fd, &f->ext);
+    if (n >= 0) {
+        f->next = n;
+        f->mapped = 1;
+    } else if (n != -EOPNOTSUPP && n != -ENOTTY) {
+        fail_file(f, "FIEMAP", -n);
+        return;
+    }
+    if (make_spans(f, keep) != 0) {
+        fail_file(f, "extent list", ENOMEM);
+        return;
+    }
+    f->small = f->bytes <= SMALL_BYTES && f->nspans <= SMALL_SPANS;
+}
+
+// The pass as written to one file. Random data gets a key of its own for
+// every file (mixed with the inode), so equal files do not get equal data.
+static void file_pattern(struct file *f, const struct pass_pattern *p) {
+    f->pat = *p;
+    if (!p->random) return;
+    unsigned long long ino = f->st.st_ino, dev = f->st.st_dev;
+    for (int i = 0; i < 8; i++) {
+        f->pat.key.bytes[i] ^= (unsigned char)(ino >> (8 * i));
+        f->pat.key.bytes[8 + i] ^= (unsigned char)(dev >> (8 * i));
+    }
+}
+
+// One pass over one file through the engine, made durable before returning.
+static void write_file(struct worker *w, struct file *f) {
+    const struct shred_opts *o = w->run->o;
+    char tag[PATH_MAX + 4];
+    snprintf(tag, sizeof(tag), "[%s] ", f->path);
+    for (int i = 0; i < f->nspans; i++) {
+        struct wipe_io io;
+        memset(&io, 0, sizeof(io));
+        io.fd = f->fd;
+        io.start = f->spans[i].off;
+        io.len = f->spans[i].len;
+        io.chunk = o->chunk;
+        io.depth = o->depth;
+        io.threads = 1;
+        io.engine = !f->small && w->ring.fd >= 0 ? o->engine : ENGINE_SYNC;
+        io.tag = tag;
+        io.progress = o->progress;
+        io.pattern = &f->pat;
+        io.cancel = o->cancel;
+        unsigned long long written = 0;
+        int rc = engine_write(&io, &written);
+        if (rc == ENGINE_CANCELLED) {
+            snprintf(f->status, sizeof(f->status), "failed: cancelled");
+            f->failed = 1;
+            return;
+        }
+        if (rc != 0) {
+            snprintf(f->status, sizeof(f->status), "failed: write error at offset %llu",
+                     f->spans[i].off + written);
+            f->failed = 1;
+            return;
+        }
+    }
+    if (fdatasync(f->fd) != 0) fail_file(f, "fdatasync", errno);
+}
+
+// One pass over the small files of a batch: each file's writes, with an
+// fdatasync linked behind them, all go to the ring in one submission.
+// Files whose writes fail are marked to be retried alone.
+static void write_batch(struct worker *w, struct file *files, int nf, const struct pass_pattern *p) {
+    const void *tile = p->random ? NULL : buffer_tile(p->byte);
+    unsigned queued = 0;
+    for (int i = 0; i < nf; i++) {
+        struct file *f = &files[i];
+        if (f->failed || !f->small) continue;
+        f->retry = !p->random && !tile;
+        if (f->retry) continue;
+        char *data = p->random ? (char *)w->data + (size_t)i * BUFFER_TILE : NULL;
+        for (int s = 0; s <= f->nspans; s++) {
+            struct io_uring_sqe *sqe = uring_get_sqe(&w->ring);
+            if (!sqe) {
+                f->retry = 1;
+                break;
+            }
+            sqe->fd = f->fd;
+            if (s == f->nspans) {
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                sqe->user_data = (unsigned long long)i << 32 | SYNC_TAG;
+            } else {
+                const struct span *sp = &f->spans[s];
+                const void *src = tile;
+                if (data) {
+                    pattern_fill(&f->pat.key, sp->off, data, (size_t)sp->len);
+                    src = data;
+                    data += sp->len;
+                }
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->addr = (unsigned long long)(uintptr_t)src;
+                sqe->len = (unsigned)sp->len;
+                sqe->off = sp->off;
+                sqe->flags = IOSQE_IO_LINK;
+                sqe->user_data = (unsigned long long)i << 32 | (unsigned)sp->len;
+            }
+            queued++;
+        }
+    }
+
+    unsigned done = 0;
+    while (done < queued) {
+        int ret = uring_submit_and_wait(&w->ring, 1);
+        if (ret < 0) {
+            // The ring is unusable: drain it by closing it, and write every
+            // file of this batch and the next ones alone.
+            fprintf(stderr, "io_uring failed (%s); writing files one at a time\n", strerror(-ret));
+            uring_exit(&w->ring);
+            w->ring.fd = -1;
+            for (int i = 0; i < nf; i++) files[i].retry = files[i].small;
+            return;
+        }
+        struct io_uring_cqe cqe;
+        while (uring_pop_cqe(&w->ring, &cqe)) {
+            done++;
+            struct file *f = &files[cqe.user_data >> 32];
+            unsigned want = (unsigned)cqe.user_data;
+            if (cqe.res < 0 || (want != SYNC_TAG && (unsigned)cqe.res != want)) f->retry = 1;
+            else if (want != SYNC_TAG) progress_add(w->run->o->progress, PROGRESS_WRITTEN, want);
+        }
+    }
+}
+
+// After the last pass: check the data stayed where it was mapped, then
+// truncate and unlink.
+static void finish_file(struct worker *w, struct file *f) {
+    struct shred_run *r = w->run;
+    if (!f->failed && f->mapped) {
+        struct file_extent *now = NULL;
+        int n = map_extents(f->fd, &now);
+        if (n >= 0 && !same_blocks(f->ext, f->next, now, n)) f->relocated = 1;
+        free(now);
+    }
+    if (!f->failed && !r->o->keep) {
+        if (ftruncate(f->fd, 0) != 0) fail_file(f, "truncate", errno);
+        else if (unlinkat(f->ent->dir->fd, f->ent->name, 0) != 0) fail_file(f, "unlink", errno);
+    }
+    if (f->fd >= 0) close(f->fd);
+
+    if (f->failed) {
+        report(r, f->status, f->bytes, f->path, 1);
+    } else if (f->relocated) {
+        count(&r->t.files, 1);
+        count(&r->t.bytes, f->bytes);
+        count(&r->t.relocated, 1);
+        report(r, "relocated: written elsewhere by the filesystem; the old blocks may survive", f->bytes,
+               f->path, 1);
+    } else {
+        count(&r->t.files, 1);
+        count(&r->t.bytes, f->bytes);
+        report(r, f->mapped ? "OK" : "OK (no extent map)", f->bytes, f->path, 0);
+    }
+    free(f->ext);
+    free(f->spans);
+}
+
+static void shred_batch(struct worker *w, struct item *it) {
+    struct shred_run *r = w->run;
+    const struct shred_opts *o = r->o;
+    struct file files[BATCH_FILES];
+    memset(files, 0, sizeof(files));
+    unsigned long long total = 0;
+    int nsmall = 0;
+    for (int i = 0; i < it->n; i++) {
+        struct file *f = &files[i];
+        f->ent = &it->e[i];
+        f->path = it->e[i].path;
+        open_file(f, o->keep);
+        if (f->failed) continue;
+        total += f->bytes;
+        nsmall += f->small;
+    }
+    progress_grow(o->progress, total * (unsigned long long)o->npasses);
+    int batched = nsmall > 1 && w->ring.fd >= 0 && (!r->random || w->data);
+
+    for (int p = 0; p < o->npasses; p++) {
+        if (cancelled(r)) {
+            for (int i = 0; i < it->n; i++) {
+                if (files[i].failed) continue;
+                snprintf(files[i].status, sizeof(files[i].status), "failed: cancelled");
+                files[i].failed = 1;
+            }
+            break;
+        }
+        for (int i = 0; i < it->n; i++) file_pattern(&files[i], &o->passes[p]);
+        if (batched) write_batch(w, files, it->n, &o->passes[p]);
+        for (int i = 0; i < it->n; i++) {
+            struct file *f = &files[i];
+            if (!f->failed && (!batched || !f->small || f->retry)) write_file(w, f);
+        }
+        if (w->ring.fd < 0) batched = 0;
+    }
+    for (int i = 0; i < it->n; i++) finish_file(w, &files[i]);
+}
+
+static void *shred_worker(void *arg) {
+    struct worker *w = arg;
+    struct shred_run *r = w->run;
+    for (;;) {
+        struct item *it = take(r, w->index);
+        if (!it) {
+            if (!__atomic_load_n(&r->outstanding, __ATOMIC_ACQUIRE)) break;
+            struct timespec ts = {0, 200000};
+            nanosleep(&ts, NULL);
+            continue;
+        }
+        // Once cancelled, queued work is dropped unread.
+        if (!cancelled(r)) {
+            if (it->is_dir) walk_dir(w, it);
+            else shred_batch(w, it);
+        }
+        free_item(r, it);
+        __atomic_fetch_sub(&r->outstanding, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// The directory holding a starting point, opened by the path the user gave,
+// and the point's name in it; the point itself is then opened relative to
+// it like everything below. Prints nothing; NULL with errno set.
+static struct dir_ref *open_holder(const char *path, char **name) {
+    char *dir = strdup(path);
+    struct dir_ref *h = calloc(1, sizeof(*h));
+    *name = NULL;
+    if (!dir || !h) {
+        free(dir);
+        free(h);
+        errno = ENOMEM;
+        return NULL;
+    }
+    size_t l = strlen(dir);
+    while (l > 1 && dir[l - 1] == '/') dir[--l] = 0;
+    char *slash = strrchr(dir, '/');
+    if (!slash) {
+        *name = strdup(dir);
+        strcpy(dir, ".");
+    } else if (slash[1] == 0) {
+        *name = strdup("/");
+    } else {
+        *name = strdup(slash + 1);
+        if (slash == dir) slash++;
+        *slash = 0;
+    }
+    h->fd = *name ? open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    if (h->fd < 0) {
+        int err = *name ? errno : ENOMEM;
+        free(*name);
+        *name = NULL;
+        free(dir);
+        free(h);
+        errno = err;
+        return NULL;
+    }
+    h->refs = 1;
+    h->path = dir;
+    return h;
+}
+
+int shred_paths(const char *const *paths, int n, const struct shred_opts *o, struct shred_totals *t) {
+    struct shred_run r;
+    memset(&r, 0, sizeof(r));
+    r.o = o;
+    r.nworkers = o->threads ? o->threads : 1;
+    if (r.nworkers > MAX_THREADS) r.nworkers = MAX_THREADS;
+    for (int p = 0; p < o->npasses; p++) r.random |= o->passes[p].random;
+    pthread_mutex_init(&r.lock, NULL);
+    r.q = calloc(r.nworkers, sizeof(*r.q));
+    struct worker *w = calloc(r.nworkers, sizeof(*w));
+    if (!r.q || !w) {
+        fprintf(stderr, "Out of memory\n");
+        free(r.q);
+        free(w);
+        return -1;
+    }
+
+    int warned = 0;
+    for (unsigned i = 0; i < r.nworkers; i++) {
+        pthread_mutex_init(&r.q[i].lock, NULL);
+        w[i].run = &r;
+        w[i].index = i;
+        w[i].ring.fd = -1;
+        if (o->engine == ENGINE_URING) {
+            int err = uring_init(&w[i].ring, RING_ENTRIES);
+            if (err != 0) {
+                w[i].ring.fd = -1;
+                if (!warned++)
+                    fprintf(stderr, "io_uring unavailable (%s); writing files one at a time\n", strerror(-err));
+            }
+        }
+        if (r.random) w[i].data = buffer_alloc(BUFFER_DATA_MAX);
+    }
+
+    // Starting points, spread over the queues.
+    struct item *batch = NULL;
+    unsigned next = 0;
+    for (int i = 0; i < n; i++) {
+        struct stat st;
+        char *name;
+        struct dir_ref *holder = open_holder(paths[i], &name);
+        if (!holder) {
+            report_errno(&r, "open", errno, paths[i]);
+            continue;
+        }
+        if (fstatat(holder->fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            report_errno(&r, "stat", errno, paths[i]);
+            free(name);
+            dir_put(&r, holder);
+            continue;
+        }
+        if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) {
+            report(&r, S_ISLNK(st.st_mode) ? "skipped: symbolic link, not followed"
+                                           : "skipped: not a regular file or directory", 0, paths[i], 1);
+            free(name);
+            dir_put(&r, holder);
+            continue;
+        }
+        struct item *it = S_ISDIR(st.st_mode) ? new_item(1, st.st_dev) : batch ? batch : new_item(0, st.st_dev);
+        int added = it && add_entry(it, holder, name, paths[i], &st) == 0;
+        free(name);
+        dir_put(&r, holder);
+        if (!added) {
+            report(&r, "failed: out of memory", 0, paths[i], 1);
+            if (it && it != batch) free(it);
+            continue;
+        }
+        if (S_ISREG(st.st_mode)) {
+            batch = it->n == BATCH_FILES ? NULL : it;
+            if (batch) continue;
+        }
+        queue(&r, next++ % r.nworkers, it);
+    }
+    if (batch) queue(&r, next % r.nworkers, batch);
+
+    unsigned started = 1;
+    for (; started < r.nworkers; started++) {
+        if (pthread_create(&w[started].tid, NULL, shred_worker, &w[started]) != 0) break;
+    }
+    shred_worker(&w[0]);
+    for (unsigned i = 1; i < started; i++) pthread_join(w[i].tid, NULL);
+
+    for (unsigned i = 0; i < r.nworkers; i++) {
+        if (w[i].ring.fd >= 0) uring_exit(&w[i].ring);
+        buffer_free(w[i].data, BUFFER_DATA_MAX);
+        free(r.q[i].v);
+        pthread_mutex_destroy(&r.q[i].lock);
+    }
+    free(w);
+    free(r.q);
+    pthread_mutex_destroy(&r.lock);
+    *t = r.t;
+    if (cancelled(&r)) return ENGINE_CANCELLED;
+    return t->failed ? -1 : 0;
+}
@@ -0,0 +1,51 @@
+// shred.h
+// File-level wiping for the Linux wiper, for directories on disks that stay
+// in service. Worker threads walk the given trees, stealing directories and
+// batches of files from each other's queues; every regular file found has
+// its extents (FIEMAP) overwritten in place, through the file, with each
+// pass pattern in turn, and is then truncated and unlinked. Small files are
+// handled a batch at a time: their writes and syncs go to io_uring together
+// rather than one file and one syscall after another.
+
+#ifndef ZT_SHRED_H
+#define ZT_SHRED_H
+
+#include <stdio.h>
+
+#include "engine.h"
+
+struct pass_pattern;
+struct progress_job;
+
+struct shred_opts {
+    const struct pass_pattern *passes;  // written in order to every file
+    int npasses;
+    unsigned threads;           // walking and writing threads (0 = 1)
+    enum io_engine engine;      // ENGINE_URING batches small files and queues large ones
+    unsigned depth;             // io_uring queue depth for large files
+    size_t chunk;               // bytes per request for large files
+    int keep;                   // overwrite only: leave every file and directory in place
+    FILE *report;               // one line per entry (NULL = problems only, on stderr)
+    volatile int *cancel;       // once set, no more files are started (NULL = never)
+    struct progress_job *progress;
+};
+
+struct shred_totals {
+    unsigned long long files;       // regular files overwritten
+    unsigned long long bytes;       // bytes of their extents, counted once per file
+    unsigned long long removed;     // directories and other entries removed
+    unsigned long long failed;      // entries left behind or not overwritten
+    unsigned long long relocated;   // overwritten, but the filesystem moved the data elsewhere
+};
+
+// Shred every file under each of paths (a directory or a regular file).
+// Symbolic links are removed, never followed, and the walk does not cross
+// into other filesystems; everything is opened and removed relative to its
+// directory's descriptor, and an entry that is no longer the inode the walk
+// listed is skipped. A file whose data the filesystem moved while it
+// was overwritten (copy-on-write) counts as relocated: its old blocks may
+// survive. Returns 0 when every entry was handled, -1 otherwise
+// (ENGINE_CANCELLED when o->cancel cut it short).
+int shred_paths(const char *const *paths, int n, const struct shred_opts *o, struct shred_totals *t);
+
+#endif
@@ -0,0 +1,305 @@
+// smart.c
+// Dirty-map scan and extent-wise overwrite for smart purge.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "smart.h"
+#include "../common/buffers.h"
+#include "../common/latency.h"
+#include "../common/memcheck.h"
+#include "../common/progress.h"
+
+// Bytes fetched per scan read; a multiple of every allowed grain. Two are
+// in flight, so this is also the scan's memory use.
+#define SCAN_REGION (16ULL * 1024 * 1024)
+
+static const char *tag(const struct wipe_io *io) {
+    return io->tag ? io->tag : "";
+}
+
+int dirty_map_init(struct dirty_map *m, unsigned long long start, unsigned long long len, size_t grain) {
+    memset(m, 0, sizeof(*m));
+    m->start = start;
+    m->len = len;
+    m->grain = grain;
+    m->ngrains = (len + grain - 1) / grain;
+    m->bits = calloc((m->ngrains + 63) / 64 + 1, sizeof(uint64_t));
+    return m->bits ? 0 : -1;
+}
+
+void dirty_map_free(struct dirty_map *m) {
+    free(m->bits);
+    m->bits = NULL;
+}
+
+void dirty_map_set(struct dirty_map *m, unsigned long long g) {
+    m->bits[g / 64] |= 1ULL << (g % 64);
+}
+
+void dirty_map_set_range(struct dirty_map *m, unsigned long long off, unsigned long long len) {
+    unsigned long long end = off + len;
+    if (off < m->start) off = m->start;
+    if (end > m->start + m->len) end = m->start + m->len;
+    if (off >= end) return;
+    unsigned long long g = (off - m->start) / m->grain;
+    unsigned long long last = (end - 1 - m->start) / m->grain;
+    for (; g <= last && (g % 64) != 0; g++) dirty_map_set(m, g);
+    for (; g + 64 <= last + 1; g += 64) m->bits[g / 64] = ~0ULL;
+    for (; g <= last; g++) dirty_map_set(m, g);
+}
+
+void dirty_map_invert(struct dirty_map *m) {
+    unsigned long long words = (m->ngrains + 63) / 64;
+    for (unsigned long long w = 0; w < words; w++) m->bits[w] = ~m->bits[w];
+    // Keep the bits past the last grain clear.
+    if (m->ngrains % 64) m->bits[words - 1] &= (1ULL << (m->ngrains % 64)) - 1;
+}
+
+int dirty_map_test(const struct dirty_map *m, unsigned long long g) {
+    return (m->bits[g / 64] >> (g % 64)) & 1;
+}
+
+// Length of grain g; only the last one can be short.
+static unsigned long long grain_len(const struct dirty_map *m, unsigned long long g) {
+    unsigned long long off = g * m->grain;
+    return m->len - off < m->grain ? m->len - off : m->grain;
+}
+
+unsigned long long dirty_map_bytes(const struct dirty_map *m) {
+    unsigned long long n = 0;
+    for (unsigned long long w = 0; w * 64 < m->ngrains; w++) {
+        uint64_t bits = m->bits[w];
+        n += (unsigned long long)__builtin_popcountll(bits) * m->grain;
+    }
+    if (m->ngrains && dirty_map_test(m, m->ngrains - 1))
+        n -= m->grain - grain_len(m, m->ngrains - 1);
+    return n;
+}
+
+// Mark the grains of [off, off + len) that hold data. Each search stops at
+// the first non-zero byte and resumes at the next grain boundary, so clean
+// space is skipped at memcheck speed and dirty grains cost one byte each.
+static void mark_region(struct dirty_map *m, unsigned long long off, const unsigned char *p, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        size_t i = mem_find_not_byte(p + pos, len - pos, 0x00);
+        if (i == len - pos) break;
+        unsigned long long g = (off + pos + i - m->start) / m->grain;
+        dirty_map_set(m, g);
+        pos = (size_t)(m->start + (g + 1) * m->grain - off);
+    }
+}
+
+enum { BUF_EMPTY, BUF_FULL, BUF_ERROR };
+
+struct scan_buf {
+    void *data;
+    unsigned long long off;
+    size_t len;
+    int state;
+    int err;            // errno of a failed read
+};
+
+// The reader fills buf[k % 2] with region k while the checker drains the
+// other one; each side waits only when it has caught up with the other.
+struct scanner {
+    const struct wipe_io *io;
+    unsigned long long nregions;
+    struct scan_buf buf[2];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+};
+
+static int read_full(int fd, void *buf, size_t len, unsigned long long off) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = pread(fd, (char *)buf + got, len - got, (off_t)(off + got));
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (r == 0) {
+            errno = EIO;
+            return -1;
+        }
+        got += (size_t)r;
+    }
+    return 0;
+}
+
+static void *scan_reader(void *arg) {
+    struct scanner *s = arg;
+    const struct wipe_io *io = s->io;
+    for (unsigned long long k = 0; k < s->nregions; k++) {
+        struct scan_buf *b = &s->buf[k & 1];
+        pthread_mutex_lock(&s->lock);
+        while (b->state != BUF_EMPTY && !s->stop) pthread_cond_wait(&s->cond, &s->lock);
+        int stop = s->stop;
+        pthread_mutex_unlock(&s->lock);
+        if (stop) break;
+
+        unsigned long long rel = k * SCAN_REGION;
+        size_t len = io->len - rel < SCAN_REGION ? (size_t)(io->len - rel) : (size_t)SCAN_REGION;
+        unsigned long long t0 = io->latency ? lat_now_ns() : 0;
+        int rc = read_full(io->fd, b->data, len, io->start + rel);
+        int err = errno;
+        if (rc == 0) lat_record(io->latency, io->start + rel, len, lat_now_ns() - t0);
+        if (rc != 0 && io->bad) {
+            // Carrying on past media errors: what cannot be read may still
+            // hold data, so the whole region is written.
+            fprintf(stderr, "%sScan read failed at offset %llu: %s; treating the region as holding data\n",
+                    tag(io), io->start + rel, strerror(err));
+            memset(b->data, 0xFF, len);
+            rc = 0;
+        }
+
+        pthread_mutex_lock(&s->lock);
+        b->off = io->start + rel;
+        b->len = len;
+        b->err = err;
+        b->state = rc == 0 ? BUF_FULL : BUF_ERROR;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        if (rc != 0) break;
+    }
+    return NULL;
+}
+
+int smart_scan(const struct wipe_io *io, struct dirty_map *m) {
+    struct scanner s;
+    memset(&s, 0, sizeof(s));
+    s.io = io;
+    s.nregions = (io->len + SCAN_REGION - 1) / SCAN_REGION;
+    if (s.nregions == 0) return 0;
+
+    for (int i = 0; i < 2; i++) {
+        s.buf[i].data = buffer_alloc(SCAN_REGION);
+        if (!s.buf[i].data) {
+            fprintf(stderr, "%sOut of memory for scan buffers\n", tag(io));
+            buffer_free(s.buf[0].data, SCAN_REGION);
+            return -1;
+        }
+    }
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.cond, NULL);
+
+    int rc = 0;
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, scan_reader, &s) != 0) {
+        fprintf(stderr, "%sFailed to start scan reader\n", tag(io));
+        rc = -1;
+        goto out;
+    }
+
+    for (unsigned long long k = 0; k < s.nregions; k++) {
+        if (io->cancel && *io->cancel) {
+            rc = ENGINE_CANCELLED;
+            break;
+        }
+        struct scan_buf *b = &s.buf[k & 1];
+        pthread_mutex_lock(&s.lock);
+        while (b->state == BUF_EMPTY) pthread_cond_wait(&s.cond, &s.lock);
+        pthread_mutex_unlock(&s.lock);
+        if (b->state == BUF_ERROR) {
+            fprintf(stderr, "%sScan read failed at offset %llu: %s\n", tag(io), b->off, strerror(b->err));
+            rc = -1;
+            break;
+        }
+
+        mark_region(m, b->off, b->data, b->len);
+        progress_add(io->progress, PROGRESS_SCANNED, b->len);
+
+        pthread_mutex_lock(&s.lock);
+        b->state = BUF_EMPTY;
+        pthread_cond_broadcast(&s.cond);
+        pthread_mutex_unlock(&s.lock);
+    }
+
+    pthread_mutex_lock(&s.lock);
+    s.stop = 1;
+    pthread_cond_broadcast(&s.cond);
+    pthread_mutex_unlock(&s.lock);
+    pthread_join(reader, NULL);
+out:
+    pthread_cond_destroy(&s.cond);
+    pthread_mutex_destroy(&s.lock);
+    buffer_free(s.buf[0].data, SCAN_REGION);
+    buffer_free(s.buf[1].data, SCAN_REGION);
+    return rc;
+}
+
+long smart_extents(const struct dirty_map *m, unsigned long long merge_gap, struct extent **out) {
+    long n = 0, cap = 0;
+    struct extent *ext = NULL;
+    *out = NULL;
+    unsigned long long g = 0;
+    while (g < m->ngrains) {
+        // Skip clean words whole; most of a sparse disk is clean.
+        if ((g % 64) == 0 && m->bits[g / 64] == 0) {
+            g += 64;
+            continue;
+        }
+        if (!dirty_map_test(m, g)) {
+            g++;
+            continue;
+        }
+        unsigned long long first = g;
+        while (g < m->ngrains && dirty_map_test(m, g)) g++;
+        unsigned long long off = m->start + first * m->grain;
+        unsigned long long end = m->start + (g - 1) * m->grain + grain_len(m, g - 1);
+
+        if (n > 0 && off - (ext[n - 1].off + ext[n - 1].len) <= merge_gap) {
+            ext[n - 1].len = end - ext[n - 1].off;
+            continue;
+        }
+        if (n == cap) {
+            cap = cap ? cap * 2 : 256;
+            struct extent *grown = realloc(ext, (size_t)cap * sizeof(*ext));
+            if (!grown) {
+                free(ext);
+                return -1;
+            }
+            ext = grown;
+        }
+        ext[n].off = off;
+        ext[n].len = end - off;
+        n++;
+    }
+    *out = ext;
+    return n;
+}
+
+int smart_write(const struct wipe_io *io, const struct extent *ext, long n, unsigned long long *written) {
+    *written = 0;
+    for (long i = 0; i < n; i++) {
+        struct wipe_io sub = *io;
+        sub.start = ext[i].off;
+        sub.len = ext[i].len;
+        unsigned long long w = 0;
+        int rc = engine_write(&sub, &w);
+        *written += w;
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+int smart_verify(const struct wipe_io *io, const struct extent *ext, long n, unsigned long long *verified) {
+    *verified = 0;
+    for (long i = 0; i < n; i++) {
+        struct wipe_io sub = *io;
+        sub.start = ext[i].off;
+        sub.len = ext[i].len;
+        unsigned long long v = 0;
+        int rc = engine_verify(&sub, &v);
+        *verified += v;
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+// smart.h
+// Smart purge for the Linux wiper: scan the device for the parts that hold
+// data, record them in a dirty bitmap, and overwrite only those, coalesced
+// into long sequential extents.
+
+#ifndef ZT_SMART_H
+#define ZT_SMART_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+#define SMART_MIN_GRAIN (4U * 1024)
+#define SMART_MAX_GRAIN (1024U * 1024)
+
+// One bit per grain of [start, start + len); a set bit means the grain
+// holds at least one non-zero byte. The last grain may be short.
+struct dirty_map {
+    unsigned long long start;
+    unsigned long long len;
+    size_t grain;                  // power of two, SMART_MIN_GRAIN..SMART_MAX_GRAIN
+    unsigned long long ngrains;
+    uint64_t *bits;
+};
+
+struct extent {
+    unsigned long long off;
+    unsigned long long len;
+};
+
+int dirty_map_init(struct dirty_map *m, unsigned long long start, unsigned long long len, size_t grain);
+void dirty_map_free(struct dirty_map *m);
+void dirty_map_set(struct dirty_map *m, unsigned long long g);
+// Mark every grain touching [off, off + len); parts outside the map are ignored.
+void dirty_map_set_range(struct dirty_map *m, unsigned long long off, unsigned long long len);
+// Swap dirty and clean, so smart_extents yields whatever was not marked.
+void dirty_map_invert(struct dirty_map *m);
+int dirty_map_test(const struct dirty_map *m, unsigned long long g);
+// Bytes covered by dirty grains.
+unsigned long long dirty_map_bytes(const struct dirty_map *m);
+
+// Read io's range and mark every grain that holds data. Reads are double
+// buffered: the next region is fetched by a helper thread while the current
+// one is being checked. Returns 0, -1 on a read error (reported), or
+// ENGINE_CANCELLED when io->cancel stopped it.
+int smart_scan(const struct wipe_io *io, struct dirty_map *m);
+
+// Turn the map into runs of dirty grains. Clean gaps of up to merge_gap
+// bytes between two runs are absorbed, trading a few extra bytes written for
+// one long sequential write instead of a seek. Returns the number of extents
+// stored in *out (malloc'd, may be NULL when there are none), or -1 when out
+// of memory.
+long smart_extents(const struct dirty_map *m, unsigned long long merge_gap, struct extent **out);
+
+// Run engine_write / engine_verify over each extent in turn with io's
+// settings (and pattern). Return and report like the engine calls.
+int smart_write(const struct wipe_io *io, const struct extent *ext, long n, unsigned long long *written);
+int smart_verify(const struct wipe_io *io, const struct extent *ext, long n, unsigned long long *verified);
+
+#endif
@@ -0,0 +1,281 @@
+// topology.c
+// Block device discovery through sysfs, and the media policy.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "topology.h"
+
+// Streaming request size on spinning disks, where a request costs a seek
+// and a rotation, and on solid-state media, where it is the queue depth
+// that keeps every channel busy.
+#define HDD_CHUNK (16ULL * 1024 * 1024)
+#define SSD_CHUNK (4ULL * 1024 * 1024)
+// Requests in flight per thread: one being written and one queued behind it
+// keep a spinning disk streaming; solid-state media get enough to fill the
+// device's own queue, within these bounds.
+#define HDD_DEPTH 2
+#define SSD_DEPTH_MIN 2
+#define SSD_DEPTH_MAX 32
+#define NVME_THREADS_MAX 4
+// Alignment units above this are not worth rounding the chunk up to.
+#define MAX_UNIT (16ULL * 1024 * 1024)
+
+static unsigned long long read_ull(const char *dir, const char *name) {
+    char p[PATH_MAX + 64];
+    unsigned long long v = 0;
+    snprintf(p, sizeof(p), "%s/%s", dir, name);
+    FILE *f = fopen(p, "r");
+    if (!f) return 0;
+    if (fscanf(f, "%llu", &v) != 1) v = 0;
+    fclose(f);
+    return v;
+}
+
+// First non-empty line among the given attributes of dir.
+static void read_string(const char *dir, const char *const *attrs, size_t nattrs, char *out, size_t n) {
+    char p[PATH_MAX + 64];
+    out[0] = 0;
+    for (size_t a = 0; a < nattrs; a++) {
+        snprintf(p, sizeof(p), "%s/%s", dir, attrs[a]);
+        FILE *f = fopen(p, "r");
+        if (!f) continue;
+        char line[256];
+        int got = fgets(line, sizeof(line), f) != NULL;
+        fclose(f);
+        if (!got) continue;
+        // Trim the padding some drives report around their strings.
+        char *s = line;
+        while (*s == ' ') s++;
+        size_t l = strcspn(s, "\n");
+        while (l && s[l - 1] == ' ') l--;
+        if (l == 0) continue;
+        snprintf(out, n, "%.*s", (int)l, s);
+        return;
+    }
+}
+
+// The bus, from where the disk sits in the device tree. USB comes first:
+// a USB bridge shows up as a SCSI host below the USB port.
+static const char *transport_of(const char *disk) {
+    static const struct { const char *part, *name; } buses[] = {
+        {"/usb", "usb"}, {"/nvme", "nvme"}, {"/ata", "sata"}, {"/mmc", "mmc"},
+        {"/virtio", "virtio"}, {"/virtual/block/loop", "loop"}, {"/virtual/", "virtual"},
+        {"/host", "scsi"},
+    };
+    for (size_t i = 0; i < sizeof(buses) / sizeof(buses[0]); i++)
+        if (strstr(disk, buses[i].part)) return buses[i].name;
+    return "other";
+}
+
+// Whether the block device with this sysfs node is the disk or below it.
+static int within(const char *disk, dev_t rdev) {
+    char p[64], node[PATH_MAX];
+    snprintf(p, sizeof(p), "/sys/dev/block/%u:%u", major(rdev), minor(rdev));
+    if (!realpath(p, node)) return 0;
+    size_t l = strlen(disk);
+    return strncmp(node, disk, l) == 0 && (node[l] == 0 || node[l] == '/');
+}
+
+// Devices named in the first column of a /proc table (mounts, swaps).
+static int table_uses(const char *table, const char *disk) {
+    FILE *f = fopen(table, "r");
+    if (!f) return 0;
+    char line[4096];
+    int used = 0;
+    while (!used && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, " \t\n")] = 0;
+        struct stat st;
+        if (strncmp(line, "/dev/", 5) == 0 && stat(line, &st) == 0 && S_ISBLK(st.st_mode))
+            used = within(disk, st.st_rdev);
+    }
+    fclose(f);
+    return used;
+}
+
+// dm, md and the like stacked on the disk or one of its partitions.
+static int has_holders(const char *disk) {
+    char p[PATH_MAX + 64];
+    snprintf(p, sizeof(p), "%s/holders", disk);
+    DIR *d = opendir(p);
+    if (!d) return 0;
+    int held = 0;
+    struct dirent *e;
+    while (!held && (e = readdir(d)) != NULL) held = e->d_name[0] != '.';
+    closedir(d);
+    if (held) return 1;
+    d = opendir(disk);
+    if (!d) return 0;
+    const char *name = strrchr(disk, '/') + 1;
+    while (!held && (e = readdir(d)) != NULL) {
+        if (strncmp(e->d_name, name, strlen(name)) != 0) continue;
+        char part[PATH_MAX + 320];
+        snprintf(part, sizeof(part), "%s/%s/holders", disk, e->d_name);
+        DIR *h = opendir(part);
+        if (!h) continue;
+        struct dirent *he;
+        while (!held && (he = readdir(h)) != NULL) held = he->d_name[0] != '.';
+        closedir(h);
+    }
+    closedir(d);
+    return held;
+}
+
+static unsigned count_entries(const char *dir, const char *name) {
+    char p[PATH_MAX + 64];
+    snprintf(p, sizeof(p), "%s/%s", dir, name);
+    DIR *d = opendir(p);
+    if (!d) return 0;
+    unsigned n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) n += e->d_name[0] != '.';
+    closedir(d);
+    return n;
+}
+
+// node is the device's own sysfs directory (resolved), for a partition
+// inside its disk's.
+static void read_node(const char *node, struct topology *t) {
+    char disk[PATH_MAX], p[PATH_MAX + 64];
+    memset(t, 0, sizeof(*t));
+    snprintf(disk, sizeof(disk), "%s", node);
+    snprintf(p, sizeof(p), "%s/partition", node);
+    if (access(p, F_OK) == 0) *strrchr(disk, '/') = 0;
+
+    snprintf(t->name, sizeof(t->name), "%s", strrchr(disk, '/') + 1);
+    snprintf(t->transport, sizeof(t->transport), "%s", transport_of(disk));
+    t->size = read_ull(node, "size") * 512;
+    t->removable = read_ull(disk, "removable") != 0;
+    t->rotational = read_ull(disk, "queue/rotational") != 0;
+    t->logical_block = (unsigned)read_ull(disk, "queue/logical_block_size");
+    t->physical_block = (unsigned)read_ull(disk, "queue/physical_block_size");
+    t->optimal_io = read_ull(disk, "queue/optimal_io_size");
+    t->max_request = read_ull(disk, "queue/max_sectors_kb") * 1024;
+    t->nr_requests = (unsigned)read_ull(disk, "queue/nr_requests");
+    t->queue_depth = (unsigned)read_ull(disk, "device/queue_depth");
+    t->hw_queues = count_entries(disk, "mq");
+    t->write_zeroes_max = read_ull(disk, "queue/write_zeroes_max_bytes");
+    t->discard_max = read_ull(disk, "queue/discard_max_bytes");
+    static const char *const serial[] = {"device/serial", "serial", "device/wwid", "wwid", "loop/backing_file"};
+    static const char *const model[] = {"device/model"};
+    read_string(disk, serial, sizeof(serial) / sizeof(serial[0]), t->serial, sizeof(t->serial));
+    read_string(disk, model, 1, t->model, sizeof(t->model));
+    t->in_use = table_uses("/proc/self/mounts", disk) || table_uses("/proc/swaps", disk) || has_holders(disk);
+}
+
+int topology_read(dev_t rdev, struct topology *t) {
+    char p[64], node[PATH_MAX];
+    snprintf(p, sizeof(p), "/sys/dev/block/%u:%u", major(rdev), minor(rdev));
+    if (!realpath(p, node)) {
+        memset(t, 0, sizeof(*t));
+        return -1;
+    }
+    read_node(node, t);
+    return 0;
+}
+
+int topology_path(const char *path, struct topology *t) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISBLK(st.st_mode)) {
+        memset(t, 0, sizeof(*t));
+        return 1;
+    }
+    return topology_read(st.st_rdev, t);
+}
+
+static int by_name(const void *a, const void *b) {
+    return strcmp(((const struct topology *)a)->name, ((const struct topology *)b)->name);
+}
+
+int topology_list(struct topology *out, int max) {
+    DIR *d = opendir("/sys/block");
+    if (!d) return -1;
+    int n = 0;
+    struct dirent *e;
+    while (n < max && (e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char p[PATH_MAX], node[PATH_MAX];
+        snprintf(p, sizeof(p), "/sys/block/%s", e->d_name);
+        if (!realpath(p, node) || strstr(node, "/virtual/")) continue;
+        read_node(node, &out[n]);
+        if (out[n].size) n++;
+    }
+    closedir(d);
+    qsort(out, n, sizeof(*out), by_name);
+    return n;
+}
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b) {
+    while (b) {
+        unsigned long long r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+int topology_policy(const struct topology *t, struct media_policy *p) {
+    memset(p, 0, sizeof(*p));
+    int nvme = strcmp(t->transport, "nvme") == 0;
+    if (strcmp(t->transport, "virtio") == 0 || strcmp(t->transport, "loop") == 0 ||
+        strcmp(t->transport, "virtual") == 0) {
+        p->media = "virtual";
+        return 1;
+    }
+    p->media = t->rotational ? "HDD" : nvme ? "NVMe SSD" : "SSD";
+
+    // Requests start on the device's optimal boundary (every offset is a
+    // multiple of the chunk) and split into whole max_sectors_kb pieces.
+    unsigned long long align = t->physical_block > t->logical_block ? t->physical_block : t->logical_block;
+    if (!align) align = 512;
+    if (t->optimal_io && t->optimal_io % align == 0 && t->optimal_io <= MAX_UNIT) align = t->optimal_io;
+    unsigned long long unit = align;
+    if (t->max_request && t->logical_block && t->max_request % t->logical_block == 0) {
+        unsigned long long l = align / gcd(align, t->max_request) * t->max_request;
+        if (l <= MAX_UNIT) unit = l;
+    }
+    unsigned long long chunk = t->rotational ? HDD_CHUNK : SSD_CHUNK;
+    p->chunk = (size_t)((chunk + unit - 1) / unit * unit);
+    p->align = (size_t)align;
+    p->engine = ENGINE_URING;
+    p->threads = 1;
+    p->offload = OFFLOAD_NONE;
+
+    if (t->queue_depth == 1) {
+        // No command queueing (USB mass storage without UAS, old PATA):
+        // a second request only waits, so issue one at a time.
+        p->engine = ENGINE_SYNC;
+        p->depth = 1;
+    } else if (t->rotational) {
+        p->depth = HDD_DEPTH;
+    } else {
+        // Enough requests, once split, to fill the device's queue.
+        unsigned slots = t->queue_depth ? t->queue_depth : t->nr_requests;
+        unsigned long long piece = t->max_request ? t->max_request : p->chunk;
+        unsigned long long per = (p->chunk + piece - 1) / piece;
+        unsigned long long depth = (slots + per - 1) / per;
+        if (nvme && t->hw_queues > 1) {
+            long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            unsigned threads = t->hw_queues;
+            if (cpus > 0 && threads > (unsigned)cpus) threads = (unsigned)cpus;
+            if (threads > NVME_THREADS_MAX) threads = NVME_THREADS_MAX;
+            p->threads = threads;
+            depth = (depth + threads - 1) / threads;
+        }
+        p->depth = depth < SSD_DEPTH_MIN ? SSD_DEPTH_MIN : depth > SSD_DEPTH_MAX ? SSD_DEPTH_MAX : (unsigned)depth;
+    }
+
+    // Solid-state media that zero ranges themselves get one offloaded pass;
+    // USB bridges that claim write-zeroes are not trusted with it. Spinning
+    // disks stream the overwrite, tuned for the drive.
+    if (!t->rotational && t->write_zeroes_max && strcmp(t->transport, "usb") != 0) p->offload = OFFLOAD_ZEROOUT;
+    p->tune = t->rotational;
+    return 0;
+}
@@ -0,0 +1,62 @@
+// topology.h
+// What sysfs says about a block device: geometry and queue limits from
+// queue/, identity from device/, the bus it hangs off, whether it is in
+// use; and the media policy derived from that, which picks engine, request
+// size, queue depth and pass for the settings the command line leaves open.
+
+#ifndef ZT_TOPOLOGY_H
+#define ZT_TOPOLOGY_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "engine.h"
+#include "offload.h"
+
+struct topology {
+    char name[32];                  // kernel name of the whole disk: sdb, nvme0n1
+    char transport[16];             // nvme, sata, usb, scsi, mmc, virtio, loop, virtual, other
+    char model[64];                 // device/model ("" = unknown)
+    char serial[128];               // serial, WWID or loop backing file ("" = unknown)
+    unsigned long long size;        // bytes of the node itself (a partition: just it)
+    int rotational;                 // queue/rotational (spinning disk)
+    int removable;
+    unsigned logical_block, physical_block;
+    unsigned long long optimal_io;  // queue/optimal_io_size (0 = not reported)
+    unsigned long long max_request; // queue/max_sectors_kb in bytes: larger requests are split
+    unsigned nr_requests;           // queue/nr_requests: requests the block layer queues
+    unsigned queue_depth;           // device/queue_depth, SCSI and SATA only (0 = not reported)
+    unsigned hw_queues;             // entries under mq/
+    unsigned long long write_zeroes_max; // queue/write_zeroes_max_bytes (0 = no offload)
+    unsigned long long discard_max;      // queue/discard_max_bytes (0 = no discard)
+    int in_use;                     // the disk or a partition is mounted, swap or held by dm/md
+};
+
+// Fill t for the block device rdev (a partition is described by its disk,
+// except for size). Returns 0, or -1 when sysfs has no such device.
+int topology_read(dev_t rdev, struct topology *t);
+
+// The same for a path; returns 1 when path is not a block device.
+int topology_path(const char *path, struct topology *t);
+
+// Every physical disk in /sys/block (virtual devices such as loop, dm and
+// zram, and empty slots, are left out), at most max of them, by name.
+// Returns the count, or -1 when /sys/block is unreadable.
+int topology_list(struct topology *out, int max);
+
+struct media_policy {
+    const char *media;          // "HDD", "SSD", "NVMe SSD" or "virtual"
+    enum io_engine engine;
+    size_t chunk;               // bytes per request, a multiple of align
+    size_t align;               // what every request offset and length is a multiple of
+    unsigned depth, threads;
+    enum offload_kind offload;  // a full clear as one offloaded pass (NONE = write it)
+    int tune;                   // time the streaming overwrite before a full clear
+};
+
+// Derive the policy for t. Returns 0, or 1 for virtual devices (loop, dm,
+// virtio, ...), whose backing store the topology does not describe; they
+// keep the built-in defaults.
+int topology_policy(const struct topology *t, struct media_policy *p);
+
+#endif
@@ -0,0 +1,185 @@
+// tune.c
+// Coordinate-descent search over chunk size, queue depth and threads.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "tune.h"
+
+#define MIB (1024ULL * 1024)
+// A setting must beat the current best by this much to replace it, so
+// measurement noise does not pick a larger setting for nothing.
+#define MIN_GAIN 1.05
+
+static const size_t chunks[] = {1 * MIB, 4 * MIB, 16 * MIB, 64 * MIB};
+static const unsigned depths[] = {1, 4, 16, 32};
+static const unsigned workers[] = {1, 2, 4, 8};
+
+static const char *tag(const struct wipe_io *io) {
+    return io->tag ? io->tag : "";
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Raises the probe's cancel flag once its time is up, or quits early when
+// the probe finishes the region first.
+struct probe_timer {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    double seconds;
+    int finished;
+    volatile int cancel;
+};
+
+static void *timer_main(void *arg) {
+    struct probe_timer *pt = arg;
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    long long ns = until.tv_nsec + (long long)(pt->seconds * 1e9);
+    until.tv_sec += ns / 1000000000LL;
+    until.tv_nsec = ns % 1000000000LL;
+    pthread_mutex_lock(&pt->lock);
+    while (!pt->finished) {
+        if (pthread_cond_timedwait(&pt->cond, &pt->lock, &until) == ETIMEDOUT) break;
+    }
+    pt->cancel = 1;
+    pthread_mutex_unlock(&pt->lock);
+    return NULL;
+}
+
+// MB/s of one setting, or a negative value when the write failed.
+static double probe(const struct wipe_io *base, unsigned long long region, double seconds,
+                    size_t chunk, unsigned depth, unsigned threads) {
+    struct probe_timer pt;
+    memset(&pt, 0, sizeof(pt));
+    pt.seconds = seconds;
+    pthread_mutex_init(&pt.lock, NULL);
+    pthread_cond_init(&pt.cond, NULL);
+
+    struct wipe_io io = *base;
+    io.len = region;
+    io.chunk = chunk;
+    io.depth = depth;
+    io.threads = threads;
+    io.cancel = &pt.cancel;
+    io.on_durable = NULL;
+    io.progress = NULL;
+    io.latency = NULL;
+    // Include the cost of making the data durable, as a real pass would.
+    if (!io.barrier) io.barrier = region;
+
+    pthread_t tid;
+    int have_timer = pthread_create(&tid, NULL, timer_main, &pt) == 0;
+    double t0 = now_seconds();
+    unsigned long long n = 0;
+    int rc = engine_write(&io, &n);
+    double dt = now_seconds() - t0;
+    if (have_timer) {
+        pthread_mutex_lock(&pt.lock);
+        pt.finished = 1;
+        pthread_cond_signal(&pt.cond);
+        pthread_mutex_unlock(&pt.lock);
+        pthread_join(tid, NULL);
+    }
+
+    pthread_cond_destroy(&pt.cond);
+    pthread_mutex_destroy(&pt.lock);
+
+    if (rc < 0 || n == 0 || dt <= 0) return -1;
+    return n / (double)MIB / dt;
+}
+
+static void report(const struct wipe_io *io, size_t chunk, unsigned depth, unsigned threads, double mbps) {
+    if (mbps < 0) printf("%sAutotune: %zu MB x qd %u x %u thread%s: write failed\n", tag(io),
+                         (size_t)(chunk / MIB), depth, threads, threads == 1 ? "" : "s");
+    else printf("%sAutotune: %zu MB x qd %u x %u thread%s: %.1f MB/s\n", tag(io),
+                (size_t)(chunk / MIB), depth, threads, threads == 1 ? "" : "s", mbps);
+}
+
+int tune_probe(const struct wipe_io *io, unsigned long long region, double seconds,
+               struct tune_result *best) {
+    if (region > io->len) region = io->len;
+    best->chunk = io->chunk;
+    best->depth = io->depth ? io->depth : 1;
+    best->threads = io->threads ? io->threads : 1;
+    best->mbps = -1;
+
+    // One knob at a time, each around the best of the previous: chunk
+    // size first (it matters for every engine), then queue depth (io_uring
+    // only), then the number of workers.
+    for (int knob = 0; knob < 3; knob++) {
+        if (knob == 1 && io->engine != ENGINE_URING) continue;
+        size_t n = knob == 0 ? sizeof(chunks) / sizeof(chunks[0])
+                 : knob == 1 ? sizeof(depths) / sizeof(depths[0]) : sizeof(workers) / sizeof(workers[0]);
+        struct tune_result round = *best;
+        for (size_t i = 0; i < n; i++) {
+            struct tune_result t = *best;
+            if (knob == 0) t.chunk = chunks[i];
+            else if (knob == 1) t.depth = depths[i];
+            else t.threads = workers[i];
+            if (t.chunk > region || t.chunk % (io->align ? io->align : 1)) continue;
+            t.mbps = probe(io, region, seconds, t.chunk, t.depth, t.threads);
+            report(io, t.chunk, t.depth, t.threads, t.mbps);
+            if (t.mbps > 0 && (round.mbps <= 0 || t.mbps > round.mbps * MIN_GAIN)) round = t;
+        }
+        *best = round;
+    }
+    return best->mbps > 0 ? 0 : -1;
+}
+
+void tune_cache_path(char *out, size_t n) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && xdg[0]) snprintf(out, n, "%s/zerotrace/tune.cache", xdg);
+    else snprintf(out, n, "%s/.cache/zerotrace/tune.cache", home && home[0] ? home : ".");
+}
+
+int tune_cache_load(const char *path, const char *key, struct tune_result *r) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 1;
+    char line[512];
+    int hit = 0;
+    size_t klen = strlen(key);
+    // Later lines override earlier ones, so keep reading to the end.
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, klen) != 0 || line[klen] != '\t') continue;
+        struct tune_result t;
+        if (sscanf(line + klen + 1, "%zu %u %u %lf", &t.chunk, &t.depth, &t.threads, &t.mbps) == 4 &&
+            t.chunk > 0 && t.depth > 0 && t.threads > 0) {
+            *r = t;
+            hit = 1;
+        }
+    }
+    fclose(f);
+    return hit ? 0 : 1;
+}
+
+int tune_cache_store(const char *path, const char *key, const struct tune_result *r) {
+    // Create the parent directories one level at a time.
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = 0;
+        mkdir(dir, 0755);
+        *p = '/';
+    }
+    FILE *f = fopen(path, "a");
+    if (!f) {
+        fprintf(stderr, "Cannot write autotune cache %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fprintf(f, "%s\t%zu %u %u %.1f\n", key, r->chunk, r->depth, r->threads, r->mbps);
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,35 @@
+// tune.h
+// Startup autotuner for the Linux wiper: time short writes to the start of
+// the target across chunk sizes, queue depths and worker counts, and keep
+// the fastest. Results are cached per device so the next wipe of the same
+// hardware skips the probe.
+
+#ifndef ZT_TUNE_H
+#define ZT_TUNE_H
+
+#include "engine.h"
+
+struct tune_result {
+    size_t chunk;
+    unsigned depth;
+    unsigned threads;
+    double mbps;
+};
+
+// Probe io's range from its start (at most `region` bytes, each setting for
+// about `seconds`), starting from io's own chunk/depth/threads. The region
+// is overwritten with zeros. Returns 0 with *best filled in, -1 when no
+// probe could write.
+int tune_probe(const struct wipe_io *io, unsigned long long region, double seconds,
+               struct tune_result *best);
+
+// Default cache file: $XDG_CACHE_HOME/zerotrace/tune.cache, else
+// ~/.cache/zerotrace/tune.cache. The directory is created on store.
+void tune_cache_path(char *out, size_t n);
+
+// Look up / record the result for key (one line per key). Load returns 0
+// on a hit, 1 on a miss; store returns 0, or -1 (reported).
+int tune_cache_load(const char *path, const char *key, struct tune_result *r);
+int tune_cache_store(const char *path, const char *key, const struct tune_result *r);
+
+#endif
@@ -0,0 +1,136 @@
+// uring.c
+// Raw-syscall io_uring ring setup, submission and completion handling.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned op, const void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nr_args);
+}
+
+int uring_init(struct uring *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(r, 0, sizeof(*r));
+    memset(&p, 0, sizeof(p));
+    r->fd = -1;
+
+    int fd = sys_io_uring_setup(entries, &p);
+    if (fd < 0) return -errno;
+    r->fd = fd;
+    r->entries = p.sq_entries;
+
+    r->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_sz > r->sq_ring_sz) r->sq_ring_sz = r->cq_ring_sz;
+        r->cq_ring_sz = r->sq_ring_sz;
+    }
+
+    r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) goto fail;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) {
+            r->cq_ring = NULL;
+            goto fail;
+        }
+    }
+
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        goto fail;
+    }
+
+    char *sq = r->sq_ring, *cq = r->cq_ring;
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:;
+    int err = -errno;
+    if (r->sq_ring == MAP_FAILED) r->sq_ring = NULL;
+    uring_exit(r);
+    return err;
+}
+
+void uring_exit(struct uring *r) {
+    if (r->sqes) munmap(r->sqes, r->sqes_sz);
+    if (r->cq_ring && r->cq_ring != r->sq_ring) munmap(r->cq_ring, r->cq_ring_sz);
+    if (r->sq_ring) munmap(r->sq_ring, r->sq_ring_sz);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+int uring_register_buffers(struct uring *r, const struct iovec *iov, unsigned n) {
+    if (sys_io_uring_register(r->fd, IORING_REGISTER_BUFFERS, iov, n) < 0) return -errno;
+    return 0;
+}
+
+struct io_uring_sqe *uring_get_sqe(struct uring *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *r->sq_tail + r->sq_pending;
+    if (tail - head >= r->entries) return NULL;
+
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_pending++;
+    return sqe;
+}
+
+int uring_submit_and_wait(struct uring *r, unsigned wait_nr) {
+    unsigned to_submit = r->sq_pending;
+    if (to_submit) {
+        __atomic_store_n(r->sq_tail, *r->sq_tail + to_submit, __ATOMIC_RELEASE);
+        r->sq_pending = 0;
+    }
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    for (;;) {
+        int ret = sys_io_uring_enter(r->fd, to_submit, wait_nr, flags);
+        if (ret >= 0) return ret;
+        // The kernel never submits more than is actually queued in the SQ
+        // ring, so retrying with the same count after EINTR is safe.
+        if (errno != EINTR) return -errno;
+    }
+}
+
+int uring_pop_cqe(struct uring *r, struct io_uring_cqe *out) {
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) return 0;
+    *out = r->cqes[head & *r->cq_mask];
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
@@ -0,0 +1,47 @@
+// uring.h
+// Minimal io_uring wrapper built directly on the raw syscalls, so the wiper
+// does not depend on liburing being installed on the live image.
+
+#ifndef ZT_URING_H
+#define ZT_URING_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+struct uring {
+    int fd;
+    unsigned entries;
+
+    // submission ring
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_pending;   // sqes handed out but not yet submitted
+
+    // completion ring
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_sz, cq_ring_sz, sqes_sz;
+};
+
+// Returns 0 on success, -errno on failure (e.g. -ENOSYS, -EPERM when
+// io_uring is missing or disabled by kernel.io_uring_disabled).
+int uring_init(struct uring *r, unsigned entries);
+void uring_exit(struct uring *r);
+
+// Register fixed buffers for IORING_OP_{READ,WRITE}_FIXED. Returns 0 or -errno.
+int uring_register_buffers(struct uring *r, const struct iovec *iov, unsigned n);
+
+// Next free submission entry (zeroed), or NULL if the SQ ring is full.
+struct io_uring_sqe *uring_get_sqe(struct uring *r);
+
+// Submit pending sqes and wait until at least wait_nr completions are ready.
+// Returns number submitted or -errno.
+int uring_submit_and_wait(struct uring *r, unsigned wait_nr);
+
+// Pop one completion. Returns 1 and fills *out if one was available, else 0.
+int uring_pop_cqe(struct uring *r, struct io_uring_cqe *out);
+
+#endif
@@ -1,10 +1,15 @@
 #!/bin/bash
 
 # ZeroTrace: Making old devices live twice!
-echo "🚀 ZeroTrace: Detecting connected devices..."
-DEVICES=$(lsblk -o NAME,MOUNTPOINT,SIZE,TYPE | grep disk)
+if [ ! -f "./a.out" ]; then
+    echo "❌ Error: a.out not found!"
+    exit 1
+fi
 
-if [ -z "$DEVICES" ]; then
+# a.out reads the disks' topology from sysfs: media, bus, model, serial,
+# whether anything on them is in use, and the policy each would be wiped with.
+echo "🚀 ZeroTrace: Detecting connected devices..."
+if ! DEVICES=$(./a.out devices); then
     echo "❌ No devices detected!"
     exit 1
 fi
@@ -12,20 +17,34 @@ fi
 echo "🔌 Connected devices:"
 echo "$DEVICES"
 
-# Ask user which device to use
-read -p "Enter the device name to process (e.g., sdc): " DEVICE
+# Ask user which device(s) to use. Several can be given; a.out wipes them
+# concurrently in one process and prints a per-device summary.
+read -p "Enter the device name(s) to process (e.g., sdc or sdc sdd): " -a NAMES
 
-# Prepend /dev/ to the device name if not already present
-if [[ "$DEVICE" != /dev/* ]]; then
-    DEVICE="/dev/$DEVICE"
+if [ ${#NAMES[@]} -eq 0 ]; then
+    echo "❌ No device entered!"
+    exit 1
 fi
 
-# Run a.out with only the device as the argument
-if [ -f "./a.out" ]; then
-    echo "✨ Running ZeroTrace on $DEVICE..."
-    sudo ./a.out "$DEVICE"
-    echo "✅ ZeroTrace operation completed for $DEVICE!"
+# Prepend /dev/ to each device name if not already present
+DEVICES=()
+for DEVICE in "${NAMES[@]}"; do
+    if [[ "$DEVICE" != /dev/* ]]; then
+        DEVICE="/dev/$DEVICE"
+    fi
+    if [ ! -b "$DEVICE" ]; then
+        echo "❌ $DEVICE is not a block device!"
+        exit 1
+    fi
+    DEVICES+=("$DEVICE")
+done
+
+# Run a.out with only the device(s) as arguments; engine, request size,
+# queue depth and passes follow each device's media.
+echo "✨ Running ZeroTrace on ${DEVICES[*]}..."
+if sudo ./a.out "${DEVICES[@]}"; then
+    echo "✅ ZeroTrace operation completed for ${DEVICES[*]}!"
 else
-    echo "❌ Error: a.out not found!"
+    echo "❌ ZeroTrace reported a failure; see the summary above."
     exit 1
 fi
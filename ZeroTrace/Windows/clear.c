@@ -1,10 +1,15 @@
 // zeroTraceVerified.c
 // WARNING: destructive. Run as Administrator.
 // Usage:
-//   zeroTraceVerified.exe <PhysicalDriveNumber> <VolumeLetter|NONE> [--test] [--verify]
+//   zeroTraceVerified.exe <PhysicalDriveNumber> <VolumeLetter|NONE> [--test] [--verify] [--threads N]
+//                         [--pipeline] [--lag MB]
 // Examples:
 //   zeroTraceVerified.exe 1 E --test
 //   zeroTraceVerified.exe 1 NONE --verify
+//   zeroTraceVerified.exe 1 NONE --verify --threads 4
+//   zeroTraceVerified.exe 1 NONE --verify --pipeline --lag 2048
+// Build (MinGW):
+//   gcc -O2 -o zeroTraceVerified.exe clear.c ../common/memcheck.c ../common/cpu.c
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <windows.h>
@@ -13,6 +18,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../common/memcheck.h"
+
 #ifndef CTL_CODE
 #define CTL_CODE(DeviceType, Function, Method, Access) (                 \
     ((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
@@ -39,11 +46,22 @@
 // Buffer size used for write & verify. 16 MiB is a reasonable compromise.
 #define BUF_SIZE (16ULL * 1024 * 1024)
 
+// --pipeline: how far the verifier trails the writer by default, and the
+// slice it reads between pauses on drives that incur a seek penalty.
+#define DEFAULT_LAG_MB 1024
+#define THROTTLE_BYTES (64ULL * 1024 * 1024)
+
 static void usage(const char *prog) {
-    printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE> [--test] [--verify]\n", prog);
+    printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE> [--test] [--verify] [--threads N]\n", prog);
     printf("Example: %s 1 E --test\n", prog);
     printf("  --test   : write a single BUF_SIZE chunk (dry run)\n");
     printf("  --verify : after overwrite, read back entire device and confirm all bytes are zero (slow)\n");
+    printf("  --threads N : split the drive into interleaved BUF_SIZE stripes handled by N worker\n");
+    printf("             threads, for both overwrite and verify (needs the disk length)\n");
+    printf("  --pipeline : with --verify, verify while writing. A verifier thread re-reads each\n");
+    printf("             window once it is flushed while the writer moves ahead, instead of a\n");
+    printf("             second full pass. Throttled on drives with a seek penalty (HDDs).\n");
+    printf("  --lag MB : pipeline window; the verifier trails the writer by this much (default %d)\n", DEFAULT_LAG_MB);
 }
 
 // Get disk length in bytes. Returns 1 on success, 0 on failure.
@@ -64,6 +82,272 @@ static int get_disk_length(HANDLE hDrive, unsigned long long *out_len) {
     }
 }
 
+// Drives that report a seek penalty are spinning disks; the pipelined
+// verifier backs off on those so the head is not dragged between two regions.
+static int incurs_seek_penalty(HANDLE hDrive) {
+    STORAGE_PROPERTY_QUERY q;
+    DEVICE_SEEK_PENALTY_DESCRIPTOR d;
+    DWORD returned = 0;
+    memset(&q, 0, sizeof(q));
+    memset(&d, 0, sizeof(d));
+    q.PropertyId = StorageDeviceSeekPenaltyProperty;
+    q.QueryType = PropertyStandardQuery;
+    if (!DeviceIoControl(hDrive, IOCTL_STORAGE_QUERY_PROPERTY, &q, sizeof(q), &d, sizeof(d), &returned, NULL)) {
+        return 0;
+    }
+    return d.IncursSeekPenalty ? 1 : 0;
+}
+
+// --threads: each worker opens its own handle to the drive and owns chunks
+// index, index + count, index + 2*count, ... so several requests are in
+// flight at once. Positioned I/O goes through the OVERLAPPED offset, which
+// works on synchronous handles too.
+typedef struct {
+    const char *path;
+    unsigned long long disk_len;
+    const void *zero_buf;   // shared zero pattern for the write phase
+    unsigned index;
+    unsigned count;
+    int verify;
+    int ok;
+} STRIPE_WORKER;
+
+static volatile LONG64 g_stripe_done;      // bytes completed by all workers
+static CRITICAL_SECTION g_stripe_lock;
+static unsigned long long g_bad_off;       // lowest mismatching offset seen
+static BYTE g_bad_byte;
+
+static DWORD WINAPI stripe_worker(LPVOID arg) {
+    STRIPE_WORKER *w = (STRIPE_WORKER *)arg;
+    w->ok = 0;
+
+    HANDLE h = CreateFileA(w->path,
+                           GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_FLAG_WRITE_THROUGH,
+                           NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Worker %u: failed to open %s (err=%lu)\n", w->index, w->path, GetLastError());
+        return 1;
+    }
+
+    // Writers share the caller's zero buffer; readers need their own.
+    BYTE *buf = (BYTE *)w->zero_buf;
+    if (w->verify) {
+        buf = (BYTE *)VirtualAlloc(NULL, BUF_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (!buf) {
+            fprintf(stderr, "Worker %u: VirtualAlloc failed\n", w->index);
+            CloseHandle(h);
+            return 1;
+        }
+    }
+
+    w->ok = 1;
+    unsigned long long nchunks = (w->disk_len + BUF_SIZE - 1) / BUF_SIZE;
+    for (unsigned long long c = w->index; c < nchunks; c += w->count) {
+        unsigned long long off = c * BUF_SIZE;
+        unsigned long long remaining = w->disk_len - off;
+        DWORD len = (remaining >= BUF_SIZE) ? (DWORD)BUF_SIZE : (DWORD)remaining;
+
+        if (w->verify) {
+            // Nothing above an already-found mismatch can change the report.
+            EnterCriticalSection(&g_stripe_lock);
+            int stop = off >= g_bad_off;
+            LeaveCriticalSection(&g_stripe_lock);
+            if (stop) break;
+        }
+
+        OVERLAPPED ov;
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = (DWORD)off;
+        ov.OffsetHigh = (DWORD)(off >> 32);
+        DWORD n = 0;
+        BOOL r = w->verify ? ReadFile(h, buf, len, &n, &ov) : WriteFile(h, buf, len, &n, &ov);
+        if (!r || n != len) {
+            fprintf(stderr, "Worker %u: %s failed at offset %llu (err=%lu)\n",
+                    w->index, w->verify ? "ReadFile" : "WriteFile", off, GetLastError());
+            w->ok = 0;
+            break;
+        }
+
+        if (w->verify) {
+            DWORD i = (DWORD)mem_find_not_byte(buf, n, 0x00);
+            if (i < n) {
+                EnterCriticalSection(&g_stripe_lock);
+                if (off + i < g_bad_off) {
+                    g_bad_off = off + i;
+                    g_bad_byte = buf[i];
+                }
+                LeaveCriticalSection(&g_stripe_lock);
+                w->ok = 0;
+                break;
+            }
+        }
+
+        unsigned long long before = (unsigned long long)InterlockedExchangeAdd64(&g_stripe_done, (LONG64)n);
+        unsigned long long after = before + n;
+        if (before / (256ULL * 1024 * 1024) != after / (256ULL * 1024 * 1024)) {
+            printf("... %llu MB %s\n", after / (1024 * 1024), w->verify ? "verified" : "written");
+        }
+    }
+
+    if (!w->verify && !FlushFileBuffers(h)) {
+        fprintf(stderr, "Worker %u: FlushFileBuffers failed (err=%lu)\n", w->index, GetLastError());
+        w->ok = 0;
+    }
+    if (w->verify) VirtualFree(buf, 0, MEM_RELEASE);
+    CloseHandle(h);
+    return 0;
+}
+
+// Run `threads` stripe workers over [0, disk_len). Returns the bytes
+// completed; *ok is cleared if any worker failed or a mismatch was found.
+static unsigned long long run_striped(const char *path, unsigned long long disk_len, const void *zero_buf,
+                                      unsigned threads, int verify, BOOL *ok) {
+    STRIPE_WORKER *w = (STRIPE_WORKER *)calloc(threads, sizeof(*w));
+    HANDLE *th = (HANDLE *)calloc(threads, sizeof(*th));
+    *ok = FALSE;
+    if (!w || !th) {
+        fprintf(stderr, "Out of memory starting %u workers\n", threads);
+        free(w);
+        free(th);
+        return 0;
+    }
+
+    g_stripe_done = 0;
+    g_bad_off = disk_len;
+    InitializeCriticalSection(&g_stripe_lock);
+
+    unsigned started = 0;
+    for (; started < threads; started++) {
+        w[started].path = path;
+        w[started].disk_len = disk_len;
+        w[started].zero_buf = zero_buf;
+        w[started].index = started;
+        w[started].count = threads;
+        w[started].verify = verify;
+        th[started] = CreateThread(NULL, 0, stripe_worker, &w[started], 0, NULL);
+        if (!th[started]) {
+            fprintf(stderr, "CreateThread failed for worker %u (err=%lu)\n", started, GetLastError());
+            break;
+        }
+    }
+    WaitForMultipleObjects(started, th, TRUE, INFINITE);
+
+    *ok = (started == threads);
+    for (unsigned i = 0; i < started; i++) {
+        if (!w[i].ok) *ok = FALSE;
+        CloseHandle(th[i]);
+    }
+    DeleteCriticalSection(&g_stripe_lock);
+
+    unsigned long long done = (unsigned long long)g_stripe_done;
+    if (verify && g_bad_off < disk_len) {
+        fprintf(stderr, "Verification failed: non-zero byte at offset %llu (0x%02X)\n", g_bad_off, g_bad_byte);
+        done = g_bad_off;
+    }
+    free(w);
+    free(th);
+    return done;
+}
+
+// --pipeline: the writer flushes after every window and publishes how far
+// the drive is durable; this verifier follows on its own handle, re-reading
+// up to that mark while the writer carries on.
+typedef struct {
+    const char *path;
+    int throttle;
+    volatile LONG64 durable;     // bytes written and flushed so far
+    volatile LONG writer_done;
+    HANDLE wake;                 // auto-reset event, set on every publish
+    unsigned long long verified;
+    int ok;
+} PIPELINE;
+
+static DWORD WINAPI pipeline_verifier(LPVOID arg) {
+    PIPELINE *p = (PIPELINE *)arg;
+    p->ok = 0;
+
+    // Unbuffered, so every read reaches the drive rather than the cache the
+    // writer just filled. Marks are whole sectors and the buffer is page
+    // aligned, as such reads require.
+    HANDLE h = CreateFileA(p->path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Verifier: failed to open %s (err=%lu)\n", p->path, GetLastError());
+        return 1;
+    }
+    BYTE *buf = (BYTE *)VirtualAlloc(NULL, BUF_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!buf) {
+        fprintf(stderr, "Verifier: VirtualAlloc failed\n");
+        CloseHandle(h);
+        return 1;
+    }
+
+    p->ok = 1;
+    unsigned long long pos = 0, slice = 0;
+    ULONGLONG slice_start = GetTickCount64();
+    for (;;) {
+        // Read the flag before the mark: once the writer is done, the mark
+        // it published beforehand is final.
+        LONG done = InterlockedCompareExchange(&p->writer_done, 0, 0);
+        unsigned long long end = (unsigned long long)InterlockedCompareExchange64(&p->durable, 0, 0);
+        if (pos >= end) {
+            if (done) break;
+            WaitForSingleObject(p->wake, INFINITE);
+            // Time spent waiting is not time spent reading: the next slice
+            // starts now, or the throttle would idle for the wait too.
+            slice = 0;
+            slice_start = GetTickCount64();
+            continue;
+        }
+
+        DWORD len = (end - pos >= BUF_SIZE) ? (DWORD)BUF_SIZE : (DWORD)(end - pos);
+        OVERLAPPED ov;
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = (DWORD)pos;
+        ov.OffsetHigh = (DWORD)(pos >> 32);
+        DWORD n = 0;
+        if (!ReadFile(h, buf, len, &n, &ov) || n != len) {
+            fprintf(stderr, "Verifier: ReadFile failed at offset %llu (err=%lu)\n", pos, GetLastError());
+            p->ok = 0;
+            break;
+        }
+        size_t i = mem_find_not_byte(buf, n, 0x00);
+        if (i < n) {
+            fprintf(stderr, "Verification failed: non-zero byte at offset %llu (0x%02X)\n", pos + i, buf[i]);
+            p->ok = 0;
+            break;
+        }
+        if (pos / (256ULL * 1024 * 1024) != (pos + n) / (256ULL * 1024 * 1024)) {
+            printf("... %llu MB verified\n", (pos + n) / (1024 * 1024));
+        }
+        pos += n;
+        p->verified = pos;
+
+        // Rotational drives: after each slice, idle for as long as it took
+        // so the writer keeps the head most of the time.
+        slice += n;
+        if (p->throttle && slice >= THROTTLE_BYTES && !done) {
+            Sleep((DWORD)(GetTickCount64() - slice_start));
+            slice = 0;
+            slice_start = GetTickCount64();
+        }
+    }
+
+    VirtualFree(buf, 0, MEM_RELEASE);
+    CloseHandle(h);
+    return 0;
+}
+
+static void pipeline_publish(PIPELINE *p, unsigned long long durable, int done) {
+    InterlockedExchange64(&p->durable, (LONG64)durable);
+    if (done) InterlockedExchange(&p->writer_done, 1);
+    SetEvent(p->wake);
+}
+
 int main(int argc, char **argv) {
     if (argc < 3) {
         usage(argv[0]);
@@ -74,9 +358,28 @@ int main(int argc, char **argv) {
     const char *volArg = argv[2]; // e.g., "E" or "NONE"
     int testMode = 0;
     int verifyMode = 0;
+    unsigned threads = 1;
+    int pipelineMode = 0;
+    unsigned long long lag = DEFAULT_LAG_MB * 1024ULL * 1024;
     for (int i = 3; i < argc; i++) {
         if (strcmp(argv[i], "--test") == 0) testMode = 1;
         else if (strcmp(argv[i], "--verify") == 0) verifyMode = 1;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int v = atoi(argv[++i]);
+            if (v < 1 || v > 64) {
+                fprintf(stderr, "Thread count must be between 1 and 64\n");
+                return 1;
+            }
+            threads = (unsigned)v;
+        } else if (strcmp(argv[i], "--pipeline") == 0) pipelineMode = 1;
+        else if (strcmp(argv[i], "--lag") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 16 || v > 1024 * 1024) {
+                fprintf(stderr, "Lag must be between 16 and 1048576 MB\n");
+                return 1;
+            }
+            lag = (unsigned long long)v * 1024 * 1024;
+        }
     }
 
     char physicalPath[64];
@@ -89,7 +392,8 @@ int main(int argc, char **argv) {
         printf("No volume lock requested (passing NONE). Writes may be blocked if volume is mounted.\n");
     }
     printf("Test mode: %s\n", testMode ? "YES (single chunk)" : "NO (full wipe)");
-    printf("Verify mode: %s\n", verifyMode ? "YES (read-back verify)" : "NO");
+    printf("Verify mode: %s\n", verifyMode ? (pipelineMode ? "YES (pipelined behind the writer)" : "YES (read-back verify)") : "NO");
+    printf("Worker threads: %u\n", threads);
     printf("Type the word 'CONFIRM' (uppercase) to proceed: ");
     char confirm[64];
     if (!fgets(confirm, sizeof(confirm), stdin)) return 1;
@@ -161,6 +465,35 @@ int main(int argc, char **argv) {
     } else {
         printf("Disk length reported: %llu bytes (~%llu MB)\n", disk_len, disk_len / (1024ULL*1024ULL));
     }
+    if (threads > 1 && disk_len == 0) {
+        printf("Warning: striping needs the disk length. Continuing with a single thread.\n");
+        threads = 1;
+    }
+
+    // The pipeline pairs one sequential writer with one trailing verifier.
+    PIPELINE pipe;
+    HANDLE verifier = NULL;
+    memset(&pipe, 0, sizeof(pipe));
+    if (pipelineMode && verifyMode && !testMode) {
+        if (disk_len == 0) {
+            printf("Warning: the pipeline needs the disk length. Verifying after the write instead.\n");
+        } else {
+            if (threads > 1) printf("Note: --pipeline uses one writer and one verifier; ignoring --threads.\n");
+            threads = 1;
+            pipe.path = physicalPath;
+            pipe.throttle = incurs_seek_penalty(hDrive);
+            pipe.wake = CreateEventA(NULL, FALSE, FALSE, NULL);
+            if (pipe.wake) verifier = CreateThread(NULL, 0, pipeline_verifier, &pipe, 0, NULL);
+            if (!verifier) {
+                fprintf(stderr, "Failed to start verifier thread (err=%lu); verifying after the write.\n", GetLastError());
+                if (pipe.wake) CloseHandle(pipe.wake);
+                pipe.wake = NULL;
+            } else {
+                printf("Verifier trailing the writer by %llu MB%s\n", lag / (1024ULL*1024ULL),
+                       pipe.throttle ? " (throttled: drive reports a seek penalty)" : "");
+            }
+        }
+    }
 
     // Allocate buffer
     void *buf = VirtualAlloc(NULL, BUF_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
@@ -192,10 +525,15 @@ int main(int argc, char **argv) {
             printf("[TEST] %u bytes written.\n", written);
         }
         FlushFileBuffers(hDrive);
+    } else if (threads > 1) {
+        BOOL ok;
+        total_written = run_striped(physicalPath, disk_len, buf, threads, 0, &ok);
+        if (!ok) fprintf(stderr, "One or more workers failed; the drive is not fully overwritten.\n");
     } else {
         if (disk_len > 0) {
             // We know the disk length: write exactly disk_len bytes
             unsigned long long remaining = disk_len;
+            unsigned long long published = 0;
             while (remaining > 0) {
                 DWORD to_write = (remaining >= BUF_SIZE) ? (DWORD)BUF_SIZE : (DWORD)remaining;
                 if (!WriteFile(hDrive, buf, to_write, &written, NULL)) {
@@ -206,9 +544,14 @@ int main(int argc, char **argv) {
                 if (written == 0) break;
                 remaining -= written;
                 total_written += written;
-                if ((total_written % (256ULL * 1024 * 1024)) == 0) {
+                if ((total_written - written) / (256ULL * 1024 * 1024) != total_written / (256ULL * 1024 * 1024)) {
                     printf("... %llu MB written\n", total_written / (1024 * 1024));
                 }
+                // Window complete: flush it and hand it to the verifier.
+                if (verifier && total_written - published >= lag && FlushFileBuffers(hDrive)) {
+                    published = total_written;
+                    pipeline_publish(&pipe, published, 0);
+                }
             }
         } else {
             // Unknown length: write until WriteFile stops (older behavior)
@@ -224,7 +567,7 @@ int main(int argc, char **argv) {
                 }
                 if (written == 0) break;
                 total_written += written;
-                if ((total_written % (256ULL * 1024 * 1024)) == 0) {
+                if ((total_written - written) / (256ULL * 1024 * 1024) != total_written / (256ULL * 1024 * 1024)) {
                     printf("... %llu MB written\n", total_written / (1024 * 1024));
                 }
             }
@@ -233,12 +576,34 @@ int main(int argc, char **argv) {
         if (!FlushFileBuffers(hDrive)) {
             fprintf(stderr, "FlushFileBuffers failed (err=%lu)\n", GetLastError());
         }
+        if (verifier) {
+            // Even after a write error the verifier checks what was written.
+            pipeline_publish(&pipe, total_written, 1);
+            WaitForSingleObject(verifier, INFINITE);
+            CloseHandle(verifier);
+            CloseHandle(pipe.wake);
+        }
     }
 
     printf("Overwrite phase complete. Total bytes written: %llu\n", total_written);
 
     // Verification (optional). Full read-back & check for non-zero bytes.
-    if (verifyMode) {
+    if (verifier) {
+        if (pipe.ok && pipe.verified == disk_len) {
+            printf("Verification succeeded: all bytes read back as zero for %llu bytes.\n", pipe.verified);
+        } else {
+            printf("Verification detected issues (%llu bytes verified).\n", pipe.verified);
+        }
+    } else if (verifyMode && threads > 1) {
+        printf("Starting verification with %u threads...\n", threads);
+        BOOL read_ok;
+        unsigned long long total_read = run_striped(physicalPath, disk_len, NULL, threads, 1, &read_ok);
+        if (read_ok) {
+            printf("Verification succeeded: all bytes read back as zero for %llu bytes.\n", total_read);
+        } else {
+            printf("Verification detected issues.\n");
+        }
+    } else if (verifyMode) {
         printf("Starting verification (reading back entire device)... This will take roughly as long as the write phase.\n");
         // reposition to beginning
         LARGE_INTEGER off0; off0.QuadPart = 0;
@@ -257,19 +622,16 @@ int main(int argc, char **argv) {
                 }
                 if (readBytes == 0) break;
                 // check buffer for any non-zero byte
-                size_t i;
                 BYTE *b = (BYTE*)buf;
-                for (i = 0; i < readBytes; ++i) {
-                    if (b[i] != 0x00) {
-                        unsigned long long pos = total_read + i;
-                        fprintf(stderr, "Verification failed: non-zero byte at offset %llu (0x%02X)\n", pos, b[i]);
-                        read_ok = FALSE;
-                        break;
-                    }
+                size_t i = mem_find_not_byte(b, readBytes, 0x00);
+                if (i < readBytes) {
+                    unsigned long long pos = total_read + i;
+                    fprintf(stderr, "Verification failed: non-zero byte at offset %llu (0x%02X)\n", pos, b[i]);
+                    read_ok = FALSE;
                 }
                 if (!read_ok) break;
                 total_read += readBytes;
-                if ((total_read % (256ULL * 1024 * 1024)) == 0) {
+                if ((total_read - readBytes) / (256ULL * 1024 * 1024) != total_read / (256ULL * 1024 * 1024)) {
                     printf("... %llu MB verified\n", total_read / (1024 * 1024));
                 }
             }
@@ -5,6 +5,8 @@
 // Example:
 // purge.exe 1 E --test
 // purge.exe 1 NONE --verify
+// Build (MinGW):
+// gcc -O2 -o purge.exe purge.c ../common/memcheck.c ../common/cpu.c
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <windows.h>
@@ -13,6 +15,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../common/memcheck.h"
+
 #ifndef CTL_CODE
 #define CTL_CODE(DeviceType, Function, Method, Access) ( \
     ((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
@@ -159,7 +163,7 @@ int main(int argc, char **argv) {
             if (!written) break;
             total += written;
             if (disk_len) remaining -= written;
-            if (total % (256ULL*1024*1024) == 0) {
+            if ((total - written) / (256ULL*1024*1024) != total / (256ULL*1024*1024)) {
                 printf("... %llu MB written\n", total / (1024*1024));
             }
         }
@@ -176,11 +180,10 @@ int main(int argc, char **argv) {
         BOOL ok = TRUE;
         while (ReadFile(hDrive, buf, (DWORD)BUF_SIZE, &readBytes, NULL) && readBytes) {
             BYTE *b = (BYTE*)buf;
-            for (DWORD i = 0; i < readBytes; i++) {
-                if (b[i] != 0x00) {
-                    printf("Verify fail at offset %llu (0x%02X)\n", totalRead + i, b[i]);
-                    ok = FALSE; break;
-                }
+            DWORD i = (DWORD)mem_find_not_byte(b, readBytes, 0x00);
+            if (i < readBytes) {
+                printf("Verify fail at offset %llu (0x%02X)\n", totalRead + i, b[i]);
+                ok = FALSE;
             }
             if (!ok) break;
             totalRead += readBytes;
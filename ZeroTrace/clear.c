@@ -1,10 +1,15 @@
 // zeroTraceFast.c
 // WARNING: destructive. Run as Administrator. Usage:
-//   zeroTraceFast.exe <PhysicalDriveNumber> <VolumeLetter|NONE> [--test]
+//   zeroTraceFast.exe <PhysicalDriveNumber> <VolumeLetter|NONE> [--test] [--threads N]
+//                     [--max-bad MB] [--bad-log FILE]
 //
 // Example:
 //   zeroTraceFast.exe 1 E --test   -> writes 512 MiB zeros to PhysicalDrive1 after locking E:
 //   zeroTraceFast.exe 1 NONE       -> attempts full wipe of PhysicalDrive1 (no lock)
+//   zeroTraceFast.exe 1 NONE --threads 4 -> same, with 4 writers on interleaved stripes
+//
+// Build (MinGW):
+//   gcc -O2 -o zeroTraceFast.exe clear.c common/badrange.c common/buffers.c
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <windows.h>
@@ -13,6 +18,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "common/badrange.h"
+#include "common/buffers.h"
+
 // --- Missing macros for MinGW (normally in MSVC headers) ---
 #ifndef CTL_CODE
 #define CTL_CODE(DeviceType, Function, Method, Access) (                 \
@@ -45,11 +53,153 @@
 #define FSCTL_DISMOUNT_VOLUME CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 8, METHOD_BUFFERED, FILE_ANY_ACCESS)
 #endif
 
-#define BUF_SIZE (512ULL * 1024 * 1024) // 512 MiB
+// Stripe handed to each --threads worker in turn, and the --test length.
+#define STRIPE_SIZE (512ULL * 1024 * 1024) // 512 MiB
+// Bytes per WriteFile. Every write comes from one zeroed buffer of this size,
+// so memory use does not depend on the stripe.
+#define WRITE_SIZE BUFFER_DATA_MAX
+// Failed writes are retried and bisected down to the sector; a drive with
+// more than this many bad bytes is given up on.
+#define DEFAULT_MAX_BAD_MB 256
 
 static void usage(const char *prog) {
-    printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE> [--test]\n", prog);
+    printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE> [--test] [--threads N]\n", prog);
     printf("Example: %s 1 E --test\n", prog);
+    printf("  --threads N : split the drive into interleaved 512 MiB stripes written by N threads\n");
+    printf("  --max-bad MB : sectors that still fail after retries are skipped and listed; give up\n");
+    printf("             once more than this much is bad (default %d)\n", DEFAULT_MAX_BAD_MB);
+    printf("  --bad-log FILE : append the bad ranges to FILE (drive offset length kind error)\n");
+}
+
+// Get disk length in bytes. Returns 1 on success, 0 on failure.
+static int get_disk_length(HANDLE hDrive, unsigned long long *out_len) {
+    typedef struct {
+        LARGE_INTEGER Length;
+    } GET_LENGTH_INFORMATION;
+    GET_LENGTH_INFORMATION info = {0};
+    DWORD returned = 0;
+    if (DeviceIoControl(hDrive, IOCTL_DISK_GET_LENGTH_INFO,
+                        NULL, 0,
+                        &info, sizeof(info),
+                        &returned, NULL)) {
+        *out_len = (unsigned long long)info.Length.QuadPart;
+        return 1;
+    }
+    return 0;
+}
+
+static unsigned get_sector_size(HANDLE hDrive) {
+    DISK_GEOMETRY g;
+    DWORD returned = 0;
+    if (DeviceIoControl(hDrive, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0, &g, sizeof(g), &returned, NULL) &&
+        g.BytesPerSector)
+        return g.BytesPerSector;
+    return 512;
+}
+
+// Retrying a failed write: positioned writes on the same handle.
+typedef struct {
+    struct bad_io x;
+    HANDLE h;
+} SALVAGE_IO;
+
+static int salvage_write(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len) {
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)off;
+    ov.OffsetHigh = (DWORD)(off >> 32);
+    DWORD written = 0;
+    if (!WriteFile(((SALVAGE_IO *)x)->h, buf, (DWORD)len, &written, &ov)) return (int)GetLastError();
+    return written == len ? 0 : ERROR_WRITE_FAULT;
+}
+
+static struct bad_list *g_bad;      // sectors given up on
+static unsigned g_sector = 512;
+static volatile LONG64 g_lost;      // bytes given up on, by every writer
+
+// The write of len bytes at off failed. Returns the bytes given up on, or
+// -1 once the drive has too many bad sectors to go on.
+static long long salvage(HANDLE h, const void *buf, unsigned long long off, unsigned long long len) {
+    SALVAGE_IO s;
+    memset(&s, 0, sizeof(s));
+    s.x.transfer = salvage_write;
+    s.x.list = g_bad;
+    s.x.kind = BAD_WRITE;
+    s.x.sector = g_sector;
+    s.h = h;
+    unsigned long long lost = 0;
+    if (bad_salvage(&s.x, (void *)buf, off, len, &lost) != 0) {
+        fprintf(stderr, "Too many bad sectors; giving up\n");
+        return -1;
+    }
+    if (lost) fprintf(stderr, "%llu of %llu bytes at offset %llu could not be written; carrying on\n", lost, len, off);
+    InterlockedExchangeAdd64(&g_lost, (LONG64)lost);
+    return (long long)lost;
+}
+
+// Write len bytes (at most WRITE_SIZE) from buf at off, salvaging a failed
+// write. Returns len, the bytes covered (what salvage gave up on is counted
+// in g_lost), or -1 once the drive has too many bad sectors to go on.
+static long long write_at(HANDLE h, const void *buf, unsigned long long off, DWORD len) {
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)off;
+    ov.OffsetHigh = (DWORD)(off >> 32);
+    DWORD written = 0;
+    if (WriteFile(h, buf, len, &written, &ov) && written == len) return len;
+    fprintf(stderr, "WriteFile failed at offset %llu (err=%lu)\n", off, GetLastError());
+    return salvage(h, buf, off, len) < 0 ? -1 : (long long)len;
+}
+
+// --threads: each worker opens its own handle and writes stripes index,
+// index + count, index + 2*count, ... from the shared zero buffer, so several
+// writes are in flight at once. The OVERLAPPED offset positions each write.
+typedef struct {
+    const char *path;
+    unsigned long long disk_len;
+    const void *buf;
+    unsigned index;
+    unsigned count;
+    int ok;
+} STRIPE_WORKER;
+
+static volatile LONG64 g_stripe_done; // bytes covered by all workers
+
+static DWORD WINAPI stripe_worker(LPVOID arg) {
+    STRIPE_WORKER *w = (STRIPE_WORKER *)arg;
+    w->ok = 0;
+
+    HANDLE h = CreateFileA(w->path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           NULL, OPEN_EXISTING, 0, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Worker %u: failed to open %s (err=%lu)\n", w->index, w->path, GetLastError());
+        return 1;
+    }
+
+    w->ok = 1;
+    unsigned long long nstripes = (w->disk_len + STRIPE_SIZE - 1) / STRIPE_SIZE;
+    for (unsigned long long c = w->index; c < nstripes && w->ok; c += w->count) {
+        unsigned long long end = (c + 1) * STRIPE_SIZE;
+        if (end > w->disk_len) end = w->disk_len;
+        for (unsigned long long off = c * STRIPE_SIZE; off < end; off += WRITE_SIZE) {
+            DWORD len = (end - off >= WRITE_SIZE) ? (DWORD)WRITE_SIZE : (DWORD)(end - off);
+            long long written = write_at(h, w->buf, off, len);
+            if (written < 0) {
+                w->ok = 0;
+                break;
+            }
+
+            unsigned long long before = (unsigned long long)InterlockedExchangeAdd64(&g_stripe_done, written);
+            unsigned long long after = before + (unsigned long long)written;
+            if (before / (1024ULL * 1024 * 1024) != after / (1024ULL * 1024 * 1024)) {
+                printf("... %llu GB written\n", after / (1024ULL * 1024 * 1024));
+            }
+        }
+    }
+
+    if (!FlushFileBuffers(h)) w->ok = 0;
+    CloseHandle(h);
+    return 0;
 }
 
 int main(int argc, char **argv) {
@@ -62,7 +212,34 @@ int main(int argc, char **argv) {
     const char *driveNumStr = argv[1];
     const char *volArg = argv[2]; // e.g., "E" or "NONE"
     int testMode = 0;
-    if (argc >= 4 && strcmp(argv[3], "--test") == 0) testMode = 1;
+    unsigned threads = 1;
+    unsigned long long maxBad = DEFAULT_MAX_BAD_MB * 1024ULL * 1024;
+    const char *badLog = NULL;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--test") == 0) testMode = 1;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            int v = atoi(argv[++i]);
+            if (v < 1 || v > 64) {
+                fprintf(stderr, "Thread count must be between 1 and 64\n");
+                return 1;
+            }
+            threads = (unsigned)v;
+        }
+        else if (strcmp(argv[i], "--max-bad") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 1 || v > 1024 * 1024) {
+                fprintf(stderr, "Max bad must be between 1 and 1048576 MB\n");
+                return 1;
+            }
+            maxBad = (unsigned long long)v * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--bad-log") == 0 && i + 1 < argc) badLog = argv[++i];
+    }
+    g_bad = bad_list_new(maxBad);
+    if (!g_bad) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
 
     char physicalPath[64];
     snprintf(physicalPath, sizeof(physicalPath), "\\\\.\\PhysicalDrive%s", driveNumStr);
@@ -74,6 +251,7 @@ int main(int argc, char **argv) {
         printf("No volume lock requested (passing NONE). Writes may be blocked if volume is mounted.\n");
     }
     printf("Test mode: %s\n", testMode ? "YES (512 MiB only)" : "NO (full wipe)");
+    printf("Writer threads: %u\n", threads);
     printf("Type the word 'CONFIRM' (uppercase) to proceed: ");
     char confirm[64];
     if (!fgets(confirm, sizeof(confirm), stdin)) return 1;
@@ -136,10 +314,10 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    // Allocate buffer via VirtualAlloc (aligned)
-    void *buf = VirtualAlloc(NULL, BUF_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    // Zeroed, page-aligned, from large pages when the account may use them.
+    void *buf = buffer_alloc(WRITE_SIZE);
     if (!buf) {
-        fprintf(stderr, "VirtualAlloc failed for 512 MB buffer\n");
+        fprintf(stderr, "Out of memory for the write buffer\n");
         CloseHandle(hDrive);
         if (hVolume != INVALID_HANDLE_VALUE) {
             DeviceIoControl(hVolume, FSCTL_UNLOCK_VOLUME, NULL, 0, NULL, 0, &(DWORD){0}, NULL);
@@ -147,44 +325,85 @@ int main(int argc, char **argv) {
         }
         return 1;
     }
-    memset(buf, 0, BUF_SIZE);
+    g_sector = get_sector_size(hDrive);
 
     printf("Starting overwrite%s ...\n", testMode ? " (test: 512 MiB)" : "");
 
     DWORD written = 0;
     unsigned long long total = 0;
     if (testMode) {
-        LARGE_INTEGER offset;
-        offset.QuadPart = 0;
-        if (!SetFilePointerEx(hDrive, offset, NULL, FILE_BEGIN)) {
-            fprintf(stderr, "SetFilePointerEx failed (err=%lu)\n", GetLastError());
+        unsigned long long end = STRIPE_SIZE;
+        if (get_disk_length(hDrive, &end) && end > STRIPE_SIZE) end = STRIPE_SIZE;
+        for (unsigned long long off = 0; off < end; off += WRITE_SIZE) {
+            DWORD len = (end - off >= WRITE_SIZE) ? (DWORD)WRITE_SIZE : (DWORD)(end - off);
+            long long n = write_at(hDrive, buf, off, len);
+            if (n < 0) break;
+            total += (unsigned long long)n;
         }
-        if (!WriteFile(hDrive, buf, BUF_SIZE, &written, NULL)) {
-            fprintf(stderr, "WriteFile failed for test write (err=%lu)\n", GetLastError());
+        printf("Test write done: %llu bytes covered.\n", total);
+    } else if (threads > 1) {
+        // Striping needs to know where the drive ends.
+        unsigned long long disk_len = 0;
+        if (!get_disk_length(hDrive, &disk_len) || disk_len == 0) {
+            fprintf(stderr, "Failed to query disk length (err=%lu); --threads needs it.\n", GetLastError());
         } else {
-            total += written;
-            printf("Test write done: %u bytes written.\n", written);
+            STRIPE_WORKER *w = (STRIPE_WORKER *)calloc(threads, sizeof(*w));
+            HANDLE *th = (HANDLE *)calloc(threads, sizeof(*th));
+            unsigned started = 0;
+            if (w && th) {
+                for (; started < threads; started++) {
+                    w[started].path = physicalPath;
+                    w[started].disk_len = disk_len;
+                    w[started].buf = buf;
+                    w[started].index = started;
+                    w[started].count = threads;
+                    th[started] = CreateThread(NULL, 0, stripe_worker, &w[started], 0, NULL);
+                    if (!th[started]) break;
+                }
+                WaitForMultipleObjects(started, th, TRUE, INFINITE);
+            }
+            int ok = (started == threads);
+            for (unsigned i = 0; i < started; i++) {
+                if (!w[i].ok) ok = 0;
+                CloseHandle(th[i]);
+            }
+            if (!ok) fprintf(stderr, "One or more writer threads failed; the drive is not fully overwritten.\n");
+            total = (unsigned long long)g_stripe_done;
+            free(w);
+            free(th);
         }
     } else {
-        while (1) {
-            if (!WriteFile(hDrive, buf, BUF_SIZE, &written, NULL)) {
+        // With the length known every write is sized to fit, and a failed
+        // one is salvaged; otherwise the first failure marks the end.
+        unsigned long long disk_len = 0, pos = 0;
+        if (!get_disk_length(hDrive, &disk_len)) disk_len = 0;
+        while (!disk_len || pos < disk_len) {
+            DWORD len = (!disk_len || disk_len - pos >= WRITE_SIZE) ? (DWORD)WRITE_SIZE : (DWORD)(disk_len - pos);
+            if (!WriteFile(hDrive, buf, len, &written, NULL)) {
                 DWORD err = GetLastError();
                 if (err == ERROR_HANDLE_DISK_FULL || err == ERROR_WRITE_PROTECT) {
                     printf("WriteFile stopped (err=%lu).\n", err);
-                } else {
-                    fprintf(stderr, "WriteFile failed (err=%lu)\n", err);
+                    break;
                 }
-                break;
+                fprintf(stderr, "WriteFile failed at offset %llu (err=%lu)\n", pos, err);
+                long long lost = disk_len ? salvage(hDrive, buf, pos, len) : -1;
+                LARGE_INTEGER next;
+                next.QuadPart = (LONGLONG)(pos + len);
+                if (lost < 0 || !SetFilePointerEx(hDrive, next, NULL, FILE_BEGIN)) break;
+                written = len;
+                pos += len;
+            } else {
+                if (written == 0) break;
+                pos += written;
             }
-            if (written == 0) break;
             total += written;
-            if ((total % (1024ULL * 1024 * 1024)) == 0) {
+            if ((total - written) / (1024ULL * 1024 * 1024) != total / (1024ULL * 1024 * 1024)) {
                 printf("... %llu GB written\n", total / (1024ULL * 1024 * 1024));
             }
         }
     }
 
-    VirtualFree(buf, 0, MEM_RELEASE);
+    buffer_free(buf, WRITE_SIZE);
     CloseHandle(hDrive);
 
     if (hVolume != INVALID_HANDLE_VALUE) {
@@ -193,7 +412,18 @@ int main(int argc, char **argv) {
         printf("Volume unlocked.\n");
     }
 
-    printf("Overwrite complete. Total bytes written: %llu\n", total);
+    // total counts every range the pass got past, salvaged ones included;
+    // what could not be written there is reported apart from it.
+    unsigned long long lost = (unsigned long long)g_lost;
+    printf("Overwrite complete. Total bytes covered: %llu\n", total);
+    printf("I/O buffers: %s\n", buffer_impl());
+    if (lost) {
+        printf("Accounting: %llu bytes written, %llu unwritable\n", total - lost, lost);
+        bad_list_report(g_bad, stdout, "");
+        if (badLog && bad_list_save(g_bad, badLog, physicalPath) != 0)
+            fprintf(stderr, "Could not write the bad-range log %s\n", badLog);
+    }
+    bad_list_free(g_bad);
     printf("Reminder: This implements NIST 800-88 'Clear'. For 'Purge', use Secure Erase or sanitize commands.\n");
-    return 0;
+    return lost ? 1 : 0;
 }
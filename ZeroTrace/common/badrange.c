@@ -0,0 +1,238 @@
+// badrange.c
+// Retry, bisection and the bad-range list shared by the Linux and Windows wipers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "badrange.h"
+
+// Ranges listed in a report; the log file gets all of them.
+#define REPORT_RANGES 32
+
+struct bad_range {
+    unsigned long long off, len;
+    enum bad_kind kind;
+    int err;
+};
+
+struct bad_list {
+    struct bad_range *r;
+    size_t n, cap;
+    unsigned long long bytes[BAD_KINDS];
+    unsigned long long limit;
+#if defined(_WIN32)
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+
+#if defined(_WIN32)
+static void lock_list(struct bad_list *b) { EnterCriticalSection(&b->lock); }
+static void unlock_list(struct bad_list *b) { LeaveCriticalSection(&b->lock); }
+
+static void format_err(char *out, size_t n, int err) {
+    snprintf(out, n, "err=%d", err);
+}
+#else
+static void lock_list(struct bad_list *b) { pthread_mutex_lock(&b->lock); }
+static void unlock_list(struct bad_list *b) { pthread_mutex_unlock(&b->lock); }
+
+static void format_err(char *out, size_t n, int err) {
+    snprintf(out, n, "%s", strerror(err));
+}
+#endif
+
+static const char *kind_name(enum bad_kind k) {
+    return k == BAD_WRITE ? "unwritable" : "unreadable";
+}
+
+struct bad_list *bad_list_new(unsigned long long limit) {
+    struct bad_list *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    b->limit = limit;
+#if defined(_WIN32)
+    InitializeCriticalSection(&b->lock);
+#else
+    pthread_mutex_init(&b->lock, NULL);
+#endif
+    return b;
+}
+
+void bad_list_free(struct bad_list *b) {
+    if (!b) return;
+#if defined(_WIN32)
+    DeleteCriticalSection(&b->lock);
+#else
+    pthread_mutex_destroy(&b->lock);
+#endif
+    free(b->r);
+    free(b);
+}
+
+int bad_list_add(struct bad_list *b, enum bad_kind k, unsigned long long off, unsigned long long len, int err) {
+    lock_list(b);
+    b->bytes[k] += len;
+    // Bisection finds the sectors of one request in order, so a run of bad
+    // sectors nearly always extends a range seen moments ago.
+    size_t i = b->n;
+    while (i > 0 && i + 8 > b->n) {
+        struct bad_range *r = &b->r[--i];
+        if (r->kind != k) continue;
+        if (r->off + r->len == off) {
+            r->len += len;
+            goto out;
+        }
+        if (off + len == r->off) {
+            r->off = off;
+            r->len += len;
+            goto out;
+        }
+    }
+    if (b->n == b->cap && b->cap < BAD_MAX_RANGES) {
+        size_t cap = b->cap ? b->cap * 2 : 64;
+        struct bad_range *r = realloc(b->r, cap * sizeof(*r));
+        if (r) {
+            b->r = r;
+            b->cap = cap;
+        }
+    }
+    if (b->n < b->cap) {
+        struct bad_range *r = &b->r[b->n++];
+        r->off = off;
+        r->len = len;
+        r->kind = k;
+        r->err = err;
+    }
+out:;
+    int over = b->limit && b->bytes[BAD_WRITE] + b->bytes[BAD_READ] > b->limit;
+    unlock_list(b);
+    return over ? -1 : 0;
+}
+
+unsigned long long bad_list_bytes(struct bad_list *b, enum bad_kind k) {
+    if (!b) return 0;
+    lock_list(b);
+    unsigned long long n = b->bytes[k];
+    unlock_list(b);
+    return n;
+}
+
+unsigned long long bad_list_covering(struct bad_list *b, enum bad_kind k, unsigned long long off) {
+    unsigned long long end = 0;
+    lock_list(b);
+    for (size_t i = 0; i < b->n && !end; i++) {
+        const struct bad_range *r = &b->r[i];
+        if (r->kind == k && off >= r->off && off - r->off < r->len) end = r->off + r->len;
+    }
+    unlock_list(b);
+    return end;
+}
+
+static int compare_range(const void *a, const void *b) {
+    const struct bad_range *x = a, *y = b;
+    if (x->kind != y->kind) return x->kind < y->kind ? -1 : 1;
+    return x->off < y->off ? -1 : x->off > y->off;
+}
+
+// Sort the list and fold ranges that overlap or touch, such as the same
+// sectors failing again on a later pass. Called with the lock held.
+static void tidy(struct bad_list *b) {
+    if (!b->n) return;
+    qsort(b->r, b->n, sizeof(*b->r), compare_range);
+    size_t out = 0;
+    for (size_t i = 1; i < b->n; i++) {
+        struct bad_range *p = &b->r[out], *r = &b->r[i];
+        if (r->kind == p->kind && r->off <= p->off + p->len) {
+            if (r->off + r->len > p->off + p->len) p->len = r->off + r->len - p->off;
+        } else {
+            b->r[++out] = *r;
+        }
+    }
+    b->n = out + 1;
+}
+
+void bad_list_report(struct bad_list *b, FILE *f, const char *tag) {
+    if (!b) return;
+    const char *t = tag ? tag : "";
+    lock_list(b);
+    if (!b->n) {
+        unlock_list(b);
+        return;
+    }
+    tidy(b);
+    fprintf(f, "%sBad ranges: %zu (%llu bytes unwritable, %llu bytes unreadable, over all passes)\n", t, b->n,
+            b->bytes[BAD_WRITE], b->bytes[BAD_READ]);
+    for (size_t i = 0; i < b->n && i < REPORT_RANGES; i++) {
+        const struct bad_range *r = &b->r[i];
+        char err[96];
+        format_err(err, sizeof(err), r->err);
+        fprintf(f, "%s  %llu - %llu (%llu bytes) %s: %s\n", t, r->off, r->off + r->len, r->len,
+                kind_name(r->kind), err);
+    }
+    if (b->n > REPORT_RANGES) fprintf(f, "%s  ... and %zu more\n", t, b->n - REPORT_RANGES);
+    unlock_list(b);
+}
+
+int bad_list_save(struct bad_list *b, const char *path, const char *device) {
+    if (!b) return 0;
+    FILE *f = fopen(path, "a");
+    if (!f) return -1;
+    lock_list(b);
+    tidy(b);
+    for (size_t i = 0; i < b->n; i++) {
+        const struct bad_range *r = &b->r[i];
+        fprintf(f, "%s %llu %llu %s %d\n", device, r->off, r->len, r->kind == BAD_WRITE ? "write" : "read", r->err);
+    }
+    unlock_list(b);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+void bad_list_json(struct bad_list *b, FILE *f) {
+    fputc('[', f);
+    if (b) {
+        lock_list(b);
+        tidy(b);
+        for (size_t i = 0; i < b->n; i++) {
+            const struct bad_range *r = &b->r[i];
+            fprintf(f, "%s{\"offset\": %llu, \"length\": %llu, \"kind\": \"%s\", \"error\": %d}", i ? ", " : "",
+                    r->off, r->len, r->kind == BAD_WRITE ? "write" : "read", r->err);
+        }
+        unlock_list(b);
+    }
+    fputc(']', f);
+}
+
+static int salvage(struct bad_io *x, char *buf, unsigned long long off, unsigned long long len,
+                   int attempts, unsigned long long *lost) {
+    int err = 0;
+    for (int a = 0; a < attempts; a++) {
+        err = x->transfer(x, buf, off, len);
+        if (err == 0) return 0;
+    }
+    if (len <= x->sector) {
+        if (x->lost) x->lost(x, buf, off, len);
+        *lost += len;
+        return bad_list_add(x->list, x->kind, off, len, err);
+    }
+    // Split on a sector boundary; the last sector of an odd-sized range
+    // may be short.
+    unsigned long long half = len / 2 / x->sector * x->sector;
+    if (!half) half = x->sector;
+    if (salvage(x, buf, off, half, half <= x->sector ? BAD_RETRIES : 1, lost) != 0) return -1;
+    return salvage(x, buf + half, off + half, len - half, len - half <= x->sector ? BAD_RETRIES : 1, lost);
+}
+
+int bad_salvage(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len,
+                unsigned long long *lost) {
+    if (!x->sector) x->sector = 512;
+    *lost = 0;
+    return salvage(x, buf, off, len, BAD_RETRIES, lost);
+}
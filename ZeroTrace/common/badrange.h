@@ -0,0 +1,69 @@
+// badrange.h
+// Carrying on past media errors. A request that fails is retried, then split
+// in halves down to the sector size; only the sectors that still fail are
+// given up on. They are recorded in a bad-range list (merged where they
+// touch) as unwritable, or unreadable when verifying, and the wipe goes on
+// at full request size after them, so every byte of the device ends up
+// accounted for as written, verified or bad.
+
+#ifndef ZT_BADRANGE_H
+#define ZT_BADRANGE_H
+
+#include <stdio.h>
+
+// Attempts at a failed request, and again at each sector it is split into.
+#define BAD_RETRIES 3
+// Ranges kept for the report and log; the byte totals cover every range.
+#define BAD_MAX_RANGES 65536
+
+enum bad_kind {
+    BAD_WRITE,      // unwritable
+    BAD_READ,       // unreadable when verifying
+    BAD_KINDS
+};
+
+struct bad_list;
+
+// A list that gives up once more than limit bytes are bad (0 = never).
+// Returns NULL when out of memory.
+struct bad_list *bad_list_new(unsigned long long limit);
+void bad_list_free(struct bad_list *b);
+
+// Record len bytes at off as bad, err being the platform error code (errno
+// or GetLastError()). Safe from any thread. Returns 0, or -1 once the limit
+// is exceeded.
+int bad_list_add(struct bad_list *b, enum bad_kind k, unsigned long long off, unsigned long long len, int err);
+unsigned long long bad_list_bytes(struct bad_list *b, enum bad_kind k);
+// End of the recorded range of kind k holding off, or 0 when off is not in one.
+unsigned long long bad_list_covering(struct bad_list *b, enum bad_kind k, unsigned long long off);
+
+// The ranges in offset order, unwritable first (the first few dozen of
+// them), each line prefixed with tag.
+void bad_list_report(struct bad_list *b, FILE *f, const char *tag);
+// Append every range as "device offset length write|read error" lines.
+// Returns 0, or -1 if the file could not be written.
+int bad_list_save(struct bad_list *b, const char *path, const char *device);
+// Every range as a JSON array of {"offset", "length", "kind", "error"}
+// objects, kind being "write" or "read".
+void bad_list_json(struct bad_list *b, FILE *f);
+
+// How a caller moves data for bad_salvage.
+struct bad_io {
+    // Move len bytes between buf and the device at off. Returns 0, or the
+    // platform error code.
+    int (*transfer)(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len);
+    // Called for every range given up on (may be NULL). Verifiers put the
+    // expected contents there so their check passes over the hole.
+    void (*lost)(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len);
+    struct bad_list *list;
+    enum bad_kind kind;
+    unsigned long long sector;  // smallest piece a request is split into
+};
+
+// [off, off + len), transferred from or to buf, just failed. Retry it, then
+// bisect it, recording what still fails. *lost receives the bytes given up
+// on. Returns 0 to carry on, -1 once the list's limit is exceeded.
+int bad_salvage(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len,
+                unsigned long long *lost);
+
+#endif
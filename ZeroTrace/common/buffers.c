@@ -0,0 +1,126 @@
+// buffers.c
+// Huge-page buffers and shared pattern tiles for the Linux and Windows wipers.
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "buffers.h"
+
+#define HUGE_PAGE (2 * 1024 * 1024)
+
+// Strongest kind of page handed out so far: 0 normal, 1 transparent huge
+// pages, 2 huge pages.
+static volatile int backing;
+
+static void note_backing(int kind) {
+    if (kind > backing) backing = kind;
+}
+
+#if defined(_WIN32)
+// Large pages need SeLockMemoryPrivilege; without it the first attempt
+// fails and later ones are not tried.
+static volatile LONG large_pages = 1;
+
+void *buffer_alloc(size_t size) {
+    SIZE_T large = GetLargePageMinimum();
+    if (large && large_pages && size >= large) {
+        SIZE_T len = (size + large - 1) / large * large;
+        void *p = VirtualAlloc(NULL, len, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (p) {
+            note_backing(2);
+            return p;
+        }
+        InterlockedExchange(&large_pages, 0);
+    }
+    // VirtualAlloc memory is zeroed.
+    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+void buffer_free(void *p, size_t size) {
+    (void)size;
+    if (p) VirtualFree(p, 0, MEM_RELEASE);
+}
+
+static void *load_tile(void *volatile *slot) {
+    void *t = *slot;
+    MemoryBarrier();
+    return t;
+}
+
+static void *publish_tile(void *volatile *slot, void *tile) {
+    void *seen = InterlockedCompareExchangePointer((PVOID volatile *)slot, tile, NULL);
+    return seen ? seen : tile;
+}
+#else
+static int huge_pages = 1;   // cleared once MAP_HUGETLB has failed
+
+static size_t map_length(size_t size) {
+    size_t page = size >= HUGE_PAGE ? HUGE_PAGE : (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+void *buffer_alloc(size_t size) {
+    size_t len = map_length(size);
+    void *p;
+    if (len >= HUGE_PAGE && __atomic_load_n(&huge_pages, __ATOMIC_RELAXED)) {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            note_backing(2);
+            return p;
+        }
+        // No huge pages reserved (vm.nr_hugepages); don't ask again.
+        __atomic_store_n(&huge_pages, 0, __ATOMIC_RELAXED);
+    }
+    // Anonymous memory is zeroed.
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+#if defined(MADV_HUGEPAGE)
+    if (len >= HUGE_PAGE && madvise(p, len, MADV_HUGEPAGE) == 0) note_backing(1);
+#endif
+    return p;
+}
+
+void buffer_free(void *p, size_t size) {
+    if (p) munmap(p, map_length(size));
+}
+
+static void *load_tile(void *volatile *slot) {
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+static void *publish_tile(void *volatile *slot, void *tile) {
+    void *expected = NULL;
+    if (__atomic_compare_exchange_n(slot, &expected, tile, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return tile;
+    return expected;
+}
+#endif
+
+// One tile per byte value, built the first time it is asked for and kept
+// for the life of the process.
+static void *volatile tiles[256];
+
+const void *buffer_tile(unsigned char b) {
+    void *t = load_tile(&tiles[b]);
+    if (t) return t;
+    t = buffer_alloc(BUFFER_TILE);
+    if (!t) return NULL;
+    if (b) memset(t, b, BUFFER_TILE);
+    void *won = publish_tile(&tiles[b], t);
+    if (won != t) buffer_free(t, BUFFER_TILE);
+    return won;
+}
+
+const char *buffer_impl(void) {
+    switch (backing) {
+    case 2:  return "huge pages";
+    case 1:  return "transparent huge pages";
+    }
+    return "normal pages";
+}
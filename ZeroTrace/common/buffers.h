@@ -0,0 +1,32 @@
+// buffers.h
+// I/O buffers for the wipers. Memory is taken from huge pages where the
+// system has them (MAP_HUGETLB, else transparent huge pages; large pages on
+// Windows when the account may lock memory) and from normal pages otherwise.
+// Writes of a fixed byte never fill a chunk-sized buffer: one small tile of
+// that byte is built once per process, shared by every thread and device,
+// and repeated as often as the request needs. Requests that carry their own
+// data (reads, random writes) get a buffer of at most BUFFER_DATA_MAX, so
+// memory per job does not grow with the chunk size.
+
+#ifndef ZT_BUFFERS_H
+#define ZT_BUFFERS_H
+
+#include <stddef.h>
+
+// Tile size: small enough to stay in cache, large enough that a 256 MiB
+// request still fits in IOV_MAX (1024) iovecs.
+#define BUFFER_TILE (256 * 1024)
+#define BUFFER_DATA_MAX (8 * 1024 * 1024)
+
+// Zero-filled, page-aligned buffer of size bytes, or NULL when out of memory.
+void *buffer_alloc(size_t size);
+// Release a buffer from buffer_alloc; size must be the size it was asked for.
+void buffer_free(void *p, size_t size);
+
+// BUFFER_TILE bytes of b, shared and read-only. NULL when out of memory.
+const void *buffer_tile(unsigned char b);
+
+// What backs the buffers handed out so far, for the banner.
+const char *buffer_impl(void);
+
+#endif
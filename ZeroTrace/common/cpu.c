@@ -0,0 +1,67 @@
+// cpu.c
+// CPUID / XGETBV probing. AVX state must also be enabled by the OS (XCR0),
+// not just advertised by CPUID.
+
+#include "cpu.h"
+
+#ifdef ZT_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void cpuid(unsigned leaf, unsigned sub, unsigned r[4]) {
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuidex(regs, (int)leaf, (int)sub);
+    for (int i = 0; i < 4; i++) r[i] = (unsigned)regs[i];
+#else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+static unsigned long long xgetbv0(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+static enum cpu_simd detect(void) {
+    unsigned r[4];
+    cpuid(0, 0, r);
+    unsigned max_leaf = r[0];
+    cpuid(1, 0, r);
+    int sse2 = (r[3] >> 26) & 1;
+    int osxsave = (r[2] >> 27) & 1;
+    if (!sse2) return CPU_SIMD_NONE;
+    if (!osxsave || max_leaf < 7) return CPU_SIMD_SSE2;
+
+    unsigned long long xcr0 = xgetbv0();
+    int ymm_ok = (xcr0 & 0x6) == 0x6;       // XMM and YMM state
+    int zmm_ok = (xcr0 & 0xE6) == 0xE6;     // plus opmask and ZMM state
+    cpuid(7, 0, r);
+    int avx2 = (r[1] >> 5) & 1;
+    int avx512f = (r[1] >> 16) & 1;
+
+    if (avx512f && zmm_ok) return CPU_SIMD_AVX512;
+    if (avx2 && ymm_ok) return CPU_SIMD_AVX2;
+    return CPU_SIMD_SSE2;
+}
+#endif
+
+enum cpu_simd cpu_simd_level(void) {
+#ifdef ZT_X86
+    // Racing first callers compute and store the same value.
+    static int level = -1;
+    if (level < 0) level = (int)detect();
+    return (enum cpu_simd)level;
+#else
+    return CPU_SIMD_NONE;
+#endif
+}
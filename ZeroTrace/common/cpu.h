@@ -0,0 +1,29 @@
+// cpu.h
+// Runtime CPU feature detection shared by the SIMD kernels in common/.
+
+#ifndef ZT_CPU_H
+#define ZT_CPU_H
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ZT_X86 1
+// Every kernel, SSE2 included, is compiled for its own extension and only
+// called once cpu_simd_level() reports it: i686 has no SSE2 baseline.
+#if defined(_MSC_VER)
+#define ZT_TARGET(x)
+#else
+#define ZT_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+enum cpu_simd {
+    CPU_SIMD_NONE,
+    CPU_SIMD_SSE2,
+    CPU_SIMD_AVX2,
+    CPU_SIMD_AVX512,     // AVX-512F
+};
+
+// Widest vector extension both the CPU and the OS support. Always
+// CPU_SIMD_NONE on non-x86 builds.
+enum cpu_simd cpu_simd_level(void);
+
+#endif
@@ -0,0 +1,499 @@
+// digest.c
+// BLAKE3: the compression function, chunk and parent nodes, and the
+// chaining-value stack that joins subtrees in order. Whole chunks inside a
+// subtree are hashed several at a time by SSE2 (4), AVX2 (8) or AVX-512
+// (16) kernels picked at run time, one chunk per vector lane.
+
+#include <string.h>
+
+#include "digest.h"
+#include "cpu.h"
+
+#ifdef ZT_X86
+#include <immintrin.h>
+#endif
+
+#define BLOCK_LEN 64
+
+enum {
+    CHUNK_START = 1 << 0,
+    CHUNK_END = 1 << 1,
+    PARENT = 1 << 2,
+    ROOT = 1 << 3,
+    KEYED_HASH = 1 << 4,
+};
+
+static const uint32_t IV[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+// Message word order for each of the seven rounds: the permutation
+// applied again and again.
+static const unsigned char SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+#define ROTR32(v, n) (((v) >> (n)) | ((v) << (32 - (n))))
+
+#define G(a, b, c, d, x, y)                                  \
+    s[a] += s[b] + (x); s[d] = ROTR32(s[d] ^ s[a], 16);      \
+    s[c] += s[d];       s[b] = ROTR32(s[b] ^ s[c], 12);      \
+    s[a] += s[b] + (y); s[d] = ROTR32(s[d] ^ s[a], 8);       \
+    s[c] += s[d];       s[b] = ROTR32(s[b] ^ s[c], 7)
+
+// One round over a state of 16 words or vectors, message words m in the
+// order of round r; G must be defined for the state's type.
+#define ROUND(m, r)                                                           \
+    G(0, 4, 8, 12, m[SCHEDULE[r][0]], m[SCHEDULE[r][1]]);                     \
+    G(1, 5, 9, 13, m[SCHEDULE[r][2]], m[SCHEDULE[r][3]]);                     \
+    G(2, 6, 10, 14, m[SCHEDULE[r][4]], m[SCHEDULE[r][5]]);                    \
+    G(3, 7, 11, 15, m[SCHEDULE[r][6]], m[SCHEDULE[r][7]]);                    \
+    G(0, 5, 10, 15, m[SCHEDULE[r][8]], m[SCHEDULE[r][9]]);                    \
+    G(1, 6, 11, 12, m[SCHEDULE[r][10]], m[SCHEDULE[r][11]]);                  \
+    G(2, 7, 8, 13, m[SCHEDULE[r][12]], m[SCHEDULE[r][13]]);                   \
+    G(3, 4, 9, 14, m[SCHEDULE[r][14]], m[SCHEDULE[r][15]])
+
+static uint32_t load32_le(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void store32_le(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+// The full 16-word output of one compression.
+static void compress(const uint32_t cv[8], const unsigned char block[BLOCK_LEN], unsigned long long counter,
+                     unsigned block_len, unsigned flags, uint32_t out[16]) {
+    uint32_t m[16], s[16];
+    for (int i = 0; i < 16; i++) m[i] = load32_le(block + 4 * i);
+    for (int i = 0; i < 8; i++) s[i] = cv[i];
+    for (int i = 0; i < 4; i++) s[8 + i] = IV[i];
+    s[12] = (uint32_t)counter;
+    s[13] = (uint32_t)(counter >> 32);
+    s[14] = block_len;
+    s[15] = flags;
+    for (int r = 0; r < 7; r++) {
+        ROUND(m, r);
+    }
+    for (int i = 0; i < 8; i++) {
+        out[i] = s[i] ^ s[i + 8];
+        out[i + 8] = s[i + 8] ^ cv[i];
+    }
+}
+
+// A node not yet compressed: enough to produce either its chaining value
+// or, for the root, the digest.
+struct node {
+    uint32_t cv[8];
+    unsigned char block[BLOCK_LEN];
+    unsigned long long counter;
+    unsigned block_len;
+    unsigned flags;
+};
+
+static void node_cv(const struct node *n, uint32_t cv[8]) {
+    uint32_t out[16];
+    compress(n->cv, n->block, n->counter, n->block_len, n->flags, out);
+    memcpy(cv, out, 8 * sizeof(uint32_t));
+}
+
+static void parent_node(struct node *n, const uint32_t left[8], const uint32_t right[8], const uint32_t key[8],
+                        unsigned flags) {
+    memcpy(n->cv, key, sizeof(n->cv));
+    for (int i = 0; i < 8; i++) {
+        store32_le(n->block + 4 * i, left[i]);
+        store32_le(n->block + 32 + 4 * i, right[i]);
+    }
+    n->counter = 0;
+    n->block_len = BLOCK_LEN;
+    n->flags = flags | PARENT;
+}
+
+static void parent_cv(const uint32_t left[8], const uint32_t right[8], const uint32_t key[8], unsigned flags,
+                      uint32_t cv[8]) {
+    struct node n;
+    parent_node(&n, left, right, key, flags);
+    node_cv(&n, cv);
+}
+
+static void chunk_init(struct digest_chunk *c, const uint32_t key[8], unsigned long long counter) {
+    memcpy(c->cv, key, sizeof(c->cv));
+    c->counter = counter;
+    c->block_len = 0;
+    c->blocks = 0;
+}
+
+static size_t chunk_len(const struct digest_chunk *c) {
+    return (size_t)c->blocks * BLOCK_LEN + c->block_len;
+}
+
+static unsigned chunk_start(const struct digest_chunk *c) {
+    return c->blocks ? 0 : CHUNK_START;
+}
+
+// Take in up to the rest of the chunk; the last block stays buffered, since
+// only the chunk's end knows its flags.
+static size_t chunk_update(struct digest_chunk *c, unsigned flags, const unsigned char *p, size_t len) {
+    size_t take = DIGEST_CHUNK - chunk_len(c);
+    if (take > len) take = len;
+    size_t left = take;
+    while (left) {
+        if (c->block_len == BLOCK_LEN) {
+            uint32_t out[16];
+            compress(c->cv, c->block, c->counter, BLOCK_LEN, flags | chunk_start(c), out);
+            memcpy(c->cv, out, sizeof(c->cv));
+            c->blocks++;
+            c->block_len = 0;
+        }
+        size_t n = BLOCK_LEN - c->block_len;
+        if (n > left) n = left;
+        memcpy(c->block + c->block_len, p, n);
+        c->block_len += (unsigned)n;
+        p += n;
+        left -= n;
+    }
+    return take;
+}
+
+static void chunk_node(const struct digest_chunk *c, unsigned flags, struct node *n) {
+    memcpy(n->cv, c->cv, sizeof(n->cv));
+    memset(n->block, 0, sizeof(n->block));
+    memcpy(n->block, c->block, c->block_len);
+    n->counter = c->counter;
+    n->block_len = c->block_len;
+    n->flags = flags | chunk_start(c) | CHUNK_END;
+}
+
+static void init(struct digest *d, const uint32_t key[8], unsigned flags) {
+    memcpy(d->key, key, sizeof(d->key));
+    d->flags = flags;
+    d->depth = 0;
+    chunk_init(&d->chunk, d->key, 0);
+}
+
+void digest_init(struct digest *d) {
+    init(d, IV, 0);
+}
+
+void digest_init_keyed(struct digest *d, const unsigned char key[DIGEST_KEY_SIZE]) {
+    uint32_t k[8];
+    for (int i = 0; i < 8; i++) k[i] = load32_le(key + 4 * i);
+    init(d, k, KEYED_HASH);
+}
+
+// A subtree of 2^levels chunks ending at chunk `total` joins the stack,
+// merging with every finished sibling below it.
+static void push_cv(struct digest *d, const uint32_t cv[8], unsigned long long total, unsigned levels) {
+    uint32_t v[8];
+    memcpy(v, cv, sizeof(v));
+    total >>= levels;
+    while ((total & 1) == 0) {
+        parent_cv(d->stack[--d->depth], v, d->key, d->flags, v);
+        total >>= 1;
+    }
+    memcpy(d->stack[d->depth++], v, sizeof(v));
+}
+
+// A chunk completed by digest_update stays open until more data arrives.
+static void close_chunk(struct digest *d) {
+    struct node n;
+    uint32_t cv[8];
+    chunk_node(&d->chunk, d->flags, &n);
+    node_cv(&n, cv);
+    unsigned long long total = d->chunk.counter + 1;
+    push_cv(d, cv, total, 0);
+    chunk_init(&d->chunk, d->key, total);
+}
+
+void digest_update(struct digest *d, const void *data, size_t len) {
+    const unsigned char *p = data;
+    while (len) {
+        // A full chunk is only closed once more input shows it is not the last.
+        if (chunk_len(&d->chunk) == DIGEST_CHUNK) close_chunk(d);
+        size_t n = chunk_update(&d->chunk, d->flags, p, len);
+        p += n;
+        len -= n;
+    }
+}
+
+void digest_final(const struct digest *d, unsigned char out[DIGEST_SIZE]) {
+    struct node n;
+    uint32_t cv[8], words[16];
+    chunk_node(&d->chunk, d->flags, &n);
+    for (unsigned i = d->depth; i > 0; i--) {
+        node_cv(&n, cv);
+        parent_node(&n, d->stack[i - 1], cv, d->key, d->flags);
+    }
+    compress(n.cv, n.block, 0, n.block_len, n.flags | ROOT, words);
+    for (int i = 0; i < 8; i++) store32_le(out + 4 * i, words[i]);
+}
+
+// ---------------------------------------------------------------------------
+// Many whole chunks at once, for subtrees: chaining values of n consecutive
+// unkeyed chunks starting at chunk `counter`.
+
+typedef void (*chunks_fn)(const unsigned char *data, unsigned long long counter, size_t n, uint32_t (*cv)[8]);
+
+static void scalar_chunks(const unsigned char *data, unsigned long long counter, size_t n, uint32_t (*cv)[8]) {
+    for (size_t c = 0; c < n; c++) {
+        uint32_t h[8], out[16];
+        memcpy(h, IV, sizeof(h));
+        for (unsigned b = 0; b < DIGEST_CHUNK / BLOCK_LEN; b++) {
+            unsigned flags = (b == 0 ? CHUNK_START : 0) | (b == DIGEST_CHUNK / BLOCK_LEN - 1 ? CHUNK_END : 0);
+            compress(h, data + c * DIGEST_CHUNK + b * BLOCK_LEN, counter + c, BLOCK_LEN, flags, out);
+            memcpy(h, out, sizeof(h));
+        }
+        memcpy(cv[c], h, sizeof(h));
+    }
+}
+
+#ifdef ZT_X86
+// Message words of block b of `lanes` consecutive chunks, word-major:
+// w[i][l] is word i of chunk l.
+static void gather_block(const unsigned char *data, unsigned lanes, unsigned b, uint32_t w[16][16]) {
+    for (unsigned l = 0; l < lanes; l++) {
+        const unsigned char *p = data + l * DIGEST_CHUNK + b * BLOCK_LEN;
+        for (int i = 0; i < 16; i++) w[i][l] = load32_le(p + 4 * i);
+    }
+}
+
+static unsigned block_flags(unsigned b) {
+    return (b == 0 ? CHUNK_START : 0) | (b == DIGEST_CHUNK / BLOCK_LEN - 1 ? CHUNK_END : 0);
+}
+
+#undef G
+
+// ---------------------------------------------------------------------------
+// SSE2: four chunks per iteration.
+
+#define SSE_ROTR(v, n) _mm_or_si128(_mm_srli_epi32(v, n), _mm_slli_epi32(v, 32 - (n)))
+#define G(a, b, c, d, x, y)                                                                   \
+    s[a] = _mm_add_epi32(_mm_add_epi32(s[a], s[b]), x); s[d] = SSE_ROTR(_mm_xor_si128(s[d], s[a]), 16); \
+    s[c] = _mm_add_epi32(s[c], s[d]); s[b] = SSE_ROTR(_mm_xor_si128(s[b], s[c]), 12);                  \
+    s[a] = _mm_add_epi32(_mm_add_epi32(s[a], s[b]), y); s[d] = SSE_ROTR(_mm_xor_si128(s[d], s[a]), 8);  \
+    s[c] = _mm_add_epi32(s[c], s[d]); s[b] = SSE_ROTR(_mm_xor_si128(s[b], s[c]), 7)
+
+ZT_TARGET("sse2")
+static void sse2_chunks(const unsigned char *data, unsigned long long counter, size_t n, uint32_t (*cv)[8]) {
+    while (n >= 4) {
+        __m128i h[8], m[16], s[16];
+        uint32_t w[16][16], lo[4], hi[4];
+        for (int l = 0; l < 4; l++) {
+            lo[l] = (uint32_t)(counter + l);
+            hi[l] = (uint32_t)((counter + l) >> 32);
+        }
+        const __m128i ctr_lo = _mm_loadu_si128((const __m128i *)lo);
+        const __m128i ctr_hi = _mm_loadu_si128((const __m128i *)hi);
+        for (int i = 0; i < 8; i++) h[i] = _mm_set1_epi32((int)IV[i]);
+        for (unsigned b = 0; b < DIGEST_CHUNK / BLOCK_LEN; b++) {
+            gather_block(data, 4, b, w);
+            for (int i = 0; i < 16; i++) m[i] = _mm_loadu_si128((const __m128i *)w[i]);
+            for (int i = 0; i < 8; i++) s[i] = h[i];
+            for (int i = 0; i < 4; i++) s[8 + i] = _mm_set1_epi32((int)IV[i]);
+            s[12] = ctr_lo;
+            s[13] = ctr_hi;
+            s[14] = _mm_set1_epi32(BLOCK_LEN);
+            s[15] = _mm_set1_epi32((int)block_flags(b));
+            for (int r = 0; r < 7; r++) {
+                ROUND(m, r);
+            }
+            for (int i = 0; i < 8; i++) h[i] = _mm_xor_si128(s[i], s[i + 8]);
+        }
+        for (int i = 0; i < 8; i++) _mm_storeu_si128((__m128i *)w[i], h[i]);
+        for (int l = 0; l < 4; l++) {
+            for (int i = 0; i < 8; i++) cv[l][i] = w[i][l];
+        }
+        data += 4 * DIGEST_CHUNK;
+        counter += 4;
+        cv += 4;
+        n -= 4;
+    }
+    scalar_chunks(data, counter, n, cv);
+}
+
+#undef G
+
+// ---------------------------------------------------------------------------
+// AVX2: eight chunks per iteration. The 16- and 8-bit rotations are byte
+// shuffles.
+
+#define AVX_ROTR(v, n) _mm256_or_si256(_mm256_srli_epi32(v, n), _mm256_slli_epi32(v, 32 - (n)))
+#define G(a, b, c, d, x, y)                                                                            \
+    s[a] = _mm256_add_epi32(_mm256_add_epi32(s[a], s[b]), x); s[d] = _mm256_shuffle_epi8(_mm256_xor_si256(s[d], s[a]), rot16); \
+    s[c] = _mm256_add_epi32(s[c], s[d]); s[b] = AVX_ROTR(_mm256_xor_si256(s[b], s[c]), 12);                              \
+    s[a] = _mm256_add_epi32(_mm256_add_epi32(s[a], s[b]), y); s[d] = _mm256_shuffle_epi8(_mm256_xor_si256(s[d], s[a]), rot8);  \
+    s[c] = _mm256_add_epi32(s[c], s[d]); s[b] = AVX_ROTR(_mm256_xor_si256(s[b], s[c]), 7)
+
+ZT_TARGET("avx2")
+static void avx2_chunks(const unsigned char *data, unsigned long long counter, size_t n, uint32_t (*cv)[8]) {
+    const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                           2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i rot8 = _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+                                          1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    while (n >= 8) {
+        __m256i h[8], m[16], s[16];
+        uint32_t w[16][16], lo[8], hi[8];
+        for (int l = 0; l < 8; l++) {
+            lo[l] = (uint32_t)(counter + l);
+            hi[l] = (uint32_t)((counter + l) >> 32);
+        }
+        const __m256i ctr_lo = _mm256_loadu_si256((const __m256i *)lo);
+        const __m256i ctr_hi = _mm256_loadu_si256((const __m256i *)hi);
+        for (int i = 0; i < 8; i++) h[i] = _mm256_set1_epi32((int)IV[i]);
+        for (unsigned b = 0; b < DIGEST_CHUNK / BLOCK_LEN; b++) {
+            gather_block(data, 8, b, w);
+            for (int i = 0; i < 16; i++) m[i] = _mm256_loadu_si256((const __m256i *)w[i]);
+            for (int i = 0; i < 8; i++) s[i] = h[i];
+            for (int i = 0; i < 4; i++) s[8 + i] = _mm256_set1_epi32((int)IV[i]);
+            s[12] = ctr_lo;
+            s[13] = ctr_hi;
+            s[14] = _mm256_set1_epi32(BLOCK_LEN);
+            s[15] = _mm256_set1_epi32((int)block_flags(b));
+            for (int r = 0; r < 7; r++) {
+                ROUND(m, r);
+            }
+            for (int i = 0; i < 8; i++) h[i] = _mm256_xor_si256(s[i], s[i + 8]);
+        }
+        for (int i = 0; i < 8; i++) _mm256_storeu_si256((__m256i *)w[i], h[i]);
+        for (int l = 0; l < 8; l++) {
+            for (int i = 0; i < 8; i++) cv[l][i] = w[i][l];
+        }
+        data += 8 * DIGEST_CHUNK;
+        counter += 8;
+        cv += 8;
+        n -= 8;
+    }
+    sse2_chunks(data, counter, n, cv);
+}
+
+#undef G
+
+// ---------------------------------------------------------------------------
+// AVX-512F: sixteen chunks per iteration, with native rotates.
+
+#define G(a, b, c, d, x, y)                                                                               \
+    s[a] = _mm512_add_epi32(_mm512_add_epi32(s[a], s[b]), x); s[d] = _mm512_ror_epi32(_mm512_xor_si512(s[d], s[a]), 16); \
+    s[c] = _mm512_add_epi32(s[c], s[d]); s[b] = _mm512_ror_epi32(_mm512_xor_si512(s[b], s[c]), 12);                     \
+    s[a] = _mm512_add_epi32(_mm512_add_epi32(s[a], s[b]), y); s[d] = _mm512_ror_epi32(_mm512_xor_si512(s[d], s[a]), 8);  \
+    s[c] = _mm512_add_epi32(s[c], s[d]); s[b] = _mm512_ror_epi32(_mm512_xor_si512(s[b], s[c]), 7)
+
+ZT_TARGET("avx512f")
+static void avx512_chunks(const unsigned char *data, unsigned long long counter, size_t n, uint32_t (*cv)[8]) {
+    while (n >= 16) {
+        __m512i h[8], m[16], s[16];
+        uint32_t w[16][16], lo[16], hi[16];
+        for (int l = 0; l < 16; l++) {
+            lo[l] = (uint32_t)(counter + l);
+            hi[l] = (uint32_t)((counter + l) >> 32);
+        }
+        const __m512i ctr_lo = _mm512_loadu_si512((const void *)lo);
+        const __m512i ctr_hi = _mm512_loadu_si512((const void *)hi);
+        for (int i = 0; i < 8; i++) h[i] = _mm512_set1_epi32((int)IV[i]);
+        for (unsigned b = 0; b < DIGEST_CHUNK / BLOCK_LEN; b++) {
+            gather_block(data, 16, b, w);
+            for (int i = 0; i < 16; i++) m[i] = _mm512_loadu_si512((const void *)w[i]);
+            for (int i = 0; i < 8; i++) s[i] = h[i];
+            for (int i = 0; i < 4; i++) s[8 + i] = _mm512_set1_epi32((int)IV[i]);
+            s[12] = ctr_lo;
+            s[13] = ctr_hi;
+            s[14] = _mm512_set1_epi32(BLOCK_LEN);
+            s[15] = _mm512_set1_epi32((int)block_flags(b));
+            for (int r = 0; r < 7; r++) {
+                ROUND(m, r);
+            }
+            for (int i = 0; i < 8; i++) h[i] = _mm512_xor_si512(s[i], s[i + 8]);
+        }
+        for (int i = 0; i < 8; i++) _mm512_storeu_si512((void *)w[i], h[i]);
+        for (int l = 0; l < 16; l++) {
+            for (int i = 0; i < 8; i++) cv[l][i] = w[i][l];
+        }
+        data += 16 * DIGEST_CHUNK;
+        counter += 16;
+        cv += 16;
+        n -= 16;
+    }
+    avx2_chunks(data, counter, n, cv);
+}
+#endif
+
+static chunks_fn impl_chunks;
+static const char *impl_name = "scalar";
+
+static chunks_fn resolve(void) {
+    chunks_fn fn = scalar_chunks;
+    const char *name = "scalar";
+#ifdef ZT_X86
+    enum cpu_simd level = cpu_simd_level();
+    if (level == CPU_SIMD_AVX512) {
+        fn = avx512_chunks;
+        name = "avx512";
+    } else if (level == CPU_SIMD_AVX2) {
+        fn = avx2_chunks;
+        name = "avx2";
+    } else if (level == CPU_SIMD_SSE2) {
+        fn = sse2_chunks;
+        name = "sse2";
+    }
+#endif
+    impl_name = name;
+    impl_chunks = fn;
+    return fn;
+}
+
+const char *digest_impl(void) {
+    if (!impl_chunks) resolve();
+    return impl_name;
+}
+
+// Chunks hashed per batch; their chaining values are then paired up.
+#define BATCH_CHUNKS 64
+
+void digest_subtree(const void *data, size_t len, unsigned long long offset, uint32_t cv[8]) {
+    size_t n = len / DIGEST_CHUNK;
+    if (n <= BATCH_CHUNKS) {
+        chunks_fn chunks = impl_chunks ? impl_chunks : resolve();
+        uint32_t cvs[BATCH_CHUNKS][8];
+        chunks(data, offset / DIGEST_CHUNK, n, cvs);
+        for (; n > 1; n /= 2) {
+            for (size_t i = 0; i < n / 2; i++) parent_cv(cvs[2 * i], cvs[2 * i + 1], IV, 0, cvs[i]);
+        }
+        memcpy(cv, cvs[0], sizeof(cvs[0]));
+        return;
+    }
+    uint32_t left[8], right[8];
+    size_t half = len / 2;
+    digest_subtree(data, half, offset, left);
+    digest_subtree((const unsigned char *)data + half, half, offset + half, right);
+    parent_cv(left, right, IV, 0, cv);
+}
+
+void digest_push(struct digest *d, const uint32_t cv[8], size_t len) {
+    if (chunk_len(&d->chunk) == DIGEST_CHUNK) close_chunk(d);
+    unsigned levels = 0;
+    while (((size_t)DIGEST_CHUNK << levels) < len) levels++;
+    unsigned long long total = d->chunk.counter + (len / DIGEST_CHUNK);
+    push_cv(d, cv, total, levels);
+    chunk_init(&d->chunk, d->key, total);
+}
+
+unsigned long long digest_length(const struct digest *d) {
+    return d->chunk.counter * DIGEST_CHUNK + chunk_len(&d->chunk);
+}
+
+void digest_hex(const unsigned char d[DIGEST_SIZE], char out[2 * DIGEST_SIZE + 1]) {
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < DIGEST_SIZE; i++) {
+        out[2 * i] = hex[d[i] >> 4];
+        out[2 * i + 1] = hex[d[i] & 15];
+    }
+    out[2 * DIGEST_SIZE] = 0;
+}
@@ -0,0 +1,59 @@
+// digest.h
+// BLAKE3 for wipe evidence. BLAKE3 is a tree hash over 1 KiB chunks: any
+// aligned, power-of-two run of chunks can be hashed on its own into a
+// subtree value, and the subtree values combined in order later. So the
+// requests of a verify pass can be hashed by several threads as they land,
+// and the result is still the plain BLAKE3 of the range - what b3sum prints
+// for an image of it.
+
+#ifndef ZT_DIGEST_H
+#define ZT_DIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DIGEST_SIZE 32
+#define DIGEST_KEY_SIZE 32
+#define DIGEST_CHUNK 1024
+
+struct digest_chunk {
+    uint32_t cv[8];
+    unsigned long long counter;
+    unsigned char block[64];
+    unsigned block_len;
+    unsigned blocks;
+};
+
+// Incremental hasher. The stack holds the subtrees finished so far, one
+// per set bit of the chunk count at most.
+struct digest {
+    uint32_t key[8];
+    unsigned flags;
+    struct digest_chunk chunk;
+    uint32_t stack[54][8];
+    unsigned depth;
+};
+
+void digest_init(struct digest *d);
+// Keyed mode: a MAC under key.
+void digest_init_keyed(struct digest *d, const unsigned char key[DIGEST_KEY_SIZE]);
+void digest_update(struct digest *d, const void *data, size_t len);
+void digest_final(const struct digest *d, unsigned char out[DIGEST_SIZE]);
+
+// Subtree value of len bytes at offset in the stream, for unkeyed hashing.
+// len must be DIGEST_CHUNK times a power of two and offset a multiple of
+// len, and more data must follow it in the stream.
+void digest_subtree(const void *data, size_t len, unsigned long long offset, uint32_t cv[8]);
+// Append a subtree value of len bytes to d, whose length must be a
+// multiple of len.
+void digest_push(struct digest *d, const uint32_t cv[8], size_t len);
+// Bytes taken in so far.
+unsigned long long digest_length(const struct digest *d);
+
+// Name of the multi-chunk kernel in use: "avx512", "avx2", "sse2" or "scalar".
+const char *digest_impl(void);
+
+// 64 lowercase hex digits plus NUL.
+void digest_hex(const unsigned char d[DIGEST_SIZE], char out[2 * DIGEST_SIZE + 1]);
+
+#endif
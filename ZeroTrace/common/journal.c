@@ -0,0 +1,224 @@
+// journal.c
+// Crash-consistent checkpoint file shared by the Linux and Windows wipers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <winioctl.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "journal.h"
+
+#define JOURNAL_MAGIC "zerotrace-journal 1"
+
+static volatile int interrupted;
+
+void journal_default_path(char *out, size_t n, const char *device, const char *serial) {
+    const char *id = serial && serial[0] ? serial : device;
+    size_t pos = (size_t)snprintf(out, n, "zerotrace-");
+    for (const char *p = id; *p && pos + 1 < n; p++) {
+        char c = *p;
+        int ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '.';
+        // Leading path separators add nothing but underscores.
+        if (!ok && pos == 10) continue;
+        out[pos++] = ok ? c : '_';
+    }
+    out[pos < n ? pos : n - 1] = 0;
+    strncat(out, ".journal", n - strlen(out) - 1);
+}
+
+// Copy a value into dst, dropping the newline and anything that would.
+static void copy_line(char *dst, size_t n, const char *src) {
+    size_t i = 0;
+    for (; src[i] && src[i] != '\r' && src[i] != '\n' && i + 1 < n; i++) dst[i] = src[i];
+    dst[i] = 0;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int journal_load(struct journal *j) {
+    char path[JOURNAL_PATH_MAX];
+    memcpy(path, j->path, sizeof(path));
+    FILE *f = fopen(path, "r");
+    if (!f) return 1;
+
+    memset(j, 0, sizeof(*j));
+    memcpy(j->path, path, sizeof(path));
+    char line[512];
+    int ok = fgets(line, sizeof(line), f) && strncmp(line, JOURNAL_MAGIC, strlen(JOURNAL_MAGIC)) == 0;
+    int have_end = 0;
+    while (ok && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = 0;
+        char *v = strchr(line, ' ');
+        if (v) *v++ = 0;
+        else v = line + strlen(line);
+        if (strcmp(line, "device") == 0) copy_line(j->device, sizeof(j->device), v);
+        else if (strcmp(line, "serial") == 0) copy_line(j->serial, sizeof(j->serial), v);
+        else if (strcmp(line, "size") == 0) j->size = strtoull(v, NULL, 10);
+        else if (strcmp(line, "pass") == 0) j->pass = atoi(v);
+        else if (strcmp(line, "offset") == 0) j->offset = strtoull(v, NULL, 10);
+        else if (strcmp(line, "key") == 0 && v[0] != '-') {
+            for (int i = 0; i < PATTERN_KEY_SIZE; i++) {
+                int hi = hex_value(v[2 * i]), lo = hi < 0 ? -1 : hex_value(v[2 * i + 1]);
+                if (lo < 0) {
+                    ok = 0;
+                    break;
+                }
+                j->key.bytes[i] = (unsigned char)(hi << 4 | lo);
+            }
+            j->has_key = ok;
+        } else if (strcmp(line, "end") == 0) {
+            have_end = 1;
+        }
+    }
+    fclose(f);
+    // The closing line guards against a file cut short by hand or by a
+    // filesystem that lost the tail of a rename's source.
+    if (!ok || !have_end || j->pass < 1) {
+        fprintf(stderr, "Journal %s is damaged; remove it to start over\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int journal_save(const struct journal *j) {
+    char tmp[JOURNAL_PATH_MAX + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", j->path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "Cannot write journal %s\n", tmp);
+        return -1;
+    }
+    char hex[2 * PATTERN_KEY_SIZE + 1] = "-";
+    if (j->has_key) pattern_key_hex(&j->key, hex);
+    fprintf(f, "%s\ndevice %s\nsize %llu\nserial %s\npass %d\noffset %llu\nkey %s\nend\n",
+            JOURNAL_MAGIC, j->device, j->size, j->serial, j->pass, j->offset, hex);
+
+    int rc = fflush(f);
+#if defined(_WIN32)
+    if (rc == 0) rc = _commit(_fileno(f));
+#else
+    if (rc == 0) rc = fsync(fileno(f));
+#endif
+    if (fclose(f) != 0) rc = -1;
+    if (rc != 0) {
+        fprintf(stderr, "Cannot flush journal %s\n", tmp);
+        remove(tmp);
+        return -1;
+    }
+
+#if defined(_WIN32)
+    if (!MoveFileExA(tmp, j->path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        fprintf(stderr, "Cannot replace journal %s (err=%lu)\n", j->path, GetLastError());
+        return -1;
+    }
+#else
+    if (rename(tmp, j->path) != 0) {
+        fprintf(stderr, "Cannot replace journal %s: %s\n", j->path, strerror(errno));
+        return -1;
+    }
+    // The rename itself is only durable once the directory is.
+    char dir[JOURNAL_PATH_MAX];
+    const char *slash = strrchr(j->path, '/');
+    if (slash) snprintf(dir, sizeof(dir), "%.*s", (int)(slash - j->path + 1), j->path);
+    else snprintf(dir, sizeof(dir), ".");
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+#endif
+    return 0;
+}
+
+void journal_remove(const struct journal *j) {
+    remove(j->path);
+}
+
+int journal_matches(const struct journal *j, unsigned long long size, const char *serial) {
+    return j->size == size && strcmp(j->serial, serial ? serial : "") == 0;
+}
+
+#if defined(_WIN32)
+static void on_signal(int sig) {
+    interrupted = 1;
+    signal(sig, on_signal);
+}
+
+static BOOL WINAPI on_console(DWORD type) {
+    if (type == CTRL_C_EVENT || type == CTRL_BREAK_EVENT || type == CTRL_CLOSE_EVENT) {
+        interrupted = 1;
+        // Closing the console kills the process once this returns; give the
+        // wipe loop a moment to reach its checkpoint.
+        if (type == CTRL_CLOSE_EVENT) Sleep(5000);
+        return TRUE;
+    }
+    return FALSE;
+}
+#else
+static void on_signal(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+#endif
+
+void journal_catch_signals(void) {
+#if defined(_WIN32)
+    SetConsoleCtrlHandler(on_console, TRUE);
+    signal(SIGTERM, on_signal);
+#else
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+#endif
+}
+
+int journal_interrupted(void) {
+    return interrupted;
+}
+
+volatile int *journal_interrupt_flag(void) {
+    return &interrupted;
+}
+
+#if defined(_WIN32)
+void journal_drive_identity(HANDLE h, unsigned long long *size, char *serial, size_t n) {
+    DWORD bytes = 0;
+    GET_LENGTH_INFORMATION len;
+    *size = 0;
+    serial[0] = 0;
+    if (DeviceIoControl(h, IOCTL_DISK_GET_LENGTH_INFO, NULL, 0, &len, sizeof(len), &bytes, NULL))
+        *size = (unsigned long long)len.Length.QuadPart;
+
+    STORAGE_PROPERTY_QUERY q;
+    BYTE buf[1024];
+    memset(&q, 0, sizeof(q));
+    q.PropertyId = StorageDeviceProperty;
+    q.QueryType = PropertyStandardQuery;
+    if (!DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &q, sizeof(q), buf, sizeof(buf), &bytes, NULL)) return;
+    const STORAGE_DEVICE_DESCRIPTOR *d = (const STORAGE_DEVICE_DESCRIPTOR *)buf;
+    if (d->SerialNumberOffset == 0 || d->SerialNumberOffset >= bytes) return;
+    // Drivers pad the serial with spaces on either side.
+    const char *s = (const char *)buf + d->SerialNumberOffset;
+    while (*s == ' ') s++;
+    copy_line(serial, n, s);
+    size_t l = strlen(serial);
+    while (l && serial[l - 1] == ' ') serial[--l] = 0;
+}
+#endif
@@ -0,0 +1,58 @@
+// journal.h
+// Checkpoint journal for long wipes. A small text file kept off the device
+// records which pass is running, how far that pass is durable, the pass's
+// pattern key and the device's identity, so an interrupted wipe can resume
+// instead of starting again from pass 1, offset 0. Every save replaces the
+// file atomically (write a temporary copy, flush it, rename it over the
+// old one), so a crash leaves either the previous checkpoint or the new one.
+
+#ifndef ZT_JOURNAL_H
+#define ZT_JOURNAL_H
+
+#include "pattern.h"
+
+#define JOURNAL_PATH_MAX 512
+
+struct journal {
+    char path[JOURNAL_PATH_MAX];    // where the journal lives
+    char device[256];               // device path, for the humans reading it
+    unsigned long long size;        // device identity: size in bytes ...
+    char serial[128];               // ... and serial number ("" if unknown)
+    int pass;                       // pass in progress, 1-based
+    unsigned long long offset;      // everything below is durable for this pass
+    int has_key;                    // pass writes random data from key
+    struct pattern_key key;
+};
+
+// Default journal path for a device: "zerotrace-<serial or device>.journal"
+// in the current directory, with anything unsafe in a file name replaced.
+void journal_default_path(char *out, size_t n, const char *device, const char *serial);
+
+// Read j->path into j. Returns 0 when loaded, 1 when there is no journal,
+// -1 when it exists but cannot be parsed (reported).
+int journal_load(struct journal *j);
+
+// Atomically replace j->path with j. Returns 0, or -1 (reported).
+int journal_save(const struct journal *j);
+
+void journal_remove(const struct journal *j);
+
+// Nonzero when j was written for a device of this size and serial.
+int journal_matches(const struct journal *j, unsigned long long size, const char *serial);
+
+// Catch SIGINT/SIGTERM (and console close on Windows) so a wipe can stop at
+// its next checkpoint instead of dying mid-pass. journal_interrupted()
+// reports whether one arrived.
+void journal_catch_signals(void);
+int journal_interrupted(void);
+// Address of the flag, for loops that poll it directly.
+volatile int *journal_interrupt_flag(void);
+
+#if defined(_WIN32)
+#include <windows.h>
+// Size and serial number of an open physical drive. Either may come back
+// empty (0 / "") when the driver does not report it.
+void journal_drive_identity(HANDLE h, unsigned long long *size, char *serial, size_t n);
+#endif
+
+#endif
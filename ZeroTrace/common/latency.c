@@ -0,0 +1,238 @@
+// latency.c
+// Latency histograms and region heatmaps shared by the Linux and Windows wipers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "latency.h"
+
+// A region is suspect when it is served this many times slower than the
+// median region, or when any request in it took longer than STALL_NS.
+#define SLOW_FACTOR 3.0
+#define STALL_NS 1000000000ULL
+#define HEATMAP_COLUMNS 64
+#define HISTOGRAM_WIDTH 40
+
+#if defined(_WIN32)
+unsigned long long lat_now_ns(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (unsigned long long)(now.QuadPart / freq.QuadPart * 1000000000ULL +
+                                now.QuadPart % freq.QuadPart * 1000000000ULL / freq.QuadPart);
+}
+
+static void add(unsigned long long *p, unsigned long long n) {
+    InterlockedExchangeAdd64((volatile LONG64 *)p, (LONG64)n);
+}
+
+static void raise_max(unsigned long long *p, unsigned long long v) {
+    LONG64 cur = *(volatile LONG64 *)p;
+    while ((unsigned long long)cur < v) {
+        LONG64 seen = InterlockedCompareExchange64((volatile LONG64 *)p, (LONG64)v, cur);
+        if (seen == cur) break;
+        cur = seen;
+    }
+}
+
+static int load_count(const int *p) {
+    return *(volatile const int *)p;
+}
+
+static void publish_count(int *p, int v) {
+    MemoryBarrier();
+    *(volatile int *)p = v;
+}
+#else
+unsigned long long lat_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static void add(unsigned long long *p, unsigned long long n) {
+    __atomic_fetch_add(p, n, __ATOMIC_RELAXED);
+}
+
+static void raise_max(unsigned long long *p, unsigned long long v) {
+    unsigned long long cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (cur < v && !__atomic_compare_exchange_n(p, &cur, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static int load_count(const int *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void publish_count(int *p, int v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+#endif
+
+struct lat_log *lat_log_new(const char *device, unsigned long long size, unsigned long long region) {
+    struct lat_log *l = calloc(1, sizeof(*l));
+    if (!l) return NULL;
+    snprintf(l->device, sizeof(l->device), "%s", device);
+    l->size = size;
+    l->region = region ? region : 1;
+    return l;
+}
+
+void lat_log_free(struct lat_log *l) {
+    if (!l) return;
+    for (int i = 0; i < l->nrecs; i++) free(l->recs[i].regions);
+    free(l);
+}
+
+// Phases start one at a time (from the thread running the wipe); a report
+// taken meanwhile only sees a recorder once it is complete.
+struct lat_rec *lat_log_phase(struct lat_log *l, const char *name) {
+    if (!l || l->nrecs == LAT_MAX_PHASES) return NULL;
+    struct lat_rec *r = &l->recs[l->nrecs];
+    memset(r, 0, sizeof(*r));
+    r->region = l->region;
+    r->nregions = (l->size + l->region - 1) / l->region;
+    r->regions = calloc(r->nregions ? r->nregions : 1, sizeof(*r->regions));
+    if (!r->regions) return NULL;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    publish_count(&l->nrecs, l->nrecs + 1);
+    return r;
+}
+
+void lat_record(struct lat_rec *r, unsigned long long off, unsigned long long len, unsigned long long ns) {
+    if (!r) return;
+    unsigned long long us = ns / 1000;
+    int b = 0;
+    while (b < LAT_BUCKETS - 1 && (us >> (b + 1)) != 0) b++;
+    add(&r->count[b], 1);
+    add(&r->ios, 1);
+    add(&r->bytes, len);
+    add(&r->busy_ns, ns);
+    raise_max(&r->max_ns, ns);
+
+    unsigned long long k = off / r->region;
+    if (k >= r->nregions) return;
+    struct lat_region *g = &r->regions[k];
+    add(&g->ios, 1);
+    add(&g->bytes, len);
+    add(&g->busy_ns, ns);
+    raise_max(&g->max_ns, ns);
+}
+
+static void format_us(char *out, size_t n, unsigned long long us) {
+    if (us < 1000) snprintf(out, n, "%llu us", us);
+    else if (us < 1000000) snprintf(out, n, "%llu ms", us / 1000);
+    else snprintf(out, n, "%llu s", us / 1000000);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Upper bound of the bucket holding the q-th quantile, in microseconds.
+static unsigned long long quantile_us(const struct lat_rec *r, unsigned long long ios, double q) {
+    unsigned long long want = (unsigned long long)(q * ios + 0.5), seen = 0;
+    if (want == 0) want = 1;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        seen += r->count[b];
+        if (seen >= want) return 2ULL << b;
+    }
+    return 2ULL << (LAT_BUCKETS - 1);
+}
+
+static double region_mbps(const struct lat_region *g) {
+    return g->busy_ns ? g->bytes / (g->busy_ns / 1e9) / (1024 * 1024) : 0;
+}
+
+static void report_rec(const struct lat_rec *r, FILE *f, const char *t) {
+    unsigned long long ios = r->ios;
+    char p50[24], p90[24], p99[24];
+    if (!ios) {
+        fprintf(f, "%s%s: no requests\n", t, r->name);
+        return;
+    }
+    format_us(p50, sizeof(p50), quantile_us(r, ios, 0.50));
+    format_us(p90, sizeof(p90), quantile_us(r, ios, 0.90));
+    format_us(p99, sizeof(p99), quantile_us(r, ios, 0.99));
+    fprintf(f, "%s%s: %llu requests, %.1f MB, mean %.2f ms, p50 < %s, p90 < %s, p99 < %s, max %.2f ms\n", t,
+            r->name, ios, r->bytes / (1024.0 * 1024.0), r->busy_ns / 1e6 / ios, p50, p90, p99,
+            r->max_ns / 1e6);
+
+    // Histogram over the occupied range of buckets.
+    int lo = 0, hi = LAT_BUCKETS - 1;
+    unsigned long long peak = 0;
+    while (lo < hi && !r->count[lo]) lo++;
+    while (hi > lo && !r->count[hi]) hi--;
+    for (int b = lo; b <= hi; b++) if (r->count[b] > peak) peak = r->count[b];
+    for (int b = lo; b <= hi; b++) {
+        char from[24], to[24], bar[HISTOGRAM_WIDTH + 1];
+        format_us(from, sizeof(from), b ? 1ULL << b : 0);
+        format_us(to, sizeof(to), 2ULL << b);
+        int w = (int)(r->count[b] * HISTOGRAM_WIDTH / peak);
+        if (r->count[b] && !w) w = 1;
+        memset(bar, '#', (size_t)w);
+        bar[w] = 0;
+        fprintf(f, "%s  %8s - %-8s |%-*s| %llu (%.1f%%)\n", t, from, to, HISTOGRAM_WIDTH, bar,
+                r->count[b], 100.0 * r->count[b] / ios);
+    }
+
+    // Heatmap: each cell's service rate against the median region's.
+    double *rates = malloc(r->nregions * sizeof(*rates));
+    if (!rates) return;
+    unsigned long long used = 0;
+    for (unsigned long long k = 0; k < r->nregions; k++)
+        if (r->regions[k].bytes) rates[used++] = region_mbps(&r->regions[k]);
+    if (!used) {
+        free(rates);
+        return;
+    }
+    qsort(rates, used, sizeof(*rates), compare_double);
+    double median = rates[used / 2];
+    free(rates);
+
+    fprintf(f, "%sHeatmap, %llu MB per cell, against the median %.1f MB/s per request stream\n", t,
+            r->region / (1024 * 1024), median);
+    fprintf(f, "%s  ('.' normal, ':' 1.5x slower, '+' 2x, '*' 3x, '#' 6x or a stall, ' ' not touched)\n", t);
+    char row[HEATMAP_COLUMNS + 1];
+    for (unsigned long long k = 0; k < r->nregions; k += HEATMAP_COLUMNS) {
+        int c = 0;
+        for (; c < HEATMAP_COLUMNS && k + c < r->nregions; c++) {
+            const struct lat_region *g = &r->regions[k + c];
+            double slow = median > 0 && region_mbps(g) > 0 ? median / region_mbps(g) : 1;
+            row[c] = !g->bytes ? ' ' : (slow >= 6 || g->max_ns >= STALL_NS) ? '#' : slow >= 3 ? '*'
+                   : slow >= 2 ? '+' : slow >= 1.5 ? ':' : '.';
+        }
+        row[c] = 0;
+        fprintf(f, "%s  %10llu MB |%s|\n", t, k * r->region / (1024 * 1024), row);
+    }
+
+    int suspects = 0;
+    for (unsigned long long k = 0; k < r->nregions; k++) {
+        const struct lat_region *g = &r->regions[k];
+        double mbps = region_mbps(g);
+        if (!g->bytes || (mbps * SLOW_FACTOR >= median && g->max_ns < STALL_NS)) continue;
+        if (!suspects++) fprintf(f, "%sSuspect regions (%.0fx slower than the median, or a request over %.0f s):\n",
+                                 t, SLOW_FACTOR, STALL_NS / 1e9);
+        fprintf(f, "%s  %llu - %llu MB: %.1f MB/s, max latency %.2f ms over %llu requests\n", t,
+                k * r->region / (1024 * 1024), (k + 1) * r->region / (1024 * 1024), mbps, g->max_ns / 1e6, g->ios);
+    }
+    if (!suspects) fprintf(f, "%sNo suspect regions.\n", t);
+}
+
+void lat_log_report(const struct lat_log *l, FILE *f, const char *tag) {
+    if (!l) return;
+    const char *t = tag ? tag : "";
+    int n = load_count(&l->nrecs);
+    fprintf(f, "%sLatency report for %s\n", t, l->device);
+    for (int i = 0; i < n; i++) report_rec(&l->recs[i], f, t);
+    fflush(f);
+}
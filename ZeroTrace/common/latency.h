@@ -0,0 +1,61 @@
+// latency.h
+// Per-request latency statistics for wipe passes. Each phase of a run (pass
+// 1 write, pass 1 verify, ...) gets a recorder holding a log2-bucketed
+// histogram of request latencies and a heatmap of service rate per
+// fixed-size region of the device. The report flags regions that are much
+// slower than the rest of the disk, or that stalled, as suspect media.
+// Recording takes no lock, so every worker thread of a pass can feed the
+// same recorder, and a report can be taken while the pass is running.
+
+#ifndef ZT_LATENCY_H
+#define ZT_LATENCY_H
+
+#include <stdio.h>
+
+// Bucket b counts requests that took [2^b, 2^(b+1)) microseconds; bucket 0
+// also takes anything under a microsecond.
+#define LAT_BUCKETS 32
+#define LAT_MAX_PHASES 16
+
+struct lat_region {
+    unsigned long long ios, bytes;
+    unsigned long long busy_ns, max_ns;
+};
+
+struct lat_rec {
+    char name[32];
+    unsigned long long count[LAT_BUCKETS];
+    unsigned long long ios, bytes, busy_ns, max_ns;
+    unsigned long long region;      // bytes per heatmap cell
+    unsigned long long nregions;
+    struct lat_region *regions;
+};
+
+struct lat_log {
+    char device[256];
+    unsigned long long size;        // bytes the heatmap covers
+    unsigned long long region;      // bytes per heatmap cell
+    int nrecs;                      // published recorders
+    struct lat_rec recs[LAT_MAX_PHASES];
+};
+
+// A log for a device of size bytes, mapped in cells of region bytes.
+// Returns NULL when out of memory.
+struct lat_log *lat_log_new(const char *device, unsigned long long size, unsigned long long region);
+void lat_log_free(struct lat_log *l);
+
+// Start recording a new phase. Returns NULL (nothing recorded) once
+// LAT_MAX_PHASES are in use, when out of memory, or when l is NULL.
+struct lat_rec *lat_log_phase(struct lat_log *l, const char *name);
+
+// One request of len bytes at off took ns nanoseconds. r may be NULL.
+void lat_record(struct lat_rec *r, unsigned long long off, unsigned long long len, unsigned long long ns);
+
+// Histogram, heatmap and suspect regions of every phase so far, each line
+// prefixed with tag.
+void lat_log_report(const struct lat_log *l, FILE *f, const char *tag);
+
+// Monotonic clock for timing requests.
+unsigned long long lat_now_ns(void);
+
+#endif
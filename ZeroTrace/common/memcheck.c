@@ -0,0 +1,246 @@
+// memcheck.c
+// SIMD "is buffer all X" / "first mismatch" kernels with runtime CPUID dispatch.
+//
+// Every kernel works the same way: XOR a block against the expected bytes,
+// OR the results together and test once per block, so the hot loop is one
+// load, one XOR and one OR per vector. Only when a block fails do we go back
+// and locate the exact byte, which keeps the reported offset identical to a
+// byte-by-byte loop.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "memcheck.h"
+#include "cpu.h"
+
+#ifdef ZT_X86
+#include <immintrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Portable fallback: eight bytes at a time.
+
+static size_t scalar_tail_not_byte(const unsigned char *p, size_t i, size_t len, unsigned char byte) {
+    for (; i < len; i++) {
+        if (p[i] != byte) return i;
+    }
+    return len;
+}
+
+static size_t scalar_tail_mismatch(const unsigned char *a, const unsigned char *b, size_t i, size_t len) {
+    for (; i < len; i++) {
+        if (a[i] != b[i]) return i;
+    }
+    return len;
+}
+
+static size_t scalar_find_not_byte(const void *buf, size_t len, unsigned char byte) {
+    const unsigned char *p = buf;
+    uint64_t pat = 0x0101010101010101ULL * byte;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        if (w != pat) return scalar_tail_not_byte(p, i, i + 8, byte);
+    }
+    return scalar_tail_not_byte(p, i, len, byte);
+}
+
+static size_t scalar_find_mismatch(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, pa + i, 8);
+        memcpy(&y, pb + i, 8);
+        if (x != y) return scalar_tail_mismatch(pa, pb, i, i + 8);
+    }
+    return scalar_tail_mismatch(pa, pb, i, len);
+}
+
+#ifdef ZT_X86
+// ---------------------------------------------------------------------------
+// SSE2: 64-byte blocks.
+
+ZT_TARGET("sse2")
+static size_t sse2_find_not_byte(const void *buf, size_t len, unsigned char byte) {
+    const unsigned char *p = buf;
+    const __m128i pat = _mm_set1_epi8((char)byte);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + i)), pat);
+        x = _mm_or_si128(x, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + i + 16)), pat));
+        x = _mm_or_si128(x, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + i + 32)), pat));
+        x = _mm_or_si128(x, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + i + 48)), pat));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF) {
+            return scalar_tail_not_byte(p, i, i + 64, byte);
+        }
+    }
+    return scalar_tail_not_byte(p, i, len, byte);
+}
+
+ZT_TARGET("sse2")
+static size_t sse2_find_mismatch(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pa + i)),
+                                  _mm_loadu_si128((const __m128i *)(pb + i)));
+        x = _mm_or_si128(x, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pa + i + 16)),
+                                          _mm_loadu_si128((const __m128i *)(pb + i + 16))));
+        x = _mm_or_si128(x, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pa + i + 32)),
+                                          _mm_loadu_si128((const __m128i *)(pb + i + 32))));
+        x = _mm_or_si128(x, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pa + i + 48)),
+                                          _mm_loadu_si128((const __m128i *)(pb + i + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF) {
+            return scalar_tail_mismatch(pa, pb, i, i + 64);
+        }
+    }
+    return scalar_tail_mismatch(pa, pb, i, len);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2: 128-byte blocks.
+
+ZT_TARGET("avx2")
+static size_t avx2_find_not_byte(const void *buf, size_t len, unsigned char byte) {
+    const unsigned char *p = buf;
+    const __m256i pat = _mm256_set1_epi8((char)byte);
+    size_t i = 0;
+    for (; i + 128 <= len; i += 128) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(p + i)), pat);
+        x = _mm256_or_si256(x, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(p + i + 32)), pat));
+        x = _mm256_or_si256(x, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(p + i + 64)), pat));
+        x = _mm256_or_si256(x, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(p + i + 96)), pat));
+        if (!_mm256_testz_si256(x, x)) return scalar_tail_not_byte(p, i, i + 128, byte);
+    }
+    return scalar_tail_not_byte(p, i, len, byte);
+}
+
+ZT_TARGET("avx2")
+static size_t avx2_find_mismatch(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    size_t i = 0;
+    for (; i + 128 <= len; i += 128) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(pa + i)),
+                                     _mm256_loadu_si256((const __m256i *)(pb + i)));
+        x = _mm256_or_si256(x, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(pa + i + 32)),
+                                                _mm256_loadu_si256((const __m256i *)(pb + i + 32))));
+        x = _mm256_or_si256(x, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(pa + i + 64)),
+                                                _mm256_loadu_si256((const __m256i *)(pb + i + 64))));
+        x = _mm256_or_si256(x, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(pa + i + 96)),
+                                                _mm256_loadu_si256((const __m256i *)(pb + i + 96))));
+        if (!_mm256_testz_si256(x, x)) return scalar_tail_mismatch(pa, pb, i, i + 128);
+    }
+    return scalar_tail_mismatch(pa, pb, i, len);
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512F: 256-byte blocks.
+
+ZT_TARGET("avx512f")
+static size_t avx512_find_not_byte(const void *buf, size_t len, unsigned char byte) {
+    const unsigned char *p = buf;
+    const __m512i pat = _mm512_set1_epi32((int)(0x01010101u * byte));
+    size_t i = 0;
+    for (; i + 256 <= len; i += 256) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void *)(p + i)), pat);
+        x = _mm512_or_si512(x, _mm512_xor_si512(_mm512_loadu_si512((const void *)(p + i + 64)), pat));
+        x = _mm512_or_si512(x, _mm512_xor_si512(_mm512_loadu_si512((const void *)(p + i + 128)), pat));
+        x = _mm512_or_si512(x, _mm512_xor_si512(_mm512_loadu_si512((const void *)(p + i + 192)), pat));
+        if (_mm512_test_epi64_mask(x, x)) return scalar_tail_not_byte(p, i, i + 256, byte);
+    }
+    return scalar_tail_not_byte(p, i, len, byte);
+}
+
+ZT_TARGET("avx512f")
+static size_t avx512_find_mismatch(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    size_t i = 0;
+    for (; i + 256 <= len; i += 256) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void *)(pa + i)),
+                                     _mm512_loadu_si512((const void *)(pb + i)));
+        x = _mm512_or_si512(x, _mm512_xor_si512(_mm512_loadu_si512((const void *)(pa + i + 64)),
+                                                _mm512_loadu_si512((const void *)(pb + i + 64))));
+        x = _mm512_or_si512(x, _mm512_xor_si512(_mm512_loadu_si512((const void *)(pa + i + 128)),
+                                                _mm512_loadu_si512((const void *)(pb + i + 128))));
+        x = _mm512_or_si512(x, _mm512_xor_si512(_mm512_loadu_si512((const void *)(pa + i + 192)),
+                                                _mm512_loadu_si512((const void *)(pb + i + 192))));
+        if (_mm512_test_epi64_mask(x, x)) return scalar_tail_mismatch(pa, pb, i, i + 256);
+    }
+    return scalar_tail_mismatch(pa, pb, i, len);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Dispatch. The pointers start at a resolver that picks the implementation
+// on first use; racing first calls all store the same values.
+
+typedef size_t (*find_not_byte_fn)(const void *, size_t, unsigned char);
+typedef size_t (*find_mismatch_fn)(const void *, const void *, size_t);
+
+static size_t resolve_find_not_byte(const void *buf, size_t len, unsigned char byte);
+static size_t resolve_find_mismatch(const void *a, const void *b, size_t len);
+
+static find_not_byte_fn impl_find_not_byte = resolve_find_not_byte;
+static find_mismatch_fn impl_find_mismatch = resolve_find_mismatch;
+static const char *impl_name = "scalar";
+
+static void resolve(void) {
+    find_not_byte_fn nb = scalar_find_not_byte;
+    find_mismatch_fn mm = scalar_find_mismatch;
+    const char *name = "scalar";
+#ifdef ZT_X86
+    switch (cpu_simd_level()) {
+    case CPU_SIMD_AVX512:
+        nb = avx512_find_not_byte;
+        mm = avx512_find_mismatch;
+        name = "avx512";
+        break;
+    case CPU_SIMD_AVX2:
+        nb = avx2_find_not_byte;
+        mm = avx2_find_mismatch;
+        name = "avx2";
+        break;
+    case CPU_SIMD_SSE2:
+        nb = sse2_find_not_byte;
+        mm = sse2_find_mismatch;
+        name = "sse2";
+        break;
+    case CPU_SIMD_NONE:
+        break;
+    }
+#endif
+    impl_name = name;
+    impl_find_not_byte = nb;
+    impl_find_mismatch = mm;
+}
+
+static size_t resolve_find_not_byte(const void *buf, size_t len, unsigned char byte) {
+    resolve();
+    return impl_find_not_byte(buf, len, byte);
+}
+
+static size_t resolve_find_mismatch(const void *a, const void *b, size_t len) {
+    resolve();
+    return impl_find_mismatch(a, b, len);
+}
+
+size_t mem_find_not_byte(const void *buf, size_t len, unsigned char byte) {
+    return impl_find_not_byte(buf, len, byte);
+}
+
+size_t mem_find_mismatch(const void *a, const void *b, size_t len) {
+    return impl_find_mismatch(a, b, len);
+}
+
+int mem_is_zero(const void *buf, size_t len) {
+    return impl_find_not_byte(buf, len, 0x00) == len;
+}
+
+const char *memcheck_impl(void) {
+    if (impl_find_not_byte == resolve_find_not_byte) resolve();
+    return impl_name;
+}
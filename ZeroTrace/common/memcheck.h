@@ -0,0 +1,24 @@
+// memcheck.h
+// Buffer check kernels used by every verify loop. Each call picks the
+// widest implementation the CPU supports (AVX-512, AVX2, SSE2) the first
+// time it runs, with a portable word-at-a-time fallback. Builds on
+// GCC/Clang/MinGW and MSVC; non-x86 targets get the portable version.
+
+#ifndef ZT_MEMCHECK_H
+#define ZT_MEMCHECK_H
+
+#include <stddef.h>
+
+// Index of the first byte in buf[0..len) that is not `byte`, or len.
+size_t mem_find_not_byte(const void *buf, size_t len, unsigned char byte);
+
+// Index of the first position where a and b differ, or len.
+size_t mem_find_mismatch(const void *a, const void *b, size_t len);
+
+// Non-zero if every byte of buf[0..len) is zero.
+int mem_is_zero(const void *buf, size_t len);
+
+// Name of the implementation in use: "avx512", "avx2", "sse2" or "scalar".
+const char *memcheck_impl(void);
+
+#endif
@@ -0,0 +1,495 @@
+// pattern.c
+// ChaCha20 keystream generation (20 rounds, 64-bit block counter, zero
+// nonce) with SSE2 (4 blocks), AVX2 (8 blocks) and AVX-512 (16 blocks)
+// kernels picked at run time. Each kernel keeps one vector per state word holding that word for several
+// consecutive blocks, runs the rounds on all of them at once and transposes
+// the result back into block order on the way out.
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <bcrypt.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "bcrypt.lib")
+#endif
+#else
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/random.h>
+#endif
+
+#include "pattern.h"
+#include "memcheck.h"
+#include "cpu.h"
+
+#ifdef ZT_X86
+#include <immintrin.h>
+#endif
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTER(a, b, c, d)                      \
+    a += b; d ^= a; d = ROTL32(d, 16);           \
+    c += d; b ^= c; b = ROTL32(b, 12);           \
+    a += b; d ^= a; d = ROTL32(d, 8);            \
+    c += d; b ^= c; b = ROTL32(b, 7)
+
+static uint32_t load32_le(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void store32_le(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+// Initial state for block 0; words 12/13 carry the block counter.
+static void init_state(const struct pattern_key *key, uint32_t s[16]) {
+    s[0] = 0x61707865;
+    s[1] = 0x3320646e;
+    s[2] = 0x79622d32;
+    s[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) s[4 + i] = load32_le(key->bytes + 4 * i);
+    s[12] = s[13] = s[14] = s[15] = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Portable: one 64-byte block at a time.
+
+static void scalar_blocks(const uint32_t in[16], unsigned long long block, unsigned char *out, size_t nblocks) {
+    for (size_t n = 0; n < nblocks; n++, block++) {
+        uint32_t x[16], s[16];
+        memcpy(s, in, sizeof(s));
+        s[12] = (uint32_t)block;
+        s[13] = (uint32_t)(block >> 32);
+        memcpy(x, s, sizeof(x));
+        for (int r = 0; r < 10; r++) {
+            QUARTER(x[0], x[4], x[8], x[12]);
+            QUARTER(x[1], x[5], x[9], x[13]);
+            QUARTER(x[2], x[6], x[10], x[14]);
+            QUARTER(x[3], x[7], x[11], x[15]);
+            QUARTER(x[0], x[5], x[10], x[15]);
+            QUARTER(x[1], x[6], x[11], x[12]);
+            QUARTER(x[2], x[7], x[8], x[13]);
+            QUARTER(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++) store32_le(out + 64 * n + 4 * i, x[i] + s[i]);
+    }
+}
+
+#ifdef ZT_X86
+// ---------------------------------------------------------------------------
+// SSE2: four blocks per iteration.
+
+#define SSE_ROTL(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+#define SSE_QUARTER(a, b, c, d)                                                  \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = SSE_ROTL(d, 16);       \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = SSE_ROTL(b, 12);       \
+    a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = SSE_ROTL(d, 8);        \
+    c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = SSE_ROTL(b, 7)
+
+ZT_TARGET("sse2")
+static void sse2_blocks(const uint32_t in[16], unsigned long long block, unsigned char *out, size_t nblocks) {
+    while (nblocks >= 4) {
+        __m128i s[16], x[16];
+        for (int i = 0; i < 12; i++) s[i] = _mm_set1_epi32((int)in[i]);
+        uint32_t lo[4], hi[4];
+        for (int l = 0; l < 4; l++) {
+            lo[l] = (uint32_t)(block + l);
+            hi[l] = (uint32_t)((block + l) >> 32);
+        }
+        s[12] = _mm_setr_epi32((int)lo[0], (int)lo[1], (int)lo[2], (int)lo[3]);
+        s[13] = _mm_setr_epi32((int)hi[0], (int)hi[1], (int)hi[2], (int)hi[3]);
+        s[14] = _mm_set1_epi32((int)in[14]);
+        s[15] = _mm_set1_epi32((int)in[15]);
+        for (int i = 0; i < 16; i++) x[i] = s[i];
+
+        for (int r = 0; r < 10; r++) {
+            SSE_QUARTER(x[0], x[4], x[8], x[12]);
+            SSE_QUARTER(x[1], x[5], x[9], x[13]);
+            SSE_QUARTER(x[2], x[6], x[10], x[14]);
+            SSE_QUARTER(x[3], x[7], x[11], x[15]);
+            SSE_QUARTER(x[0], x[5], x[10], x[15]);
+            SSE_QUARTER(x[1], x[6], x[11], x[12]);
+            SSE_QUARTER(x[2], x[7], x[8], x[13]);
+            SSE_QUARTER(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++) x[i] = _mm_add_epi32(x[i], s[i]);
+
+        // Words 4g..4g+3 of all four blocks -> 16 bytes of each block.
+        for (int g = 0; g < 4; g++) {
+            __m128i t0 = _mm_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+            __m128i t1 = _mm_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+            __m128i t2 = _mm_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+            __m128i t3 = _mm_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+            _mm_storeu_si128((__m128i *)(out + 16 * g), _mm_unpacklo_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *)(out + 64 + 16 * g), _mm_unpackhi_epi64(t0, t1));
+            _mm_storeu_si128((__m128i *)(out + 128 + 16 * g), _mm_unpacklo_epi64(t2, t3));
+            _mm_storeu_si128((__m128i *)(out + 192 + 16 * g), _mm_unpackhi_epi64(t2, t3));
+        }
+        out += 256;
+        block += 4;
+        nblocks -= 4;
+    }
+    scalar_blocks(in, block, out, nblocks);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2: eight blocks per iteration. The 16- and 8-bit rotations are byte
+// shuffles.
+
+#define AVX_ROTL(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+#define AVX_QUARTER(a, b, c, d)                                                          \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = _mm256_shuffle_epi8(d, rot16); \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = AVX_ROTL(b, 12);         \
+    a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = _mm256_shuffle_epi8(d, rot8);  \
+    c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = AVX_ROTL(b, 7)
+
+ZT_TARGET("avx2")
+static void avx2_blocks(const uint32_t in[16], unsigned long long block, unsigned char *out, size_t nblocks) {
+    const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                           2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                          3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    while (nblocks >= 8) {
+        __m256i x[16];
+        int lo[8], hi[8];
+        for (int l = 0; l < 8; l++) {
+            lo[l] = (int)(uint32_t)(block + l);
+            hi[l] = (int)(uint32_t)((block + l) >> 32);
+        }
+        // Only the counter words differ between blocks; the rest are
+        // rebroadcast for the final addition rather than kept live.
+        const __m256i ctr_lo = _mm256_setr_epi32(lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7]);
+        const __m256i ctr_hi = _mm256_setr_epi32(hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7]);
+        for (int i = 0; i < 16; i++) x[i] = _mm256_set1_epi32((int)in[i]);
+        x[12] = ctr_lo;
+        x[13] = ctr_hi;
+
+        for (int r = 0; r < 10; r++) {
+            AVX_QUARTER(x[0], x[4], x[8], x[12]);
+            AVX_QUARTER(x[1], x[5], x[9], x[13]);
+            AVX_QUARTER(x[2], x[6], x[10], x[14]);
+            AVX_QUARTER(x[3], x[7], x[11], x[15]);
+            AVX_QUARTER(x[0], x[5], x[10], x[15]);
+            AVX_QUARTER(x[1], x[6], x[11], x[12]);
+            AVX_QUARTER(x[2], x[7], x[8], x[13]);
+            AVX_QUARTER(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++) {
+            if (i != 12 && i != 13) x[i] = _mm256_add_epi32(x[i], _mm256_set1_epi32((int)in[i]));
+        }
+        x[12] = _mm256_add_epi32(x[12], ctr_lo);
+        x[13] = _mm256_add_epi32(x[13], ctr_hi);
+
+        // Unpacks work within 128-bit lanes, so after the 4x4 transpose the
+        // low lane of r[g][j] holds words 4g..4g+3 of block j and the high
+        // lane those of block j + 4; pairing lanes gives 32-byte stores.
+        __m256i r[4][4];
+        for (int g = 0; g < 4; g++) {
+            __m256i t0 = _mm256_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+            __m256i t1 = _mm256_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+            __m256i t2 = _mm256_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+            __m256i t3 = _mm256_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+            r[g][0] = _mm256_unpacklo_epi64(t0, t1);
+            r[g][1] = _mm256_unpackhi_epi64(t0, t1);
+            r[g][2] = _mm256_unpacklo_epi64(t2, t3);
+            r[g][3] = _mm256_unpackhi_epi64(t2, t3);
+        }
+        for (int j = 0; j < 4; j++) {
+            unsigned char *o = out + 64 * j;
+            _mm256_storeu_si256((__m256i *)o, _mm256_permute2x128_si256(r[0][j], r[1][j], 0x20));
+            _mm256_storeu_si256((__m256i *)(o + 32), _mm256_permute2x128_si256(r[2][j], r[3][j], 0x20));
+            _mm256_storeu_si256((__m256i *)(o + 256), _mm256_permute2x128_si256(r[0][j], r[1][j], 0x31));
+            _mm256_storeu_si256((__m256i *)(o + 288), _mm256_permute2x128_si256(r[2][j], r[3][j], 0x31));
+        }
+        out += 512;
+        block += 8;
+        nblocks -= 8;
+    }
+    scalar_blocks(in, block, out, nblocks);
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512F: sixteen blocks per iteration, with native rotates.
+
+#define ZMM_QUARTER(a, b, c, d)                                                          \
+    a = _mm512_add_epi32(a, b); d = _mm512_xor_si512(d, a); d = _mm512_rol_epi32(d, 16); \
+    c = _mm512_add_epi32(c, d); b = _mm512_xor_si512(b, c); b = _mm512_rol_epi32(b, 12); \
+    a = _mm512_add_epi32(a, b); d = _mm512_xor_si512(d, a); d = _mm512_rol_epi32(d, 8);  \
+    c = _mm512_add_epi32(c, d); b = _mm512_xor_si512(b, c); b = _mm512_rol_epi32(b, 7)
+
+ZT_TARGET("avx512f")
+static void avx512_blocks(const uint32_t in[16], unsigned long long block, unsigned char *out, size_t nblocks) {
+    while (nblocks >= 16) {
+        __m512i x[16];
+        int lo[16], hi[16];
+        for (int l = 0; l < 16; l++) {
+            lo[l] = (int)(uint32_t)(block + l);
+            hi[l] = (int)(uint32_t)((block + l) >> 32);
+        }
+        const __m512i ctr_lo = _mm512_loadu_si512((const void *)lo);
+        const __m512i ctr_hi = _mm512_loadu_si512((const void *)hi);
+        for (int i = 0; i < 16; i++) x[i] = _mm512_set1_epi32((int)in[i]);
+        x[12] = ctr_lo;
+        x[13] = ctr_hi;
+
+        for (int r = 0; r < 10; r++) {
+            ZMM_QUARTER(x[0], x[4], x[8], x[12]);
+            ZMM_QUARTER(x[1], x[5], x[9], x[13]);
+            ZMM_QUARTER(x[2], x[6], x[10], x[14]);
+            ZMM_QUARTER(x[3], x[7], x[11], x[15]);
+            ZMM_QUARTER(x[0], x[5], x[10], x[15]);
+            ZMM_QUARTER(x[1], x[6], x[11], x[12]);
+            ZMM_QUARTER(x[2], x[7], x[8], x[13]);
+            ZMM_QUARTER(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++) {
+            if (i != 12 && i != 13) x[i] = _mm512_add_epi32(x[i], _mm512_set1_epi32((int)in[i]));
+        }
+        x[12] = _mm512_add_epi32(x[12], ctr_lo);
+        x[13] = _mm512_add_epi32(x[13], ctr_hi);
+
+        // As with AVX2, an in-lane 4x4 transpose leaves 128-bit lane L of
+        // r[g][j] holding words 4g..4g+3 of block j + 4L; a second 4x4
+        // transpose of lanes then assembles whole 64-byte blocks.
+        __m512i r[4][4];
+        for (int g = 0; g < 4; g++) {
+            __m512i t0 = _mm512_unpacklo_epi32(x[4 * g], x[4 * g + 1]);
+            __m512i t1 = _mm512_unpacklo_epi32(x[4 * g + 2], x[4 * g + 3]);
+            __m512i t2 = _mm512_unpackhi_epi32(x[4 * g], x[4 * g + 1]);
+            __m512i t3 = _mm512_unpackhi_epi32(x[4 * g + 2], x[4 * g + 3]);
+            r[g][0] = _mm512_unpacklo_epi64(t0, t1);
+            r[g][1] = _mm512_unpackhi_epi64(t0, t1);
+            r[g][2] = _mm512_unpacklo_epi64(t2, t3);
+            r[g][3] = _mm512_unpackhi_epi64(t2, t3);
+        }
+        for (int j = 0; j < 4; j++) {
+            __m512i t0 = _mm512_shuffle_i32x4(r[0][j], r[1][j], 0x44);
+            __m512i t1 = _mm512_shuffle_i32x4(r[2][j], r[3][j], 0x44);
+            __m512i t2 = _mm512_shuffle_i32x4(r[0][j], r[1][j], 0xEE);
+            __m512i t3 = _mm512_shuffle_i32x4(r[2][j], r[3][j], 0xEE);
+            _mm512_storeu_si512((void *)(out + 64 * j), _mm512_shuffle_i32x4(t0, t1, 0x88));
+            _mm512_storeu_si512((void *)(out + 64 * (j + 4)), _mm512_shuffle_i32x4(t0, t1, 0xDD));
+            _mm512_storeu_si512((void *)(out + 64 * (j + 8)), _mm512_shuffle_i32x4(t2, t3, 0x88));
+            _mm512_storeu_si512((void *)(out + 64 * (j + 12)), _mm512_shuffle_i32x4(t2, t3, 0xDD));
+        }
+        out += 1024;
+        block += 16;
+        nblocks -= 16;
+    }
+    avx2_blocks(in, block, out, nblocks);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Dispatch and the public API.
+
+typedef void (*blocks_fn)(const uint32_t in[16], unsigned long long block, unsigned char *out, size_t nblocks);
+
+static blocks_fn impl_blocks;
+static const char *impl_name = "scalar";
+
+static blocks_fn resolve(void) {
+    blocks_fn fn = scalar_blocks;
+    const char *name = "scalar";
+#ifdef ZT_X86
+    enum cpu_simd level = cpu_simd_level();
+    if (level == CPU_SIMD_AVX512) {
+        fn = avx512_blocks;
+        name = "avx512";
+    } else if (level == CPU_SIMD_AVX2) {
+        fn = avx2_blocks;
+        name = "avx2";
+    } else if (level == CPU_SIMD_SSE2) {
+        fn = sse2_blocks;
+        name = "sse2";
+    }
+#endif
+    impl_name = name;
+    impl_blocks = fn;
+    return fn;
+}
+
+void pattern_fill(const struct pattern_key *key, unsigned long long offset, void *buf, size_t len) {
+    blocks_fn blocks = impl_blocks ? impl_blocks : resolve();
+    unsigned char *out = buf;
+    uint32_t in[16];
+    init_state(key, in);
+
+    unsigned long long block = offset / 64;
+    size_t skip = (size_t)(offset % 64);
+    if (skip) {
+        // Range starts inside a block: generate it whole and keep the end.
+        unsigned char tmp[64];
+        size_t n = 64 - skip < len ? 64 - skip : len;
+        scalar_blocks(in, block++, tmp, 1);
+        memcpy(out, tmp + skip, n);
+        out += n;
+        len -= n;
+    }
+    if (len >= 64) {
+        size_t nblocks = len / 64;
+        blocks(in, block, out, nblocks);
+        block += nblocks;
+        out += nblocks * 64;
+        len -= nblocks * 64;
+    }
+    if (len) {
+        unsigned char tmp[64];
+        scalar_blocks(in, block, tmp, 1);
+        memcpy(out, tmp, len);
+    }
+}
+
+// pattern_fill_mt: each thread fills one contiguous, block-aligned slice.
+struct fill_job {
+    const struct pattern_key *key;
+    unsigned long long offset;
+    unsigned char *buf;
+    size_t len;
+};
+
+#if defined(_WIN32)
+static DWORD WINAPI fill_thread(LPVOID arg) {
+    struct fill_job *j = arg;
+    pattern_fill(j->key, j->offset, j->buf, j->len);
+    return 0;
+}
+#else
+static void *fill_thread(void *arg) {
+    struct fill_job *j = arg;
+    pattern_fill(j->key, j->offset, j->buf, j->len);
+    return NULL;
+}
+#endif
+
+static unsigned online_cpus(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors ? (unsigned)si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+#endif
+}
+
+#define FILL_MT_MAX 16
+#define FILL_MT_MIN_SLICE (1024 * 1024)
+
+void pattern_fill_mt(const struct pattern_key *key, unsigned long long offset, void *buf, size_t len,
+                     unsigned threads) {
+    if (threads == 0) threads = online_cpus();
+    if (threads > FILL_MT_MAX) threads = FILL_MT_MAX;
+    if (threads > len / FILL_MT_MIN_SLICE) threads = (unsigned)(len / FILL_MT_MIN_SLICE);
+    if (threads <= 1) {
+        pattern_fill(key, offset, buf, len);
+        return;
+    }
+    if (!impl_blocks) resolve();
+
+    struct fill_job jobs[FILL_MT_MAX];
+#if defined(_WIN32)
+    HANDLE th[FILL_MT_MAX];
+#else
+    pthread_t th[FILL_MT_MAX];
+#endif
+    int started[FILL_MT_MAX];
+    size_t slice = (len / threads + 63) & ~(size_t)63;
+    size_t pos = 0;
+    unsigned n = 0;
+    for (; n < threads && pos < len; n++) {
+        jobs[n].key = key;
+        jobs[n].offset = offset + pos;
+        jobs[n].buf = (unsigned char *)buf + pos;
+        jobs[n].len = len - pos < slice ? len - pos : slice;
+        pos += jobs[n].len;
+        // The calling thread takes the first slice itself.
+        if (n == 0) {
+            started[n] = 0;
+            continue;
+        }
+#if defined(_WIN32)
+        th[n] = CreateThread(NULL, 0, fill_thread, &jobs[n], 0, NULL);
+        started[n] = th[n] != NULL;
+#else
+        started[n] = pthread_create(&th[n], NULL, fill_thread, &jobs[n]) == 0;
+#endif
+    }
+
+    pattern_fill(key, jobs[0].offset, jobs[0].buf, jobs[0].len);
+    for (unsigned i = 1; i < n; i++) {
+        if (!started[i]) {
+            pattern_fill(key, jobs[i].offset, jobs[i].buf, jobs[i].len);
+            continue;
+        }
+#if defined(_WIN32)
+        WaitForSingleObject(th[i], INFINITE);
+        CloseHandle(th[i]);
+#else
+        pthread_join(th[i], NULL);
+#endif
+    }
+}
+
+const char *pattern_impl(void) {
+    if (!impl_blocks) resolve();
+    return impl_name;
+}
+
+void pattern_key_hex(const struct pattern_key *key, char out[2 * PATTERN_KEY_SIZE + 1]) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < PATTERN_KEY_SIZE; i++) {
+        out[2 * i] = digits[key->bytes[i] >> 4];
+        out[2 * i + 1] = digits[key->bytes[i] & 0xF];
+    }
+    out[2 * PATTERN_KEY_SIZE] = 0;
+}
+
+void pass_fill(const struct pass_pattern *p, unsigned long long offset, void *buf, size_t len) {
+    if (p->random) pattern_fill_mt(&p->key, offset, buf, len, 0);
+    else memset(buf, p->byte, len);
+}
+
+// Regenerate in slices small enough to stay in L1/L2 next to the data.
+#define CHECK_SLICE (16 * 1024)
+
+size_t pass_check(const struct pass_pattern *p, unsigned long long offset, const void *data, size_t len) {
+    if (!p->random) return mem_find_not_byte(data, len, p->byte);
+
+    const unsigned char *d = data;
+    unsigned char expect[CHECK_SLICE];
+    for (size_t pos = 0; pos < len; pos += CHECK_SLICE) {
+        size_t n = len - pos < CHECK_SLICE ? len - pos : CHECK_SLICE;
+        pattern_fill(&p->key, offset + pos, expect, n);
+        size_t i = mem_find_mismatch(d + pos, expect, n);
+        if (i < n) return pos + i;
+    }
+    return len;
+}
+
+int pattern_key_generate(struct pattern_key *key) {
+#if defined(_WIN32)
+    if (BCryptGenRandom(NULL, key->bytes, sizeof(key->bytes), BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0) {
+        return -1;
+    }
+    return 0;
+#else
+    size_t got = 0;
+    while (got < sizeof(key->bytes)) {
+        ssize_t r = getrandom(key->bytes + got, sizeof(key->bytes) - got, 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        got += (size_t)r;
+    }
+    return 0;
+#endif
+}
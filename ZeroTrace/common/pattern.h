@@ -0,0 +1,53 @@
+// pattern.h
+// Keyed random overwrite data. The stream is ChaCha20 in counter mode with
+// a 64-bit block counter: the byte written at device offset `off` is byte
+// `off` of the keystream, so any range can be produced independently - by
+// several threads at once, or again later to check what was written.
+
+#ifndef ZT_PATTERN_H
+#define ZT_PATTERN_H
+
+#include <stddef.h>
+
+#define PATTERN_KEY_SIZE 32
+
+struct pattern_key {
+    unsigned char bytes[PATTERN_KEY_SIZE];
+};
+
+// Fill key from the operating system's CSPRNG. Returns 0, or -1 if no
+// entropy source was available.
+int pattern_key_generate(struct pattern_key *key);
+
+// Write the keystream for [offset, offset + len) into buf. Disjoint ranges
+// may be filled concurrently with the same key.
+void pattern_fill(const struct pattern_key *key, unsigned long long offset, void *buf, size_t len);
+
+// pattern_fill split across `threads` threads (0 = one per online CPU,
+// capped at 16). Small buffers are filled on the calling thread.
+void pattern_fill_mt(const struct pattern_key *key, unsigned long long offset, void *buf, size_t len,
+                     unsigned threads);
+
+// Name of the implementation in use: "avx512", "avx2", "sse2" or "scalar".
+const char *pattern_impl(void);
+
+// Key as 64 lowercase hex digits plus NUL, for recording in the run log.
+void pattern_key_hex(const struct pattern_key *key, char out[2 * PATTERN_KEY_SIZE + 1]);
+
+// What one overwrite pass puts on the drive: a fixed byte everywhere, or
+// the keystream under `key`. Either can be checked later from this alone.
+struct pass_pattern {
+    int random;
+    unsigned char byte;
+    struct pattern_key key;
+};
+
+// Fill buf with what the pass writes at [offset, offset + len).
+void pass_fill(const struct pass_pattern *p, unsigned long long offset, void *buf, size_t len);
+
+// Compare data read back from [offset, offset + len) with what the pass
+// wrote there. Returns the index of the first wrong byte, or len. Random
+// data is regenerated piecewise, so no second full-size buffer is needed.
+size_t pass_check(const struct pass_pattern *p, unsigned long long offset, const void *data, size_t len);
+
+#endif
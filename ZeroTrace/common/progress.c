@@ -0,0 +1,362 @@
+// progress.c
+// Progress reporter shared by the Linux and Windows wipers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "progress.h"
+
+// Time constant of the smoothed throughput, in seconds.
+#define SMOOTH_SECONDS 10.0
+
+struct progress_job {
+    char device[256];
+    char tag[80];
+    char phase[32];
+    int pass, passes;
+    enum progress_counter track;
+    unsigned long long total;
+    unsigned long long count[PROGRESS_COUNTERS];   // updated atomically
+    const char *status;         // NULL while running
+    // Reporter state, refreshed every tick.
+    unsigned long long done;    // tracked counter at the last tick
+    double stamp;               // when done was sampled
+    double rate, smoothed;      // bytes per second
+    double eta;                 // seconds, -1 when unknown
+    int sampled;                // rate has been measured in this phase
+    int ended;                  // final state already reported
+};
+
+static struct progress_opts opts;
+static struct progress_job jobs[PROGRESS_MAX_JOBS];
+static int njobs;
+static int running;
+static volatile int stopping;
+
+#if defined(_WIN32)
+static CRITICAL_SECTION lock;
+static HANDLE thread, wake;
+
+static void lock_jobs(void) { EnterCriticalSection(&lock); }
+static void unlock_jobs(void) { LeaveCriticalSection(&lock); }
+
+static double now_seconds(void) {
+    return GetTickCount64() / 1000.0;
+}
+
+static unsigned long long load(unsigned long long *p) {
+    return (unsigned long long)InterlockedExchangeAdd64((volatile LONG64 *)p, 0);
+}
+
+static void store(unsigned long long *p, unsigned long long v) {
+    InterlockedExchange64((volatile LONG64 *)p, (LONG64)v);
+}
+#else
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_t thread;
+
+static void lock_jobs(void) { pthread_mutex_lock(&lock); }
+static void unlock_jobs(void) { pthread_mutex_unlock(&lock); }
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long load(unsigned long long *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static void store(unsigned long long *p, unsigned long long v) {
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+}
+#endif
+
+// Quote-safe copy for JSON strings and Prometheus label values.
+static void escape(char *dst, size_t n, const char *src) {
+    size_t o = 0;
+    for (; *src && o + 3 < n; src++) {
+        if (*src == '\\' || *src == '"') {
+            dst[o++] = '\\';
+            dst[o++] = *src;
+        } else if (*src == '\n') {
+            dst[o++] = '\\';
+            dst[o++] = 'n';
+        } else if ((unsigned char)*src >= 0x20) {
+            dst[o++] = *src;
+        }
+    }
+    dst[o] = 0;
+}
+
+static const char *counter_name(enum progress_counter c) {
+    return c == PROGRESS_VERIFIED ? "verified" : c == PROGRESS_SCANNED ? "scanned" : "written";
+}
+
+static void format_eta(char *out, size_t n, double eta) {
+    if (eta < 0) {
+        snprintf(out, n, "--:--:--");
+        return;
+    }
+    unsigned long long s = (unsigned long long)(eta + 0.5);
+    snprintf(out, n, "%llu:%02llu:%02llu", s / 3600, s / 60 % 60, s % 60);
+}
+
+static void print_human(const struct progress_job *j) {
+    char pass[32] = "", eta[32];
+    if (j->passes > 0) snprintf(pass, sizeof(pass), ", pass %d/%d", j->pass, j->passes);
+    format_eta(eta, sizeof(eta), j->eta);
+    printf("%s... %llu / %llu MB %s%s (%.1f MB/s, ETA %s)\n", j->tag, j->done / (1024 * 1024),
+           j->total / (1024 * 1024), counter_name(j->track), pass, j->smoothed / (1024 * 1024), eta);
+}
+
+static void write_json(struct progress_job *j) {
+    char dev[512], phase[64], status[128], eta[32], line[1024];
+    escape(dev, sizeof(dev), j->device);
+    escape(phase, sizeof(phase), j->phase);
+    escape(status, sizeof(status), j->status ? j->status : "running");
+    if (j->eta < 0) snprintf(eta, sizeof(eta), "null");
+    else snprintf(eta, sizeof(eta), "%.1f", j->eta);
+    int len = snprintf(line, sizeof(line),
+                       "{\"time\": %lld, \"device\": \"%s\", \"phase\": \"%s\", \"pass\": %d, \"passes\": %d, "
+                       "\"bytes_done\": %llu, \"bytes_total\": %llu, \"written\": %llu, \"verified\": %llu, "
+                       "\"scanned\": %llu, \"mb_s\": %.1f, \"mb_s_smoothed\": %.1f, \"eta_s\": %s, \"status\": \"%s\"}\n",
+                       (long long)time(NULL), dev, phase, j->pass, j->passes, j->done, j->total,
+                       load(&j->count[PROGRESS_WRITTEN]), load(&j->count[PROGRESS_VERIFIED]),
+                       load(&j->count[PROGRESS_SCANNED]),
+                       j->rate / (1024 * 1024), j->smoothed / (1024 * 1024), eta, status);
+    if (len <= 0) return;
+    if (len >= (int)sizeof(line)) len = (int)sizeof(line) - 1;
+    // One write per line, so lines from several jobs never interleave.
+#if defined(_WIN32)
+    if (_write(opts.json_fd, line, (unsigned)len) != len) { /* a reader went away; keep wiping */ }
+#else
+    if (write(opts.json_fd, line, (size_t)len) != len) { /* a reader went away; keep wiping */ }
+#endif
+}
+
+// Rewrite the textfile from scratch; the collector must never see half of it.
+static void write_prom(void) {
+    static const char *const metrics[][2] = {
+        {"zerotrace_bytes_done", "Bytes finished in the current phase."},
+        {"zerotrace_bytes_total", "Bytes the current phase covers."},
+        {"zerotrace_throughput_bytes_per_second", "Throughput over the last interval."},
+        {"zerotrace_throughput_smoothed_bytes_per_second", "Exponentially smoothed throughput."},
+        {"zerotrace_eta_seconds", "Estimated seconds until the current phase ends."},
+        {"zerotrace_pass", "Pass in progress (0 when the run has no passes)."},
+        {"zerotrace_passes", "Passes in the run."},
+        {"zerotrace_finished", "1 once the wipe has ended, with its status."},
+    };
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", opts.prom_path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+    for (size_t m = 0; m < sizeof(metrics) / sizeof(metrics[0]); m++) {
+        fprintf(f, "# HELP %s %s\n# TYPE %s gauge\n", metrics[m][0], metrics[m][1], metrics[m][0]);
+        for (int i = 0; i < njobs; i++) {
+            const struct progress_job *j = &jobs[i];
+            char dev[512], phase[64], status[128];
+            escape(dev, sizeof(dev), j->device);
+            escape(phase, sizeof(phase), j->phase);
+            escape(status, sizeof(status), j->status ? j->status : "running");
+            double v;
+            switch (m) {
+            case 0: v = (double)j->done; break;
+            case 1: v = (double)j->total; break;
+            case 2: v = j->rate; break;
+            case 3: v = j->smoothed; break;
+            case 4: v = j->eta; break;
+            case 5: v = j->pass; break;
+            case 6: v = j->passes; break;
+            default: v = j->status != NULL; break;
+            }
+            if (m == 4 && v < 0) continue;      // unknown: leave the series out
+            if (m == 7) fprintf(f, "%s{device=\"%s\",status=\"%s\"} %.0f\n", metrics[m][0], dev, status, v);
+            else fprintf(f, "%s{device=\"%s\",phase=\"%s\"} %.1f\n", metrics[m][0], dev, phase, v);
+        }
+    }
+    fprintf(f, "# HELP zerotrace_last_update_timestamp_seconds When this file was written.\n"
+               "# TYPE zerotrace_last_update_timestamp_seconds gauge\n"
+               "zerotrace_last_update_timestamp_seconds %lld\n", (long long)time(NULL));
+    if (fclose(f) != 0) {
+        remove(tmp);
+        return;
+    }
+#if defined(_WIN32)
+    MoveFileExA(tmp, opts.prom_path, MOVEFILE_REPLACE_EXISTING);
+#else
+    rename(tmp, opts.prom_path);
+#endif
+}
+
+// Sample every job and report it.
+static void tick(void) {
+    lock_jobs();
+    double now = now_seconds();
+    for (int i = 0; i < njobs; i++) {
+        struct progress_job *j = &jobs[i];
+        if (j->ended) continue;
+        unsigned long long done = load(&j->count[j->track]);
+        // Measured from the phase start at first, so a new phase's rate
+        // never includes time spent in the previous one.
+        double dt = now - j->stamp;
+        j->stamp = now;
+        if (dt > 0) {
+            j->rate = done > j->done ? (done - j->done) / dt : 0;
+            if (!j->sampled) j->smoothed = j->rate;
+            else j->smoothed += dt / (SMOOTH_SECONDS + dt) * (j->rate - j->smoothed);
+            j->sampled = 1;
+        }
+        j->done = done;
+        if (done >= j->total) j->eta = 0;
+        else j->eta = j->smoothed > 0 ? (j->total - done) / j->smoothed : -1;
+
+        if (opts.human && !j->status) print_human(j);
+        if (opts.json_fd >= 0) write_json(j);
+        if (j->status) j->ended = 1;
+    }
+    if (opts.prom_path) write_prom();
+    unlock_jobs();
+}
+
+// Sleep for one interval. Returns nonzero once progress_stop wants out.
+static int wait_interval(void) {
+#if defined(_WIN32)
+    return WaitForSingleObject(wake, (DWORD)(opts.interval * 1000)) == WAIT_OBJECT_0;
+#else
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    double s = until.tv_sec + until.tv_nsec / 1e9 + opts.interval;
+    until.tv_sec = (time_t)s;
+    until.tv_nsec = (long)((s - (double)until.tv_sec) * 1e9);
+    pthread_mutex_lock(&lock);
+    int rc = 0;
+    while (!stopping && rc != ETIMEDOUT) rc = pthread_cond_timedwait(&wake, &lock, &until);
+    int stop = stopping;
+    pthread_mutex_unlock(&lock);
+    return stop;
+#endif
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI reporter(LPVOID arg) {
+#else
+static void *reporter(void *arg) {
+#endif
+    (void)arg;
+    while (!wait_interval()) tick();
+    return 0;
+}
+
+int progress_start(const struct progress_opts *o) {
+    opts = *o;
+    if (opts.interval <= 0) opts.interval = 1;
+    njobs = 0;
+    stopping = 0;
+#if defined(_WIN32)
+    InitializeCriticalSection(&lock);
+    wake = CreateEventA(NULL, TRUE, FALSE, NULL);
+    thread = wake ? CreateThread(NULL, 0, reporter, NULL, 0, NULL) : NULL;
+    if (!thread) {
+        fprintf(stderr, "Cannot start the progress reporter (err=%lu)\n", GetLastError());
+        return -1;
+    }
+#else
+    int rc = pthread_create(&thread, NULL, reporter, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "Cannot start the progress reporter: %s\n", strerror(rc));
+        return -1;
+    }
+#endif
+    running = 1;
+    return 0;
+}
+
+void progress_stop(void) {
+    if (!running) return;
+#if defined(_WIN32)
+    stopping = 1;
+    SetEvent(wake);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    CloseHandle(wake);
+#else
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+#endif
+    tick();
+    running = 0;
+}
+
+struct progress_job *progress_job_add(const char *device, const char *tag) {
+    if (!running) return NULL;
+    lock_jobs();
+    struct progress_job *j = njobs < PROGRESS_MAX_JOBS ? &jobs[njobs++] : NULL;
+    if (j) {
+        memset(j, 0, sizeof(*j));
+        snprintf(j->device, sizeof(j->device), "%s", device);
+        snprintf(j->tag, sizeof(j->tag), "%s", tag ? tag : "");
+        snprintf(j->phase, sizeof(j->phase), "starting");
+        j->stamp = now_seconds();
+        j->eta = -1;
+    }
+    unlock_jobs();
+    return j;
+}
+
+void progress_phase(struct progress_job *j, const char *phase, int pass, int passes,
+                    enum progress_counter track, unsigned long long total, unsigned long long done) {
+    if (!j) return;
+    lock_jobs();
+    snprintf(j->phase, sizeof(j->phase), "%s", phase);
+    j->pass = pass;
+    j->passes = passes;
+    j->track = track;
+    j->total = total;
+    for (int c = 0; c < PROGRESS_COUNTERS; c++) store(&j->count[c], c == (int)track ? done : 0);
+    j->done = done;
+    j->stamp = now_seconds();
+    j->rate = j->smoothed = 0;
+    j->eta = -1;
+    j->sampled = 0;
+    unlock_jobs();
+}
+
+void progress_grow(struct progress_job *j, unsigned long long n) {
+    if (!j) return;
+    lock_jobs();
+    j->total += n;
+    unlock_jobs();
+}
+
+void progress_add(struct progress_job *j, enum progress_counter c, unsigned long long n) {
+    if (!j) return;
+#if defined(_WIN32)
+    InterlockedExchangeAdd64((volatile LONG64 *)&j->count[c], (LONG64)n);
+#else
+    __atomic_fetch_add(&j->count[c], n, __ATOMIC_RELAXED);
+#endif
+}
+
+void progress_job_end(struct progress_job *j, const char *status) {
+    if (!j) return;
+    lock_jobs();
+    j->status = status;
+    unlock_jobs();
+}
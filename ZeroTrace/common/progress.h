@@ -0,0 +1,52 @@
+// progress.h
+// Live progress for long wipes. I/O loops only add finished bytes to a
+// job's counters; a reporter thread samples every job on a fixed interval
+// and reports bytes done, instantaneous and smoothed throughput, the current
+// pass and an ETA: as a line on stdout, as one JSON object per job per tick
+// on a file descriptor, and as a Prometheus textfile (node_exporter's
+// textfile collector) replaced atomically on every tick.
+
+#ifndef ZT_PROGRESS_H
+#define ZT_PROGRESS_H
+
+#define PROGRESS_MAX_JOBS 64
+
+// What a phase counts; the ETA follows the phase's tracked counter.
+enum progress_counter {
+    PROGRESS_WRITTEN,
+    PROGRESS_VERIFIED,
+    PROGRESS_SCANNED,
+    PROGRESS_COUNTERS
+};
+
+struct progress_opts {
+    double interval;        // seconds between reports
+    int human;              // print "... MB written (MB/s, ETA)" lines on stdout
+    int json_fd;            // JSON lines go here; -1 for none
+    const char *prom_path;  // Prometheus textfile; NULL for none
+};
+
+struct progress_job;
+
+// Start the reporter thread. Returns 0, or -1 (reported). Until it is
+// started, progress_job_add returns NULL and every call below ignores NULL.
+int progress_start(const struct progress_opts *o);
+// Report every job one last time and stop the reporter.
+void progress_stop(void);
+
+// Register a device. tag prefixes its human-readable lines ("" for none).
+struct progress_job *progress_job_add(const char *device, const char *tag);
+// Begin a phase ("write", "verify", "scan", ...) of pass/passes (0/0 when
+// the run has no passes), covering total bytes with done already behind it.
+// Resets every counter; the tracked one starts at done.
+void progress_phase(struct progress_job *j, const char *phase, int pass, int passes,
+                    enum progress_counter track, unsigned long long total, unsigned long long done);
+// Add n bytes to the phase's total, for phases that find their work as
+// they go (file trees). Safe from any thread.
+void progress_grow(struct progress_job *j, unsigned long long n);
+// Count n finished bytes. Safe from any thread; takes no lock.
+void progress_add(struct progress_job *j, enum progress_counter c, unsigned long long n);
+// The job finished with status ("OK" or a failure reason).
+void progress_job_end(struct progress_job *j, const char *status);
+
+#endif
@@ -1,25 +1,66 @@
 // purgeTrace.c
 // WARNING: Destructive. Run as Administrator. Usage:
-//   purgeTrace.exe <PhysicalDriveNumber> <VolumeLetter|NONE> [--test|--purge]
+//   purgeTrace.exe <PhysicalDriveNumber> <VolumeLetter|NONE> [--test|--purge] [--verify]
+//                  [--resume] [--journal FILE]
 //
 // Example:
 //   purgeTrace.exe 1 D --purge
+//   purgeTrace.exe 1 D --purge --verify
+//   purgeTrace.exe 1 D --purge --resume
+//
+// Build (MinGW):
+//   gcc -O2 -o purgeTrace.exe eff_purge.c common/journal.c common/pattern.c common/memcheck.c common/cpu.c -lbcrypt
 
 #include <windows.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "common/journal.h"
+#include "common/pattern.h"
+
 #define BUF_SIZE (64*1024*1024) // 64 MiB
 #define PASSES 3
+#define CHECKPOINT_BYTES (1024ULL * 1024 * 1024) // journal interval within a pass
 
 void usage(const char *prog) {
-    printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE> [--test|--purge]\n", prog);
+    printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE> [--test|--purge] [--verify]\n", prog);
+    printf("       [--resume] [--journal FILE]\n");
     printf("Example: %s 1 D --purge\n", prog);
+    printf("  --verify : read every pass back before the next and compare it with its pattern;\n");
+    printf("             random passes are regenerated from their key\n");
+    printf("  --resume : continue an interrupted purge from its journal (pass, offset and key)\n");
+    printf("  --journal FILE : journal location (default zerotrace-<serial>.journal here)\n");
 }
 
-void fill_random(BYTE *buf, size_t size) {
-    for (size_t i = 0; i < size; i++) buf[i] = (BYTE)(rand() % 256);
+// Read back [0, len) and compare it with what the pass wrote. Returns 1 if
+// it all matches, 0 on a mismatch (*bad_off set), -1 on a read error, 4
+// when Ctrl-C stopped it. *checked receives the bytes confirmed.
+int verify_pass(HANDLE hDrive, BYTE *buf, const struct pass_pattern *pat, unsigned long long len,
+                unsigned long long *checked, unsigned long long *bad_off) {
+    LARGE_INTEGER offset = {0};
+    *checked = 0;
+    if (!SetFilePointerEx(hDrive, offset, NULL, FILE_BEGIN)) return -1;
+    while (*checked < len) {
+        if (journal_interrupted()) return 4;
+        DWORD want = (len - *checked < BUF_SIZE) ? (DWORD)(len - *checked) : (DWORD)BUF_SIZE;
+        DWORD got = 0;
+        if (!ReadFile(hDrive, buf, want, &got, NULL) || got == 0) {
+            fprintf(stderr, "ReadFile failed at offset %llu (err=%lu)\n", *checked, GetLastError());
+            return -1;
+        }
+        size_t i = pass_check(pat, *checked, buf, got);
+        if (i < got) {
+            *bad_off = *checked + i;
+            fprintf(stderr, "Verify fail at offset %llu (0x%02X)\n", *bad_off, buf[i]);
+            *checked += i;
+            return 0;
+        }
+        *checked += got;
+        if ((*checked - got) / (256ULL * 1024 * 1024) != *checked / (256ULL * 1024 * 1024))
+            printf("... %llu MB verified\n", *checked / (1024 * 1024));
+    }
+    return 1;
 }
 
 int main(int argc, char **argv) {
@@ -30,7 +71,9 @@ int main(int argc, char **argv) {
 
     const char *driveNumStr = argv[1];
     const char *volArg = argv[2];
-    int testMode = 0, purgeMode = 0;
+    int testMode = 0, purgeMode = 0, verifyMode = 0, resumeMode = 0;
+    const char *journalPath = NULL;
+    int failed = 0;
 
     if (strcmp(argv[3], "--test") == 0) testMode = 1;
     else if (strcmp(argv[3], "--purge") == 0) purgeMode = 1;
@@ -38,6 +81,11 @@ int main(int argc, char **argv) {
         usage(argv[0]);
         return 1;
     }
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--verify") == 0) verifyMode = 1;
+        else if (strcmp(argv[i], "--resume") == 0) resumeMode = 1;
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) journalPath = argv[++i];
+    }
 
     char physicalPath[64];
     snprintf(physicalPath, sizeof(physicalPath), "\\\\.\\PhysicalDrive%s", driveNumStr);
@@ -46,6 +94,7 @@ int main(int argc, char **argv) {
     if (strcmp(volArg, "NONE") != 0) printf("Volume to lock/dismount: %s:\n", volArg);
 
     printf("Mode: %s\n", testMode ? "TEST (1 MiB)" : (purgeMode ? "PURGE (multi-pass)" : "OVERWRITE"));
+    if (purgeMode) printf("Verify each pass: %s\n", verifyMode ? "YES" : "NO");
 
     printf("Type the word 'CONFIRM' (uppercase) to proceed: ");
     char confirm[64];
@@ -57,7 +106,7 @@ int main(int argc, char **argv) {
     }
 
     HANDLE hDrive = CreateFileA(physicalPath,
-                                GENERIC_WRITE,
+                                GENERIC_READ | GENERIC_WRITE,
                                 FILE_SHARE_READ | FILE_SHARE_WRITE,
                                 NULL,
                                 OPEN_EXISTING,
@@ -87,32 +136,162 @@ int main(int argc, char **argv) {
         } else printf("[TEST] %u bytes written.\n", written);
         FlushFileBuffers(hDrive);
     } else if (purgeMode) {
-        BYTE patterns[PASSES] = {0x00, 0xFF, 0xAA};
+        BYTE patterns[PASSES] = {0x00, 0xFF, 0xAA};   // 0xAA = random
+        struct pass_pattern pats[PASSES];
+        unsigned long long written_by[PASSES] = {0}, checked_by[PASSES] = {0}, bad_at[PASSES] = {0};
+        int verdict[PASSES] = {0};   // 1 ok, 0 mismatch, -1 read error, 2 not verified,
+                                     // 3 done before --resume, 4 interrupted
         unsigned long long total = 0;
 
+        // Journal: which pass, how far it is durable, and its key, tied to
+        // this drive's size and serial.
+        struct journal jr;
+        memset(&jr, 0, sizeof(jr));
+        char serial[sizeof(jr.serial)];
+        journal_drive_identity(hDrive, &jr.size, serial, sizeof(serial));
+        unsigned long long driveSize = jr.size;
+        if (journalPath) snprintf(jr.path, sizeof(jr.path), "%s", journalPath);
+        else journal_default_path(jr.path, sizeof(jr.path), physicalPath, serial);
+        int firstPass = 0, interrupted = 0;
+        unsigned long long resumeAt = 0;
+        if (resumeMode) {
+            int lr = journal_load(&jr);
+            if (lr < 0) {
+                failed = 1;
+                goto out;
+            }
+            if (lr > 0) {
+                printf("No journal at %s; starting from pass 1\n", jr.path);
+            } else if (!journal_matches(&jr, driveSize, serial) || jr.pass > PASSES) {
+                fprintf(stderr, "Journal %s is for another drive (%llu bytes, serial '%s'); not resuming\n",
+                        jr.path, jr.size, jr.serial);
+                failed = 1;
+                goto out;
+            } else {
+                firstPass = jr.pass - 1;
+                resumeAt = jr.offset;
+                printf("[PURGE] Resuming pass %d at %llu MB from %s\n", jr.pass, resumeAt / (1024 * 1024), jr.path);
+            }
+        }
+        snprintf(jr.device, sizeof(jr.device), "%s", physicalPath);
+        snprintf(jr.serial, sizeof(jr.serial), "%s", serial);
+        jr.size = driveSize;
+        journal_catch_signals();
+
         for (int pass = 0; pass < PASSES; pass++) {
-            printf("[PURGE] Pass %d: writing pattern 0x%02X\n", pass + 1, patterns[pass]);
-            if (patterns[pass] == 0xAA) fill_random((BYTE *)buf, BUF_SIZE);
-            else memset(buf, patterns[pass], BUF_SIZE);
+            struct pass_pattern *pat = &pats[pass];
+            memset(pat, 0, sizeof(*pat));
+            pat->byte = patterns[pass];
+            pat->random = patterns[pass] == 0xAA;
+            verdict[pass] = pass < firstPass ? 3 : 2;
+            if (pass < firstPass || interrupted) continue;
+            unsigned long long start = pass == firstPass ? resumeAt : 0;
+            if (pat->random && start && jr.has_key) {
+                // A resumed random pass continues the stream it started.
+                pat->key = jr.key;
+                char hex[2 * PATTERN_KEY_SIZE + 1];
+                pattern_key_hex(&pat->key, hex);
+                printf("[PURGE] Pass %d: continuing random data, key %s (from journal)\n", pass + 1, hex);
+            } else if (pat->random) {
+                start = 0;
+                printf("[PURGE] Pass %d: writing random data (ChaCha20, %s)\n", pass + 1, pattern_impl());
+                if (pattern_key_generate(&pat->key) != 0) {
+                    fprintf(stderr, "No system random source available; skipping pass %d\n", pass + 1);
+                    continue;
+                }
+                // Logged so the pass can be re-checked from the key later.
+                char hex[2 * PATTERN_KEY_SIZE + 1];
+                pattern_key_hex(&pat->key, hex);
+                printf("[PURGE] Pass %d key: %s\n", pass + 1, hex);
+            } else {
+                printf("[PURGE] Pass %d: writing pattern 0x%02X\n", pass + 1, patterns[pass]);
+                pass_fill(pat, 0, buf, BUF_SIZE);
+            }
+
+            // Checkpoint the start of the pass, key included, before writing.
+            jr.pass = pass + 1;
+            jr.has_key = pat->random;
+            jr.key = pat->key;
+            jr.offset = start;
+            journal_save(&jr);
 
-            LARGE_INTEGER offset = {0};
+            LARGE_INTEGER offset;
+            offset.QuadPart = (LONGLONG)start;
             SetFilePointerEx(hDrive, offset, NULL, FILE_BEGIN);
 
             DWORD written;
-            total = 0;
-            while (WriteFile(hDrive, buf, BUF_SIZE, &written, NULL) && written > 0) {
+            total = start;
+            unsigned long long since_checkpoint = 0;
+            for (;;) {
+                if (journal_interrupted()) {
+                    interrupted = 1;
+                    break;
+                }
+                // Random data is generated for each chunk's own offset.
+                if (pat->random) pass_fill(pat, total, buf, BUF_SIZE);
+                if (!WriteFile(hDrive, buf, BUF_SIZE, &written, NULL) || written == 0) break;
                 total += written;
-                if ((total % (256ULL * 1024 * 1024)) == 0)
+                if ((total - written) / (256ULL * 1024 * 1024) != total / (256ULL * 1024 * 1024))
                     printf("... %llu MB written\n", total / (1024 * 1024));
+                since_checkpoint += written;
+                if (since_checkpoint >= CHECKPOINT_BYTES) {
+                    FlushFileBuffers(hDrive);
+                    jr.offset = total;
+                    journal_save(&jr);
+                    since_checkpoint = 0;
+                }
             }
             FlushFileBuffers(hDrive);
+            written_by[pass] = total;
+            if (interrupted) {
+                jr.offset = total;
+                journal_save(&jr);
+                verdict[pass] = 4;
+                printf("[PURGE] Interrupted at %llu MB; checkpoint kept in %s. Run again with --resume.\n",
+                       total / (1024 * 1024), jr.path);
+                continue;
+            }
+
+            if (verifyMode) {
+                printf("[PURGE] Pass %d: verifying...\n", pass + 1);
+                verdict[pass] = verify_pass(hDrive, (BYTE *)buf, pat, total, &checked_by[pass], &bad_at[pass]);
+                if (verdict[pass] == 4) {
+                    // The pass is written; a resume only reads it back.
+                    interrupted = 1;
+                    jr.offset = total;
+                    journal_save(&jr);
+                    printf("[PURGE] Verify interrupted at %llu MB; checkpoint kept in %s. Run again with --resume.\n",
+                           checked_by[pass] / (1024 * 1024), jr.path);
+                }
+            }
+        }
+        if (!interrupted) {
+            journal_remove(&jr);
+            printf("[PURGE] Multi-pass overwrite complete. Total bytes written: %llu\n", total);
+        }
+
+        printf("\n%-6s %-8s %12s %12s  %s\n", "Pass", "Pattern", "Written MB", "Verified MB", "Result");
+        for (int pass = 0; pass < PASSES; pass++) {
+            char name[8], res[48];
+            if (pats[pass].random) snprintf(name, sizeof(name), "Random");
+            else snprintf(name, sizeof(name), "0x%02X", pats[pass].byte);
+            if (verdict[pass] == 1) snprintf(res, sizeof(res), "OK");
+            else if (verdict[pass] == 0) snprintf(res, sizeof(res), "MISMATCH at %llu", bad_at[pass]);
+            else if (verdict[pass] == -1) snprintf(res, sizeof(res), "READ ERROR");
+            else if (verdict[pass] == 3) snprintf(res, sizeof(res), "done before resume");
+            else if (verdict[pass] == 4) snprintf(res, sizeof(res), "INTERRUPTED");
+            else snprintf(res, sizeof(res), written_by[pass] ? "not verified" : "not written");
+            printf("%-6d %-8s %12llu %12llu  %s\n", pass + 1, name,
+                   written_by[pass] / (1024 * 1024), checked_by[pass] / (1024 * 1024), res);
+            if (verdict[pass] == 0 || verdict[pass] == -1 || verdict[pass] == 4) failed = 1;
+            if (!written_by[pass] && verdict[pass] != 3) failed = 1;
         }
-        printf("[PURGE] Multi-pass overwrite complete. Total bytes written: %llu\n", total);
     }
 
+out:
     VirtualFree(buf, 0, MEM_RELEASE);
     CloseHandle(hDrive);
 
     printf("Done. Recovery from typical forensic tools is now extremely unlikely.\n");
-    return 0;
+    return failed ? 1 : 0;
 }
@@ -1,8 +1,19 @@
+// purge.c
+// Three-pass overwrite (0x00, 0xFF, random) of a physical drive. Progress is
+// checkpointed to a journal so an interrupted purge can continue (--resume).
+// Build (MinGW):
+//   gcc -O2 -o purge.exe purge.c common/badrange.c common/journal.c common/pattern.c common/progress.c common/latency.c common/memcheck.c common/cpu.c -lbcrypt
+
 #include <windows.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+
+#include "common/badrange.h"
+#include "common/journal.h"
+#include "common/latency.h"
+#include "common/pattern.h"
+#include "common/progress.h"
 
 #ifndef CTL_CODE
 #define CTL_CODE(DeviceType, Function, Method, Access) (                 \
@@ -29,57 +40,314 @@
 
 #define BUF_SIZE (512 * 1024) // 512 KB buffer
 
-void overwrite_pass(HANDLE hDrive, BYTE pattern, int pass) {
+#define PASSES 3
+// Journal checkpoint interval within a pass.
+#define CHECKPOINT_BYTES (1024ULL * 1024 * 1024)
+#define DEFAULT_PROGRESS_SECONDS 2.0
+#define DEFAULT_HEATMAP_REGION_MB 1024
+// Failed requests are retried and bisected down to the sector; a drive with
+// more than this many bad bytes is given up on.
+#define DEFAULT_MAX_BAD_MB 256
+
+// Outcome of one pass, reported together at the end.
+struct pass_result {
+    int pass;
+    struct pass_pattern pat;
+    unsigned long long written;
+    unsigned long long verified;
+    int verify;                 // 0 not run, 1 ok, -1 mismatch, -2 read error
+    unsigned long long bad_off;
+    BYTE bad_byte;
+    int skipped;                // finished before a --resume, not run again
+    int interrupted;            // stopped at a checkpoint by Ctrl-C
+    // Of written: bytes given up on as bad. Of verified: bytes that could
+    // not be read, and unwritable bytes stepped over.
+    unsigned long long unwritable, unreadable, holes;
+};
+
+static struct bad_list *g_bad;      // sectors given up on, over every pass
+static unsigned g_sector = 512;
+
+static unsigned get_sector_size(HANDLE hDrive) {
+    DISK_GEOMETRY g;
+    DWORD returned = 0;
+    if (DeviceIoControl(hDrive, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0, &g, sizeof(g), &returned, NULL) &&
+        g.BytesPerSector)
+        return g.BytesPerSector;
+    return 512;
+}
+
+// Retrying a failed request: positioned reads or writes on the drive handle.
+struct salvage_io {
+    struct bad_io x;
+    HANDLE h;
+    const struct pass_pattern *pat;
+};
+
+static int salvage_transfer(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len) {
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)off;
+    ov.OffsetHigh = (DWORD)(off >> 32);
+    DWORD n = 0;
+    HANDLE h = ((struct salvage_io *)x)->h;
+    BOOL ok = x->kind == BAD_WRITE ? WriteFile(h, buf, (DWORD)len, &n, &ov) : ReadFile(h, buf, (DWORD)len, &n, &ov);
+    if (!ok) return (int)GetLastError();
+    return n == len ? 0 : x->kind == BAD_WRITE ? ERROR_WRITE_FAULT : ERROR_READ_FAULT;
+}
+
+// An unreadable hole gets the pattern so the check passes over it.
+static void salvage_lost(struct bad_io *x, void *buf, unsigned long long off, unsigned long long len) {
+    if (x->kind == BAD_READ) pass_fill(((struct salvage_io *)x)->pat, off, buf, (size_t)len);
+}
+
+// The request of len bytes at off failed. Retry and bisect it, then move
+// the file pointer past it. Returns the bytes given up on, or -1 to stop.
+static long long salvage(HANDLE h, enum bad_kind kind, const struct pass_pattern *pat, BYTE *buf,
+                         unsigned long long off, DWORD len) {
+    struct salvage_io s;
+    memset(&s, 0, sizeof(s));
+    s.x.transfer = salvage_transfer;
+    s.x.lost = salvage_lost;
+    s.x.list = g_bad;
+    s.x.kind = kind;
+    s.x.sector = g_sector;
+    s.h = h;
+    s.pat = pat;
+    unsigned long long lost = 0;
+    if (bad_salvage(&s.x, buf, off, len, &lost) != 0) {
+        fprintf(stderr, "Too many bad sectors; giving up\n");
+        return -1;
+    }
+    LARGE_INTEGER next;
+    next.QuadPart = (LONGLONG)(off + len);
+    if (!SetFilePointerEx(h, next, NULL, FILE_BEGIN)) return -1;
+    if (lost)
+        fprintf(stderr, "%llu of %lu bytes at offset %llu could not be %s; carrying on\n", lost, len, off,
+                kind == BAD_WRITE ? "written" : "read");
+    return (long long)lost;
+}
+
+// Index of the first unexpected byte read back at off. Sectors already
+// known to be unwritable hold old data and are stepped over; *holes
+// receives their length.
+static size_t check_read(const struct pass_pattern *pat, unsigned long long off, const BYTE *buf, size_t len,
+                         unsigned long long *holes) {
+    size_t pos = 0;
+    for (;;) {
+        size_t i = pos + pass_check(pat, off + pos, buf + pos, len - pos);
+        if (i >= len) return i;
+        unsigned long long end = bad_list_covering(g_bad, BAD_WRITE, off + i);
+        if (!end) return i;
+        pos = end - off < len ? (size_t)(end - off) : len;
+        *holes += pos - i;
+    }
+}
+
+static const char *pass_name(const struct pass_result *r, char *tmp, size_t n) {
+    if (r->pat.random) return "Random";
+    snprintf(tmp, n, "0x%02X", r->pat.byte);
+    return tmp;
+}
+
+// Write the pass from byte `start` (0, or the journal's durable offset on
+// resume) to the end of the drive, checkpointing to jr along the way.
+// Request latencies go to lr when it is not NULL.
+void overwrite_pass(HANDLE hDrive, struct pass_result *r, unsigned long long start, struct journal *jr,
+                    struct progress_job *pj, struct lat_rec *lr) {
     BYTE *buf = (BYTE *)malloc(BUF_SIZE);
     DWORD written;
     LARGE_INTEGER pos;
     DWORD err;
+    char tmp[8];
 
     if (!buf) {
         fprintf(stderr, "Memory allocation failed\n");
         exit(1);
     }
 
-    if (pattern == 0xAA) { // Random pass
-        srand((unsigned)time(NULL));
-        for (size_t i = 0; i < BUF_SIZE; i++) buf[i] = rand() % 256;
-    } else {
-        memset(buf, pattern, BUF_SIZE);
-    }
+    // Random passes generate each chunk for its own offset, so no two
+    // chunks on the drive carry the same data.
+    if (!r->pat.random) pass_fill(&r->pat, 0, buf, BUF_SIZE);
 
-    pos.QuadPart = 0;
+    pos.QuadPart = (LONGLONG)start;
     if (!SetFilePointerEx(hDrive, pos, NULL, FILE_BEGIN)) {
-        fprintf(stderr, "[PASS %d] SetFilePointerEx failed (err=%lu)\n", pass, GetLastError());
+        fprintf(stderr, "[PASS %d] SetFilePointerEx failed (err=%lu)\n", r->pass, GetLastError());
         free(buf);
         return;
     }
 
-    size_t total = 0;
+    unsigned long long total = start, since_checkpoint = 0;
+    progress_phase(pj, "write", r->pass, PASSES, PROGRESS_WRITTEN, jr->size, start);
     while (1) {
-        if (!WriteFile(hDrive, buf, BUF_SIZE, &written, NULL)) {
+        if (journal_interrupted()) {
+            r->interrupted = 1;
+            break;
+        }
+        if (r->pat.random) pass_fill(&r->pat, total, buf, BUF_SIZE);
+        unsigned long long t0 = lr ? lat_now_ns() : 0;
+        // With the drive size known, the last write is sized to fit and a
+        // failed write is salvaged; otherwise the first failure is the end.
+        if (jr->size && total >= jr->size) break;
+        DWORD len = jr->size && jr->size - total < BUF_SIZE ? (DWORD)(jr->size - total) : BUF_SIZE;
+        long long lost = 0;
+        if (!WriteFile(hDrive, buf, len, &written, NULL)) {
             err = GetLastError();
             if (err == ERROR_HANDLE_EOF) break;
-            fprintf(stderr, "[PASS %d] WriteFile failed (err=%lu)\n", pass, err);
-            break;
+            fprintf(stderr, "[PASS %d] WriteFile failed at offset %llu (err=%lu)\n", r->pass, total, err);
+            if (!jr->size) break;
+            lost = salvage(hDrive, BAD_WRITE, &r->pat, buf, total, len);
+            if (lost < 0) break;
+            r->unwritable += (unsigned long long)lost;
+            written = len;
         }
         if (written == 0) break;
+        if (lr) lat_record(lr, total, written, lat_now_ns() - t0);
         total += written;
+        since_checkpoint += written;
+        progress_add(pj, PROGRESS_WRITTEN, written - (DWORD)lost);
+        if (since_checkpoint >= CHECKPOINT_BYTES) {
+            FlushFileBuffers(hDrive);
+            jr->offset = total;
+            journal_save(jr);
+            since_checkpoint = 0;
+        }
+    }
+    r->written = total;
+    if (r->interrupted) {
+        // Final checkpoint: everything written so far is made durable first.
+        FlushFileBuffers(hDrive);
+        jr->offset = total;
+        journal_save(jr);
+        printf("[PASS %d] Interrupted at %llu MB; checkpoint kept in %s. Run again with --resume.\n",
+               r->pass, total / (1024 * 1024), jr->path);
+        free(buf);
+        return;
     }
 
-    printf("[PASS %d] Pattern %s complete (%zu MB)\n",
-           pass,
-           (pattern == 0x00 ? "0x00" :
-            pattern == 0xFF ? "0xFF" : "Random"),
-           total / (1024 * 1024));
+    printf("[PASS %d] Pattern %s complete (%llu MB)\n",
+           r->pass, pass_name(r, tmp, sizeof(tmp)), total / (1024 * 1024));
+
+    free(buf);
+}
+
+// Read back everything the pass wrote and compare it with the pass's
+// pattern. Random data is regenerated from the key, never stored. Ctrl-C
+// stops it at the next read with r->interrupted set.
+void verify_pass(HANDLE hDrive, struct pass_result *r, struct progress_job *pj, struct lat_rec *lr) {
+    BYTE *buf = (BYTE *)malloc(BUF_SIZE);
+    LARGE_INTEGER pos;
+
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    r->verify = -2;
+    pos.QuadPart = 0;
+    if (!SetFilePointerEx(hDrive, pos, NULL, FILE_BEGIN)) {
+        fprintf(stderr, "[PASS %d] SetFilePointerEx failed (err=%lu)\n", r->pass, GetLastError());
+        free(buf);
+        return;
+    }
+
+    unsigned long long done = 0;
+    r->verify = 1;
+    progress_phase(pj, "verify", r->pass, PASSES, PROGRESS_VERIFIED, r->written, 0);
+    while (done < r->written) {
+        if (journal_interrupted()) {
+            r->interrupted = 1;
+            r->verify = 0;
+            break;
+        }
+        DWORD want = (r->written - done < BUF_SIZE) ? (DWORD)(r->written - done) : BUF_SIZE;
+        DWORD got = 0;
+        unsigned long long t0 = lr ? lat_now_ns() : 0;
+        long long lost = 0;
+        if (!ReadFile(hDrive, buf, want, &got, NULL) || got == 0) {
+            fprintf(stderr, "[PASS %d] ReadFile failed at offset %llu (err=%lu)\n", r->pass, done, GetLastError());
+            lost = salvage(hDrive, BAD_READ, &r->pat, buf, done, want);
+            if (lost < 0) {
+                r->verify = -2;
+                break;
+            }
+            r->unreadable += (unsigned long long)lost;
+            got = want;
+        }
+        if (lr) lat_record(lr, done, got, lat_now_ns() - t0);
+        unsigned long long holes = 0;
+        size_t i = check_read(&r->pat, done, buf, got, &holes);
+        r->holes += holes;
+        if (i < got) {
+            r->verify = -1;
+            r->bad_off = done + i;
+            r->bad_byte = buf[i];
+            fprintf(stderr, "[PASS %d] Verify fail at offset %llu (0x%02X)\n", r->pass, r->bad_off, r->bad_byte);
+            done += i;
+            break;
+        }
+        done += got;
+        progress_add(pj, PROGRESS_VERIFIED, got - (DWORD)lost - holes);
+    }
+    r->verified = done;
+    if (r->verify == 1) printf("[PASS %d] Verified %llu MB\n", r->pass, done / (1024 * 1024));
 
     free(buf);
 }
 
 int main(int argc, char *argv[]) {
     if (argc < 3) {
-        printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE>\n", argv[0]);
+        printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE> [--verify] [--resume] [--journal FILE]\n", argv[0]);
+        printf("       [--progress-interval SEC] [--progress-fd N] [--prom FILE] [--latency] [--heatmap-region MB]\n");
+        printf("       [--max-bad MB] [--bad-log FILE]\n");
+        printf("  --verify : read each pass back before the next one and compare it with the\n");
+        printf("             pattern; random passes are regenerated from their key\n");
+        printf("  --resume : continue from the last checkpoint in the journal (pass, offset and key)\n");
+        printf("  --journal FILE : journal location (default zerotrace-<serial>.journal here)\n");
+        printf("  --progress-interval SEC : how often progress is reported (default %.0f)\n", DEFAULT_PROGRESS_SECONDS);
+        printf("  --progress-fd N : also write progress as JSON lines to file descriptor N\n");
+        printf("  --prom FILE : keep a Prometheus textfile with the progress figures\n");
+        printf("  --latency : time every request and print per-pass latency histograms and a\n");
+        printf("             heatmap of throughput across the drive at the end, listing unusually\n");
+        printf("             slow regions as suspect media\n");
+        printf("  --heatmap-region MB : bytes of the drive per heatmap cell (default %d)\n", DEFAULT_HEATMAP_REGION_MB);
+        printf("  --max-bad MB : sectors that still fail after retries are skipped and listed; give\n");
+        printf("             up once more than this much is bad (default %d)\n", DEFAULT_MAX_BAD_MB);
+        printf("  --bad-log FILE : append the bad ranges to FILE (drive offset length kind error)\n");
         return 1;
     }
+    int verifyMode = 0, resumeMode = 0, latencyMode = 0;
+    unsigned long long heatmapRegion = DEFAULT_HEATMAP_REGION_MB * 1024ULL * 1024;
+    unsigned long long maxBad = DEFAULT_MAX_BAD_MB * 1024ULL * 1024;
+    const char *badLog = NULL;
+    const char *journalPath = NULL;
+    struct progress_opts popts = {DEFAULT_PROGRESS_SECONDS, 1, -1, NULL};
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--verify") == 0) verifyMode = 1;
+        else if (strcmp(argv[i], "--resume") == 0) resumeMode = 1;
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) journalPath = argv[++i];
+        else if (strcmp(argv[i], "--progress-interval") == 0 && i + 1 < argc) popts.interval = atof(argv[++i]);
+        else if (strcmp(argv[i], "--progress-fd") == 0 && i + 1 < argc) popts.json_fd = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--prom") == 0 && i + 1 < argc) popts.prom_path = argv[++i];
+        else if (strcmp(argv[i], "--latency") == 0) latencyMode = 1;
+        else if (strcmp(argv[i], "--bad-log") == 0 && i + 1 < argc) badLog = argv[++i];
+        else if (strcmp(argv[i], "--max-bad") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 1 || v > 1024 * 1024) {
+                fprintf(stderr, "Max bad must be between 1 and 1048576 MB\n");
+                return 1;
+            }
+            maxBad = (unsigned long long)v * 1024 * 1024;
+        }
+        else if (strcmp(argv[i], "--heatmap-region") == 0 && i + 1 < argc) {
+            long long v = atoll(argv[++i]);
+            if (v < 1 || v > 1024 * 1024) {
+                fprintf(stderr, "Heatmap region must be between 1 and 1048576 MB\n");
+                return 1;
+            }
+            heatmapRegion = (unsigned long long)v * 1024 * 1024;
+        }
+    }
 
     int driveNum = atoi(argv[1]);
     char volLetter = argv[2][0];
@@ -135,12 +403,163 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
-    overwrite_pass(hDrive, 0x00, 1);
-    overwrite_pass(hDrive, 0xFF, 2);
-    overwrite_pass(hDrive, 0xAA, 3);
+    // The journal identifies the drive by size and serial, so a resume can
+    // never continue on a different disk that took the same number.
+    struct journal jr;
+    memset(&jr, 0, sizeof(jr));
+    unsigned long long driveSize;
+    char serial[sizeof(jr.serial)];
+    journal_drive_identity(hDrive, &driveSize, serial, sizeof(serial));
+    if (journalPath) snprintf(jr.path, sizeof(jr.path), "%s", journalPath);
+    else journal_default_path(jr.path, sizeof(jr.path), drivePath, serial);
+
+    int firstPass = 1;
+    unsigned long long resumeAt = 0;
+    if (resumeMode) {
+        int lr = journal_load(&jr);
+        if (lr < 0) {
+            CloseHandle(hDrive);
+            return 1;
+        }
+        if (lr > 0) {
+            printf("No journal at %s; starting from pass 1\n", jr.path);
+        } else if (!journal_matches(&jr, driveSize, serial) || jr.pass > PASSES) {
+            fprintf(stderr, "Journal %s is for another drive (%llu bytes, serial '%s'); not resuming\n",
+                    jr.path, jr.size, jr.serial);
+            CloseHandle(hDrive);
+            return 1;
+        } else {
+            firstPass = jr.pass;
+            resumeAt = jr.offset;
+            printf("Resuming pass %d at %llu MB from %s\n", firstPass, resumeAt / (1024 * 1024), jr.path);
+        }
+    }
+    snprintf(jr.device, sizeof(jr.device), "%s", drivePath);
+    snprintf(jr.serial, sizeof(jr.serial), "%s", serial);
+    jr.size = driveSize;
+
+    g_bad = bad_list_new(maxBad);
+    if (!g_bad) {
+        fprintf(stderr, "Out of memory\n");
+        CloseHandle(hDrive);
+        return 1;
+    }
+    g_sector = get_sector_size(hDrive);
+
+    // Ctrl-C stops at the next write or read-back with a final checkpoint.
+    journal_catch_signals();
+    if (progress_start(&popts) != 0) {
+        CloseHandle(hDrive);
+        return 1;
+    }
+    struct progress_job *pj = progress_job_add(drivePath, "");
+    struct lat_log *lat = latencyMode ? lat_log_new(drivePath, driveSize, heatmapRegion) : NULL;
+
+    BYTE patterns[PASSES] = {0x00, 0xFF, 0xAA};   // 0xAA = random
+    struct pass_result results[PASSES];
+    int interrupted = 0;
+    memset(results, 0, sizeof(results));
+    for (int p = 0; p < PASSES; p++) {
+        struct pass_result *r = &results[p];
+        r->pass = p + 1;
+        r->pat.byte = patterns[p];
+        r->pat.random = (patterns[p] == 0xAA);
+        if (r->pass < firstPass) {
+            r->skipped = 1;
+            continue;
+        }
+        if (interrupted) continue;
+        int resumed = r->pass == firstPass && resumeAt > 0;
+        if (r->pat.random && resumed && jr.has_key) {
+            // The rest of the pass must continue the same stream.
+            r->pat.key = jr.key;
+            printf("[PASS %d] Random key (from journal): ", r->pass);
+        } else if (r->pat.random) {
+            // Fresh key per pass, logged so the pass can be re-checked later.
+            if (pattern_key_generate(&r->pat.key) != 0) {
+                fprintf(stderr, "[PASS %d] No system random source available\n", r->pass);
+                continue;
+            }
+            resumed = 0;
+            printf("[PASS %d] Random key: ", r->pass);
+        }
+        if (r->pat.random) {
+            char hex[2 * PATTERN_KEY_SIZE + 1];
+            pattern_key_hex(&r->pat.key, hex);
+            printf("%s\n", hex);
+        }
+
+        // Checkpoint the start of the pass (with its key) before writing.
+        jr.pass = r->pass;
+        jr.has_key = r->pat.random;
+        jr.key = r->pat.key;
+        jr.offset = resumed ? resumeAt : 0;
+        journal_save(&jr);
+
+        char phase[32];
+        snprintf(phase, sizeof(phase), "pass %d write", r->pass);
+        overwrite_pass(hDrive, r, jr.offset, &jr, pj, lat_log_phase(lat, phase));
+        if (r->interrupted) {
+            interrupted = 1;
+            continue;
+        }
+        snprintf(phase, sizeof(phase), "pass %d verify", r->pass);
+        if (verifyMode) verify_pass(hDrive, r, pj, lat_log_phase(lat, phase));
+        if (r->interrupted) {
+            // The pass is written; a resume only reads it back.
+            interrupted = 1;
+            jr.offset = r->written;
+            journal_save(&jr);
+            printf("[PASS %d] Verify interrupted at %llu MB; checkpoint kept in %s. Run again with --resume.\n",
+                   r->pass, r->verified / (1024 * 1024), jr.path);
+        }
+    }
+    if (!interrupted) journal_remove(&jr);
+    int mismatch = 0;
+    for (int p = 0; p < PASSES; p++) if (results[p].verify < 0) mismatch = 1;
+    int bad = bad_list_bytes(g_bad, BAD_WRITE) || bad_list_bytes(g_bad, BAD_READ);
+    progress_job_end(pj, interrupted ? "interrupted" : mismatch ? "verify failed" : bad ? "bad sectors" : "OK");
+    progress_stop();
+    lat_log_report(lat, stdout, "");
+    lat_log_free(lat);
 
     CloseHandle(hDrive);
 
+    int failed = 0;
+    printf("\n%-6s %-8s %12s %12s  %s\n", "Pass", "Pattern", "Written MB", "Verified MB", "Result");
+    for (int p = 0; p < PASSES; p++) {
+        const struct pass_result *r = &results[p];
+        char tmp[8], res[64];
+        if (r->skipped) snprintf(res, sizeof(res), "done before resume");
+        else if (r->interrupted) snprintf(res, sizeof(res), "INTERRUPTED");
+        else if (r->verify == 1) snprintf(res, sizeof(res), "OK");
+        else if (r->verify == -1) snprintf(res, sizeof(res), "MISMATCH at %llu (0x%02X)", r->bad_off, r->bad_byte);
+        else if (r->verify == -2) snprintf(res, sizeof(res), "READ ERROR");
+        else snprintf(res, sizeof(res), r->written ? "not verified" : "not written");
+        printf("%-6d %-8s %12llu %12llu  %s\n", r->pass, pass_name(r, tmp, sizeof(tmp)),
+               (r->written - r->unwritable) / (1024 * 1024),
+               (r->verified - r->unreadable - r->holes) / (1024 * 1024), res);
+        if (r->verify < 0 || r->interrupted || (r->written == 0 && !r->skipped)) failed = 1;
+    }
+    if (bad) {
+        // Every byte of every pass is written or unwritable, and when
+        // verified, verified, unreadable or stepped over as unwritable.
+        for (int p = 0; p < PASSES; p++) {
+            const struct pass_result *r = &results[p];
+            if (r->skipped || !r->written) continue;
+            printf("[PASS %d] Accounting: %llu bytes written, %llu unwritable", r->pass,
+                   r->written - r->unwritable, r->unwritable);
+            if (r->verify) printf("; %llu verified, %llu unreadable, %llu not checked (unwritable)",
+                                  r->verified - r->unreadable - r->holes, r->unreadable, r->holes);
+            printf("\n");
+        }
+        bad_list_report(g_bad, stdout, "");
+        if (badLog && bad_list_save(g_bad, badLog, drivePath) != 0)
+            fprintf(stderr, "Could not write the bad-range log %s\n", badLog);
+        failed = 1;
+    }
+    bad_list_free(g_bad);
+
     printf("Purge operation completed.\n");
-    return 0;
+    return failed ? 1 : 0;
 }
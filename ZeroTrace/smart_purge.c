@@ -1,12 +1,17 @@
 // smartPurgeTrace.c
 // WARNING: destructive. Run as Administrator. Usage:
-//   smartPurgeTrace.exe <PhysicalDriveNumber> <VolumeLetter|NONE>
+//   smartPurgeTrace.exe <PhysicalDriveNumber> <VolumeLetter|NONE> [--verify]
+//                       [--progress-interval SEC] [--progress-fd N] [--prom FILE]
 //
 // Example:
 //   smartPurgeTrace.exe 1 D
+//   smartPurgeTrace.exe 1 D --verify
 //
 // Performs selective multi-pass overwrite (Purge-like).
 // Skips empty blocks, overwrites only those with non-zero data.
+//
+// Build (MinGW):
+//   gcc -O2 -o smartPurgeTrace.exe smart_purge.c common/pattern.c common/progress.c common/memcheck.c common/cpu.c -lbcrypt
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <windows.h>
@@ -15,24 +20,37 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "common/memcheck.h"
+#include "common/pattern.h"
+#include "common/progress.h"
+
 #define BUF_SIZE (64*1024*1024) // 64 MB buffer
 #define PASSES 3
+#define DEFAULT_PROGRESS_SECONDS 2.0
 
 // Print usage instructions
 void usage(const char *prog) {
-    printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE>\n", prog);
+    printf("Usage: %s <PhysicalDriveNumber> <VolumeLetter|NONE> [--verify]\n", prog);
+    printf("       [--progress-interval SEC] [--progress-fd N] [--prom FILE]\n");
     printf("Example: %s 1 D\n", prog);
+    printf("  --verify : read each pass back and compare it with its pattern; the random\n");
+    printf("             pass is regenerated from its key\n");
+    printf("  --progress-interval SEC : how often progress is reported (default %.0f)\n", DEFAULT_PROGRESS_SECONDS);
+    printf("  --progress-fd N : also write progress as JSON lines to file descriptor N\n");
+    printf("  --prom FILE : keep a Prometheus textfile with the progress figures\n");
 }
 
-// Simple pseudo-random fill
-void fill_random(BYTE *buf, size_t size) {
-    for (size_t i=0; i<size; i++) buf[i] = (BYTE)(rand() % 256);
-}
+// Per-pass totals across all purged blocks.
+typedef struct {
+    unsigned long long written, verified;
+    unsigned long long bad_blocks;
+    unsigned long long first_bad;   // drive offset of the first wrong byte
+    unsigned long long read_errors;
+} PASS_STATS;
 
 // Check if buffer has any non-zero byte
 int is_nonzero(BYTE *buf, size_t size) {
-    for (size_t i=0; i<size; i++) if (buf[i] != 0) return 1;
-    return 0;
+    return !mem_is_zero(buf, size);
 }
 
 int main(int argc, char **argv) {
@@ -40,6 +58,14 @@ int main(int argc, char **argv) {
 
     const char *driveNumStr = argv[1];
     const char *volArg = argv[2];
+    int verifyMode = 0;
+    struct progress_opts popts = {DEFAULT_PROGRESS_SECONDS, 1, -1, NULL};
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--verify") == 0) verifyMode = 1;
+        else if (strcmp(argv[i], "--progress-interval") == 0 && i + 1 < argc) popts.interval = atof(argv[++i]);
+        else if (strcmp(argv[i], "--progress-fd") == 0 && i + 1 < argc) popts.json_fd = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--prom") == 0 && i + 1 < argc) popts.prom_path = argv[++i];
+    }
 
     char physicalPath[64];
     snprintf(physicalPath, sizeof(physicalPath), "\\\\.\\PhysicalDrive%s", driveNumStr);
@@ -94,7 +120,36 @@ int main(int argc, char **argv) {
     unsigned long long totalBlocks = (driveSizeBytes + BUF_SIZE - 1) / BUF_SIZE;
     printf("Drive size: %llu bytes, total blocks: %llu\n", driveSizeBytes, totalBlocks);
 
-    BYTE patterns[PASSES] = {0x00, 0xFF, 0xAA};
+    BYTE patterns[PASSES] = {0x00, 0xFF, 0xAA};   // 0xAA = random
+    struct pass_pattern pats[PASSES];
+    PASS_STATS stats[PASSES];
+    memset(pats, 0, sizeof(pats));
+    memset(stats, 0, sizeof(stats));
+    for (int pass=0; pass<PASSES; pass++) {
+        pats[pass].byte = patterns[pass];
+        pats[pass].random = patterns[pass] == 0xAA;
+        if (!pats[pass].random) continue;
+        // One key for the whole run; every block gets distinct random data.
+        // Logged so the pass can be re-checked from the key later.
+        char hex[2 * PATTERN_KEY_SIZE + 1];
+        if (pattern_key_generate(&pats[pass].key) != 0) {
+            fprintf(stderr,"No system random source available\n");
+            VirtualFree(buf,0,MEM_RELEASE);
+            CloseHandle(hDrive);
+            return 1;
+        }
+        pattern_key_hex(&pats[pass].key, hex);
+        printf("Pass %d random key: %s\n", pass+1, hex);
+    }
+
+    // Passes run block by block, so progress follows the sweep over the drive.
+    if (progress_start(&popts) != 0) {
+        VirtualFree(buf,0,MEM_RELEASE);
+        CloseHandle(hDrive);
+        return 1;
+    }
+    struct progress_job *pj = progress_job_add(physicalPath, "");
+    progress_phase(pj, "purge", 0, 0, PROGRESS_SCANNED, driveSizeBytes, 0);
 
     LARGE_INTEGER offset = {0};
     for (unsigned long long blk=0; blk<totalBlocks; blk++) {
@@ -109,6 +164,7 @@ int main(int argc, char **argv) {
         if (!is_nonzero((BYTE*)buf, readBytes)) {
             // Skip block if empty
             offset.QuadPart += readBytes;
+            progress_add(pj, PROGRESS_SCANNED, readBytes);
             continue;
         }
 
@@ -116,8 +172,8 @@ int main(int argc, char **argv) {
 
         // Multi-pass overwrite
         for (int pass=0; pass<PASSES; pass++) {
-            if (patterns[pass] == 0xAA) fill_random((BYTE*)buf, readBytes);
-            else memset(buf, patterns[pass], readBytes);
+            PASS_STATS *st = &stats[pass];
+            pass_fill(&pats[pass], offset.QuadPart, buf, readBytes);
 
             SetFilePointerEx(hDrive, offset, NULL, FILE_BEGIN);
             DWORD written = 0;
@@ -125,14 +181,56 @@ int main(int argc, char **argv) {
                 fprintf(stderr,"WriteFile failed at block %llu, pass %d\n", blk, pass+1);
             }
             FlushFileBuffers(hDrive);
+            st->written += written;
+            progress_add(pj, PROGRESS_WRITTEN, written);
+            if (!verifyMode) continue;
+
+            // Read the block back before the next pass overwrites it.
+            SetFilePointerEx(hDrive, offset, NULL, FILE_BEGIN);
+            DWORD got = 0;
+            if (!ReadFile(hDrive, buf, readBytes, &got, NULL) || got != readBytes) {
+                fprintf(stderr,"Verify ReadFile failed at block %llu, pass %d\n", blk, pass+1);
+                st->read_errors++;
+                continue;
+            }
+            size_t i = pass_check(&pats[pass], offset.QuadPart, buf, got);
+            if (i < got) {
+                unsigned long long at = offset.QuadPart + i;
+                fprintf(stderr,"Verify fail at offset %llu (0x%02X), pass %d\n", at, ((BYTE*)buf)[i], pass+1);
+                if (!st->bad_blocks) st->first_bad = at;
+                st->bad_blocks++;
+            }
+            st->verified += got;
+            progress_add(pj, PROGRESS_VERIFIED, got);
         }
 
         offset.QuadPart += readBytes;
+        progress_add(pj, PROGRESS_SCANNED, readBytes);
     }
 
     VirtualFree(buf, 0, MEM_RELEASE);
     CloseHandle(hDrive);
 
+    int failed = 0;
+    for (int pass=0; pass<PASSES; pass++)
+        if (stats[pass].bad_blocks || stats[pass].read_errors) failed = 1;
+    progress_job_end(pj, failed ? "verify failed" : "OK");
+    progress_stop();
+    if (verifyMode) {
+        printf("\n%-6s %-8s %12s %12s  %s\n", "Pass", "Pattern", "Written MB", "Verified MB", "Result");
+        for (int pass=0; pass<PASSES; pass++) {
+            PASS_STATS *st = &stats[pass];
+            char name[8], res[64];
+            if (pats[pass].random) snprintf(name, sizeof(name), "Random");
+            else snprintf(name, sizeof(name), "0x%02X", pats[pass].byte);
+            if (st->bad_blocks) snprintf(res, sizeof(res), "MISMATCH in %llu block(s), first at %llu", st->bad_blocks, st->first_bad);
+            else if (st->read_errors) snprintf(res, sizeof(res), "%llu READ ERROR(S)", st->read_errors);
+            else snprintf(res, sizeof(res), "OK");
+            printf("%-6d %-8s %12llu %12llu  %s\n", pass+1, name,
+                   st->written / (1024*1024), st->verified / (1024*1024), res);
+        }
+    }
+
     printf("Selective multi-pass purge complete. Recovery extremely unlikely.\n");
-    return 0;
+    return failed ? 1 : 0;
 }
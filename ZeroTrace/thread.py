@@ -48,11 +48,12 @@ def run_wiper(drive_num: int, vol_letter: str = "NONE", extra_args: list = None,
     logger.info(f"Starting wipe on PhysicalDrive{drive_num} (Volume {vol_letter}) with command: {' '.join(cmd)}")
 
     try:
+        # No timeout: a full-disk wipe of a large drive legitimately runs for
+        # many hours, and killing it part-way leaves the drive half wiped.
         result = subprocess.run(
             cmd,
             text=True,
-            capture_output=True,
-            timeout=3600  # 1-hour timeout to prevent hanging
+            capture_output=True
         )
         success = result.returncode == 0
         output = result.stdout if result.stdout else ""
@@ -63,9 +64,6 @@ def run_wiper(drive_num: int, vol_letter: str = "NONE", extra_args: list = None,
         else:
             logger.error(f"Wipe failed on PhysicalDrive{drive_num} (return code: {result.returncode})")
         return drive_num, success, output
-    except subprocess.TimeoutExpired:
-        logger.error(f"Wipe timed out on PhysicalDrive{drive_num}")
-        return drive_num, False, "Process timed out"
     except Exception as e:
         logger.error(f"Failed on PhysicalDrive{drive_num}: {e}")
         return drive_num, False, str(e)